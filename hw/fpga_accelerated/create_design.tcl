@@ -4,12 +4,36 @@
 # Used for FPGA PL accelerated CNN inference
 ################################################################################
 
+# Accelerator data path:
+#   0: S_AXI_HP0, not coherent; the driver flushes/invalidates each map
+#   1: S_AXI_ACP, snooped by the SCU; build the software with CNN_ACCEL_USE_ACP=1
+# ACP reads/writes are coherent when AxCACHE[1] and AxUSER[0] are set: the
+# HLS masters issue AxCACHE=0011, the PS drives AxUSER (DEFAULT_ACP_USER_VAL).
+set use_acp 0
+if {$use_acp} {
+    set data_port S_AXI_ACP
+    set data_seg  ACP_DDR_LOWOCM
+} else {
+    set data_port S_AXI_HP0
+    set data_seg  HP0_DDR_LOWOCM
+}
+
+# Live video: camera preprocessing IP (hls/script.tcl: export camera) writing
+# frames into the accelerator's input map. Its video_in AXI4-Stream is made
+# external for the sensor pipeline or a VDMA MM2S channel to drive (on
+# FCLK_CLK0; a camera on its own clock needs an AXI4-Stream clock converter).
+set use_camera 0
+
 # Create project
 create_project fpga_accel_design ./fpga_accel_design -part xc7z020clg484-1
 set_property board_part digilentinc.com:zedboard:part0:1.0 [current_project]
 
 # Add HLS IP repository
-set_property ip_repo_paths ../hls/ip_export [current_project]
+if {$use_camera} {
+    set_property ip_repo_paths [list ../hls/ip_export ../hls/ip_output_camera] [current_project]
+} else {
+    set_property ip_repo_paths ../hls/ip_export [current_project]
+}
 update_ip_catalog
 
 # Create block design
@@ -23,9 +47,13 @@ apply_bd_automation -rule xilinx.com:bd_rule:processing_system7 \
 # Configure PS: Enable AXI GP + HP ports, UART, clocks
 set_property -dict [list \
     CONFIG.PCW_USE_M_AXI_GP0 {1} \
-    CONFIG.PCW_USE_S_AXI_HP0 {1} \
+    CONFIG.PCW_USE_S_AXI_HP0 [expr {!$use_acp}] \
+    CONFIG.PCW_USE_S_AXI_ACP $use_acp \
+    CONFIG.PCW_USE_DEFAULT_ACP_USER_VAL $use_acp \
     CONFIG.PCW_UART1_PERIPHERAL_ENABLE {1} \
     CONFIG.PCW_FPGA0_PERIPHERAL_FREQMHZ {100} \
+    CONFIG.PCW_USE_FABRIC_INTERRUPT {1} \
+    CONFIG.PCW_IRQ_F2P_INTR {1} \
 ] [get_bd_cells ps7]
 
 ################################################################################
@@ -46,17 +74,44 @@ connect_bd_intf_net [get_bd_intf_pins axi_ctrl/M00_AXI] \
                     [get_bd_intf_pins cnn_accel_0/s_axi_control]
 
 ################################################################################
-# AXI Interconnect for Data (AXI Master: CNN Accel m_axi_data → PS HP0 → DDR)
+# AXI Interconnect for Data (AXI Master: CNN Accel m_axi_data → PS HP0/ACP → DDR)
 ################################################################################
 create_bd_cell -type ip -vlnv xilinx.com:ip:axi_interconnect:2.1 axi_data
 set_property CONFIG.NUM_SI {1} [get_bd_cells axi_data]
 set_property CONFIG.NUM_MI {1} [get_bd_cells axi_data]
 
-# CNN Accel m_axi_data → AXI Interconnect → PS S_AXI_HP0 (DDR access)
+# CNN Accel m_axi_data → AXI Interconnect → PS S_AXI_HP0 or S_AXI_ACP (DDR access)
 connect_bd_intf_net [get_bd_intf_pins cnn_accel_0/m_axi_data] \
                     [get_bd_intf_pins axi_data/S00_AXI]
 connect_bd_intf_net [get_bd_intf_pins axi_data/M00_AXI] \
-                    [get_bd_intf_pins ps7/S_AXI_HP0]
+                    [get_bd_intf_pins ps7/$data_port]
+
+################################################################################
+# Camera Preprocessing IP (optional): control on a second axi_ctrl master,
+# frames into DDR through a second axi_data slave; the driver polls ap_done
+################################################################################
+if {$use_camera} {
+    create_bd_cell -type ip -vlnv xilinx.com:hls:camera_preprocess:1.0 camera_pre_0
+    set_property CONFIG.NUM_MI {2} [get_bd_cells axi_ctrl]
+    set_property CONFIG.NUM_SI {2} [get_bd_cells axi_data]
+
+    connect_bd_intf_net [get_bd_intf_pins axi_ctrl/M01_AXI] \
+                        [get_bd_intf_pins camera_pre_0/s_axi_control]
+    connect_bd_intf_net [get_bd_intf_pins camera_pre_0/m_axi_data] \
+                        [get_bd_intf_pins axi_data/S01_AXI]
+    make_bd_intf_pins_external [get_bd_intf_pins camera_pre_0/video_in]
+
+    connect_bd_net [get_bd_pins ps7/FCLK_CLK0] \
+                   [get_bd_pins camera_pre_0/ap_clk] \
+                   [get_bd_pins axi_ctrl/M01_ACLK] \
+                   [get_bd_pins axi_data/S01_ACLK]
+}
+
+################################################################################
+# Interrupt (CNN Accel ap_done → PS IRQ_F2P[0], GIC ID 61)
+################################################################################
+connect_bd_net [get_bd_pins cnn_accel_0/interrupt] \
+               [get_bd_pins ps7/IRQ_F2P]
 
 ################################################################################
 # Clock and Reset connections
@@ -71,7 +126,7 @@ connect_bd_net [get_bd_pins ps7/FCLK_CLK0] \
                [get_bd_pins axi_data/S00_ACLK] \
                [get_bd_pins axi_data/M00_ACLK] \
                [get_bd_pins ps7/M_AXI_GP0_ACLK] \
-               [get_bd_pins ps7/S_AXI_HP0_ACLK]
+               [get_bd_pins ps7/${data_port}_ACLK]
 
 # Reset
 create_bd_cell -type ip -vlnv xilinx.com:ip:proc_sys_reset:5.0 rst_ps7
@@ -88,6 +143,12 @@ connect_bd_net [get_bd_pins rst_ps7/peripheral_aresetn] \
                [get_bd_pins axi_data/ARESETN] \
                [get_bd_pins axi_data/S00_ARESETN] \
                [get_bd_pins axi_data/M00_ARESETN]
+if {$use_camera} {
+    connect_bd_net [get_bd_pins rst_ps7/peripheral_aresetn] \
+                   [get_bd_pins camera_pre_0/ap_rst_n] \
+                   [get_bd_pins axi_ctrl/M01_ARESETN] \
+                   [get_bd_pins axi_data/S01_ARESETN]
+}
 
 ################################################################################
 # Address mapping
@@ -95,8 +156,14 @@ connect_bd_net [get_bd_pins rst_ps7/peripheral_aresetn] \
 # CNN Accel control registers: 0x43C00000
 assign_bd_address [get_bd_addr_segs cnn_accel_0/s_axi_control/reg0]
 
+# Camera control registers: CAMERA_CONTROL_BASE in sw/common/camera_ingest.h
+if {$use_camera} {
+    assign_bd_address -offset 0x40020000 -range 64K \
+        [get_bd_addr_segs camera_pre_0/s_axi_control/reg0]
+}
+
 # CNN Accel DDR access: full 512MB range
-assign_bd_address [get_bd_addr_segs ps7/S_AXI_HP0/HP0_DDR_LOWOCM]
+assign_bd_address [get_bd_addr_segs ps7/$data_port/$data_seg]
 
 ################################################################################
 # Validate, synthesize, implement
@@ -123,4 +190,12 @@ puts "Block Design Summary:"
 puts "  PS (ARM):  Cortex-A9 @ 667 MHz"
 puts "  PL (CNN):  HLS Accelerator @ 100 MHz"
 puts "  AXI-Lite:  PS GP0 -> CNN Accel (control)"
-puts "  AXI HP0:   CNN Accel -> DDR (data)"
+if {$use_acp} {
+    puts "  AXI ACP:   CNN Accel -> SCU -> DDR (data, cache coherent)"
+} else {
+    puts "  AXI HP0:   CNN Accel -> DDR (data)"
+}
+puts "  IRQ_F2P:   CNN Accel ap_done -> GIC (ID 61)"
+if {$use_camera} {
+    puts "  Camera:    video_in (AXI4-Stream) -> preprocess -> DDR input map"
+}
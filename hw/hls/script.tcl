@@ -6,6 +6,11 @@
 #   vitis_hls -f script.tcl -tclargs csim    # C Simulation
 #   vitis_hls -f script.tcl -tclargs cosim   # RTL Co-Simulation
 #   vitis_hls -f script.tcl -tclargs export  # Export IP
+#   vitis_hls -f script.tcl -tclargs bench   # Per-layer cosim latency vs baseline
+#   vitis_hls -f script.tcl -tclargs bench update   # ... and store as the baseline
+#   vitis_hls -f script.tcl -tclargs <mode> int8    # Any mode, INT8 build (CNN_INT8=1)
+#   vitis_hls -f script.tcl -tclargs <mode> nowino  # Without an optional engine (also nolb, nores)
+#   vitis_hls -f script.tcl -tclargs <mode> camera  # Camera preprocessing IP (csim/synth/export)
 # ==============================================================================
 
 # Project configuration
@@ -19,17 +24,59 @@ set clock_period 10
 set script_dir [file dirname [info script]]
 set src_dir "$script_dir/src"
 set tb_dir "$script_dir/tb"
+set sw_dir "$script_dir/../../sw/common"
 
 # Parse command line argument
 set run_mode "synth"
 if {$argc > 0} {
     set run_mode [lindex $argv 0]
 }
+set bench_update [expr {[lsearch -exact [lrange $argv 1 end] "update"] >= 0}]
+
+# Number format: Q8.8 by default, INT8 in its own project and bench baseline
+set int8 [expr {[lsearch -exact [lrange $argv 1 end] "int8"] >= 0}]
+set cflags ""
+if {$int8} {
+    set project_name "${project_name}_int8"
+    set cflags "-DCNN_INT8=1"
+}
+
+# Optional engines (cnn_accel.h): drop one to fit the part, with its own
+# project, bench baseline and IP output
+set variant ""
+foreach {arg flag} {nolb CNN_LINE_BUFFER nowino CNN_WINOGRAD nores CNN_RESIDENT} {
+    if {[lsearch -exact [lrange $argv 1 end] $arg] >= 0} {
+        append variant "_$arg"
+        set cflags [string trim "$cflags -D$flag=0"]
+    }
+}
+set project_name "${project_name}$variant"
+
+# Camera preprocessing: same sources and testbench, its own top and project
+set camera [expr {[lsearch -exact [lrange $argv 1 end] "camera"] >= 0}]
+if {$camera} {
+    set project_name "${project_name}_camera"
+    set top_function "camera_preprocess_top"
+}
+
+# Bench: one cosim run per network layer (fpga_layers[] in sw/fpga_accelerated/main.c)
+set bench_layers 7
+set bench_dir [expr {$int8 ? "$script_dir/bench/int8" : "$script_dir/bench"}]
+set ip_dir [expr {$int8 ? "$script_dir/ip_output_int8" : "$script_dir/ip_output"}]
+if {$camera} {
+    set ip_dir "$script_dir/ip_output_camera"
+}
+set bench_dir "${bench_dir}$variant"
+set ip_dir "${ip_dir}$variant"
+set bench_latency_tol 0.02   ;# Relative latency increase that fails the bench
+set bench_snr_tol 0.5        ;# SNR drop (dB) that fails the bench
 
 puts "====================================="
 puts "CNN Accelerator HLS Build"
 puts "====================================="
 puts "Mode: $run_mode"
+puts "Top: $top_function"
+puts "Format: [expr {$int8 ? "INT8" : "Q8.8"}]"
 puts "Part: $part_name"
 puts "Clock: ${clock_period}ns (100MHz)"
 puts "====================================="
@@ -38,14 +85,18 @@ puts "====================================="
 open_project -reset $project_name
 
 # Add source files
-add_files "$src_dir/cnn_accel.h"
-add_files "$src_dir/cnn_accel.cpp"
-add_files "$src_dir/conv_layer.cpp"
-add_files "$src_dir/activation.cpp"
-add_files "$src_dir/pooling.cpp"
+add_files "$src_dir/cnn_accel.h" -cflags $cflags
+add_files "$src_dir/cnn_accel.cpp" -cflags $cflags
+add_files "$src_dir/conv_layer.cpp" -cflags $cflags
+add_files "$src_dir/activation.cpp" -cflags $cflags
+add_files "$src_dir/pooling.cpp" -cflags $cflags
+add_files "$src_dir/camera_preprocess.cpp" -cflags $cflags
+add_files "$src_dir/yolo_decode.cpp" -cflags $cflags
 
-# Add testbench
-add_files -tb "$tb_dir/tb_cnn_accel.cpp"
+# Add testbench (the camera and Q8.8 model tests compare against the ARM sources)
+add_files -tb "$tb_dir/tb_cnn_accel.cpp" -cflags $cflags
+add_files -tb "$sw_dir/image_preprocess.c"
+add_files -tb "$sw_dir/layers_q88.c" -cflags "-DLAYERS_Q88_KERNELS_ONLY"
 
 # Set top function
 set_top $top_function
@@ -64,6 +115,141 @@ config_compile -pipeline_loops 64
 config_interface -m_axi_alignment_byte_size 64
 config_interface -m_axi_max_widen_bitwidth 512
 
+# ------------------------------------------------------------------------------
+# Synthesis summary: resource usage and achieved II of the compute loops
+# ------------------------------------------------------------------------------
+proc xml_value {xml tag} {
+    if {[regexp "<$tag>(\[^<\]*)</$tag>" $xml -> value]} {
+        return $value
+    }
+    return "-"
+}
+
+proc report_synth_summary {project_name solution_name} {
+    set report_dir "$project_name/$solution_name/syn/report"
+    set top_xml "$report_dir/csynth.xml"
+    if {![file exists $top_xml]} {
+        puts "Synthesis report not found: $top_xml"
+        return
+    }
+    
+    set fp [open $top_xml r]
+    set xml [read $fp]
+    close $fp
+    
+    regexp {<AreaEstimates>.*?<Resources>(.*?)</Resources>} $xml -> used
+    regexp {<AvailableResources>(.*?)</AvailableResources>} $xml -> avail
+    
+    puts "\n====================================="
+    puts "Synthesis Summary"
+    puts "====================================="
+    foreach res {DSP BRAM_18K FF LUT} {
+        puts [format "  %-9s %7s / %s" $res [xml_value $used $res] [xml_value $avail $res]]
+    }
+    puts "  Est. clock: [xml_value $xml EstimatedClockPeriod] ns"
+    
+    # Per-loop II of the MAC array stage (target II=1 for COMPUTE_TILE)
+    set stage_xml "$report_dir/compute_stage_csynth.xml"
+    if {[file exists $stage_xml]} {
+        set fp [open $stage_xml r]
+        set sxml [read $fp]
+        close $fp
+        
+        # Loops nest in the XML; each <Name> is followed by its own fields
+        puts "  compute_stage loops:"
+        set chunks [split [string map {<Name> \x01} $sxml] \x01]
+        foreach chunk [lrange $chunks 1 end] {
+            if {[regexp {^([^<]+)</Name>} $chunk -> name] &&
+                [regexp {^[^\x01]*?<PipelineII>([^<]*)</PipelineII>} $chunk -> ii] &&
+                $ii ne "-"} {
+                puts [format "    %-40s II=%s" $name $ii]
+            }
+        }
+    }
+    puts "====================================="
+}
+
+# ------------------------------------------------------------------------------
+# Bench: per-layer cosim latency and testbench SNR/counters against a baseline
+# CSV columns: layer,latency,snr_db,saturated,compute_cycles,read_beats,write_beats
+# ------------------------------------------------------------------------------
+proc cosim_latency {project_name solution_name top_function} {
+    set rpt "$project_name/$solution_name/sim/report/${top_function}_cosim.rpt"
+    if {![file exists $rpt]} {
+        return -1
+    }
+    set fp [open $rpt r]
+    set text [read $fp]
+    close $fp
+    
+    # |   Verilog|      Pass|   min|   avg|   max| ...
+    if {[regexp {\|\s*Verilog\|\s*Pass\|\s*(\d+)\|\s*(\d+)\|\s*(\d+)\|} $text -> lat_min lat_avg lat_max]} {
+        return $lat_max
+    }
+    return -1
+}
+
+proc read_bench_csv {path} {
+    set rows [dict create]
+    set fp [open $path r]
+    set header [split [string trim [gets $fp]] ","]
+    while {[gets $fp line] >= 0} {
+        if {[string trim $line] eq ""} continue
+        set row [dict create]
+        foreach key $header value [split [string trim $line] ","] {
+            dict set row $key $value
+        }
+        dict set rows [dict get $row layer] $row
+    }
+    close $fp
+    return $rows
+}
+
+proc write_bench_csv {path rows} {
+    set columns {layer latency snr_db saturated compute_cycles read_beats write_beats}
+    set fp [open $path w]
+    puts $fp [join $columns ","]
+    foreach layer [lsort -integer [dict keys $rows]] {
+        set values {}
+        foreach key $columns {
+            lappend values [dict get [dict get $rows $layer] $key]
+        }
+        puts $fp [join $values ","]
+    }
+    close $fp
+}
+
+# Returns the number of layers that regressed
+proc compare_bench {latest baseline latency_tol snr_tol} {
+    set regressions 0
+    puts "\n====================================="
+    puts "Bench vs Baseline"
+    puts "====================================="
+    puts [format "  %-5s %10s %10s %7s %8s %8s" layer latency baseline delta snr_db base_snr]
+    foreach layer [lsort -integer [dict keys $latest]] {
+        set now [dict get $latest $layer]
+        set lat [dict get $now latency]
+        set snr [dict get $now snr_db]
+        if {![dict exists $baseline $layer]} {
+            puts [format "  L%-4s %10s %10s %7s %8s %8s" $layer $lat - - $snr -]
+            continue
+        }
+        set base [dict get $baseline $layer]
+        set base_lat [dict get $base latency]
+        set base_snr [dict get $base snr_db]
+        set delta [expr {$base_lat > 0 ? double($lat - $base_lat) / $base_lat : 0.0}]
+        set status ""
+        if {$lat < 0 || $delta > $latency_tol || $snr < $base_snr - $snr_tol} {
+            set status "  REGRESSION"
+            incr regressions
+        }
+        puts [format "  L%-4s %10s %10s %+6.1f%% %8s %8s%s" $layer $lat $base_lat \
+                  [expr {$delta * 100}] $snr $base_snr $status]
+    }
+    puts "====================================="
+    return $regressions
+}
+
 # Run based on mode
 switch $run_mode {
     "csim" {
@@ -73,6 +259,7 @@ switch $run_mode {
     "synth" {
         puts "\n>>> Running C Synthesis..."
         csynth_design
+        report_synth_summary $project_name $solution_name
     }
     "cosim" {
         puts "\n>>> Running C Synthesis..."
@@ -80,22 +267,66 @@ switch $run_mode {
         puts "\n>>> Running RTL Co-Simulation..."
         cosim_design -rtl verilog
     }
+    "bench" {
+        puts "\n>>> Running C Synthesis..."
+        csynth_design
+        file mkdir $bench_dir
+        set tb_report [file normalize "$bench_dir/tb_report.csv"]
+        file delete -force $tb_report
+        set latency [dict create]
+        
+        # One top-function transaction per cosim run, so the report is the layer's
+        for {set layer 0} {$layer < $bench_layers} {incr layer} {
+            puts "\n>>> RTL Co-Simulation of layer $layer..."
+            if {[catch {cosim_design -rtl verilog -argv "bench $layer $tb_report"} err]} {
+                puts "Co-simulation of layer $layer failed: $err"
+                dict set latency $layer -1
+            } else {
+                dict set latency $layer [cosim_latency $project_name $solution_name $top_function]
+            }
+        }
+        
+        set latest [dict create]
+        if {[file exists $tb_report]} {
+            set latest [read_bench_csv $tb_report]
+        }
+        foreach layer [dict keys $latency] {
+            if {![dict exists $latest $layer]} {
+                dict set latest $layer [dict create layer $layer snr_db 0 saturated - \
+                                        compute_cycles - read_beats - write_beats -]
+            }
+            dict set latest $layer latency [dict get $latency $layer]
+        }
+        write_bench_csv "$bench_dir/latest.csv" $latest
+        puts "Bench report: $bench_dir/latest.csv"
+        
+        set baseline_csv "$bench_dir/baseline.csv"
+        if {$bench_update || ![file exists $baseline_csv]} {
+            file copy -force "$bench_dir/latest.csv" $baseline_csv
+            puts "Baseline stored: $baseline_csv"
+        } elseif {[compare_bench $latest [read_bench_csv $baseline_csv] \
+                       $bench_latency_tol $bench_snr_tol] > 0} {
+            puts "Bench FAILED: throughput or accuracy regression"
+            exit 1
+        }
+    }
     "export" {
         puts "\n>>> Running C Synthesis..."
         csynth_design
         puts "\n>>> Exporting IP..."
-        export_design -rtl verilog -format ip_catalog -output "$script_dir/ip_output"
+        export_design -rtl verilog -format ip_catalog -output $ip_dir
     }
     "all" {
         puts "\n>>> Running Full Flow..."
         csim_design
         csynth_design
         cosim_design -rtl verilog
-        export_design -rtl verilog -format ip_catalog -output "$script_dir/ip_output"
+        export_design -rtl verilog -format ip_catalog -output $ip_dir
     }
     default {
         puts "\n>>> Running C Synthesis (default)..."
         csynth_design
+        report_synth_summary $project_name $solution_name
     }
 }
 
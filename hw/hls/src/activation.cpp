@@ -1,6 +1,6 @@
 /*******************************************************************************
  * CNN Accelerator - Activation Functions
- * LeakyReLU and Sigmoid implementations for HLS
+ * LeakyReLU, Sigmoid and Exp implementations for HLS
  ******************************************************************************/
 
 #include "cnn_accel.h"
@@ -36,61 +36,125 @@ data_t leaky_relu_hw(data_t x) {
 // Index 0 = sigmoid(-8), Index 255 = sigmoid(7.9375)
 static const data_t SIGMOID_LUT[256] = {
     // Generated from: sigmoid(i * 16/256 - 8)
-    0.0003, 0.0004, 0.0004, 0.0005, 0.0005, 0.0006, 0.0007, 0.0008,
-    0.0009, 0.0010, 0.0011, 0.0012, 0.0014, 0.0015, 0.0017, 0.0019,
-    0.0021, 0.0024, 0.0026, 0.0029, 0.0033, 0.0037, 0.0041, 0.0045,
-    0.0050, 0.0056, 0.0062, 0.0069, 0.0076, 0.0084, 0.0094, 0.0104,
-    0.0115, 0.0127, 0.0141, 0.0155, 0.0172, 0.0190, 0.0210, 0.0232,
-    0.0256, 0.0283, 0.0312, 0.0345, 0.0380, 0.0419, 0.0462, 0.0509,
-    0.0560, 0.0616, 0.0677, 0.0744, 0.0817, 0.0896, 0.0982, 0.1076,
-    0.1178, 0.1288, 0.1407, 0.1536, 0.1675, 0.1824, 0.1984, 0.2156,
-    0.2340, 0.2536, 0.2744, 0.2964, 0.3196, 0.3440, 0.3695, 0.3962,
-    0.4239, 0.4526, 0.4822, 0.5125, 0.5434, 0.5748, 0.6065, 0.6382,
-    0.6698, 0.7011, 0.7319, 0.7621, 0.7914, 0.8198, 0.8470, 0.8730,
-    0.8976, 0.9208, 0.9426, 0.9628, 0.9814, 0.9985, 0.9990, 0.9993,
-    0.9995, 0.9997, 0.9997, 0.9998, 0.9998, 0.9999, 0.9999, 0.9999,
-    0.9999, 0.9999, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    // Continued...
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000,
-    1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000
+    0.000335, 0.000357, 0.000380, 0.000404, 0.000431, 0.000458, 0.000488, 0.000519,
+    0.000553, 0.000588, 0.000626, 0.000667, 0.000710, 0.000755, 0.000804, 0.000856,
+    0.000911, 0.000970, 0.001032, 0.001099, 0.001170, 0.001245, 0.001325, 0.001410,
+    0.001501, 0.001598, 0.001701, 0.001810, 0.001927, 0.002051, 0.002183, 0.002323,
+    0.002473, 0.002632, 0.002801, 0.002981, 0.003173, 0.003377, 0.003594, 0.003824,
+    0.004070, 0.004332, 0.004610, 0.004905, 0.005220, 0.005555, 0.005911, 0.006290,
+    0.006693, 0.007121, 0.007577, 0.008062, 0.008577, 0.009126, 0.009708, 0.010328,
+    0.010987, 0.011687, 0.012432, 0.013223, 0.014064, 0.014957, 0.015906, 0.016915,
+    0.017986, 0.019124, 0.020332, 0.021615, 0.022977, 0.024423, 0.025957, 0.027585,
+    0.029312, 0.031144, 0.033086, 0.035145, 0.037327, 0.039639, 0.042088, 0.044681,
+    0.047426, 0.050331, 0.053403, 0.056652, 0.060087, 0.063715, 0.067547, 0.071591,
+    0.075858, 0.080357, 0.085099, 0.090093, 0.095349, 0.100879, 0.106691, 0.112795,
+    0.119203, 0.125923, 0.132964, 0.140336, 0.148047, 0.156105, 0.164516, 0.173288,
+    0.182426, 0.191933, 0.201813, 0.212069, 0.222700, 0.233706, 0.245085, 0.256832,
+    0.268941, 0.281406, 0.294215, 0.307358, 0.320821, 0.334589, 0.348645, 0.362969,
+    0.377541, 0.392337, 0.407333, 0.422505, 0.437823, 0.453262, 0.468791, 0.484380,
+    0.500000, 0.515620, 0.531209, 0.546738, 0.562177, 0.577495, 0.592667, 0.607663,
+    0.622459, 0.637031, 0.651355, 0.665411, 0.679179, 0.692642, 0.705785, 0.718594,
+    0.731059, 0.743168, 0.754915, 0.766294, 0.777300, 0.787931, 0.798187, 0.808067,
+    0.817574, 0.826712, 0.835484, 0.843895, 0.851953, 0.859664, 0.867036, 0.874077,
+    0.880797, 0.887205, 0.893309, 0.899121, 0.904651, 0.909907, 0.914901, 0.919643,
+    0.924142, 0.928409, 0.932453, 0.936285, 0.939913, 0.943348, 0.946597, 0.949669,
+    0.952574, 0.955319, 0.957912, 0.960361, 0.962673, 0.964855, 0.966914, 0.968856,
+    0.970688, 0.972415, 0.974043, 0.975577, 0.977023, 0.978385, 0.979668, 0.980876,
+    0.982014, 0.983085, 0.984094, 0.985043, 0.985936, 0.986777, 0.987568, 0.988313,
+    0.989013, 0.989672, 0.990292, 0.990874, 0.991423, 0.991938, 0.992423, 0.992879,
+    0.993307, 0.993710, 0.994089, 0.994445, 0.994780, 0.995095, 0.995390, 0.995668,
+    0.995930, 0.996176, 0.996406, 0.996623, 0.996827, 0.997019, 0.997199, 0.997368,
+    0.997527, 0.997677, 0.997817, 0.997949, 0.998073, 0.998190, 0.998299, 0.998402,
+    0.998499, 0.998590, 0.998675, 0.998755, 0.998830, 0.998901, 0.998968, 0.999030,
+    0.999089, 0.999144, 0.999196, 0.999245, 0.999290, 0.999333, 0.999374, 0.999412,
+    0.999447, 0.999481, 0.999512, 0.999542, 0.999569, 0.999596, 0.999620, 0.999643
 };
 
 data_t sigmoid_hw(data_t x) {
     #pragma HLS INLINE
     
-    // Clamp input to LUT range [-8, 8)
-    data_t clamped;
-    if (x < data_t(-8)) {
-        clamped = data_t(-8);
-    } else if (x >= data_t(8)) {
-        clamped = data_t(7.9375);
-    } else {
-        clamped = x;
+    // Nearest LUT index: (x + 8) * 16, rounded, in a type wide enough for
+    // any data_t input, clamped to the LUT range [-8, 8)
+    ap_fixed<24, 16> pos = (ap_fixed<24, 16>(x) + 8) * 16 + ap_fixed<24, 16>(0.5);
+    int index = pos.to_int();
+    if (index < 0) {
+        index = 0;
+    } else if (index > 255) {
+        index = 255;
     }
     
-    // Convert to LUT index: (x + 8) * 16 = (x + 8) << 4
-    // Index range: 0-255
-    ap_uint<8> index = ap_uint<8>((clamped + data_t(8)) * data_t(16));
-    
     return SIGMOID_LUT[index];
 }
 
+/*******************************************************************************
+ * Exponential (LUT-based, YOLO box decode)
+ * exp(x) = exp(floor(x)) * exp(frac(x)), exact for Q8.8 inputs
+ * 
+ * One table over the integer parts -8..7 and one over the 256 fractions,
+ * the same split as the ARM decoder's exp_q(); inputs clamp to [-8, 8)
+ ******************************************************************************/
+typedef ap_ufixed<18, 2> exp_frac_t;
+
+// Generated from: exp(i - 8)
+static const exp_t EXP_INT_LUT[16] = {
+    0.000335462628, 0.000911881966, 0.00247875218, 0.006737947,
+    0.0183156389, 0.0497870684, 0.135335283, 0.367879441,
+    1, 2.71828183, 7.3890561, 20.0855369,
+    54.59815, 148.413159, 403.428793, 1096.63316
+};
+
+// Generated from: exp(i / 256)
+static const exp_frac_t EXP_FRAC_LUT[256] = {
+    1.0000000, 1.0039139, 1.0078431, 1.0117877, 1.0157477, 1.0197232, 1.0237143, 1.0277210,
+    1.0317434, 1.0357815, 1.0398355, 1.0439053, 1.0479910, 1.0520927, 1.0562105, 1.0603444,
+    1.0644945, 1.0686608, 1.0728434, 1.0770424, 1.0812578, 1.0854897, 1.0897382, 1.0940033,
+    1.0982851, 1.1025837, 1.1068991, 1.1112314, 1.1155806, 1.1199469, 1.1243302, 1.1287307,
+    1.1331485, 1.1375835, 1.1420358, 1.1465056, 1.1509929, 1.1554978, 1.1600203, 1.1645605,
+    1.1691184, 1.1736942, 1.1782880, 1.1828996, 1.1875294, 1.1921772, 1.1968433, 1.2015276,
+    1.2062302, 1.2109513, 1.2156908, 1.2204489, 1.2252256, 1.2300210, 1.2348352, 1.2396682,
+    1.2445201, 1.2493910, 1.2542810, 1.2591901, 1.2641184, 1.2690661, 1.2740331, 1.2790195,
+    1.2840254, 1.2890510, 1.2940962, 1.2991611, 1.3042459, 1.3093505, 1.3144752, 1.3196199,
+    1.3247848, 1.3299698, 1.3351752, 1.3404009, 1.3456471, 1.3509138, 1.3562011, 1.3615091,
+    1.3668379, 1.3721876, 1.3775582, 1.3829498, 1.3883625, 1.3937964, 1.3992516, 1.4047281,
+    1.4102260, 1.4157455, 1.4212866, 1.4268493, 1.4324339, 1.4380403, 1.4436686, 1.4493189,
+    1.4549914, 1.4606861, 1.4664031, 1.4721424, 1.4779042, 1.4836885, 1.4894955, 1.4953253,
+    1.5011778, 1.5070532, 1.5129517, 1.5188732, 1.5248179, 1.5307859, 1.5367772, 1.5427920,
+    1.5488303, 1.5548922, 1.5609779, 1.5670874, 1.5732208, 1.5793782, 1.5855598, 1.5917655,
+    1.5979954, 1.6042498, 1.6105287, 1.6168321, 1.6231602, 1.6295131, 1.6358908, 1.6422935,
+    1.6487213, 1.6551742, 1.6616524, 1.6681559, 1.6746849, 1.6812394, 1.6878196, 1.6944255,
+    1.7010573, 1.7077151, 1.7143989, 1.7211088, 1.7278451, 1.7346077, 1.7413967, 1.7482123,
+    1.7550547, 1.7619237, 1.7688197, 1.7757427, 1.7826927, 1.7896700, 1.7966746, 1.8037066,
+    1.8107661, 1.8178532, 1.8249681, 1.8321108, 1.8392815, 1.8464802, 1.8537072, 1.8609624,
+    1.8682460, 1.8755581, 1.8828988, 1.8902682, 1.8976666, 1.9050938, 1.9125501, 1.9200356,
+    1.9275505, 1.9350947, 1.9426684, 1.9502718, 1.9579050, 1.9655680, 1.9732610, 1.9809841,
+    1.9887375, 1.9965212, 2.0043353, 2.0121801, 2.0200555, 2.0279618, 2.0358990, 2.0438673,
+    2.0518668, 2.0598976, 2.0679598, 2.0760535, 2.0841790, 2.0923362, 2.1005254, 2.1087466,
+    2.1170000, 2.1252857, 2.1336039, 2.1419545, 2.1503379, 2.1587541, 2.1672032, 2.1756854,
+    2.1842008, 2.1927495, 2.2013317, 2.2099475, 2.2185970, 2.2272803, 2.2359976, 2.2447491,
+    2.2535348, 2.2623549, 2.2712095, 2.2800987, 2.2890228, 2.2979818, 2.3069758, 2.3160051,
+    2.3250697, 2.3341697, 2.3433054, 2.3524768, 2.3616842, 2.3709276, 2.3802071, 2.3895230,
+    2.3988753, 2.4082642, 2.4176899, 2.4271525, 2.4366521, 2.4461889, 2.4557630, 2.4653746,
+    2.4750238, 2.4847107, 2.4944356, 2.5041986, 2.5139997, 2.5238392, 2.5337173, 2.5436340,
+    2.5535895, 2.5635839, 2.5736175, 2.5836904, 2.5938026, 2.6039545, 2.6141461, 2.6243776,
+    2.6346491, 2.6449608, 2.6553129, 2.6657055, 2.6761388, 2.6866129, 2.6971280, 2.7076843
+};
+
+exp_t exp_hw(data_t x) {
+    #pragma HLS INLINE
+    
+    // Clamped input shifted to [0, 16): integer part and the 8 fraction bits
+    ap_fixed<24, 16> pos = ap_fixed<24, 16>(x) + 8;
+    if (pos < 0) {
+        pos = 0;
+    } else if (pos >= 16) {
+        pos = ap_fixed<24, 16>(16) - ap_fixed<24, 16>(1.0 / 256);
+    }
+    int ip = pos.to_int();
+    int frac = ((pos - ip) * 256).to_int();
+    
+    return exp_t(EXP_INT_LUT[ip] * EXP_FRAC_LUT[frac]);
+}
+
 /*******************************************************************************
  * Batch Normalization + LeakyReLU (Fused)
  * out = leaky_relu(gamma * (x - mean) / sqrt(var + eps) + beta)
@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * CNN Accelerator - Camera Preprocessing
+ * Live-video front end, exported as its own IP (script.tcl: camera)
+ *
+ * An AXI4-Stream video feed (VDMA MM2S or a sensor pipeline) is resized,
+ * normalised to [0, 1] and converted to Q8.8 CHW on its way to DDR: the
+ * frame lands in the accelerator's input map with no ARM copy. Source rows
+ * stream into a two-row line buffer, and each output row is blended and
+ * written as soon as its lower source row has arrived (several rows per
+ * source row when upscaling), so a frame takes one pass over the stream.
+ *
+ * The arithmetic is preprocess_image()'s (sw/common/image_preprocess.c):
+ * corner-aligned 16.16 source coordinates, Q8 blend weights, vertical then
+ * horizontal blend and x 256/255 by shifts. Either path gives the same
+ * input map bit for bit.
+ ******************************************************************************/
+
+#include "cnn_accel.h"
+
+#define CAM_BLEND_BITS  8
+#define CAM_BLEND_ONE   (1 << CAM_BLEND_BITS)
+#define CAM_ROW_WORDS   (MAX_INPUT_SIZE / CAM_LANES)
+
+typedef ap_uint<24> rgb_t;
+
+// 16.16 step of the corner-aligned grid, per output row or column
+static unsigned cam_step(int src, int dst) {
+    #pragma HLS INLINE
+    return (dst > 1) ? ((unsigned)(src - 1) << 16) / (unsigned)(dst - 1) : 0;
+}
+
+// d * step in 16.16 to a Q8 source position, rounded
+static unsigned cam_pos(unsigned coord) {
+    #pragma HLS INLINE
+    return (coord + (1 << (15 - CAM_BLEND_BITS))) >> (16 - CAM_BLEND_BITS);
+}
+
+// Channel c (0: R, 1: G, 2: B) of a {R, B, G} video pixel
+static int cam_channel(rgb_t pix, int c) {
+    #pragma HLS INLINE
+    int lsb = (c == 0) ? 16 : (c == 1) ? 0 : 8;
+    return (int)((pix >> lsb) & 0xFF);
+}
+
+// Q16 pixel (0..255 << 16) to Q8.8 of pixel / 255: x 256/255 = 1 + 1/256 + 1/65536 + ...
+static ap_uint<16> cam_q16_to_q88(unsigned v) {
+    #pragma HLS INLINE
+    return (ap_uint<16>)((v + (v >> 8) + (v >> 16) + (1 << 15)) >> 16);
+}
+
+/*******************************************************************************
+ * One Output Row
+ * Blends source rows y0 (top) and y1 (bottom) of the line buffer into the
+ * three channel rows, then writes each as one burst of the pitched map. Pad
+ * columns are written as zero.
+ ******************************************************************************/
+static void emit_row(
+    rgb_t lines[2][CAM_MAX_SRC_WIDTH],
+    const ap_uint<11> x0_tab[MAX_INPUT_SIZE],
+    const ap_uint<11> x1_tab[MAX_INPUT_SIZE],
+    const ap_uint<8> fx_tab[MAX_INPUT_SIZE],
+    int y, int y0, int y1, int fy,
+    axi_data_t *input_fm,
+    int dst_width, int dst_height, int pitch
+) {
+    axi_data_t words[3][CAM_ROW_WORDS];
+    axi_data_t cur[3] = {0, 0, 0};
+
+    #pragma HLS ARRAY_PARTITION variable=words dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=cur complete
+
+    CAM_BLEND:
+    for (int x = 0; x < pitch; x++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT min=224 max=608
+        int xs = (x < dst_width) ? x : dst_width - 1;
+        int x0 = x0_tab[xs];
+        int x1 = x1_tab[xs];
+        int fx = fx_tab[xs];
+
+        // Both banks at both columns (two reads per bank), then pick the rows
+        rgb_t a0 = lines[0][x0], a1 = lines[0][x1];
+        rgb_t b0 = lines[1][x0], b1 = lines[1][x1];
+        rgb_t t0 = (y0 & 1) ? b0 : a0, t1 = (y0 & 1) ? b1 : a1;
+        rgb_t u0 = (y1 & 1) ? b0 : a0, u1 = (y1 & 1) ? b1 : a1;
+
+        CAM_CHANNELS:
+        for (int c = 0; c < 3; c++) {
+            #pragma HLS UNROLL
+            // r0 * (256 - f) + r1 * f as r0 * 256 + (r1 - r0) * f
+            int p00 = cam_channel(t0, c), p01 = cam_channel(t1, c);
+            int v0 = (p00 << CAM_BLEND_BITS) + (cam_channel(u0, c) - p00) * fy;
+            int v1 = (p01 << CAM_BLEND_BITS) + (cam_channel(u1, c) - p01) * fy;
+            unsigned v = (unsigned)((v0 << CAM_BLEND_BITS) + (v1 - v0) * fx);
+            axi_data_t q = (x < dst_width) ? axi_data_t(cam_q16_to_q88(v)) : axi_data_t(0);
+
+            // Lane 0 in the low bits: shift in from the top
+            cur[c] = (cur[c] >> 16) | (q << 48);
+            if ((x & (CAM_LANES - 1)) == CAM_LANES - 1) {
+                words[c][x / CAM_LANES] = cur[c];
+            }
+        }
+    }
+
+    CAM_WRITE_ROW:
+    for (int c = 0; c < 3; c++) {
+        int base = (c * dst_height + y) * (pitch / CAM_LANES);
+        CAM_WRITE_WORDS:
+        for (int i = 0; i < pitch / CAM_LANES; i++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=56 max=152
+            input_fm[base + i] = words[c][i];
+        }
+    }
+}
+
+/*******************************************************************************
+ * Top Level
+ ******************************************************************************/
+void camera_preprocess_top(
+    hls::stream<video_pixel_t> &video_in,
+    axi_data_t *input_fm,
+    int src_width,
+    int src_height,
+    int dst_width,
+    int dst_height,
+    volatile ap_uint<32> *dropped
+) {
+    #pragma HLS INTERFACE axis port=video_in
+    #pragma HLS INTERFACE m_axi port=input_fm offset=slave bundle=data depth=CAM_FM_DEPTH max_write_burst_length=64
+    #pragma HLS INTERFACE s_axilite port=input_fm bundle=control
+    #pragma HLS INTERFACE s_axilite port=src_width bundle=control
+    #pragma HLS INTERFACE s_axilite port=src_height bundle=control
+    #pragma HLS INTERFACE s_axilite port=dst_width bundle=control
+    #pragma HLS INTERFACE s_axilite port=dst_height bundle=control
+    #pragma HLS INTERFACE s_axilite port=dropped bundle=control
+    #pragma HLS INTERFACE s_axilite port=return bundle=control
+
+    static rgb_t lines[2][CAM_MAX_SRC_WIDTH];
+    ap_uint<11> x0_tab[MAX_INPUT_SIZE];
+    ap_uint<11> x1_tab[MAX_INPUT_SIZE];
+    ap_uint<8> fx_tab[MAX_INPUT_SIZE];
+
+    #pragma HLS BIND_STORAGE variable=lines type=ram_t2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=lines dim=1 complete
+
+    // The driver checks sizes; anything else leaves the stream untouched
+    if (src_width < 1 || src_width > CAM_MAX_SRC_WIDTH || src_height < 1 ||
+        src_height > CAM_MAX_SRC_HEIGHT || dst_width < 1 || dst_width > MAX_INPUT_SIZE ||
+        dst_height < 1 || dst_height > MAX_INPUT_SIZE) {
+        *dropped = 0;
+        return;
+    }
+    int pitch = (dst_width + CAM_LANES - 1) & ~(CAM_LANES - 1);
+
+    // Source column and weight of every output column, for the frame
+    unsigned xstep = cam_step(src_width, dst_width);
+    unsigned xcoord = 0;
+    CAM_X_TABLE:
+    for (int x = 0; x < dst_width; x++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT min=224 max=608
+        unsigned pos = cam_pos(xcoord);
+        int i = (int)(pos >> CAM_BLEND_BITS);
+        x0_tab[x] = i;
+        x1_tab[x] = (i + 1 < src_width) ? i + 1 : i;
+        fx_tab[x] = pos & (CAM_BLEND_ONE - 1);
+        xcoord += xstep;
+    }
+
+    // Skip to the start of a frame (tuser on its first pixel)
+    video_pixel_t pix;
+    ap_uint<32> skipped = 0;
+    CAM_WAIT_SOF:
+    do {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT min=0 max=0
+        pix = video_in.read();
+        if (!pix.user) {
+            skipped++;
+        }
+    } while (!pix.user);
+
+    unsigned ystep = cam_step(src_height, dst_height);
+    unsigned ycoord = 0;
+    int y = 0;
+
+    CAM_ROW_LOOP:
+    for (int r = 0; r < src_height; r++) {
+        #pragma HLS LOOP_TRIPCOUNT min=480 max=720
+        // Lines are counted by src_width (tlast is not checked)
+        CAM_READ_ROW:
+        for (int x = 0; x < src_width; x++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=640 max=1280
+            if (r != 0 || x != 0) {
+                pix = video_in.read();
+            }
+            lines[r & 1][x] = pix.data;
+        }
+
+        // Every output row whose bottom source row is r; its top row is r or r - 1
+        CAM_EMIT_ROWS:
+        while (y < dst_height) {
+            #pragma HLS LOOP_TRIPCOUNT min=0 max=2
+            unsigned pos = cam_pos(ycoord);
+            int y0 = (int)(pos >> CAM_BLEND_BITS);
+            int y1 = (y0 + 1 < src_height) ? y0 + 1 : y0;
+            if (y1 != r) {
+                break;
+            }
+            emit_row(lines, x0_tab, x1_tab, fx_tab, y, y0, y1, (int)(pos & (CAM_BLEND_ONE - 1)),
+                     input_fm, dst_width, dst_height, pitch);
+            y++;
+            ycoord += ystep;
+        }
+    }
+
+    *dropped = skipped;
+}
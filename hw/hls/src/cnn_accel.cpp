@@ -6,41 +6,2013 @@
  * to fit within the Zedboard's limited BRAM resources.
  * 
  * Memory Strategy:
- * - Feature maps: Stored in DDR, processed tile-by-tile
+ * - Feature maps: Stored in DDR (row-pitched, see FM_PITCH), processed tile-by-tile
  * - Weights: Streamed from DDR per layer
  * - On-chip: Only tile buffers (small) and line buffers for conv
+ *
+ * Pipeline Structure (DATAFLOW):
+ *   load_stage  --in/weight streams-->  compute_stage  --acc stream-->  store_stage
+ * Each stream is one full tile deep and forms the second half of a ping-pong
+ * pair with the consumer's local tile buffer, so the DDR fetch of tile N+1
+ * and the writeback of tile N-1 overlap the MAC loop of tile N.
  ******************************************************************************/
 
 #include "cnn_accel.h"
 
 // Optimized tile sizes to fit in BRAM
-// Each tile: TILE_H x TILE_W x TILE_CH = 14 x 14 x 32 = 6272 elements = 12.5 KB
+// Each tile: TILE_H x TILE_W x TILE_CH = 14 x 16 x 32 = 7168 elements = 14 KB
+// TILE_W is a multiple of AXI_LANES so output tiles start on a 64-bit word
 #define TILE_H      14
-#define TILE_W      14
+#define TILE_W      16
 #define TILE_CH     32
 
 // Small on-chip buffers (total ~100 KB BRAM)
-#define INPUT_TILE_SIZE   (TILE_CH * (TILE_H + 2) * (TILE_W + 2))  // With padding
+#define INPUT_TILE_SIZE   (TILE_CH * (TILE_H + 2) * FM_PITCH(TILE_W + 2))  // With padding
 #define OUTPUT_TILE_SIZE  (TILE_CH * TILE_H * TILE_W)
 #define WEIGHT_BUF_SIZE   (TILE_CH * TILE_CH * 9)  // 3x3 kernel
 
+// Stationary caches: the tile buffers are sized to hold several IC tiles so
+// that one operand can stay on chip while the other is swept past it.
+// Weight-stationary: all IC tiles of one OC tile (up to 128 input channels at 3x3)
+// Input-stationary:  all IC tiles of one spatial tile (e.g. L4/L5/L6)
+#define WEIGHT_CACHE_SIZE (WEIGHT_BUF_SIZE * 4)
+#define INPUT_CACHE_SIZE  (INPUT_TILE_SIZE * 4)
+
+// MAC array banking: each lane of the PARALLEL_OUT_CH x PARALLEL_IN_CH array
+// reads its own bank, holding TILE_CH / PARALLEL_*_CH channel slots per IC tile
+#define IC_SLOTS          (TILE_CH / PARALLEL_IN_CH)
+#define INPUT_BANK_SIZE   (INPUT_CACHE_SIZE / PARALLEL_IN_CH)
+#define WEIGHT_BANK_SIZE  (WEIGHT_CACHE_SIZE / (PARALLEL_OUT_CH * PARALLEL_IN_CH))
+#define ACC_BANK_SIZE     (OUTPUT_TILE_SIZE / PARALLEL_OUT_CH)
+
+/*******************************************************************************
+ * Layer Parameters
+ * Derived once per layer in the top function and passed to every stage
+ ******************************************************************************/
+struct LayerParams {
+    int layer_type;
+    int in_channels, out_channels;
+    int in_height, in_width;
+    int kernel_size, stride, padding;
+    int out_height, out_width;
+    int in_pitch, out_pitch;    // DDR row pitch (elements) of input/output maps
+    int in_words, w_words;      // DDR extent (64-bit words) of input/weights
+    int out_words;              // DDR extent of the output (after the optional pool)
+    int batch;                  // Images, in_words / out_words apart in DDR
+    int oc_tiles, ic_tiles, oh_tiles, ow_tiles;
+    int mode;          // Resolved DATAFLOW_* mode
+    int in_block;      // Input cache stride between IC tiles (input-stationary)
+    int w_block;       // Weight cache stride between IC tiles (weight-stationary)
+};
+
+// Four accumulators moved per cycle from compute to store
+struct acc_vec_t {
+    acc_t v[AXI_LANES];
+};
+
+/*******************************************************************************
+ * Activity Counters
+ * Issue slots of the II=1 loops, summed over one start and returned through
+ * the perf_* registers: MAC array cycles, and 64-bit beats on the read
+ * (feature maps, weights) and write ports. Against the start-to-done cycles
+ * measured by the ARM, whatever a port did not fill is stall or fill/drain.
+ ******************************************************************************/
+struct PerfCounts {
+    int compute;
+    int read;
+    int write;
+};
+
+/*******************************************************************************
+ * Tile Schedule
+ * All three stages walk the same tile order; each keeps its own cursor.
+ ******************************************************************************/
+struct TileCursor {
+    int oc_t, oh_t, ow_t;
+};
+
+struct TileBounds {
+    int oc_start, oc_count;
+    int oh_start, oh_count;
+    int ow_start, ow_count;
+};
+
+static void advance_tile(TileCursor &c, const LayerParams &p) {
+    #pragma HLS INLINE
+    
+    if (p.mode == DATAFLOW_INPUT_STATIONARY) {
+        // Spatial tiles outer, OC tiles inner
+        if (++c.oc_t == p.oc_tiles) {
+            c.oc_t = 0;
+            if (++c.ow_t == p.ow_tiles) {
+                c.ow_t = 0;
+                c.oh_t++;
+            }
+        }
+    } else {
+        // OC tiles outer, spatial tiles inner
+        if (++c.ow_t == p.ow_tiles) {
+            c.ow_t = 0;
+            if (++c.oh_t == p.oh_tiles) {
+                c.oh_t = 0;
+                c.oc_t++;
+            }
+        }
+    }
+}
+
+static TileBounds tile_bounds(const TileCursor &c, const LayerParams &p) {
+    #pragma HLS INLINE
+    
+    TileBounds b;
+    b.oc_start = c.oc_t * TILE_CH;
+    b.oc_count = (b.oc_start + TILE_CH > p.out_channels) ? p.out_channels - b.oc_start : TILE_CH;
+    b.oh_start = c.oh_t * TILE_H;
+    b.oh_count = (b.oh_start + TILE_H > p.out_height) ? p.out_height - b.oh_start : TILE_H;
+    b.ow_start = c.ow_t * TILE_W;
+    b.ow_count = (b.ow_start + TILE_W > p.out_width) ? p.out_width - b.ow_start : TILE_W;
+    return b;
+}
+
+// Inputs are refetched unless a spatial tile is resident across OC tiles
+static bool tile_needs_input(const TileCursor &c, const LayerParams &p) {
+    #pragma HLS INLINE
+    return p.mode != DATAFLOW_INPUT_STATIONARY || c.oc_t == 0;
+}
+
+// Weights are refetched unless an OC tile is resident across spatial tiles
+static bool tile_needs_weights(const TileCursor &c, const LayerParams &p) {
+    #pragma HLS INLINE
+    return p.mode != DATAFLOW_WEIGHT_STATIONARY || (c.oh_t == 0 && c.ow_t == 0);
+}
+
+/*******************************************************************************
+ * Packed Row Reader
+ * Streams `count` consecutive values starting at element e0 as 64-bit
+ * words, one DDR beat per cycle. e0 need not be word aligned: each output word
+ * is spliced from two neighbouring beats. Lanes outside [valid_lo, valid_hi)
+ * are zeroed (conv padding); beats outside the buffer are never issued.
+ * Returns the number of beats requested (0 for an all-padding row).
+ ******************************************************************************/
+static int read_packed_row(
+    axi_data_t *mem,
+    int mem_words,
+    int e0,
+    int count,
+    int valid_lo,
+    int valid_hi,
+    hls::stream<axi_data_t> &out
+) {
+    #pragma HLS INLINE
+    
+    int shift = e0 & (AXI_LANES - 1);
+    int w0 = e0 >> AXI_LANE_SHIFT;          // Floor, e0 may be negative
+    int n_out = (count + AXI_LANES - 1) / AXI_LANES;
+    int n_reads = n_out + (shift != 0);
+    bool any_valid = valid_lo < valid_hi;
+    axi_data_t prev = 0;
+    
+    READ_ROW:
+    for (int i = 0; i < n_reads; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=73
+        
+        int wi = w0 + i;
+        axi_data_t cur = 0;
+        if (any_valid && wi >= 0 && wi < mem_words) {
+            cur = mem[wi];
+        }
+        
+        if (shift == 0 || i > 0) {
+            axi_data_t word = (shift == 0) ? cur :
+                axi_data_t((prev >> (DATA_BITS * shift)) | (cur << (DATA_BITS * (AXI_LANES - shift))));
+            
+            int base = (i - (shift != 0)) * AXI_LANES;
+            for (int j = 0; j < AXI_LANES; j++) {
+                #pragma HLS UNROLL
+                if (base + j < valid_lo || base + j >= valid_hi) {
+                    word.range(DATA_BITS * j + DATA_BITS - 1, DATA_BITS * j) = 0;
+                }
+            }
+            out.write(word);
+        }
+        prev = cur;
+    }
+    return any_valid ? n_reads : 0;
+}
+
+/*******************************************************************************
+ * Load Stage
+ * Fetches input tiles (with halo and zero padding) and weight tiles from DDR
+ * in schedule order as packed words. Resident operands are not refetched.
+ ******************************************************************************/
+static void load_stage(
+    axi_data_t *input_fm,
+    axi_data_t *weights,
+    LayerParams p,
+    hls::stream<axi_data_t> &in_s,
+    hls::stream<axi_data_t> &w_s,
+    int &read_beats
+) {
+    int num_tiles = p.oc_tiles * p.oh_tiles * p.ow_tiles;
+    int kk = p.kernel_size * p.kernel_size;
+    int beats = 0;
+    TileCursor c = {0, 0, 0};
+    
+    LOAD_TILE_LOOP:
+    for (int t = 0; t < num_tiles; t++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=256
+        
+        TileBounds b = tile_bounds(c, p);
+        bool need_input = tile_needs_input(c, p);
+        bool need_weights = tile_needs_weights(c, p);
+        
+        // Input tile extent in DDR (with halo for convolution)
+        int ih_start = b.oh_start * p.stride - p.padding;
+        int ih_end = (b.oh_start + b.oh_count - 1) * p.stride + p.kernel_size - p.padding;
+        int iw_start = b.ow_start * p.stride - p.padding;
+        int tile_iw = (b.ow_count - 1) * p.stride + p.kernel_size;
+        
+        // Columns of the tile row that fall inside the map
+        int col_lo = (iw_start < 0) ? -iw_start : 0;
+        int col_hi = (p.in_width - iw_start < tile_iw) ? p.in_width - iw_start : tile_iw;
+        
+        LOAD_IC_TILE_LOOP:
+        for (int ic_t = 0; ic_t < p.ic_tiles; ic_t++) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=16
+            
+            int ic_start = ic_t * TILE_CH;
+            int ic_end = (ic_start + TILE_CH > p.in_channels) ? p.in_channels : ic_start + TILE_CH;
+            
+            if (need_input) {
+                LOAD_INPUT:
+                for (int ic = ic_start; ic < ic_end; ic++) {
+                    for (int ih = ih_start; ih < ih_end; ih++) {
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=512
+                        
+                        bool row_valid = (ih >= 0 && ih < p.in_height);   // Zero padding rows
+                        beats += read_packed_row(input_fm, p.in_words,
+                                        (ic * p.in_height + ih) * p.in_pitch + iw_start, tile_iw,
+                                        col_lo, row_valid ? col_hi : 0, in_s);
+                    }
+                }
+            }
+            
+            if (need_weights) {
+                // Weights are channel-last: one tap's IC tile is contiguous in DDR
+                LOAD_WEIGHTS:
+                for (int oc = b.oc_start; oc < b.oc_start + b.oc_count; oc++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+                    for (int k = 0; k < kk; k++) {
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=9
+                        beats += read_packed_row(weights, p.w_words,
+                                                 (oc * kk + k) * p.in_channels + ic_start,
+                                                 ic_end - ic_start, 0, ic_end - ic_start, w_s);
+                    }
+                }
+            }
+        }
+        
+        advance_tile(c, p);
+    }
+    read_beats = beats;
+}
+
+/*******************************************************************************
+ * Compute Stage
+ * Owns the stationary caches and the accumulator tile. Fills the caches from
+ * the load streams when the schedule says an operand changed, accumulates over
+ * all IC tiles, then hands the finished accumulator tile to the store stage.
+ *
+ * MAC Array: PARALLEL_OUT_CH x PARALLEL_IN_CH products every cycle (mac_array).
+ * Each input lane is broadcast to all output lanes, and every lane owns its
+ * own BRAM bank so the array can be fed at II=1:
+ *   input_tile[pi]        input channels with ic % PARALLEL_IN_CH == pi
+ *   weight_tile[po][pi]   weights of that (oc, ic) lane pair
+ *   acc_tile[po]          output channels with oc % PARALLEL_OUT_CH == po
+ * Unused lanes (channel counts not a multiple of the array) have zero weights.
+ ******************************************************************************/
+#define TILE_PIX_MIN      16     // Output pixels per tile that cover the MAC pipeline depth
+
+// One pixel of PARALLEL_IN_CH channels into PARALLEL_OUT_CH accumulators
+static void tile_mac_pixel(
+    data_t input_tile[PARALLEL_IN_CH][INPUT_BANK_SIZE],
+    weight_t weight_tile[PARALLEL_OUT_CH][PARALLEL_IN_CH][WEIGHT_BANK_SIZE],
+    acc_t acc_tile[PARALLEL_OUT_CH][ACC_BANK_SIZE],
+    int in_addr,
+    int w_addr,
+    int acc_idx
+) {
+    #pragma HLS INLINE
+    // Broadcast one pixel of PARALLEL_IN_CH channels
+    data_t x[PARALLEL_IN_CH];
+    #pragma HLS ARRAY_PARTITION variable=x complete
+    for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+        #pragma HLS UNROLL
+        x[pi] = input_tile[pi][in_addr];
+    }
+    
+    weight_t wv[PARALLEL_OUT_CH][PARALLEL_IN_CH];
+    acc_t sum[PARALLEL_OUT_CH];
+    #pragma HLS ARRAY_PARTITION variable=wv complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=sum complete
+    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+        #pragma HLS UNROLL
+        sum[po] = acc_tile[po][acc_idx];
+        for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+            #pragma HLS UNROLL
+            wv[po][pi] = weight_tile[po][pi][w_addr];
+        }
+    }
+    mac_array(x, wv, sum);
+    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+        #pragma HLS UNROLL
+        acc_tile[po][acc_idx] = sum[po];
+    }
+}
+
+static void compute_stage(
+    LayerParams p,
+    hls::stream<axi_data_t> &in_s,
+    hls::stream<axi_data_t> &w_s,
+    hls::stream<acc_vec_t> &acc_s,
+    int &mac_cycles
+) {
+    // On-chip tile buffers (fits in BRAM), sized as stationary caches
+    static data_t input_tile[PARALLEL_IN_CH][INPUT_BANK_SIZE];
+    static weight_t weight_tile[PARALLEL_OUT_CH][PARALLEL_IN_CH][WEIGHT_BANK_SIZE];
+    static acc_t acc_tile[PARALLEL_OUT_CH][ACC_BANK_SIZE];
+    
+    #pragma HLS BIND_STORAGE variable=input_tile type=ram_2p impl=bram
+    #pragma HLS BIND_STORAGE variable=weight_tile type=ram_1p impl=bram
+    #pragma HLS BIND_STORAGE variable=acc_tile type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=input_tile dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=input_tile dim=2 cyclic factor=AXI_LANES
+    #pragma HLS ARRAY_PARTITION variable=weight_tile dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=weight_tile dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=acc_tile dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=acc_tile dim=2 cyclic factor=AXI_LANES
+    
+    int num_tiles = p.oc_tiles * p.oh_tiles * p.ow_tiles;
+    int kk = p.kernel_size * p.kernel_size;
+    int in_stride = (p.mode == DATAFLOW_INPUT_STATIONARY) ? p.in_block / PARALLEL_IN_CH : 0;
+    int w_stride = (p.mode == DATAFLOW_WEIGHT_STATIONARY) ?
+                   p.w_block / (PARALLEL_OUT_CH * PARALLEL_IN_CH) : 0;
+    int macs = 0;
+    TileCursor c = {0, 0, 0};
+    
+    COMPUTE_TILE_LOOP:
+    for (int t = 0; t < num_tiles; t++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=256
+        
+        TileBounds b = tile_bounds(c, p);
+        bool need_input = tile_needs_input(c, p);
+        bool need_weights = tile_needs_weights(c, p);
+        
+        // Local row pitches are word aligned to match the packed streams
+        int tile_ih = (b.oh_count - 1) * p.stride + p.kernel_size;
+        int tile_iw = FM_PITCH((b.ow_count - 1) * p.stride + p.kernel_size);
+        int in_plane = tile_ih * tile_iw;
+        int acc_w = FM_PITCH(b.ow_count);
+        int acc_plane = b.oh_count * acc_w;
+        int oc_groups = (b.oc_count + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+        
+        // Initialize accumulators for this tile
+        INIT_ACC:
+        for (int i = 0; i < oc_groups * acc_plane; i += AXI_LANES) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=224
+            for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                #pragma HLS UNROLL
+                for (int j = 0; j < AXI_LANES; j++) {
+                    #pragma HLS UNROLL
+                    acc_tile[po][i + j] = 0;
+                }
+            }
+        }
+        
+        // Accumulate over input channel tiles
+        IC_TILE_LOOP:
+        for (int ic_t = 0; ic_t < p.ic_tiles; ic_t++) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=16
+            
+            int ic_start = ic_t * TILE_CH;
+            int ic_count = (ic_start + TILE_CH > p.in_channels) ? p.in_channels - ic_start : TILE_CH;
+            int ic_groups = (ic_count + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+            int tap_words = (ic_count + AXI_LANES - 1) / AXI_LANES;
+            int in_base = ic_t * in_stride;
+            int w_base = ic_t * w_stride;
+            
+            if (need_input) {
+                // Each word is AXI_LANES columns of one channel row
+                FILL_INPUT:
+                for (int ic = 0; ic < ic_count; ic++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+                    for (int i = 0; i < in_plane; i += AXI_LANES) {
+                        #pragma HLS PIPELINE II=1
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=80
+                        int addr = in_base + (ic / PARALLEL_IN_CH) * in_plane + i;
+                        data_t v[AXI_LANES];
+                        unpack_word(in_s.read(), v);
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            input_tile[ic % PARALLEL_IN_CH][addr + j] = v[j];
+                        }
+                    }
+                }
+            }
+            
+            if (need_weights) {
+                // Each word is AXI_LANES input channels of one tap; a group of
+                // PARALLEL_IN_CH / AXI_LANES words fills one row of lanes
+                FILL_WEIGHTS:
+                for (int oc = 0; oc < b.oc_count; oc++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+                    for (int k = 0; k < kk; k++) {
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=9
+                        for (int g = 0; g < ic_groups; g++) {
+                            #pragma HLS PIPELINE II=2
+                            #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                            int addr = w_base + ((oc / PARALLEL_OUT_CH) * IC_SLOTS + g) * kk + k;
+                            for (int q = 0; q < PARALLEL_IN_CH / AXI_LANES; q++) {
+                                #pragma HLS UNROLL
+                                axi_data_t word = 0;
+                                if (g * (PARALLEL_IN_CH / AXI_LANES) + q < tap_words) {
+                                    word = w_s.read();
+                                }
+                                data_t v[AXI_LANES];
+                                unpack_word(word, v);
+                                for (int j = 0; j < AXI_LANES; j++) {
+                                    #pragma HLS UNROLL
+                                    weight_tile[oc % PARALLEL_OUT_CH][q * AXI_LANES + j][addr] = v[j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            
+            // Compute convolution for this tile on the MAC array
+            // Pixels are innermost, so an accumulator is revisited only after
+            // a full output plane. Smaller tiles (remainder tiles, 7x7 maps)
+            // are padded with bubble pixels up to TILE_PIX_MIN, so the
+            // read-modify-write distance always covers the MAC pipeline
+            int tile_pix = b.oh_count * b.ow_count;
+            int pix_iters = (tile_pix < TILE_PIX_MIN) ? TILE_PIX_MIN : tile_pix;
+            COMPUTE_TILE:
+            for (int og = 0; og < oc_groups; og++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                for (int g = 0; g < ic_groups; g++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                    for (int kh = 0; kh < p.kernel_size; kh++) {
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=3
+                        for (int kw = 0; kw < p.kernel_size; kw++) {
+                            #pragma HLS LOOP_TRIPCOUNT min=1 max=3
+                            
+                            int w_addr = w_base + (og * IC_SLOTS + g) * kk + kh * p.kernel_size + kw;
+                            int in_row = g * tile_ih + kh;
+                            int acc_row = og * acc_plane;
+                            
+                            COMPUTE_PIXELS:
+                            for (int px = 0, oh = 0, ow = 0; px < pix_iters; px++) {
+                                #pragma HLS PIPELINE II=1
+                                #pragma HLS LOOP_TRIPCOUNT min=16 max=224
+                                #pragma HLS DEPENDENCE variable=acc_tile inter false
+                                if (px < tile_pix) {
+                                    tile_mac_pixel(input_tile, weight_tile, acc_tile,
+                                                   in_base + (in_row + oh * p.stride) * tile_iw + ow * p.stride + kw,
+                                                   w_addr, acc_row + oh * acc_w + ow);
+                                }
+                                if (++ow == b.ow_count) {
+                                    ow = 0;
+                                    oh++;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            macs += oc_groups * ic_groups * kk * b.oh_count * b.ow_count;
+        }
+        
+        // Hand the finished tile to the store stage, AXI_LANES values per cycle
+        DRAIN_ACC:
+        for (int oc = 0; oc < b.oc_count; oc++) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+            for (int i = 0; i < acc_plane; i += AXI_LANES) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=56
+                acc_vec_t vec;
+                int addr = (oc / PARALLEL_OUT_CH) * acc_plane + i;
+                for (int j = 0; j < AXI_LANES; j++) {
+                    #pragma HLS UNROLL
+                    vec.v[j] = acc_tile[oc % PARALLEL_OUT_CH][addr + j];
+                }
+                acc_s.write(vec);
+            }
+        }
+        
+        advance_tile(c, p);
+    }
+    mac_cycles = macs;
+}
+
+/*******************************************************************************
+ * BatchNorm + LeakyReLU Epilogue
+ * Shared by every engine's writeback path
+ ******************************************************************************/
+static data_t bn_leaky(acc_t acc, bn_t scale_val, bn_t shift_val, int layer_type) {
+    #pragma HLS INLINE
+    
+    // BatchNorm: out = acc * scale + shift (INT8: requantised to output codes)
+    epi_t bn_out = acc * scale_val + shift_val;
+    
+    // LeakyReLU (if not output layer)
+    if (layer_type != 2) {
+        if (bn_out > epi_t(0)) {
+            return data_t(bn_out);
+        } else {
+            return data_t(bn_out >> 3);  // Approx 0.1x
+        }
+    }
+    return data_t(bn_out);
+}
+
+/*******************************************************************************
+ * Store Stage
+ * Applies BatchNorm + LeakyReLU to each accumulator tile and writes it to DDR
+ * as whole 64-bit words (tile rows start word aligned in the pitched layout).
+ * For pool layers the 2x2 max is taken on chip as rows stream past, so only
+ * the pooled map is written (tiles start on even rows/cols, so windows never
+ * straddle a tile boundary).
+ ******************************************************************************/
+static void store_stage(
+    axi_data_t *output_fm,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    hls::stream<acc_vec_t> &acc_s,
+    int &write_beats
+) {
+    // Previous (even) row of the current 2x2 windows
+    data_t pool_row[TILE_W];
+    #pragma HLS ARRAY_PARTITION variable=pool_row complete
+    data_t pool_half[AXI_LANES / 2];
+    #pragma HLS ARRAY_PARTITION variable=pool_half complete
+    
+    bool do_pool = (p.layer_type == 1);
+    int pool_height = p.out_height / 2;
+    int pool_pitch = FM_PITCH(p.out_width / 2);
+    int num_tiles = p.oc_tiles * p.oh_tiles * p.ow_tiles;
+    int beats = 0;
+    TileCursor c = {0, 0, 0};
+    
+    STORE_TILE_LOOP:
+    for (int t = 0; t < num_tiles; t++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=256
+        
+        TileBounds b = tile_bounds(c, p);
+        int row_words = FM_PITCH(b.ow_count) / AXI_LANES;
+        
+        // Apply BatchNorm + LeakyReLU and write output tile to DDR
+        WRITE_OUTPUT:
+        for (int oc = 0; oc < b.oc_count; oc++) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+            
+            bn_t scale_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_scale[b.oc_start + oc] : bn_t(1);
+            bn_t shift_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_shift[b.oc_start + oc] : bn_t(0);
+            
+            for (int oh = 0; oh < b.oh_count; oh++) {
+                for (int k = 0; k < row_words; k++) {
+                    #pragma HLS PIPELINE II=1
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=56
+                    
+                    acc_vec_t vec = acc_s.read();
+                    data_t result[AXI_LANES];
+                    
+                    for (int j = 0; j < AXI_LANES; j++) {
+                        #pragma HLS UNROLL
+                        result[j] = bn_leaky(vec.v[j], scale_val, shift_val, p.layer_type);
+                    }
+                    
+                    if (!do_pool) {
+                        // Write to DDR
+                        int out_idx = ((b.oc_start + oc) * p.out_height + (b.oh_start + oh)) * p.out_pitch +
+                                      b.ow_start;
+                        output_fm[out_idx / AXI_LANES + k] = pack_word(result);
+                        beats++;
+                    } else if (!(oh & 1)) {
+                        // Even row: hold values for the row below
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            pool_row[k * AXI_LANES + j] = result[j];
+                        }
+                    } else {
+                        // Odd row: close AXI_LANES / 2 windows, emit a word every two
+                        data_t m[AXI_LANES / 2];
+                        data_t word[AXI_LANES];
+                        for (int j = 0; j < AXI_LANES / 2; j++) {
+                            #pragma HLS UNROLL
+                            m[j] = max4_hw(pool_row[k * AXI_LANES + 2 * j], pool_row[k * AXI_LANES + 2 * j + 1],
+                                           result[2 * j], result[2 * j + 1]);
+                            word[j] = (k & 1) ? pool_half[j] : m[j];
+                            word[AXI_LANES / 2 + j] = (k & 1) ? m[j] : data_t(0);
+                        }
+                        
+                        int pw = (b.ow_start >> 1) + (k >> 1) * AXI_LANES;
+                        int pool_idx = ((b.oc_start + oc) * pool_height + ((b.oh_start + oh) >> 1)) * pool_pitch +
+                                       pw;
+                        if (!(k & 1)) {
+                            for (int j = 0; j < AXI_LANES / 2; j++) {
+                                #pragma HLS UNROLL
+                                pool_half[j] = m[j];
+                            }
+                            if (k == row_words - 1 && pw < pool_pitch) {
+                                output_fm[pool_idx / AXI_LANES] = pack_word(word);
+                                beats++;
+                            }
+                        } else if (pw < pool_pitch) {
+                            output_fm[pool_idx / AXI_LANES] = pack_word(word);
+                            beats++;
+                        }
+                    }
+                }
+            }
+        }
+        
+        advance_tile(c, p);
+    }
+    write_beats = beats;
+}
+
+/*******************************************************************************
+ * Layer Dataflow Region
+ * Load, compute and store run concurrently, connected by tile-deep streams
+ ******************************************************************************/
+static void run_layer(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    int &read_beats,
+    int &mac_cycles,
+    int &write_beats
+) {
+    #pragma HLS DATAFLOW
+    
+    hls::stream<axi_data_t> in_s("in_s");
+    hls::stream<axi_data_t> w_s("w_s");
+    hls::stream<acc_vec_t> acc_s("acc_s");
+    
+    // One tile of slack per channel: the ping-pong half for the consumer
+    #pragma HLS STREAM variable=in_s depth=INPUT_TILE_SIZE/AXI_LANES
+    #pragma HLS STREAM variable=w_s depth=WEIGHT_BUF_SIZE/AXI_LANES
+    #pragma HLS STREAM variable=acc_s depth=OUTPUT_TILE_SIZE/AXI_LANES
+    
+    load_stage(input_fm, weights, p, in_s, w_s, read_beats);
+    compute_stage(p, in_s, w_s, acc_s, mac_cycles);
+    store_stage(output_fm, bn_scale, bn_shift, p, acc_s, write_beats);
+}
+
+/*******************************************************************************
+ * Line-Buffer Streaming Engine (3x3, stride 1, pad 1)
+ * Multi-channel form of line_buffer_3x3: the input map streams row by row into
+ * a 4-row ring that holds every input channel, so each input pixel is read
+ * from DDR once per OC group (once in total for out_channels <= TILE_CH)
+ * instead of once per overlapping tile halo. Output rows are produced in
+ * pairs on the same MAC array as the tiled path, which lets the 2x2 pool
+ * close directly from the accumulators. The OC group's weights stay resident
+ * while the whole map streams past.
+ ******************************************************************************/
+#define ENGINE_RING_ROWS  4
+#define ENGINE_ROW_BANK   448    // ceil(in_channels / PARALLEL_IN_CH) * FM_PITCH(in_width)
+#define ENGINE_MAX_IC     64
+#define ENGINE_MIN_WIDTH  8      // Two rows of pixels cover the MAC pipeline depth
+#define ENGINE_MAX_WIDTH  416    // Accumulator rows; wider layers run tiled
+#define ENGINE_IC_SLOTS   (ENGINE_MAX_IC / PARALLEL_IN_CH)
+#define ENGINE_W_BANK     ((TILE_CH / PARALLEL_OUT_CH) * ENGINE_IC_SLOTS * 9)
+#define ENGINE_ACC_BANK   ((TILE_CH / PARALLEL_OUT_CH) * 2 * ENGINE_MAX_WIDTH)
+
+#if LINE_BUFFER_ENABLED
+static bool line_buffer_supported(const LayerParams &p) {
+    #pragma HLS INLINE
+    int ic_groups = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    return p.kernel_size == 3 && p.stride == 1 && p.padding == 1 &&
+           p.in_channels <= ENGINE_MAX_IC &&
+           p.in_width >= ENGINE_MIN_WIDTH && p.in_width <= ENGINE_MAX_WIDTH &&
+           (p.in_height % 2 == 0 || p.in_width >= 2 * ENGINE_MIN_WIDTH) &&   // Odd heights end on one row
+           ic_groups * p.in_pitch <= ENGINE_ROW_BANK;
+}
+
+// Row ring, the OC tile's filters and two output rows of accumulators.
+// Shared by line_buffer_engine and winograd_engine (only one runs at a time)
+static data_t engine_ring[PARALLEL_IN_CH][ENGINE_RING_ROWS][ENGINE_ROW_BANK];
+static weight_t engine_wbuf[PARALLEL_OUT_CH][PARALLEL_IN_CH][ENGINE_W_BANK];
+static acc_t engine_acc[PARALLEL_OUT_CH][ENGINE_ACC_BANK];
+
+// Nine taps of every filter in one OC tile (same lane layout as compute_stage)
+static int engine_load_weights(
+    axi_data_t *weights,
+    const LayerParams &p,
+    int oc_start,
+    int oc_count,
+    hls::stream<axi_data_t> &w_s
+) {
+    #pragma HLS INLINE
+    int ic_groups = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    int tap_words = (p.in_channels + AXI_LANES - 1) / AXI_LANES;
+    int rd = 0;
+    
+    ENGINE_LOAD_WEIGHTS:
+    for (int oc = 0; oc < oc_count; oc++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+        for (int k = 0; k < 9; k++) {
+            rd += read_packed_row(weights, p.w_words, ((oc_start + oc) * 9 + k) * p.in_channels,
+                                  p.in_channels, 0, p.in_channels, w_s);
+            
+            for (int g = 0; g < ic_groups; g++) {
+                #pragma HLS PIPELINE II=2
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+                int addr = ((oc / PARALLEL_OUT_CH) * ENGINE_IC_SLOTS + g) * 9 + k;
+                for (int q = 0; q < PARALLEL_IN_CH / AXI_LANES; q++) {
+                    #pragma HLS UNROLL
+                    axi_data_t word = 0;
+                    if (g * (PARALLEL_IN_CH / AXI_LANES) + q < tap_words) {
+                        word = w_s.read();
+                    }
+                    data_t v[AXI_LANES];
+                    unpack_word(word, v);
+                    for (int j = 0; j < AXI_LANES; j++) {
+                        #pragma HLS UNROLL
+                        engine_wbuf[oc % PARALLEL_OUT_CH][q * AXI_LANES + j][addr] = v[j];
+                    }
+                }
+            }
+        }
+    }
+    return rd;
+}
+
+// Bring input rows up to oh0 + 2 into the ring; each DDR row is read once
+static int engine_load_rows(axi_data_t *input_fm, const LayerParams &p, int oh0) {
+    #pragma HLS INLINE
+    int height = p.in_height;
+    int pitch = p.in_pitch;
+    int row_words = pitch / AXI_LANES;
+    int rd = 0;
+    
+    ENGINE_LOAD_ROWS:
+    for (int r = (oh0 == 0) ? 0 : oh0 + 1; r <= oh0 + 2 && r < height; r++) {
+        #pragma HLS LOOP_TRIPCOUNT min=2 max=3
+        for (int ic = 0; ic < p.in_channels; ic++) {
+            #pragma HLS LOOP_TRIPCOUNT min=3 max=64
+            for (int i = 0; i < row_words; i++) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT min=2 max=56
+                int addr = (ic / PARALLEL_IN_CH) * pitch + i * AXI_LANES;
+                data_t *bank = engine_ring[ic % PARALLEL_IN_CH][r % ENGINE_RING_ROWS];
+                data_t v[AXI_LANES];
+                unpack_word(input_fm[((ic * height + r) * pitch) / AXI_LANES + i], v);
+                for (int j = 0; j < AXI_LANES; j++) {
+                    #pragma HLS UNROLL
+                    bank[addr + j] = v[j];
+                }
+            }
+            rd += row_words;
+        }
+    }
+    return rd;
+}
+
+static void line_buffer_engine(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    PerfCounts &perf
+) {
+    bn_t scale_buf[TILE_CH];
+    bn_t shift_buf[TILE_CH];
+    
+    #pragma HLS BIND_STORAGE variable=engine_ring type=ram_2p impl=bram
+    #pragma HLS BIND_STORAGE variable=engine_acc type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=engine_ring dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=engine_ring dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=engine_ring dim=3 cyclic factor=AXI_LANES
+    #pragma HLS ARRAY_PARTITION variable=engine_wbuf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=engine_wbuf dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=engine_acc dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=engine_acc dim=2 cyclic factor=AXI_LANES
+    
+    hls::stream<axi_data_t> w_s("engine_w_s");
+    #pragma HLS STREAM variable=w_s depth=ENGINE_MAX_IC/AXI_LANES
+    
+    int height = p.in_height;
+    int width = p.in_width;
+    int pitch = p.in_pitch;              // Same as out_pitch (pad 1 keeps width)
+    int row_words = pitch / AXI_LANES;
+    int ic_groups = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    bool do_pool = (p.layer_type == 1);
+    int pool_height = height / 2;
+    int pool_pitch = FM_PITCH(width / 2);
+    int rd = 0, macs = 0, wr = 0;
+    
+    ENGINE_OC_LOOP:
+    for (int oc_start = 0; oc_start < p.out_channels; oc_start += TILE_CH) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+        
+        int oc_count = (oc_start + TILE_CH > p.out_channels) ? p.out_channels - oc_start : TILE_CH;
+        int oc_groups = (oc_count + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+        
+        // Resident weights for this OC group
+        rd += engine_load_weights(weights, p, oc_start, oc_count, w_s);
+        
+        ENGINE_LOAD_BN:
+        for (int oc = 0; oc < oc_count; oc++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+            scale_buf[oc] = (p.layer_type != 2 || HEAD_REQUANT) ? bn_scale[oc_start + oc] : bn_t(1);
+            shift_buf[oc] = (p.layer_type != 2 || HEAD_REQUANT) ? bn_shift[oc_start + oc] : bn_t(0);
+        }
+        
+        ENGINE_ROW_PAIR_LOOP:
+        for (int oh0 = 0; oh0 < height; oh0 += 2) {
+            #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+            
+            int rows = (oh0 + 2 > height) ? height - oh0 : 2;
+            
+            rd += engine_load_rows(input_fm, p, oh0);
+            
+            ENGINE_INIT_ACC:
+            for (int i = 0; i < oc_groups * 2 * pitch; i += AXI_LANES) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=448
+                for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                    #pragma HLS UNROLL
+                    for (int j = 0; j < AXI_LANES; j++) {
+                        #pragma HLS UNROLL
+                        engine_acc[po][i + j] = 0;
+                    }
+                }
+            }
+            
+            // 3x3 windows slide over the ring; padding rows/cols read as zero
+            ENGINE_MAC:
+            for (int og = 0; og < oc_groups; og++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                for (int g = 0; g < ic_groups; g++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+                    for (int kh = 0; kh < 3; kh++) {
+                        for (int kw = 0; kw < 3; kw++) {
+                            int w_addr = (og * ENGINE_IC_SLOTS + g) * 9 + kh * 3 + kw;
+                            
+                            for (int r2 = 0; r2 < rows; r2++) {
+                                #pragma HLS LOOP_TRIPCOUNT min=1 max=2
+                                for (int ow = 0; ow < width; ow++) {
+                                    #pragma HLS PIPELINE II=1
+                                    #pragma HLS LOOP_TRIPCOUNT min=8 max=224
+                                    #pragma HLS DEPENDENCE variable=engine_acc inter false
+                                    
+                                    int ih = oh0 + r2 + kh - 1;
+                                    int iw = ow + kw - 1;
+                                    bool valid = ih >= 0 && ih < height && iw >= 0 && iw < width;
+                                    int acc_idx = (og * 2 + r2) * pitch + ow;
+                                    
+                                    data_t x[PARALLEL_IN_CH];
+                                    #pragma HLS ARRAY_PARTITION variable=x complete
+                                    for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                                        #pragma HLS UNROLL
+                                        x[pi] = valid ? engine_ring[pi][ih & (ENGINE_RING_ROWS - 1)][g * pitch + iw] :
+                                                        data_t(0);
+                                    }
+                                    
+                                    weight_t wv[PARALLEL_OUT_CH][PARALLEL_IN_CH];
+                                    acc_t sum[PARALLEL_OUT_CH];
+                                    #pragma HLS ARRAY_PARTITION variable=wv complete dim=0
+                                    #pragma HLS ARRAY_PARTITION variable=sum complete
+                                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                                        #pragma HLS UNROLL
+                                        sum[po] = engine_acc[po][acc_idx];
+                                        for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                                            #pragma HLS UNROLL
+                                            wv[po][pi] = engine_wbuf[po][pi][w_addr];
+                                        }
+                                    }
+                                    mac_array(x, wv, sum);
+                                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                                        #pragma HLS UNROLL
+                                        engine_acc[po][acc_idx] = sum[po];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            macs += oc_groups * ic_groups * 9 * rows * width;
+            
+            // Apply BatchNorm + LeakyReLU (+ 2x2 pool) and write the row pair
+            ENGINE_STORE:
+            for (int oc = 0; oc < oc_count; oc++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+                
+                acc_t *bank = engine_acc[oc % PARALLEL_OUT_CH];
+                int base = (oc / PARALLEL_OUT_CH) * 2 * pitch;
+                
+                if (!do_pool) {
+                    for (int r2 = 0; r2 < rows; r2++) {
+                        for (int i = 0; i < row_words; i++) {
+                            #pragma HLS PIPELINE II=1
+                            #pragma HLS LOOP_TRIPCOUNT min=2 max=56
+                            data_t v[AXI_LANES];
+                            for (int j = 0; j < AXI_LANES; j++) {
+                                #pragma HLS UNROLL
+                                v[j] = bn_leaky(bank[base + r2 * pitch + i * AXI_LANES + j],
+                                                scale_buf[oc], shift_buf[oc], p.layer_type);
+                            }
+                            output_fm[(((oc_start + oc) * height + oh0 + r2) * pitch) / AXI_LANES + i] =
+                                pack_word(v);
+                        }
+                    }
+                    wr += rows * row_words;
+                } else if (rows == 2) {
+                    for (int i = 0; i < pool_pitch / AXI_LANES; i++) {
+                        #pragma HLS PIPELINE II=2
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=28
+                        data_t v[AXI_LANES];
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            int col = 2 * (i * AXI_LANES + j);
+                            v[j] = 0;
+                            if (col + 1 < pitch) {
+                                v[j] = max4_hw(
+                                    bn_leaky(bank[base + col], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                    bn_leaky(bank[base + col + 1], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                    bn_leaky(bank[base + pitch + col], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                    bn_leaky(bank[base + pitch + col + 1], scale_buf[oc], shift_buf[oc], p.layer_type));
+                            }
+                        }
+                        output_fm[(((oc_start + oc) * pool_height + oh0 / 2) * pool_pitch) / AXI_LANES + i] =
+                            pack_word(v);
+                    }
+                    wr += pool_pitch / AXI_LANES;
+                }
+            }
+        }
+    }
+    
+    perf.read += rd;
+    perf.compute += macs;
+    perf.write += wr;
+}
+#endif
+
+/*******************************************************************************
+ * Winograd Engine (F(2x2, 3x3) on the line-buffer ring)
+ * Same row ring, filter banks, output rows, row pairs and OC groups as
+ * line_buffer_engine (the buffers are shared), but each 2x2 output block is
+ * computed in the Winograd domain:
+ *   Y = A^T [ sum_ic (G g G^T) . (B^T d B) ] A
+ * so one block costs 16 element-wise products per input channel instead
+ * of 36 direct MACs. Filters are transformed on chip once loaded (4 G g G^T
+ * with G scaled to integers, one Q8.8 weight word format for every engine),
+ * input tiles as they leave the ring, and the output transform divides the
+ * factor 4 back out. Every intermediate is exact, so results match the
+ * direct engines bit for bit unless the direct path saturates its
+ * accumulator. Q8.8 only: the widened operands do not pack two to a DSP48
+ * like INT8's mac_array, which already doubles the MAC rate.
+ ******************************************************************************/
+#define WINO_MAX_WIDTH    224    // Block buffers; wider layers run on the line buffer
+#define WINO_BLK_MAX      (WINO_MAX_WIDTH / 2)   // 2x2 blocks across one row pair
+#define WINO_W_BANK       ((TILE_CH / PARALLEL_OUT_CH) * ENGINE_IC_SLOTS * 16)
+
+#if WINO_ENABLED
+typedef ap_fixed<20, 12> wino_w_t;       // 4 G g G^T: up to 9x a weight
+typedef ap_fixed<18, 10> wino_d_t;       // B^T d B: up to 4x an activation
+typedef ap_fixed<48, 32> wino_acc_t;     // Exact Q.16 sums (one DSP48 accumulator)
+
+static bool winograd_supported(const LayerParams &p) {
+    #pragma HLS INLINE
+    return line_buffer_supported(p) && p.in_width <= WINO_MAX_WIDTH;
+}
+
+static void winograd_engine(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    PerfCounts &perf
+) {
+    // Ring, raw filters and output rows are line_buffer_engine's (and partitioned
+    // there); filters, input tiles and block sums in the Winograd domain
+    static wino_w_t ubuf[PARALLEL_OUT_CH][PARALLEL_IN_CH][WINO_W_BANK];
+    static wino_d_t vbuf[PARALLEL_IN_CH][16][WINO_BLK_MAX];
+    static wino_acc_t macc[PARALLEL_OUT_CH][16][WINO_BLK_MAX];
+    bn_t scale_buf[TILE_CH];
+    bn_t shift_buf[TILE_CH];
+    
+    #pragma HLS BIND_STORAGE variable=macc type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=ubuf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=ubuf dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=vbuf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=vbuf dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=macc dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=macc dim=2 cyclic factor=4
+    
+    hls::stream<axi_data_t> w_s("wino_w_s");
+    #pragma HLS STREAM variable=w_s depth=ENGINE_MAX_IC/AXI_LANES
+    
+    int height = p.in_height;
+    int width = p.in_width;
+    int pitch = p.in_pitch;              // Same as out_pitch (pad 1 keeps width)
+    int row_words = pitch / AXI_LANES;
+    int blocks = (width + 1) / 2;
+    int ic_groups = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    bool do_pool = (p.layer_type == 1);
+    int pool_height = height / 2;
+    int pool_pitch = FM_PITCH(width / 2);
+    int rd = 0, macs = 0, wr = 0;
+    
+    WINO_OC_LOOP:
+    for (int oc_start = 0; oc_start < p.out_channels; oc_start += TILE_CH) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+        
+        int oc_count = (oc_start + TILE_CH > p.out_channels) ? p.out_channels - oc_start : TILE_CH;
+        int oc_groups = (oc_count + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+        
+        // Each filter's nine taps, then U = 4 G g G^T per input channel
+        rd += engine_load_weights(weights, p, oc_start, oc_count, w_s);
+        
+        WINO_TRANSFORM_WEIGHTS:
+        for (int oc = 0; oc < oc_count; oc++) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+            for (int g = 0; g < ic_groups; g++) {
+                #pragma HLS PIPELINE II=9
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+                int src = ((oc / PARALLEL_OUT_CH) * ENGINE_IC_SLOTS + g) * 9;   // Nine taps, one per cycle
+                int addr = ((oc / PARALLEL_OUT_CH) * ENGINE_IC_SLOTS + g) * 16;
+                for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                    #pragma HLS UNROLL
+                    weight_t *graw = engine_wbuf[oc % PARALLEL_OUT_CH][pi] + src;
+                    // t = G' g with G' = 2G = [2 0 0; 1 1 1; 1 -1 1; 0 0 2], then U = t G'^T
+                    wino_w_t t[4][3];
+                    for (int c = 0; c < 3; c++) {
+                        #pragma HLS UNROLL
+                        wino_w_t g0 = graw[c], g1 = graw[3 + c], g2 = graw[6 + c];
+                        t[0][c] = 2 * g0;
+                        t[1][c] = g0 + g1 + g2;
+                        t[2][c] = g0 - g1 + g2;
+                        t[3][c] = 2 * g2;
+                    }
+                    for (int r = 0; r < 4; r++) {
+                        #pragma HLS UNROLL
+                        wino_w_t *u = &ubuf[oc % PARALLEL_OUT_CH][pi][addr + 4 * r];
+                        u[0] = 2 * t[r][0];
+                        u[1] = t[r][0] + t[r][1] + t[r][2];
+                        u[2] = t[r][0] - t[r][1] + t[r][2];
+                        u[3] = 2 * t[r][2];
+                    }
+                }
+            }
+        }
+        
+        WINO_LOAD_BN:
+        for (int oc = 0; oc < oc_count; oc++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=32
+            scale_buf[oc] = (p.layer_type != 2 || HEAD_REQUANT) ? bn_scale[oc_start + oc] : bn_t(1);
+            shift_buf[oc] = (p.layer_type != 2 || HEAD_REQUANT) ? bn_shift[oc_start + oc] : bn_t(0);
+        }
+        
+        WINO_ROW_PAIR_LOOP:
+        for (int oh0 = 0; oh0 < height; oh0 += 2) {
+            #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+            
+            int rows = (oh0 + 2 > height) ? height - oh0 : 2;
+            
+            rd += engine_load_rows(input_fm, p, oh0);
+            
+            WINO_OG_LOOP:
+            for (int og = 0; og < oc_groups; og++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                
+                WINO_INIT_ACC:
+                for (int b = 0; b < blocks; b++) {
+                    #pragma HLS PIPELINE II=4
+                    #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                        #pragma HLS UNROLL
+                        for (int e = 0; e < 16; e++) {
+                            #pragma HLS UNROLL
+                            macc[po][e][b] = 0;
+                        }
+                    }
+                }
+                
+                // Same reduction order as the direct engines: IC group, then the block's sums
+                WINO_MAC:
+                for (int g = 0; g < ic_groups; g++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+                    
+                    // V = B^T d B of every 4x4 input tile (rows oh0-1..oh0+2), padding as zero
+                    WINO_INPUT_TRANSFORM:
+                    for (int b = 0; b < blocks; b++) {
+                        #pragma HLS PIPELINE II=1
+                        #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+                        for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                            #pragma HLS UNROLL
+                            wino_d_t d[4][4];
+                            for (int r = 0; r < 4; r++) {
+                                #pragma HLS UNROLL
+                                for (int c = 0; c < 4; c++) {
+                                    #pragma HLS UNROLL
+                                    int ih = oh0 - 1 + r;
+                                    int iw = 2 * b - 1 + c;
+                                    bool valid = ih >= 0 && ih < height && iw >= 0 && iw < width;
+                                    d[r][c] = valid ? engine_ring[pi][ih & (ENGINE_RING_ROWS - 1)][g * pitch + iw] :
+                                                      data_t(0);
+                                }
+                            }
+                            // s = B^T d with B^T = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1], then V = s B
+                            wino_d_t s[4][4];
+                            for (int c = 0; c < 4; c++) {
+                                #pragma HLS UNROLL
+                                s[0][c] = d[0][c] - d[2][c];
+                                s[1][c] = d[1][c] + d[2][c];
+                                s[2][c] = d[2][c] - d[1][c];
+                                s[3][c] = d[1][c] - d[3][c];
+                            }
+                            for (int r = 0; r < 4; r++) {
+                                #pragma HLS UNROLL
+                                vbuf[pi][4 * r + 0][b] = s[r][0] - s[r][2];
+                                vbuf[pi][4 * r + 1][b] = s[r][1] + s[r][2];
+                                vbuf[pi][4 * r + 2][b] = s[r][2] - s[r][1];
+                                vbuf[pi][4 * r + 3][b] = s[r][1] - s[r][3];
+                            }
+                        }
+                    }
+                    
+                    int w_addr = (og * ENGINE_IC_SLOTS + g) * 16;
+                    for (int e = 0; e < 16; e++) {
+                        for (int b = 0; b < blocks; b++) {
+                            #pragma HLS PIPELINE II=1
+                            #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+                            #pragma HLS DEPENDENCE variable=macc inter false
+                            for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                                #pragma HLS UNROLL
+                                wino_acc_t sum = macc[po][e][b];
+                                for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                                    #pragma HLS UNROLL
+                                    sum += ubuf[po][pi][w_addr + e] * vbuf[pi][e][b];
+                                }
+                                macc[po][e][b] = sum;
+                            }
+                        }
+                    }
+                }
+                macs += ic_groups * 16 * blocks;
+                
+                // Y = A^T M A / 4 with A^T = [1 1 1 0; 0 1 -1 -1] into two output rows
+                WINO_OUTPUT_TRANSFORM:
+                for (int b = 0; b < blocks; b++) {
+                    #pragma HLS PIPELINE II=4
+                    #pragma HLS LOOP_TRIPCOUNT min=4 max=112
+                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                        #pragma HLS UNROLL
+                        wino_acc_t q[2][4];
+                        for (int c = 0; c < 4; c++) {
+                            #pragma HLS UNROLL
+                            q[0][c] = macc[po][c][b] + macc[po][4 + c][b] + macc[po][8 + c][b];
+                            q[1][c] = macc[po][4 + c][b] - macc[po][8 + c][b] - macc[po][12 + c][b];
+                        }
+                        for (int r = 0; r < 2; r++) {
+                            #pragma HLS UNROLL
+                            wino_acc_t y0 = q[r][0] + q[r][1] + q[r][2];
+                            wino_acc_t y1 = q[r][1] - q[r][2] - q[r][3];
+                            engine_acc[po][r * pitch + 2 * b] = acc_t(y0 >> 2);
+                            engine_acc[po][r * pitch + 2 * b + 1] = acc_t(y1 >> 2);
+                        }
+                    }
+                }
+                
+                // Apply BatchNorm + LeakyReLU (+ 2x2 pool) and write the row pair
+                WINO_STORE:
+                for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                    int oc = og * PARALLEL_OUT_CH + po;
+                    if (oc < oc_count) {
+                        acc_t *bank = engine_acc[po];
+                        
+                        if (!do_pool) {
+                            for (int r2 = 0; r2 < rows; r2++) {
+                                for (int i = 0; i < row_words; i++) {
+                                    #pragma HLS PIPELINE II=1
+                                    #pragma HLS LOOP_TRIPCOUNT min=2 max=56
+                                    data_t v[AXI_LANES];
+                                    for (int j = 0; j < AXI_LANES; j++) {
+                                        #pragma HLS UNROLL
+                                        v[j] = bn_leaky(bank[r2 * pitch + i * AXI_LANES + j],
+                                                        scale_buf[oc], shift_buf[oc], p.layer_type);
+                                    }
+                                    output_fm[(((oc_start + oc) * height + oh0 + r2) * pitch) / AXI_LANES + i] =
+                                        pack_word(v);
+                                }
+                            }
+                            wr += rows * row_words;
+                        } else if (rows == 2) {
+                            for (int i = 0; i < pool_pitch / AXI_LANES; i++) {
+                                #pragma HLS PIPELINE II=2
+                                #pragma HLS LOOP_TRIPCOUNT min=1 max=28
+                                data_t v[AXI_LANES];
+                                for (int j = 0; j < AXI_LANES; j++) {
+                                    #pragma HLS UNROLL
+                                    int col = 2 * (i * AXI_LANES + j);
+                                    v[j] = 0;
+                                    if (col + 1 < width) {
+                                        v[j] = max4_hw(
+                                            bn_leaky(bank[col], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                            bn_leaky(bank[col + 1], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                            bn_leaky(bank[pitch + col], scale_buf[oc], shift_buf[oc], p.layer_type),
+                                            bn_leaky(bank[pitch + col + 1], scale_buf[oc], shift_buf[oc], p.layer_type));
+                                    }
+                                }
+                                output_fm[(((oc_start + oc) * pool_height + oh0 / 2) * pool_pitch) / AXI_LANES + i] =
+                                    pack_word(v);
+                            }
+                            wr += pool_pitch / AXI_LANES;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    perf.read += rd;
+    perf.compute += macs;
+    perf.write += wr;
+}
+#endif
+
+/*******************************************************************************
+ * Pointwise (1x1) Engine
+ * A 1x1 stride-1 layer is a GEMM: out[oc][pix] = sum_ic W[oc][ic] * in[ic][pix].
+ * Pixels of a channel plane are contiguous in the pitched layout, so a pixel
+ * tile is a straight run of words per channel with no halo. The pixel tile
+ * holds every input channel, and the weight tile packs as many output
+ * channels x all input channels as fit (all 24 of L6's outputs in one tile),
+ * both sized at run time from the channel counts, on the shared mac_array.
+ ******************************************************************************/
+#define PW_IN_SIZE        (INPUT_TILE_SIZE * 2)
+#define PW_W_SIZE         (WEIGHT_BUF_SIZE * 2)
+#define PW_PIX_MAX        1024   // Accumulator depth per output lane
+#define PW_PIX_MIN        16     // Pixels per tile cover the MAC pipeline depth
+#define PW_IN_BANK        (PW_IN_SIZE / PARALLEL_IN_CH)
+#define PW_W_BANK         (PW_W_SIZE / (PARALLEL_OUT_CH * PARALLEL_IN_CH))
+
+static bool pointwise_supported(const LayerParams &p) {
+    #pragma HLS INLINE
+    int ic_slots = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    return p.kernel_size == 1 && p.stride == 1 && p.padding == 0 &&
+           p.layer_type != 1 &&                 // Pool needs row pairs: tiled path
+           ic_slots <= PW_W_BANK &&
+           (PW_IN_BANK / ic_slots) >= PW_PIX_MIN;
+}
+
+// One pixel of the GEMM: PARALLEL_IN_CH channels into PARALLEL_OUT_CH accumulators
+static void pw_mac_pixel(
+    data_t in_buf[PARALLEL_IN_CH][PW_IN_BANK],
+    weight_t w_buf[PARALLEL_OUT_CH][PARALLEL_IN_CH][PW_W_BANK],
+    acc_t acc[PARALLEL_OUT_CH][PW_PIX_MAX],
+    int in_addr,
+    int w_addr,
+    int px
+) {
+    #pragma HLS INLINE
+    data_t x[PARALLEL_IN_CH];
+    #pragma HLS ARRAY_PARTITION variable=x complete
+    for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+        #pragma HLS UNROLL
+        x[pi] = in_buf[pi][in_addr];
+    }
+    
+    weight_t wv[PARALLEL_OUT_CH][PARALLEL_IN_CH];
+    acc_t sum[PARALLEL_OUT_CH];
+    #pragma HLS ARRAY_PARTITION variable=wv complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=sum complete
+    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+        #pragma HLS UNROLL
+        sum[po] = acc[po][px];
+        for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+            #pragma HLS UNROLL
+            wv[po][pi] = w_buf[po][pi][w_addr];
+        }
+    }
+    mac_array(x, wv, sum);
+    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+        #pragma HLS UNROLL
+        acc[po][px] = sum[po];
+    }
+}
+
+static void pointwise_engine(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    PerfCounts &perf
+) {
+    static data_t in_buf[PARALLEL_IN_CH][PW_IN_BANK];
+    static weight_t w_buf[PARALLEL_OUT_CH][PARALLEL_IN_CH][PW_W_BANK];
+    static acc_t acc[PARALLEL_OUT_CH][PW_PIX_MAX];
+    
+    #pragma HLS BIND_STORAGE variable=in_buf type=ram_2p impl=bram
+    #pragma HLS BIND_STORAGE variable=acc type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=in_buf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=in_buf dim=2 cyclic factor=AXI_LANES
+    #pragma HLS ARRAY_PARTITION variable=w_buf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=w_buf dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=acc dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=acc dim=2 cyclic factor=AXI_LANES
+    
+    hls::stream<axi_data_t> w_s("pw_w_s");
+    #pragma HLS STREAM variable=w_s depth=MAX_CHANNELS/AXI_LANES
+    
+    int plane = p.in_height * p.in_pitch;    // Pixels per channel incl. pad columns
+    int ic_slots = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    int tap_words = (p.in_channels + AXI_LANES - 1) / AXI_LANES;
+    
+    // Adaptive tiles: all input channels per pixel tile, as many OC as fit
+    int pix_tile = (PW_IN_BANK / ic_slots) & ~(AXI_LANES - 1);
+    if (pix_tile > PW_PIX_MAX) pix_tile = PW_PIX_MAX;
+    if (pix_tile > plane) pix_tile = plane;
+    int oc_tile = (PW_W_BANK / ic_slots) * PARALLEL_OUT_CH;
+    if (oc_tile > p.out_channels) oc_tile = p.out_channels;
+    bool w_resident = (oc_tile == p.out_channels);
+    int rd = 0, macs = 0, wr = 0;
+    
+    PW_PIX_LOOP:
+    for (int pix0 = 0; pix0 < plane; pix0 += pix_tile) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=64
+        
+        int n = (pix0 + pix_tile > plane) ? plane - pix0 : pix_tile;
+        int words = n / AXI_LANES;
+        
+        PW_LOAD_INPUT:
+        for (int ic = 0; ic < p.in_channels; ic++) {
+            #pragma HLS LOOP_TRIPCOUNT min=8 max=512
+            for (int i = 0; i < words; i++) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT min=4 max=256
+                int addr = (ic / PARALLEL_IN_CH) * pix_tile + i * AXI_LANES;
+                data_t *bank = in_buf[ic % PARALLEL_IN_CH];
+                data_t v[AXI_LANES];
+                unpack_word(input_fm[(ic * plane + pix0) / AXI_LANES + i], v);
+                for (int j = 0; j < AXI_LANES; j++) {
+                    #pragma HLS UNROLL
+                    bank[addr + j] = v[j];
+                }
+            }
+        }
+        rd += p.in_channels * words;
+        
+        PW_OC_LOOP:
+        for (int oc0 = 0; oc0 < p.out_channels; oc0 += oc_tile) {
+            #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+            
+            int oc_count = (oc0 + oc_tile > p.out_channels) ? p.out_channels - oc0 : oc_tile;
+            int oc_groups = (oc_count + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+            
+            // Weights are [OC][IC] for k=1; fetched once if every OC fits
+            if (!w_resident || pix0 == 0) {
+                PW_LOAD_WEIGHTS:
+                for (int oc = 0; oc < oc_count; oc++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=64
+                    rd += read_packed_row(weights, p.w_words, (oc0 + oc) * p.in_channels,
+                                          p.in_channels, 0, p.in_channels, w_s);
+                    
+                    for (int g = 0; g < ic_slots; g++) {
+                        #pragma HLS PIPELINE II=2
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=64
+                        int addr = (oc / PARALLEL_OUT_CH) * ic_slots + g;
+                        for (int q = 0; q < PARALLEL_IN_CH / AXI_LANES; q++) {
+                            #pragma HLS UNROLL
+                            axi_data_t word = 0;
+                            if (g * (PARALLEL_IN_CH / AXI_LANES) + q < tap_words) {
+                                word = w_s.read();
+                            }
+                            data_t v[AXI_LANES];
+                            unpack_word(word, v);
+                            for (int j = 0; j < AXI_LANES; j++) {
+                                #pragma HLS UNROLL
+                                w_buf[oc % PARALLEL_OUT_CH][q * AXI_LANES + j][addr] = v[j];
+                            }
+                        }
+                    }
+                }
+            }
+            
+            PW_OG_LOOP:
+            for (int og = 0; og < oc_groups; og++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=8
+                
+                PW_INIT_ACC:
+                for (int i = 0; i < n; i += AXI_LANES) {
+                    #pragma HLS PIPELINE II=1
+                    #pragma HLS LOOP_TRIPCOUNT min=4 max=256
+                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                        #pragma HLS UNROLL
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            acc[po][i + j] = 0;
+                        }
+                    }
+                }
+                
+                // GEMM over input channel groups, pixels innermost: an
+                // accumulator comes back after n pixels, and a short last
+                // tile (n < PW_PIX_MIN) runs bubble pixels up to PW_PIX_MIN
+                int pix_iters = (n < PW_PIX_MIN) ? PW_PIX_MIN : n;
+                PW_GEMM:
+                for (int g = 0; g < ic_slots; g++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=64
+                    PW_GEMM_PIXELS:
+                    for (int px = 0; px < pix_iters; px++) {
+                        #pragma HLS PIPELINE II=1
+                        #pragma HLS LOOP_TRIPCOUNT min=16 max=1024
+                        #pragma HLS DEPENDENCE variable=acc inter false
+                        if (px < n) {
+                            pw_mac_pixel(in_buf, w_buf, acc, g * pix_tile + px, og * ic_slots + g, px);
+                        }
+                    }
+                }
+                macs += ic_slots * n;
+                
+                // Apply BatchNorm (+ LeakyReLU) and write this group's rows
+                PW_STORE:
+                for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                    int oc = oc0 + og * PARALLEL_OUT_CH + po;
+                    if (oc < oc0 + oc_count) {
+                        bn_t scale_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_scale[oc] : bn_t(1);
+                        bn_t shift_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_shift[oc] : bn_t(0);
+                        
+                        for (int i = 0; i < words; i++) {
+                            #pragma HLS PIPELINE II=1
+                            #pragma HLS LOOP_TRIPCOUNT min=4 max=256
+                            data_t v[AXI_LANES];
+                            for (int j = 0; j < AXI_LANES; j++) {
+                                #pragma HLS UNROLL
+                                v[j] = bn_leaky(acc[po][i * AXI_LANES + j], scale_val, shift_val,
+                                                p.layer_type);
+                            }
+                            output_fm[(oc * plane + pix0) / AXI_LANES + i] = pack_word(v);
+                        }
+                        wr += words;
+                    }
+                }
+            }
+        }
+    }
+    
+    perf.read += rd;
+    perf.compute += macs;
+    perf.write += wr;
+}
+
+/*******************************************************************************
+ * Resident Engine (small maps, fused tail)
+ * Whole input maps sit on chip in one arena, banked by input channel like
+ * the other engines ([ic % PARALLEL_IN_CH], rows pitched to FM_PITCH).
+ * Weights of one OC group stream in once and are swept over every output
+ * pixel of every image in the arena, so each input value is read from DDR
+ * at most once and each weight once per pass over the batch. A layer with
+ * out_chip set writes its result to the other end of the arena, where the
+ * next resident layer finds it, instead of to DDR; a layer without in_chip
+ * first loads as many input maps as the arena holds from DDR.
+ * Tap, pixel and row loops take the layer shape at run time, bounded by
+ * RES_MAX_H x RES_MAX_W, so L4-L6 share one instance of the datapath.
+ ******************************************************************************/
+#define RES_ARENA_BANK    7168   // ceil(channels / PARALLEL_IN_CH) * H * FM_PITCH(W) of every map on
+                                 // chip: 128x14x14 in + 256x7x7 out, or four 256x7x7 (L5 batch)
+#define RES_W_BANK        (256 * 9 / PARALLEL_IN_CH)   // ceil(in_channels / PARALLEL_IN_CH) * k * k
+
+#define RES_MAX_H         14     // Largest map: L4's 14x14 input
+#define RES_MAX_W         14
+#define RES_ACC_BANK      (RES_MAX_H * FM_PITCH(RES_MAX_W))   // One output plane per lane
+#define RES_PIX_MIN       16     // H * W covers the MAC pipeline depth
+
+// Same-padded stride-1 1x1 or 3x3 on a map that fits the accumulators
+static bool resident_shape(int height, int width, int kernel_size, int stride, int padding) {
+    #pragma HLS INLINE
+    return (kernel_size == 1 || kernel_size == 3) && stride == 1 && padding == kernel_size / 2 &&
+           height <= RES_MAX_H && width <= RES_MAX_W && height * width >= RES_PIX_MIN;
+}
+
+// Arena words (per bank) of one map
+static int resident_map_words(int channels, int height, int width) {
+    #pragma HLS INLINE
+    return ((channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH) * height * FM_PITCH(width);
+}
+
+// Arena words of one image's input and output map (a layer chained on chip)
+static int resident_footprint(int layer_type, int in_channels, int out_channels, int height, int width) {
+    #pragma HLS INLINE
+    int pool = (layer_type == 1) ? 2 : 1;
+    return resident_map_words(in_channels, height, width) +
+           resident_map_words(out_channels, height / pool, width / pool);
+}
+
+// Output channels are runtime (one OC group of accumulators at a time), so
+// only the input map and one group's filters bound a layer
+static bool resident_supported(int layer_type, int in_channels,
+                               int height, int width, int kernel_size, int stride, int padding) {
+    #pragma HLS INLINE
+    int ic_groups = (in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    return RESIDENT_ENABLED && resident_shape(height, width, kernel_size, stride, padding) &&
+           resident_map_words(in_channels, height, width) <= RES_ARENA_BANK &&
+           ic_groups * kernel_size * kernel_size <= RES_W_BANK;
+}
+
+#if RESIDENT_ENABLED
+// The arena persists across layers of one start: inputs start at res_src_base, outputs are placed at the other end
+// so a chained layer keeps its input
+static data_t res_map[PARALLEL_IN_CH][RES_ARENA_BANK];
+static int res_src_base = 0;
+static weight_t res_wbuf[PARALLEL_OUT_CH][PARALLEL_IN_CH][RES_W_BANK];
+
+static void resident_engine(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    LayerParams p,
+    bool in_chip,
+    bool out_chip,
+    PerfCounts &perf
+) {
+    const int K = p.kernel_size;
+    const int H = p.in_height;
+    const int W = p.in_width;
+    const bool POOL = (p.layer_type == 1);
+    const int PITCH = p.in_pitch;               // Same for the output (stride 1, same padding)
+    const int PAD = K / 2;
+    const int KK = K * K;
+    const int ROW_WORDS = PITCH / AXI_LANES;
+    const int IN_PLANE = H * PITCH;
+    const int OUT_H = POOL ? H / 2 : H;
+    const int OUT_PITCH = POOL ? FM_PITCH(W / 2) : PITCH;
+    const int OUT_WORDS = OUT_PITCH / AXI_LANES;
+    const int OUT_PLANE = OUT_H * OUT_PITCH;
+    
+    // RES_MAC revisits an accumulator after H * W >= RES_PIX_MIN pixels (no dependence kept)
+    static acc_t acc[PARALLEL_OUT_CH][RES_ACC_BANK];
+    
+    #pragma HLS BIND_STORAGE variable=res_map type=ram_2p impl=bram
+    #pragma HLS BIND_STORAGE variable=acc type=ram_2p impl=bram
+    #pragma HLS ARRAY_PARTITION variable=res_map dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=res_map dim=2 cyclic factor=AXI_LANES
+    #pragma HLS ARRAY_PARTITION variable=res_wbuf dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=res_wbuf dim=2 complete
+    #pragma HLS ARRAY_PARTITION variable=acc dim=1 complete
+    #pragma HLS ARRAY_PARTITION variable=acc dim=2 cyclic factor=AXI_LANES
+    
+    hls::stream<axi_data_t> w_s("res_w_s");
+    #pragma HLS STREAM variable=w_s depth=MAX_CHANNELS/AXI_LANES
+    
+    int ic_groups = (p.in_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+    int oc_groups = (p.out_channels + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+    int tap_words = (p.in_channels + AXI_LANES - 1) / AXI_LANES;
+    int in_size = ic_groups * IN_PLANE;      // Arena words per image
+    int out_size = ((p.out_channels + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH) * OUT_PLANE;
+    int rd = 0, macs = 0, wr = 0;
+    
+    // Images per weight pass: the whole batch when chained, else as many
+    // input maps as the arena holds
+    int chunk = (in_chip || out_chip) ? p.batch : RES_ARENA_BANK / in_size;
+    if (chunk > p.batch) {
+        chunk = p.batch;
+    }
+    if (!in_chip) {
+        res_src_base = 0;
+    }
+    int dst_base = (res_src_base == 0) ? RES_ARENA_BANK - p.batch * out_size : 0;
+    
+    RES_CHUNK_LOOP:
+    for (int b0 = 0; b0 < p.batch; b0 += chunk) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=2
+        int images = (p.batch - b0 < chunk) ? p.batch - b0 : chunk;
+        
+        if (!in_chip) {
+            RES_LOAD_INPUT:
+            for (int b = 0; b < images; b++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                for (int ic = 0; ic < p.in_channels; ic++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=128 max=128
+                    for (int i = 0; i < H * ROW_WORDS; i++) {
+                        #pragma HLS PIPELINE II=1
+                        #pragma HLS LOOP_TRIPCOUNT min=14 max=56
+                        int addr = b * in_size + (ic / PARALLEL_IN_CH) * IN_PLANE + i * AXI_LANES;
+                        data_t v[AXI_LANES];
+                        unpack_word(input_fm[(b0 + b) * p.in_words + (ic * IN_PLANE) / AXI_LANES + i], v);
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            res_map[ic % PARALLEL_IN_CH][addr + j] = v[j];
+                        }
+                    }
+                }
+            }
+            rd += images * p.in_channels * H * ROW_WORDS;
+        }
+        
+        RES_OG_LOOP:
+        for (int og = 0; og < oc_groups; og++) {
+            #pragma HLS LOOP_TRIPCOUNT min=3 max=64
+            
+            // This group's filters, every tap and input channel (lanes as compute_stage)
+            RES_LOAD_WEIGHTS:
+            for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                int oc = og * PARALLEL_OUT_CH + po;
+                for (int t = 0; t < KK; t++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=1 max=9
+                    if (oc < p.out_channels) {
+                        rd += read_packed_row(weights, p.w_words, (oc * KK + t) * p.in_channels,
+                                              p.in_channels, 0, p.in_channels, w_s);
+                    }
+                    for (int g = 0; g < ic_groups; g++) {
+                        #pragma HLS PIPELINE II=2
+                        #pragma HLS LOOP_TRIPCOUNT min=16 max=64
+                        for (int q = 0; q < PARALLEL_IN_CH / AXI_LANES; q++) {
+                            #pragma HLS UNROLL
+                            axi_data_t word = 0;
+                            if (oc < p.out_channels && g * (PARALLEL_IN_CH / AXI_LANES) + q < tap_words) {
+                                word = w_s.read();
+                            }
+                            data_t v[AXI_LANES];
+                            unpack_word(word, v);
+                            for (int j = 0; j < AXI_LANES; j++) {
+                                #pragma HLS UNROLL
+                                res_wbuf[po][q * AXI_LANES + j][g * KK + t] = v[j];
+                            }
+                        }
+                    }
+                }
+            }
+            
+            // The group's weights stay put while every image of the chunk passes
+            RES_IMAGE_LOOP:
+            for (int b = 0; b < images; b++) {
+                #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+                int in_base = res_src_base + b * in_size;
+                int out_base = dst_base + (b0 + b) * out_size;
+                axi_data_t *out_img = output_fm + (b0 + b) * p.out_words;
+                
+                RES_INIT_ACC:
+                for (int i = 0; i < IN_PLANE; i += AXI_LANES) {
+                    #pragma HLS PIPELINE II=1
+                    #pragma HLS LOOP_TRIPCOUNT min=14 max=56
+                    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                        #pragma HLS UNROLL
+                        for (int j = 0; j < AXI_LANES; j++) {
+                            #pragma HLS UNROLL
+                            acc[po][i + j] = 0;
+                        }
+                    }
+                }
+                
+                // Same reduction order as the other engines: IC group, tap, then pixels
+                RES_MAC:
+                for (int g = 0; g < ic_groups; g++) {
+                    #pragma HLS LOOP_TRIPCOUNT min=16 max=64
+                    for (int t = 0; t < KK; t++) {
+                        #pragma HLS LOOP_TRIPCOUNT min=1 max=9
+                        int kh = t / K, kw = t % K;
+                        int oh = 0, ow = 0;
+                        for (int px = 0; px < H * W; px++) {
+                            #pragma HLS PIPELINE II=1
+                            #pragma HLS LOOP_TRIPCOUNT min=49 max=196
+                            #pragma HLS DEPENDENCE variable=acc inter false
+                            
+                            int ih = oh + kh - PAD;
+                            int iw = ow + kw - PAD;
+                            bool valid = ih >= 0 && ih < H && iw >= 0 && iw < W;
+                            int acc_idx = oh * PITCH + ow;
+                            
+                            data_t x[PARALLEL_IN_CH];
+                            #pragma HLS ARRAY_PARTITION variable=x complete
+                            for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                                #pragma HLS UNROLL
+                                x[pi] = valid ? res_map[pi][in_base + g * IN_PLANE + ih * PITCH + iw] : data_t(0);
+                            }
+                            
+                            weight_t wv[PARALLEL_OUT_CH][PARALLEL_IN_CH];
+                            acc_t sum[PARALLEL_OUT_CH];
+                            #pragma HLS ARRAY_PARTITION variable=wv complete dim=0
+                            #pragma HLS ARRAY_PARTITION variable=sum complete
+                            for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                                #pragma HLS UNROLL
+                                sum[po] = acc[po][acc_idx];
+                                for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+                                    #pragma HLS UNROLL
+                                    wv[po][pi] = res_wbuf[po][pi][g * KK + t];
+                                }
+                            }
+                            mac_array(x, wv, sum);
+                            for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                                #pragma HLS UNROLL
+                                acc[po][acc_idx] = sum[po];
+                            }
+                            
+                            if (++ow == W) {
+                                ow = 0;
+                                oh++;
+                            }
+                        }
+                    }
+                }
+                macs += ic_groups * KK * H * W;
+                
+                // BatchNorm + LeakyReLU (+ 2x2 pool) into the arena or DDR; pad columns are zero
+                RES_STORE:
+                for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+                    int oc = og * PARALLEL_OUT_CH + po;
+                    if (oc < p.out_channels) {
+                        bn_t scale_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_scale[oc] : bn_t(1);
+                        bn_t shift_val = (p.layer_type != 2 || HEAD_REQUANT) ? bn_shift[oc] : bn_t(0);
+                        acc_t *bank = acc[po];
+                        
+                        for (int i = 0; i < OUT_H * OUT_WORDS; i++) {
+                            #pragma HLS PIPELINE II=2
+                            #pragma HLS LOOP_TRIPCOUNT min=14 max=14
+                            int r = i / OUT_WORDS, c0 = (i % OUT_WORDS) * AXI_LANES;
+                            data_t v[AXI_LANES];
+                            for (int j = 0; j < AXI_LANES; j++) {
+                                #pragma HLS UNROLL
+                                int col = c0 + j;
+                                v[j] = 0;
+                                if (POOL && 2 * col + 1 < W) {
+                                    int a = 2 * r * PITCH + 2 * col;
+                                    v[j] = max4_hw(bn_leaky(bank[a], scale_val, shift_val, p.layer_type),
+                                                   bn_leaky(bank[a + 1], scale_val, shift_val, p.layer_type),
+                                                   bn_leaky(bank[a + PITCH], scale_val, shift_val, p.layer_type),
+                                                   bn_leaky(bank[a + PITCH + 1], scale_val, shift_val, p.layer_type));
+                                } else if (!POOL && col < W) {
+                                    v[j] = bn_leaky(bank[r * PITCH + col], scale_val, shift_val, p.layer_type);
+                                }
+                            }
+                            
+                            if (out_chip) {
+                                int addr = out_base + (oc / PARALLEL_IN_CH) * OUT_PLANE + i * AXI_LANES;
+                                for (int j = 0; j < AXI_LANES; j++) {
+                                    #pragma HLS UNROLL
+                                    res_map[oc % PARALLEL_IN_CH][addr + j] = v[j];
+                                }
+                            } else {
+                                out_img[(oc * OUT_PLANE) / AXI_LANES + i] = pack_word(v);
+                            }
+                        }
+                        if (!out_chip) {
+                            wr += OUT_H * OUT_WORDS;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    if (out_chip) {
+        res_src_base = dst_base;
+    }
+    
+    perf.read += rd;
+    perf.compute += macs;
+    perf.write += wr;
+}
+#endif
+
+/*******************************************************************************
+ * Run One Layer
+ * Derives the tile schedule for a layer and dispatches it to an engine
+ ******************************************************************************/
+static void run_network_layer(
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
+    int layer_type,
+    int in_channels,
+    int out_channels,
+    int in_height,
+    int in_width,
+    int kernel_size,
+    int stride,
+    int padding,
+    int dataflow,
+    int engine,
+    int batch,            // Images, back to back in the input and output buffers
+    bool in_chip,         // Input is the resident map left by the previous layer
+    bool out_chip,        // Leave the output in the resident maps for the next layer
+    PerfCounts &perf
+) {
+    // Calculate output dimensions
+    LayerParams p;
+    p.layer_type = layer_type;
+    p.in_channels = in_channels;
+    p.out_channels = out_channels;
+    p.in_height = in_height;
+    p.in_width = in_width;
+    p.kernel_size = kernel_size;
+    p.stride = stride;
+    p.padding = padding;
+    p.out_height = (in_height + 2 * padding - kernel_size) / stride + 1;
+    p.out_width = (in_width + 2 * padding - kernel_size) / stride + 1;
+    int out_height = p.out_height;
+    int out_width = p.out_width;
+    p.in_pitch = FM_PITCH(in_width);
+    p.out_pitch = FM_PITCH(out_width);
+    p.in_words = in_channels * in_height * p.in_pitch / AXI_LANES;
+    p.w_words = (out_channels * in_channels * kernel_size * kernel_size + AXI_LANES - 1) / AXI_LANES;
+    p.out_words = (layer_type == 1) ? out_channels * (out_height / 2) * FM_PITCH(out_width / 2) / AXI_LANES
+                                    : out_channels * out_height * p.out_pitch / AXI_LANES;
+    p.batch = (batch > 1) ? batch : 1;
+    
+    // Process output channels in tiles
+    p.oc_tiles = (out_channels + TILE_CH - 1) / TILE_CH;
+    p.ic_tiles = (in_channels + TILE_CH - 1) / TILE_CH;
+    p.oh_tiles = (out_height + TILE_H - 1) / TILE_H;
+    p.ow_tiles = (out_width + TILE_W - 1) / TILE_W;
+    
+    // Cache footprint of one IC tile (largest spatial tile, with halo)
+    int tile_oh = (out_height < TILE_H) ? out_height : TILE_H;
+    int tile_ow = (out_width < TILE_W) ? out_width : TILE_W;
+    p.in_block = TILE_CH * ((tile_oh - 1) * stride + kernel_size) *
+                           FM_PITCH((tile_ow - 1) * stride + kernel_size);
+    p.w_block = TILE_CH * TILE_CH * kernel_size * kernel_size;
+    
+    // Fall back to output-stationary when the resident operand does not fit
+    p.mode = dataflow;
+    if (p.mode == DATAFLOW_WEIGHT_STATIONARY && p.ic_tiles * p.w_block > WEIGHT_CACHE_SIZE) {
+        p.mode = DATAFLOW_OUTPUT_STATIONARY;
+    }
+    if (p.mode == DATAFLOW_INPUT_STATIONARY && p.ic_tiles * p.in_block > INPUT_CACHE_SIZE) {
+        p.mode = DATAFLOW_OUTPUT_STATIONARY;
+    }
+    
+#if RESIDENT_ENABLED
+    if (in_chip || out_chip ||
+        (engine == ENGINE_RESIDENT && resident_supported(layer_type, in_channels, in_height, in_width,
+                                                         kernel_size, stride, padding))) {
+        resident_engine(input_fm, output_fm, weights, bn_scale, bn_shift, p, in_chip, out_chip, perf);
+        return;
+    }
+#endif
+    
+    // The streaming engines hold one image at a time and run the batch in turn
+    BATCH_LOOP:
+    for (int b = 0; b < p.batch; b++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+        axi_data_t *in_img = input_fm + b * p.in_words;
+        axi_data_t *out_img = output_fm + b * p.out_words;
+        
+        if (pointwise_supported(p)) {
+            pointwise_engine(in_img, out_img, weights, bn_scale, bn_shift, p, perf);
+#if WINO_ENABLED
+        } else if (engine == ENGINE_WINOGRAD && winograd_supported(p)) {
+            winograd_engine(in_img, out_img, weights, bn_scale, bn_shift, p, perf);
+#endif
+#if LINE_BUFFER_ENABLED
+        } else if ((engine == ENGINE_LINE_BUFFER || engine == ENGINE_WINOGRAD) && line_buffer_supported(p)) {
+            line_buffer_engine(in_img, out_img, weights, bn_scale, bn_shift, p, perf);
+#endif
+        } else {
+            int rd, macs, wr;
+            run_layer(in_img, out_img, weights, bn_scale, bn_shift, p, rd, macs, wr);
+            perf.read += rd;
+            perf.compute += macs;
+            perf.write += wr;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Head Decode
+ * Runs yolo_decode_hw over every image of a head layer (type 2: raw sums,
+ * its bn_shift entries are the conv bias) once the layer has written its
+ * output. The maps are read back over the output port, behind its writes.
+ ******************************************************************************/
+static void decode_head(
+    axi_data_t *output_fm,
+    bn_t *bn_shift,
+    int *decode_params,
+    axi_data_t *candidates,
+    int layer_type,
+    int out_channels,
+    int in_height,
+    int in_width,
+    int kernel_size,
+    int stride,
+    int padding,
+    int batch,
+    ap_uint<32> &found
+) {
+#if HEAD_DECODE_ENABLED
+    int out_height = (in_height + 2 * padding - kernel_size) / stride + 1;
+    int out_width = (in_width + 2 * padding - kernel_size) / stride + 1;
+    int out_words = out_channels * out_height * FM_PITCH(out_width) / AXI_LANES;
+    
+    if (layer_type != 2) {
+        return;
+    }
+    
+    DECODE_IMAGES:
+    for (int b = 0; b < ((batch > 1) ? batch : 1); b++) {
+        #pragma HLS LOOP_TRIPCOUNT min=1 max=4
+        yolo_decode_hw(output_fm + b * out_words, bn_shift, decode_params, candidates,
+                       out_channels, out_height, out_width, b, found);
+    }
+#else
+    // INT8 heads are requantised: nothing to decode, found stays 0
+    (void)output_fm;
+    (void)bn_shift;
+    (void)decode_params;
+    (void)candidates;
+    (void)layer_type;
+    (void)out_channels;
+    (void)in_height;
+    (void)in_width;
+    (void)kernel_size;
+    (void)stride;
+    (void)padding;
+    (void)batch;
+    (void)found;
+#endif
+}
+
 /*******************************************************************************
  * Top-Level Accelerator Function (Optimized)
  * Processes one layer at a time with DDR-based feature maps
+ *
+ * Tile loop order is chosen per layer by the dataflow register:
+ * - Output-stationary: OC -> spatial -> IC, every operand refetched per tile
+ * - Weight-stationary: OC -> spatial -> IC, an OC tile's weights are fetched
+ *   once and reused for every spatial tile (large maps: L0-L3)
+ * - Input-stationary:  spatial -> OC -> IC, a spatial tile's inputs are
+ *   fetched once and reused for every OC tile (small maps, big weights: L4-L6)
+ * Modes whose working set does not fit the caches fall back to output-stationary.
+ *
+ * The engine register selects between the tiled pipeline above, the
+ * line-buffer streaming engine (3x3/s1/p1 layers with up to ENGINE_MAX_IC
+ * input channels), its Winograd F(2x2,3x3) variant on the same shapes (the
+ * plain line buffer in INT8 builds) and the resident engine (same-padded 1x1
+ * or 3x3 maps up to RES_MAX_H x RES_MAX_W); unsupported layers fall back to the tiled pipeline. Other 1x1 stride-1
+ * layers (no pool) always take the pointwise GEMM engine.
+ *
+ * Command-list mode: with num_layers > 0 the layer registers are ignored and
+ * the IP walks num_layers descriptors in DDR (DESC_* layout), offsetting each
+ * pointer register by the descriptor's offsets, and raises done once at the
+ * end of the network. A run of resident layers in the list is fused: the
+ * maps between them never leave the chip, and their DDR output buffers are
+ * not written.
+ *
+ * Batch mode: batch > 1 (register or DESC_BATCH) runs that many images whose
+ * maps lie back to back in each buffer, one map size apart. The resident
+ * engine loads as many input maps as its arena holds and sweeps each OC
+ * group's weights over all of them, so the weight-heavy tail (L5: 2.4 MB in
+ * Q8.8) is fetched once per pass instead of once per image. The streaming
+ * engines run the images in turn; a resident run stays fused only when the
+ * maps of the whole batch fit on chip.
+ *
+ * perf_compute / perf_read / perf_write return the activity counters of the
+ * start (see PerfCounts), summed over every layer in command-list mode.
+ *
+ * Head decode: with the decode register (or DESC_DECODE) set on a head
+ * layer, its output is also reduced to YOLO candidate boxes appended to
+ * 'candidates' (yolo_decode_hw); num_candidates returns the total found
+ * in the start. The head map is still written in full.
  ******************************************************************************/
 void cnn_accelerator_top(
     // Control/Status (memory-mapped)
     volatile ap_uint<32> *control,
     volatile ap_uint<32> *status,
     
-    // Feature maps in DDR (memory-mapped)
-    data_t *input_fm,
-    data_t *output_fm,
+    // Feature maps in DDR (memory-mapped, 64-bit packed)
+    axi_data_t *input_fm,
+    axi_data_t *output_fm,
+    
+    // Weights in DDR (memory-mapped, 64-bit packed)
+    axi_data_t *weights,
+    bn_t *bn_scale,
+    bn_t *bn_shift,
     
-    // Weights in DDR (memory-mapped)
-    weight_t *weights,
-    weight_t *bn_scale,
-    weight_t *bn_shift,
+    // Layer descriptor table in DDR (command-list mode)
+    int *descriptors,
     
     // Layer configuration
     int layer_type,       // 0: conv+bn+relu, 1: conv+bn+relu+pool, 2: conv only
@@ -50,7 +2022,22 @@ void cnn_accelerator_top(
     int in_width,
     int kernel_size,
     int stride,
-    int padding
+    int padding,
+    int dataflow,         // 0: output-, 1: weight-, 2: input-stationary
+    int engine,           // 0: tiled, 1: line-buffer streaming, 2: resident, 3: Winograd
+    int num_layers,       // 0: single layer from registers, N: walk N descriptors
+    int batch,            // Images per layer (0 or 1: one), register mode
+    
+    // Activity counters of this start (status outputs)
+    volatile ap_uint<32> *perf_compute,   // MAC array cycles
+    volatile ap_uint<32> *perf_read,      // Read beats: feature maps + weights
+    volatile ap_uint<32> *perf_write,     // Write beats: feature maps
+    
+    // YOLO head decode (see yolo_decode_hw)
+    int decode,                           // Register mode: decode the head's output
+    int *decode_params,                   // DECODE_* parameter block
+    axi_data_t *candidates,               // Candidate list
+    volatile ap_uint<32> *num_candidates  // Candidates found (the list keeps DECODE_MAX_CAND)
 ) {
     // AXI Interface Pragmas
     #pragma HLS INTERFACE s_axilite port=return bundle=control
@@ -64,242 +2051,109 @@ void cnn_accelerator_top(
     #pragma HLS INTERFACE s_axilite port=kernel_size bundle=control
     #pragma HLS INTERFACE s_axilite port=stride bundle=control
     #pragma HLS INTERFACE s_axilite port=padding bundle=control
+    #pragma HLS INTERFACE s_axilite port=dataflow bundle=control
+    #pragma HLS INTERFACE s_axilite port=engine bundle=control
+    #pragma HLS INTERFACE s_axilite port=num_layers bundle=control
+    #pragma HLS INTERFACE s_axilite port=batch bundle=control
+    #pragma HLS INTERFACE s_axilite port=perf_compute bundle=control
+    #pragma HLS INTERFACE s_axilite port=perf_read bundle=control
+    #pragma HLS INTERFACE s_axilite port=perf_write bundle=control
+    #pragma HLS INTERFACE s_axilite port=decode bundle=control
+    #pragma HLS INTERFACE s_axilite port=num_candidates bundle=control
     
-    // AXI Master interfaces for DDR access with reasonable depths
-    #pragma HLS INTERFACE m_axi port=input_fm offset=slave bundle=gmem0 depth=150528 max_read_burst_length=64
-    #pragma HLS INTERFACE m_axi port=output_fm offset=slave bundle=gmem1 depth=150528 max_write_burst_length=64
-    #pragma HLS INTERFACE m_axi port=weights offset=slave bundle=gmem2 depth=18432 max_read_burst_length=64
+    // AXI Master interfaces for DDR access, deep enough for any single layer
+    // Ports are 64 bits wide to match the Zynq-7000 HP ports (AXI_LANES values per beat)
+    #pragma HLS INTERFACE m_axi port=input_fm offset=slave bundle=gmem0 depth=DDR_FM_DEPTH max_read_burst_length=64
+    #pragma HLS INTERFACE m_axi port=output_fm offset=slave bundle=gmem1 depth=DDR_FM_DEPTH max_write_burst_length=64
+    #pragma HLS INTERFACE m_axi port=weights offset=slave bundle=gmem2 depth=DDR_WEIGHTS_DEPTH max_read_burst_length=64
     #pragma HLS INTERFACE m_axi port=bn_scale offset=slave bundle=gmem3 depth=512
     #pragma HLS INTERFACE m_axi port=bn_shift offset=slave bundle=gmem3 depth=512
-    
-    // Small on-chip tile buffers (fits in BRAM)
-    static data_t input_tile[INPUT_TILE_SIZE];
-    static data_t output_tile[OUTPUT_TILE_SIZE];
-    static weight_t weight_tile[WEIGHT_BUF_SIZE];
-    static acc_t acc_tile[OUTPUT_TILE_SIZE];
-    
-    #pragma HLS BIND_STORAGE variable=input_tile type=ram_2p impl=bram
-    #pragma HLS BIND_STORAGE variable=output_tile type=ram_2p impl=bram
-    #pragma HLS BIND_STORAGE variable=weight_tile type=ram_1p impl=bram
-    #pragma HLS BIND_STORAGE variable=acc_tile type=ram_2p impl=bram
-    
-    // Calculate output dimensions
-    int out_height = (in_height + 2 * padding - kernel_size) / stride + 1;
-    int out_width = (in_width + 2 * padding - kernel_size) / stride + 1;
+    #pragma HLS INTERFACE m_axi port=descriptors offset=slave bundle=gmem3 depth=DESC_WORDS*8
+    #pragma HLS INTERFACE m_axi port=decode_params offset=slave bundle=gmem3 depth=DECODE_PARAM_WORDS
+    #pragma HLS INTERFACE m_axi port=candidates offset=slave bundle=gmem1 depth=DECODE_MAX_CANDS*DECODE_CAND_WORDS max_write_burst_length=64
     
     // Signal processing start
     *status = 1;  // Running
     
-    // Process output channels in tiles
-    int oc_tiles = (out_channels + TILE_CH - 1) / TILE_CH;
-    int ic_tiles = (in_channels + TILE_CH - 1) / TILE_CH;
-    int oh_tiles = (out_height + TILE_H - 1) / TILE_H;
-    int ow_tiles = (out_width + TILE_W - 1) / TILE_W;
-    
-    // Main processing loop - tile by tile
-    OC_TILE_LOOP:
-    for (int oc_t = 0; oc_t < oc_tiles; oc_t++) {
-        #pragma HLS LOOP_TRIPCOUNT min=1 max=16
-        
-        int oc_start = oc_t * TILE_CH;
-        int oc_end = (oc_start + TILE_CH > out_channels) ? out_channels : oc_start + TILE_CH;
-        int oc_count = oc_end - oc_start;
-        
-        // Process spatial tiles
-        OH_TILE_LOOP:
-        for (int oh_t = 0; oh_t < oh_tiles; oh_t++) {
+    PerfCounts perf = {0, 0, 0};
+    ap_uint<32> found = 0;
+    
+    if (num_layers == 0) {
+        run_network_layer(input_fm, output_fm, weights, bn_scale, bn_shift,
+                          layer_type, in_channels, out_channels, in_height, in_width,
+                          kernel_size, stride, padding, dataflow, engine, batch, false, false, perf);
+        if (decode) {
+            decode_head(output_fm, bn_shift, decode_params, candidates, layer_type, out_channels,
+                        in_height, in_width, kernel_size, stride, padding, batch, found);
+        }
+    } else {
+        bool on_chip = false;   // Previous layer left its output in the resident maps
+        
+        LAYER_LOOP:
+        for (int l = 0; l < num_layers; l++) {
             #pragma HLS LOOP_TRIPCOUNT min=1 max=16
             
-            int oh_start = oh_t * TILE_H;
-            int oh_end = (oh_start + TILE_H > out_height) ? out_height : oh_start + TILE_H;
+            int desc[DESC_WORDS];
+            #pragma HLS ARRAY_PARTITION variable=desc complete
             
-            OW_TILE_LOOP:
-            for (int ow_t = 0; ow_t < ow_tiles; ow_t++) {
-                #pragma HLS LOOP_TRIPCOUNT min=1 max=16
-                
-                int ow_start = ow_t * TILE_W;
-                int ow_end = (ow_start + TILE_W > out_width) ? out_width : ow_start + TILE_W;
-                
-                // Initialize accumulators for this tile
-                int tile_size = oc_count * (oh_end - oh_start) * (ow_end - ow_start);
-                INIT_ACC:
-                for (int i = 0; i < tile_size; i++) {
-                    #pragma HLS PIPELINE II=1
-                    #pragma HLS LOOP_TRIPCOUNT min=1 max=6272
-                    acc_tile[i] = 0;
-                }
-                
-                // Accumulate over input channel tiles
-                IC_TILE_LOOP:
-                for (int ic_t = 0; ic_t < ic_tiles; ic_t++) {
-                    #pragma HLS LOOP_TRIPCOUNT min=1 max=16
-                    
-                    int ic_start = ic_t * TILE_CH;
-                    int ic_end = (ic_start + TILE_CH > in_channels) ? in_channels : ic_start + TILE_CH;
-                    int ic_count = ic_end - ic_start;
-                    
-                    // Load input tile from DDR (with halo for convolution)
-                    int ih_start = oh_start * stride - padding;
-                    int ih_end = (oh_end - 1) * stride + kernel_size - padding;
-                    int iw_start = ow_start * stride - padding;
-                    int iw_end = (ow_end - 1) * stride + kernel_size - padding;
-                    
-                    // Load input tile
-                    int tile_idx = 0;
-                    LOAD_INPUT:
-                    for (int ic = ic_start; ic < ic_end; ic++) {
-                        for (int ih = ih_start; ih < ih_end; ih++) {
-                            for (int iw = iw_start; iw < iw_end; iw++) {
-                                #pragma HLS PIPELINE II=1
-                                #pragma HLS LOOP_TRIPCOUNT min=1 max=8192
-                                
-                                if (ih >= 0 && ih < in_height && iw >= 0 && iw < in_width) {
-                                    int ddr_idx = ic * in_height * in_width + ih * in_width + iw;
-                                    input_tile[tile_idx] = input_fm[ddr_idx];
-                                } else {
-                                    input_tile[tile_idx] = 0;  // Zero padding
-                                }
-                                tile_idx++;
-                            }
-                        }
-                    }
-                    
-                    // Load weights for this tile pair
-                    LOAD_WEIGHTS:
-                    for (int oc = oc_start; oc < oc_end; oc++) {
-                        for (int ic = ic_start; ic < ic_end; ic++) {
-                            for (int kh = 0; kh < kernel_size; kh++) {
-                                for (int kw = 0; kw < kernel_size; kw++) {
-                                    #pragma HLS PIPELINE II=1
-                                    #pragma HLS LOOP_TRIPCOUNT min=1 max=9216
-                                    
-                                    int w_ddr_idx = oc * in_channels * kernel_size * kernel_size +
-                                                   ic * kernel_size * kernel_size +
-                                                   kh * kernel_size + kw;
-                                    int w_tile_idx = (oc - oc_start) * ic_count * kernel_size * kernel_size +
-                                                    (ic - ic_start) * kernel_size * kernel_size +
-                                                    kh * kernel_size + kw;
-                                    weight_tile[w_tile_idx] = weights[w_ddr_idx];
-                                }
-                            }
-                        }
-                    }
-                    
-                    // Compute convolution for this tile
-                    int tile_ih = ih_end - ih_start;
-                    int tile_iw = iw_end - iw_start;
-                    
-                    COMPUTE_TILE:
-                    for (int oc = 0; oc < oc_count; oc++) {
-                        for (int oh = 0; oh < (oh_end - oh_start); oh++) {
-                            for (int ow = 0; ow < (ow_end - ow_start); ow++) {
-                                #pragma HLS PIPELINE II=1
-                                #pragma HLS LOOP_TRIPCOUNT min=1 max=6272
-                                
-                                acc_t sum = acc_tile[oc * (oh_end - oh_start) * (ow_end - ow_start) + 
-                                                    oh * (ow_end - ow_start) + ow];
-                                
-                                // Convolve over input channels and kernel
-                                for (int ic = 0; ic < ic_count; ic++) {
-                                    #pragma HLS UNROLL factor=4
-                                    for (int kh = 0; kh < kernel_size; kh++) {
-                                        for (int kw = 0; kw < kernel_size; kw++) {
-                                            int ih_local = oh * stride + kh;
-                                            int iw_local = ow * stride + kw;
-                                            
-                                            int in_idx = ic * tile_ih * tile_iw + ih_local * tile_iw + iw_local;
-                                            int w_idx = oc * ic_count * kernel_size * kernel_size +
-                                                       ic * kernel_size * kernel_size +
-                                                       kh * kernel_size + kw;
-                                            
-                                            sum += input_tile[in_idx] * weight_tile[w_idx];
-                                        }
-                                    }
-                                }
-                                
-                                acc_tile[oc * (oh_end - oh_start) * (ow_end - ow_start) + 
-                                        oh * (ow_end - ow_start) + ow] = sum;
-                            }
-                        }
-                    }
-                }
-                
-                // Apply BatchNorm + LeakyReLU and write output tile to DDR
-                WRITE_OUTPUT:
-                for (int oc = 0; oc < oc_count; oc++) {
-                    #pragma HLS LOOP_TRIPCOUNT min=1 max=32
-                    
-                    weight_t scale_val = (layer_type != 2) ? bn_scale[oc_start + oc] : weight_t(1);
-                    weight_t shift_val = (layer_type != 2) ? bn_shift[oc_start + oc] : weight_t(0);
-                    
-                    for (int oh = 0; oh < (oh_end - oh_start); oh++) {
-                        for (int ow = 0; ow < (ow_end - ow_start); ow++) {
-                            #pragma HLS PIPELINE II=1
-                            #pragma HLS LOOP_TRIPCOUNT min=1 max=196
-                            
-                            int tile_idx = oc * (oh_end - oh_start) * (ow_end - ow_start) + 
-                                          oh * (ow_end - ow_start) + ow;
-                            
-                            // BatchNorm: out = acc * scale + shift
-                            acc_t bn_out = acc_tile[tile_idx] * scale_val + shift_val;
-                            
-                            // LeakyReLU (if not output layer)
-                            data_t result;
-                            if (layer_type != 2) {
-                                if (bn_out > acc_t(0)) {
-                                    result = data_t(bn_out);
-                                } else {
-                                    result = data_t(bn_out >> 3);  // Approx 0.1x
-                                }
-                            } else {
-                                result = data_t(bn_out);
-                            }
-                            
-                            // Write to DDR
-                            int out_idx = (oc_start + oc) * out_height * out_width +
-                                         (oh_start + oh) * out_width +
-                                         (ow_start + ow);
-                            output_fm[out_idx] = result;
-                        }
-                    }
-                }
+            READ_DESC:
+            for (int i = 0; i < DESC_WORDS; i++) {
+                #pragma HLS PIPELINE II=1
+                desc[i] = descriptors[l * DESC_WORDS + i];
             }
-        }
-    }
-    
-    // Handle max pooling as separate pass if needed
-    if (layer_type == 1) {
-        int pool_height = out_height / 2;
-        int pool_width = out_width / 2;
-        
-        POOL_LOOP:
-        for (int c = 0; c < out_channels; c++) {
-            #pragma HLS LOOP_TRIPCOUNT min=16 max=512
-            for (int ph = 0; ph < pool_height; ph++) {
-                for (int pw = 0; pw < pool_width; pw++) {
-                    #pragma HLS PIPELINE II=1
-                    #pragma HLS LOOP_TRIPCOUNT min=1 max=12544
-                    
-                    // Read 2x2 window
-                    int base_idx = c * out_height * out_width + (ph * 2) * out_width + (pw * 2);
-                    data_t v00 = output_fm[base_idx];
-                    data_t v01 = output_fm[base_idx + 1];
-                    data_t v10 = output_fm[base_idx + out_width];
-                    data_t v11 = output_fm[base_idx + out_width + 1];
-                    
-                    // Max
-                    data_t max01 = (v00 > v01) ? v00 : v01;
-                    data_t max23 = (v10 > v11) ? v10 : v11;
-                    data_t max_val = (max01 > max23) ? max01 : max23;
-                    
-                    // Write back (in-place to different region)
-                    int pool_idx = c * pool_height * pool_width + ph * pool_width + pw;
-                    output_fm[pool_idx] = max_val;
-                }
+            
+            // A resident layer followed by another keeps its output on chip
+            // when both maps of every image in the batch fit the arena
+            int next[DESC_WORDS];
+            #pragma HLS ARRAY_PARTITION variable=next complete
+            
+            READ_NEXT_DESC:
+            for (int i = 0; i < DESC_WORDS; i++) {
+                #pragma HLS PIPELINE II=1
+                next[i] = (l + 1 < num_layers) ? descriptors[(l + 1) * DESC_WORDS + i] : 0;
             }
+            int batch_l = (desc[DESC_BATCH] > 1) ? desc[DESC_BATCH] : 1;
+            int batch_next = (next[DESC_BATCH] > 1) ? next[DESC_BATCH] : 1;
+            bool out_chip = l + 1 < num_layers &&
+                desc[DESC_ENGINE] == ENGINE_RESIDENT &&
+                resident_supported(desc[DESC_LAYER_TYPE], desc[DESC_IN_CHANNELS], desc[DESC_IN_HEIGHT],
+                                   desc[DESC_IN_WIDTH], desc[DESC_KERNEL_SIZE], desc[DESC_STRIDE],
+                                   desc[DESC_PADDING]) &&
+                next[DESC_ENGINE] == ENGINE_RESIDENT &&
+                resident_supported(next[DESC_LAYER_TYPE], next[DESC_IN_CHANNELS], next[DESC_IN_HEIGHT],
+                                   next[DESC_IN_WIDTH], next[DESC_KERNEL_SIZE], next[DESC_STRIDE],
+                                   next[DESC_PADDING]) &&
+                batch_next == batch_l &&
+                batch_l * resident_footprint(desc[DESC_LAYER_TYPE], desc[DESC_IN_CHANNELS],
+                                             desc[DESC_OUT_CHANNELS], desc[DESC_IN_HEIGHT],
+                                             desc[DESC_IN_WIDTH]) <= RES_ARENA_BANK;
+            
+            run_network_layer(input_fm + desc[DESC_INPUT_OFFSET],
+                              output_fm + desc[DESC_OUTPUT_OFFSET],
+                              weights + desc[DESC_WEIGHTS_OFFSET],
+                              bn_scale + desc[DESC_BN_OFFSET],
+                              bn_shift + desc[DESC_BN_OFFSET],
+                              desc[DESC_LAYER_TYPE], desc[DESC_IN_CHANNELS], desc[DESC_OUT_CHANNELS],
+                              desc[DESC_IN_HEIGHT], desc[DESC_IN_WIDTH], desc[DESC_KERNEL_SIZE],
+                              desc[DESC_STRIDE], desc[DESC_PADDING], desc[DESC_DATAFLOW],
+                              desc[DESC_ENGINE], batch_l, on_chip, out_chip, perf);
+            
+            // A head kept on chip for the next layer has no map in DDR to decode
+            if (desc[DESC_DECODE] && !out_chip) {
+                decode_head(output_fm + desc[DESC_OUTPUT_OFFSET], bn_shift + desc[DESC_BN_OFFSET],
+                            decode_params, candidates, desc[DESC_LAYER_TYPE], desc[DESC_OUT_CHANNELS],
+                            desc[DESC_IN_HEIGHT], desc[DESC_IN_WIDTH], desc[DESC_KERNEL_SIZE],
+                            desc[DESC_STRIDE], desc[DESC_PADDING], batch_l, found);
+            }
+            on_chip = out_chip;
         }
     }
     
+    *perf_compute = perf.compute;
+    *perf_read = perf.read;
+    *perf_write = perf.write;
+    *num_candidates = found;
+    
     // Signal completion
     *status = 0;  // Done
 }
@@ -12,24 +12,55 @@
 #include <ap_fixed.h>
 #include <ap_int.h>
 #include <hls_stream.h>
+#include <ap_axi_sdata.h>
 
 /*******************************************************************************
  * Fixed-Point Type Definitions
+ * Selected at synthesis time: Q8.8 by default, or INT8 with CNN_INT8=1
+ * (script.tcl: -tclargs <mode> int8). The INT8 build keeps the same ports
+ * and layouts with 8-bit elements, eight per 64-bit word.
  ******************************************************************************/
+#ifndef CNN_INT8
+#define CNN_INT8            0
+#endif
+
+#if CNN_INT8
+// INT8: symmetric 8-bit codes (value = code * scale), int32 accumulators.
+// Per-layer activation and per-OC weight scales fold into BN scale/shift:
+//   bn_scale = s_in * s_w[oc] * gamma / sqrt(var + eps) / s_out
+//   bn_shift = (beta - mean * gamma / sqrt(var + eps)) / s_out
+typedef ap_fixed<8, 8, AP_RND, AP_SAT> data_t;       // Activations
+typedef ap_fixed<8, 8, AP_RND, AP_SAT> weight_t;     // Weights
+typedef ap_fixed<32, 32, AP_RND, AP_SAT> acc_t;      // Accumulator (int32)
+typedef ap_fixed<32, 8, AP_RND, AP_SAT> bn_t;        // Requantisation scale/shift
+#define DATA_BITS           8
+#else
 // Q8.8 format: 8 integer bits, 8 fractional bits (16-bit total)
 typedef ap_fixed<16, 8, AP_RND, AP_SAT> data_t;      // Activations
 typedef ap_fixed<16, 8, AP_RND, AP_SAT> weight_t;    // Weights
 typedef ap_fixed<32, 16, AP_RND, AP_SAT> acc_t;      // Accumulator (extra precision)
+typedef ap_fixed<16, 8, AP_RND, AP_SAT> bn_t;        // BatchNorm scale/shift
+#define DATA_BITS           16
+#endif
+
+// BatchNorm / requantisation result before LeakyReLU and output rounding
+typedef ap_fixed<32, 16, AP_RND, AP_SAT> epi_t;
+
+// INT8 also requantises the output head (layer type 2) through bn_scale and
+// bn_shift; Q8.8 writes its raw sums
+#define HEAD_REQUANT        CNN_INT8
 
-// Unsigned versions for indices
-typedef ap_uint<8> channel_t;
-typedef ap_uint<8> dim_t;
+// Unsigned versions for indices (up to 1023: 512 channels, 416/608 inputs)
+typedef ap_uint<10> channel_t;
+typedef ap_uint<10> dim_t;
 
 /*******************************************************************************
  * Network Configuration Constants
  ******************************************************************************/
 // Maximum supported dimensions (for buffer sizing)
-#define MAX_INPUT_SIZE      224
+// Inputs up to 608 (YOLO 416/608): the tiled engine takes any width, the row
+// engines cap theirs on chip (ENGINE_MAX_WIDTH, WINO_MAX_WIDTH in cnn_accel.cpp)
+#define MAX_INPUT_SIZE      608
 #define MAX_CHANNELS        512
 #define MAX_KERNEL_SIZE     3
 #define MAX_OUTPUT_CHANNELS 512
@@ -43,21 +74,102 @@ typedef ap_uint<8> dim_t;
  * Hardware Design Parameters
  ******************************************************************************/
 // Parallelism factors (adjust based on resource constraints)
+// INT8 packs two output lanes into each DSP48, so it has twice the output
+// lanes for the same 64 DSPs in the MAC array
+#if CNN_INT8
+#define PARALLEL_OUT_CH     16   // Process 16 output channels in parallel (even)
+#else
 #define PARALLEL_OUT_CH     8    // Process 8 output channels in parallel
-#define PARALLEL_IN_CH      8    // Process 8 input channels in parallel
+#endif
+#define PARALLEL_IN_CH      8    // Process 8 input channels in parallel (multiple of AXI_LANES)
 #define BURST_LENGTH        64   // AXI burst length
 
 // Line buffer depth (for 3x3 convolution)
 #define LINE_BUFFER_SIZE    (MAX_INPUT_SIZE * 2)  // 2 full lines
 
+/*******************************************************************************
+ * Dataflow Modes (tile loop order, selected per layer)
+ ******************************************************************************/
+#define DATAFLOW_OUTPUT_STATIONARY  0    // Refetch inputs and weights per tile
+#define DATAFLOW_WEIGHT_STATIONARY  1    // Reuse OC tile weights across spatial tiles
+#define DATAFLOW_INPUT_STATIONARY   2    // Reuse spatial tile inputs across OC tiles
+
+/*******************************************************************************
+ * Compute Engines (selected per layer)
+ * In a command list, consecutive ENGINE_RESIDENT layers form a fused tail:
+ * each hands its output to the next in on-chip maps, so only the first
+ * reads a feature map from DDR and only the last writes one. The chain
+ * assumes each layer consumes the previous layer's output.
+ ******************************************************************************/
+#define ENGINE_TILED                0    // Tiled load/compute/store pipeline
+#define ENGINE_LINE_BUFFER          1    // Row-streaming 3x3 engine, no halo refetch
+#define ENGINE_RESIDENT             2    // Small maps held on chip (up to 14x14, 1x1 or 3x3)
+#define ENGINE_WINOGRAD             3    // F(2x2,3x3) on the line-buffer ring (line buffer in INT8)
+
+// Optional engines, on by default. Each brings its own MAC array and buffers
+// (README: Resource Utilization); a build without one runs its layers on
+// the next engine down (Winograd -> line buffer -> tiled, resident -> tiled).
+// The tiled and pointwise engines are always built.
+#ifndef CNN_LINE_BUFFER
+#define CNN_LINE_BUFFER             1    // script.tcl: -tclargs <mode> nolb
+#endif
+#ifndef CNN_WINOGRAD
+#define CNN_WINOGRAD                1    // script.tcl: -tclargs <mode> nowino
+#endif
+#ifndef CNN_RESIDENT
+#define CNN_RESIDENT                1    // script.tcl: -tclargs <mode> nores
+#endif
+#define LINE_BUFFER_ENABLED         CNN_LINE_BUFFER
+#define WINO_ENABLED                (CNN_WINOGRAD && CNN_LINE_BUFFER && !CNN_INT8)
+#define RESIDENT_ENABLED            CNN_RESIDENT
+
+/*******************************************************************************
+ * DDR Memory Layout
+ * Feature maps are stored [C][H][FM_PITCH(W)] so every row starts on a 64-bit
+ * word; pad columns are don't-care. Weights are channel-last [OC][K][K][IC]
+ * so one 64-bit beat carries AXI_LANES input channels of the same kernel tap.
+ ******************************************************************************/
+#define AXI_LANES           (64 / DATA_BITS)    // Values per 64-bit AXI word (4, INT8: 8)
+#define AXI_LANE_SHIFT      (AXI_LANES == 8 ? 3 : 2)
+#define FM_PITCH(w)         (((w) + AXI_LANES - 1) & ~(AXI_LANES - 1))
+
+// Largest single-layer buffers of the network in 64-bit words (m_axi depth:
+// cosim copies this many words per port, so testbenches allocate as many)
+#define DDR_FM_DEPTH        (16 * 112 * 112 / AXI_LANES)   // L0 output, L1 input
+#define DDR_WEIGHTS_DEPTH   (512 * 3 * 3 * 256 / AXI_LANES) // L5
+
+/*******************************************************************************
+ * Layer Descriptor (command-list mode)
+ * DESC_WORDS 32-bit words per layer in DDR. The first eleven words mirror the
+ * layer registers; offsets are relative to the pointer registers, in 64-bit
+ * words for feature maps/weights and in elements for BN scale/shift.
+ ******************************************************************************/
+#define DESC_WORDS          16
+#define DESC_LAYER_TYPE     0
+#define DESC_IN_CHANNELS    1
+#define DESC_OUT_CHANNELS   2
+#define DESC_IN_HEIGHT      3
+#define DESC_IN_WIDTH       4
+#define DESC_KERNEL_SIZE    5
+#define DESC_STRIDE         6
+#define DESC_PADDING        7
+#define DESC_DATAFLOW       8
+#define DESC_ENGINE         9
+#define DESC_BATCH          10   // Images, maps back to back (0 or 1: one)
+#define DESC_INPUT_OFFSET   11
+#define DESC_OUTPUT_OFFSET  12
+#define DESC_WEIGHTS_OFFSET 13
+#define DESC_BN_OFFSET      14   // Applies to both bn_scale and bn_shift
+#define DESC_DECODE         15   // Non-zero: YOLO head decode after the layer
+
 /*******************************************************************************
  * Layer Configuration Structure
  ******************************************************************************/
 struct LayerConfig {
-    ap_uint<8> in_channels;
-    ap_uint<8> out_channels;
-    ap_uint<8> in_height;
-    ap_uint<8> in_width;
+    channel_t in_channels;
+    channel_t out_channels;
+    dim_t in_height;
+    dim_t in_width;
     ap_uint<8> kernel_size;    // 1 or 3
     ap_uint<8> stride;         // 1 or 2
     ap_uint<8> padding;        // 0 or 1
@@ -78,6 +190,60 @@ struct axis_packet {
     ap_uint<1> last;
 };
 
+// Video pixel: RGB888 as {R, B, G} (AXI4-Stream video), tuser = start of
+// frame, tlast = end of line
+typedef ap_axiu<24, 1, 1, 1> video_pixel_t;
+
+/*******************************************************************************
+ * Camera Preprocessing (separate IP, camera_preprocess.cpp)
+ * Resizes a live RGB888 frame to the network input and writes it as Q8.8
+ * [3][H][FM_PITCH(W)] straight into the accelerator's input map. Q8.8 in
+ * both builds: four values per 64-bit word, like the ARM driver's maps.
+ ******************************************************************************/
+#define CAM_MAX_SRC_WIDTH   1280    // Line buffer (PREPROC_MAX_SRC_WIDTH in image_preprocess.h)
+#define CAM_MAX_SRC_HEIGHT  1024
+#define CAM_LANES           4       // Q8.8 values per 64-bit word
+#define CAM_FM_DEPTH        (3 * INPUT_SIZE * INPUT_SIZE / CAM_LANES)  // m_axi depth: network input
+
+/*******************************************************************************
+ * YOLO Head Decode (yolo_decode.cpp, Q8.8 builds)
+ * After a head layer (type 2) with the decode register or DESC_DECODE set,
+ * the IP thresholds objectness, decodes the passing boxes and appends them
+ * to the candidate list; num_candidates returns how many were found in the
+ * start, which may exceed the list. INT8 heads are requantised and are not
+ * decoded (num_candidates stays 0).
+ *
+ * decode_params, int32 words (sw/common/yolo_postprocess.h builds them):
+ *   DECODE_NUM_ANCHORS, DECODE_NUM_CLASSES, DECODE_MAX_CANDS, then per
+ *   anchor a from DECODE_ANCHOR_BASE + DECODE_ANCHOR_WORDS * a:
+ *   raw Q8.8 objectness threshold (bias not included), anchor w and h in
+ *   grid cells (Q16.16)
+ *
+ * Candidate, DECODE_CAND_WORDS 64-bit words:
+ *   0: bx [15:0], by [31:16], bw [47:32], bh [63:48], Q8.8 grid cells
+ *   1: cell x [7:0], cell y [15:8], anchor [19:16], image [23:20],
+ *      class [31:24], objectness logit [47:32], class logit [63:48] (Q8.8,
+ *      bias included)
+ ******************************************************************************/
+#define HEAD_DECODE_ENABLED (!CNN_INT8)
+
+#define DECODE_MAX_ANCHORS  9
+#define DECODE_MAX_CLASSES  80
+#define DECODE_MAX_CANDS    256     // Entries written per start
+#define DECODE_NUM_ANCHORS  0
+#define DECODE_NUM_CLASSES  1
+#define DECODE_MAX_CAND     2       // List capacity, <= DECODE_MAX_CANDS
+#define DECODE_ANCHOR_BASE  4
+#define DECODE_ANCHOR_WORDS 4       // obj_min, anchor_w, anchor_h, reserved
+#define DECODE_OBJ_MIN      0
+#define DECODE_ANCHOR_W     1
+#define DECODE_ANCHOR_H     2
+#define DECODE_PARAM_WORDS  (DECODE_ANCHOR_BASE + DECODE_ANCHOR_WORDS * DECODE_MAX_ANCHORS)
+#define DECODE_CAND_WORDS   2
+
+// exp_hw() result: exp(x) for x in [-8, 8)
+typedef ap_ufixed<32, 12> exp_t;
+
 /*******************************************************************************
  * Function Prototypes
  ******************************************************************************/
@@ -85,17 +251,63 @@ struct axis_packet {
 // Top-level accelerator function (exported as IP)
 void cnn_accelerator_top(
     // AXI-Lite control interface
-    ap_uint<32> *control,
-    ap_uint<32> *status,
+    volatile ap_uint<32> *control,
+    volatile ap_uint<32> *status,
     
     // AXI Memory-Mapped interfaces for DDR access
-    data_t *input_fm,         // Input feature map in DDR
-    data_t *output_fm,        // Output feature map in DDR
-    weight_t *weights,        // Convolution weights in DDR
-    weight_t *bn_params,      // BatchNorm parameters in DDR
+    axi_data_t *input_fm,     // Input feature map in DDR (AXI_LANES/word)
+    axi_data_t *output_fm,    // Output feature map in DDR (AXI_LANES/word)
+    axi_data_t *weights,      // Convolution weights in DDR (AXI_LANES/word)
+    bn_t *bn_scale,           // BatchNorm scale in DDR (INT8: requantisation)
+    bn_t *bn_shift,           // BatchNorm shift in DDR
+    int *descriptors,         // Layer descriptor table in DDR
     
     // Layer configuration
-    LayerConfig config
+    int layer_type,           // 0: conv+bn+relu, 1: conv+bn+relu+pool, 2: conv only
+    int in_channels,
+    int out_channels,
+    int in_height,
+    int in_width,
+    int kernel_size,
+    int stride,
+    int padding,
+    int dataflow,             // DATAFLOW_* loop order
+    int engine,               // ENGINE_* compute engine
+    int num_layers,           // 0: registers, N: run N descriptors
+    int batch,                // Images per layer, back to back in each buffer
+    
+    // Activity counters of the start (MAC cycles, read beats, write beats)
+    volatile ap_uint<32> *perf_compute,
+    volatile ap_uint<32> *perf_read,
+    volatile ap_uint<32> *perf_write,
+    
+    // YOLO head decode (HEAD_DECODE_ENABLED builds)
+    int decode,               // Register mode: decode the layer's output
+    int *decode_params,       // DECODE_* parameter block in DDR
+    axi_data_t *candidates,   // Candidate list in DDR (DECODE_CAND_WORDS/entry)
+    volatile ap_uint<32> *num_candidates  // Candidates found in the start
+);
+
+// Camera preprocessing top (exported as its own IP)
+void camera_preprocess_top(
+    hls::stream<video_pixel_t> &video_in,   // AXI4-Stream video
+    axi_data_t *input_fm,     // Accelerator input map in DDR (Q8.8, CAM_LANES/word)
+    int src_width,            // Camera frame, <= CAM_MAX_SRC_WIDTH x CAM_MAX_SRC_HEIGHT
+    int src_height,
+    int dst_width,            // Network input, <= MAX_INPUT_SIZE
+    int dst_height,
+    volatile ap_uint<32> *dropped  // Pixels discarded before start of frame
+);
+
+// YOLO head decode of one image's head map, appending to the candidate list
+void yolo_decode_hw(
+    axi_data_t *head,         // Head map [C][H][FM_PITCH(W)], raw sums
+    bn_t *bias,               // Head conv bias (its bn_shift entries)
+    int *params,              // DECODE_* parameter block
+    axi_data_t *candidates,   // Candidate list
+    int channels, int height, int width,
+    int image,                // Batch index, stored in each entry
+    ap_uint<32> &found        // Candidates so far in the start (updated)
 );
 
 // Convolution core
@@ -107,6 +319,21 @@ void conv2d_hw(
     int out_ch, int kernel, int stride, int pad
 );
 
+// Pointwise MAC lane: acc + dot(input, weights) over PARALLEL_IN_CH channels
+acc_t conv1x1_channel(
+    data_t input[PARALLEL_IN_CH],
+    weight_t weights[PARALLEL_IN_CH],
+    acc_t acc
+);
+
+// One MAC array step: acc[po] += dot(input, weights[po]) for every output lane
+// (INT8: two lanes per DSP48)
+void mac_array(
+    data_t input[PARALLEL_IN_CH],
+    weight_t weights[PARALLEL_OUT_CH][PARALLEL_IN_CH],
+    acc_t acc[PARALLEL_OUT_CH]
+);
+
 // Batch normalization + LeakyReLU (fused)
 // Uses pre-computed: scale = gamma / sqrt(var + eps)
 //                    shift = beta - mean * scale
@@ -118,6 +345,7 @@ void batchnorm_relu_hw(
 );
 
 // Max pooling 2x2
+data_t max4_hw(data_t a, data_t b, data_t c, data_t d);
 void maxpool2d_hw(
     data_t *input,
     data_t *output,
@@ -127,6 +355,7 @@ void maxpool2d_hw(
 // Activation functions
 data_t leaky_relu_hw(data_t x);
 data_t sigmoid_hw(data_t x);
+exp_t exp_hw(data_t x);
 
 /*******************************************************************************
  * Utility Functions
@@ -141,25 +370,24 @@ inline float fixed_to_float(data_t d) {
     return d.to_float();
 }
 
-// Pack/unpack for AXI bus
-inline axi_data_t pack_4x16(data_t d0, data_t d1, data_t d2, data_t d3) {
+// Pack/unpack for AXI bus: AXI_LANES values per word, lane 0 in the low bits
+inline axi_data_t pack_word(const data_t v[AXI_LANES]) {
+    #pragma HLS INLINE
     axi_data_t packed;
-    packed.range(15, 0) = d0.range(15, 0);
-    packed.range(31, 16) = d1.range(15, 0);
-    packed.range(47, 32) = d2.range(15, 0);
-    packed.range(63, 48) = d3.range(15, 0);
+    for (int j = 0; j < AXI_LANES; j++) {
+        #pragma HLS UNROLL
+        packed.range(DATA_BITS * j + DATA_BITS - 1, DATA_BITS * j) = v[j].range(DATA_BITS - 1, 0);
+    }
     return packed;
 }
 
-inline void unpack_4x16(axi_data_t packed, data_t &d0, data_t &d1, data_t &d2, data_t &d3) {
-    ap_uint<16> tmp0 = packed.range(15, 0);
-    ap_uint<16> tmp1 = packed.range(31, 16);
-    ap_uint<16> tmp2 = packed.range(47, 32);
-    ap_uint<16> tmp3 = packed.range(63, 48);
-    d0.range(15, 0) = tmp0;
-    d1.range(15, 0) = tmp1;
-    d2.range(15, 0) = tmp2;
-    d3.range(15, 0) = tmp3;
+inline void unpack_word(axi_data_t packed, data_t v[AXI_LANES]) {
+    #pragma HLS INLINE
+    for (int j = 0; j < AXI_LANES; j++) {
+        #pragma HLS UNROLL
+        ap_uint<DATA_BITS> bits = packed.range(DATA_BITS * j + DATA_BITS - 1, DATA_BITS * j);
+        v[j].range(DATA_BITS - 1, 0) = bits;
+    }
 }
 
 #endif // CNN_ACCEL_H
@@ -84,26 +84,78 @@ acc_t conv_3x3_kernel(
 /*******************************************************************************
  * 1x1 Convolution (Pointwise)
  * Used for channel reduction/expansion
+ * PARALLEL_IN_CH-lane dot product for one output channel at one pixel; the
+ * pointwise engine instantiates one per output lane of the MAC array
  ******************************************************************************/
-void conv1x1_channel(
-    data_t input[MAX_CHANNELS],
-    weight_t weights[MAX_CHANNELS],
-    acc_t &output,
-    int in_channels
+acc_t conv1x1_channel(
+    data_t input[PARALLEL_IN_CH],
+    weight_t weights[PARALLEL_IN_CH],
+    acc_t acc
 ) {
-    #pragma HLS INLINE off
-    #pragma HLS PIPELINE II=1
-    
-    acc_t sum = 0;
+    #pragma HLS INLINE
     
     CONV1X1_IC:
-    for (int ic = 0; ic < in_channels; ic++) {
-        #pragma HLS LOOP_TRIPCOUNT min=3 max=512
-        #pragma HLS PIPELINE II=1
-        sum = mac_unit(input[ic], weights[ic], sum);
+    for (int ic = 0; ic < PARALLEL_IN_CH; ic++) {
+        #pragma HLS UNROLL
+        acc = mac_unit(input[ic], weights[ic], acc);
     }
     
-    output = sum;
+    return acc;
+}
+
+/*******************************************************************************
+ * MAC Array Step
+ * acc[po] += dot(input, weights[po]) for all PARALLEL_OUT_CH output lanes.
+ *
+ * Q8.8: one conv1x1_channel per lane, one DSP48 per multiply.
+ * INT8: lanes po and po + 1 share a DSP48. Their weights go into one 25-bit
+ * operand, w_hi * 2^16 + w_lo, and a single multiply by x gives both
+ * products. Each int8 x int8 product fits in 16 signed bits (|p| <= 2^14),
+ * so the low half is w_lo * x exactly and the rest, less the low half, is
+ * w_hi * x * 2^16.
+ ******************************************************************************/
+#if CNN_INT8
+static void mul2_int8(data_t x, weight_t w_hi, weight_t w_lo, acc_t &p_hi, acc_t &p_lo) {
+    #pragma HLS INLINE
+    
+    ap_int<25> packed = (ap_int<25>(w_hi.to_int()) << 16) + ap_int<25>(w_lo.to_int());
+    ap_int<33> prod = packed * ap_int<8>(x.to_int());
+    #pragma HLS BIND_OP variable=prod op=mul impl=dsp
+    
+    ap_int<16> lo = prod.range(15, 0);
+    ap_int<33> hi = (prod - lo) >> 16;
+    p_hi = hi.to_int();
+    p_lo = lo.to_int();
+}
+#endif
+
+void mac_array(
+    data_t input[PARALLEL_IN_CH],
+    weight_t weights[PARALLEL_OUT_CH][PARALLEL_IN_CH],
+    acc_t acc[PARALLEL_OUT_CH]
+) {
+    #pragma HLS INLINE
+    
+#if CNN_INT8
+    MAC_PAIR:
+    for (int po = 0; po < PARALLEL_OUT_CH; po += 2) {
+        #pragma HLS UNROLL
+        MAC_PAIR_IC:
+        for (int pi = 0; pi < PARALLEL_IN_CH; pi++) {
+            #pragma HLS UNROLL
+            acc_t p_hi, p_lo;
+            mul2_int8(input[pi], weights[po + 1][pi], weights[po][pi], p_hi, p_lo);
+            acc[po] += p_lo;
+            acc[po + 1] += p_hi;
+        }
+    }
+#else
+    MAC_LANE:
+    for (int po = 0; po < PARALLEL_OUT_CH; po++) {
+        #pragma HLS UNROLL
+        acc[po] = conv1x1_channel(input, weights[po], acc[po]);
+    }
+#endif
 }
 
 /*******************************************************************************
@@ -0,0 +1,198 @@
+/*******************************************************************************
+ * CNN Accelerator - YOLO Head Decode
+ * Optional stage after the output head (decode register or DESC_DECODE)
+ *
+ * The head map has just been written to DDR; the stage reads its objectness
+ * planes back, rejects every anchor below its raw Q8.8 threshold (the ARM
+ * decoder's obj_min, so exactly the cells it would look at pass) and, for
+ * the survivors only, reads the box and class channels, picks the best
+ * class by logit and decodes the box with sigmoid_hw / exp_hw and the
+ * anchors. The ARM is left with a compact candidate list to finish the
+ * confidence on and run NMS over, instead of the whole map.
+ *
+ * Q8.8 builds only (HEAD_DECODE_ENABLED): the head's raw sums plus its
+ * conv bias are the logits.
+ ******************************************************************************/
+
+#include "cnn_accel.h"
+
+#if HEAD_DECODE_ENABLED
+
+// Largest head plane held on chip: the 608 input's 19 x 19 grid
+#define DECODE_MAX_GRID     (MAX_INPUT_SIZE / 32)
+#define DECODE_MAX_PLANE    (DECODE_MAX_GRID * FM_PITCH(DECODE_MAX_GRID))
+#define DECODE_MAX_CHANNELS (DECODE_MAX_ANCHORS * (5 + DECODE_MAX_CLASSES))
+
+typedef ap_ufixed<16, 8, AP_RND, AP_SAT> box_t;     // Q8.8 grid cells
+typedef ap_ufixed<32, 16> anchor_t;                  // Q16.16 grid cells
+typedef ap_fixed<18, 10> logit_t;                    // Raw sum + bias, no overflow
+typedef ap_fixed<32, 24> obj_min_t;                  // Q8.8 threshold on 32 bits
+
+// One head value: lane of its 64-bit word (planes are whole words)
+static data_t head_value(axi_data_t *head, int index) {
+    #pragma HLS INLINE
+    data_t v[AXI_LANES];
+    unpack_word(head[index / AXI_LANES], v);
+    return v[index % AXI_LANES];
+}
+
+// Q8.8 bits of a fixed-point value, saturated to 16 bits
+static ap_uint<16> q88_bits(logit_t x) {
+    #pragma HLS INLINE
+    data_t d = x;
+    return (ap_uint<16>)d.range(15, 0);
+}
+
+void yolo_decode_hw(
+    axi_data_t *head,
+    bn_t *bias,
+    int *params,
+    axi_data_t *candidates,
+    int channels,
+    int height,
+    int width,
+    int image,
+    ap_uint<32> &found
+) {
+    obj_min_t obj_min[DECODE_MAX_ANCHORS];
+    anchor_t anchor_w[DECODE_MAX_ANCHORS];
+    anchor_t anchor_h[DECODE_MAX_ANCHORS];
+    bn_t bias_buf[DECODE_MAX_CHANNELS];
+    data_t obj[DECODE_MAX_ANCHORS][DECODE_MAX_PLANE];
+    ap_uint<16> hits[DECODE_MAX_CANDS];     // Cell pixel << 4 | anchor
+
+    #pragma HLS ARRAY_PARTITION variable=obj_min complete
+    #pragma HLS ARRAY_PARTITION variable=anchor_w complete
+    #pragma HLS ARRAY_PARTITION variable=anchor_h complete
+
+    int num_anchors = params[DECODE_NUM_ANCHORS];
+    int num_classes = params[DECODE_NUM_CLASSES];
+    int max_cands = params[DECODE_MAX_CAND];
+    int stride = 5 + num_classes;
+    int pitch = FM_PITCH(width);
+    int plane = height * pitch;
+
+    // Only a head laid out for these parameters is decoded
+    if (num_anchors < 1 || num_anchors > DECODE_MAX_ANCHORS ||
+        num_classes < 1 || num_classes > DECODE_MAX_CLASSES ||
+        channels != num_anchors * stride || height > DECODE_MAX_GRID || width > DECODE_MAX_GRID) {
+        return;
+    }
+    if (max_cands > DECODE_MAX_CANDS) {
+        max_cands = DECODE_MAX_CANDS;
+    }
+
+    DECODE_PARAMS:
+    for (int a = 0; a < DECODE_MAX_ANCHORS; a++) {
+        #pragma HLS PIPELINE II=1
+        int base = DECODE_ANCHOR_BASE + DECODE_ANCHOR_WORDS * a;
+        bool used = a < num_anchors;
+        obj_min[a].range(31, 0) = used ? params[base + DECODE_OBJ_MIN] : 0;
+        anchor_w[a].range(31, 0) = used ? params[base + DECODE_ANCHOR_W] : 0;
+        anchor_h[a].range(31, 0) = used ? params[base + DECODE_ANCHOR_H] : 0;
+    }
+
+    DECODE_BIAS:
+    for (int c = 0; c < channels; c++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT min=24 max=765
+        bias_buf[c] = bias[c];
+    }
+
+    // Objectness planes, one burst each
+    DECODE_OBJ_PLANES:
+    for (int a = 0; a < num_anchors; a++) {
+        #pragma HLS LOOP_TRIPCOUNT min=3 max=9
+        int base = ((a * stride + 4) * plane) / AXI_LANES;
+        DECODE_OBJ_WORDS:
+        for (int i = 0; i < plane / AXI_LANES; i++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=14 max=95
+            data_t v[AXI_LANES];
+            unpack_word(head[base + i], v);
+            for (int j = 0; j < AXI_LANES; j++) {
+                #pragma HLS UNROLL
+                obj[a][i * AXI_LANES + j] = v[j];
+            }
+        }
+    }
+
+    // Threshold scan in the ARM decoder's order: cells row-major, anchors inner
+    int num_hits = 0;
+    ap_uint<32> passed = 0;
+    DECODE_SCAN_ROWS:
+    for (int cy = 0; cy < height; cy++) {
+        #pragma HLS LOOP_TRIPCOUNT min=7 max=19
+        DECODE_SCAN_CELLS:
+        for (int cx = 0; cx < width; cx++) {
+            #pragma HLS LOOP_TRIPCOUNT min=7 max=19
+            DECODE_SCAN_ANCHORS:
+            for (int a = 0; a < num_anchors; a++) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT min=3 max=9
+                int pix = cy * pitch + cx;
+                if (obj[a][pix] >= obj_min[a]) {
+                    // The list takes the first passes of the start
+                    if ((int)(found + passed) < max_cands) {
+                        hits[num_hits++] = (ap_uint<16>)((pix << 4) | a);
+                    }
+                    passed++;
+                }
+            }
+        }
+    }
+
+    // Survivors: box and class channels, best class, decoded box
+    DECODE_HITS:
+    for (int h = 0; h < num_hits; h++) {
+        #pragma HLS LOOP_TRIPCOUNT min=0 max=16
+        int pix = (int)(hits[h] >> 4);
+        int a = (int)(hits[h] & 0xF);
+        int ch0 = a * stride;
+
+        logit_t t[5];
+        logit_t best = 0;
+        int best_class = 0;
+        #pragma HLS ARRAY_PARTITION variable=t complete
+
+        DECODE_ATTRS:
+        for (int k = 0; k < stride; k++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT min=8 max=85
+            logit_t v = logit_t(head_value(head, (ch0 + k) * plane + pix)) + logit_t(bias_buf[ch0 + k]);
+            if (k < 5) {
+                t[k] = v;
+            } else if (k == 5 || v > best) {
+                // First class on ties, like the ARM decoder
+                best = v;
+                best_class = k - 5;
+            }
+        }
+
+        box_t bx = box_t(sigmoid_hw(data_t(t[0]))) + box_t(pix % pitch);
+        box_t by = box_t(sigmoid_hw(data_t(t[1]))) + box_t(pix / pitch);
+        box_t bw = box_t(exp_hw(data_t(t[2])) * anchor_w[a]);
+        box_t bh = box_t(exp_hw(data_t(t[3])) * anchor_h[a]);
+
+        axi_data_t w0, w1;
+        w0.range(15, 0) = bx.range(15, 0);
+        w0.range(31, 16) = by.range(15, 0);
+        w0.range(47, 32) = bw.range(15, 0);
+        w0.range(63, 48) = bh.range(15, 0);
+        w1.range(7, 0) = pix % pitch;
+        w1.range(15, 8) = pix / pitch;
+        w1.range(19, 16) = a;
+        w1.range(23, 20) = image;
+        w1.range(31, 24) = best_class;
+        w1.range(47, 32) = q88_bits(t[4]);
+        w1.range(63, 48) = q88_bits(best);
+
+        int n = (int)found + h;
+        candidates[n * DECODE_CAND_WORDS] = w0;
+        candidates[n * DECODE_CAND_WORDS + 1] = w1;
+    }
+
+    found += passed;
+}
+
+#endif // HEAD_DECODE_ENABLED
@@ -4,10 +4,22 @@
  ******************************************************************************/
 
 #include <iostream>
+#include <fstream>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 #include "cnn_accel.h"
 
+// Float network, trained weights and test image (ARM application sources)
+#include "../../../sw/common/yolo_layers.h"
+#include "../../../sw/common/tiny_yolo_weights.h"
+#include "../../../sw/common/test_image.h"
+#include "../../../sw/common/image_preprocess.h"
+#define LAYERS_Q88_KERNELS_ONLY                         // Operators only, no driver types
+#include "../../../sw/common/layers_q88.h"
+
 // Reference software implementations (from existing yolo_layers.h logic)
 void conv2d_ref(float* in, float* out, float* w, int ic, int ih, int iw, int oc, int k, int s, int p);
 void leaky_relu_ref(float* data, int size);
@@ -16,6 +28,29 @@ void maxpool2d_ref(float* in, float* out, int c, int h, int w);
 /*******************************************************************************
  * Test Utilities
  ******************************************************************************/
+// Value ranges of the top-level tests. INT8 codes are integers, so inputs
+// and weights span a few codes and the BN scale brings the sums back into
+// range; the tolerance is half an output code.
+#if CNN_INT8
+#define TB_IN_RANGE   4.0f
+#define TB_W_RANGE    4.0f
+#define TB_OUT_SCALE  0.125f
+#define TB_TOL        0.51f
+#else
+#define TB_IN_RANGE   1.0f
+#define TB_W_RANGE    0.125f
+#define TB_OUT_SCALE  1.0f
+#define TB_TOL        0.1f
+#endif
+
+// Activity counter outputs of the last start
+static ap_uint<32> perf_compute, perf_read, perf_write;
+#define PERF_REGS &perf_compute, &perf_read, &perf_write
+
+// Head decode off, and its count output
+static ap_uint<32> num_candidates;
+#define DECODE_OFF 0, NULL, NULL, &num_candidates
+
 void init_random(data_t* arr, int size, float scale = 1.0f) {
     for (int i = 0; i < size; i++) {
         arr[i] = data_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * scale);
@@ -28,6 +63,57 @@ void init_random_float(float* arr, int size, float scale = 1.0f) {
     }
 }
 
+// Pack a dense [C][H][W] map into the accelerator's row-pitched DDR layout
+axi_data_t* pack_feature_map(data_t* fm, int c, int h, int w) {
+    int pitch = FM_PITCH(w);
+    axi_data_t* packed = new axi_data_t[c * h * pitch / AXI_LANES];
+    for (int row = 0; row < c * h; row++) {
+        for (int x = 0; x < pitch; x += AXI_LANES) {
+            data_t v[AXI_LANES];
+            for (int j = 0; j < AXI_LANES; j++) {
+                v[j] = (x + j < w) ? fm[row * w + x + j] : data_t(0);
+            }
+            packed[(row * pitch + x) / AXI_LANES] = pack_word(v);
+        }
+    }
+    return packed;
+}
+
+// Unpack a row-pitched map back to dense [C][H][W]
+void unpack_feature_map(axi_data_t* packed, data_t* fm, int c, int h, int w) {
+    int pitch = FM_PITCH(w);
+    for (int row = 0; row < c * h; row++) {
+        for (int x = 0; x < w; x++) {
+            int idx = row * pitch + x;
+            ap_uint<DATA_BITS> bits = packed[idx / AXI_LANES].range(DATA_BITS * (idx % AXI_LANES) + DATA_BITS - 1,
+                                                                    DATA_BITS * (idx % AXI_LANES));
+            fm[row * w + x].range(DATA_BITS - 1, 0) = bits;
+        }
+    }
+}
+
+// Reorder [OC][IC][K][K] weights to channel-last [OC][K][K][IC], AXI_LANES per word
+axi_data_t* pack_weights(weight_t* w, int oc, int ic, int k) {
+    int size = oc * ic * k * k;
+    int words = (size + AXI_LANES - 1) / AXI_LANES;
+    weight_t* reordered = new weight_t[words * AXI_LANES];
+    for (int o = 0; o < oc; o++) {
+        for (int i = 0; i < ic; i++) {
+            for (int t = 0; t < k * k; t++) {
+                reordered[(o * k * k + t) * ic + i] = w[(o * ic + i) * k * k + t];
+            }
+        }
+    }
+    for (int i = size; i < words * AXI_LANES; i++) reordered[i] = 0;
+    
+    axi_data_t* packed = new axi_data_t[words];
+    for (int i = 0; i < words; i++) {
+        packed[i] = pack_word(&reordered[i * AXI_LANES]);
+    }
+    delete[] reordered;
+    return packed;
+}
+
 bool compare_results(data_t* hw, float* ref, int size, float tol = 0.1f) {
     int errors = 0;
     float max_err = 0;
@@ -87,6 +173,13 @@ void leaky_relu_ref(float* data, int size) {
     }
 }
 
+// BN scale of the top-level tests (INT8 requantisation)
+void scale_ref(float* data, int size) {
+    for (int i = 0; i < size; i++) {
+        data[i] *= TB_OUT_SCALE;
+    }
+}
+
 void maxpool2d_ref(float* in, float* out, int c, int h, int w) {
     int oh = h / 2;
     int ow = w / 2;
@@ -117,6 +210,8 @@ void maxpool2d_ref(float* in, float* out, int c, int h, int w) {
 /*******************************************************************************
  * Test Cases
  ******************************************************************************/
+#if !CNN_INT8
+// Standalone Q8.8 building blocks (the INT8 build checks them through the top)
 int test_leaky_relu() {
     std::cout << "\n=== Test LeakyReLU ===" << std::endl;
     
@@ -142,6 +237,7 @@ int test_leaky_relu() {
     
     return compare_results(hw_data, ref_data, size, 0.01f) ? 0 : 1;
 }
+#endif
 
 int test_maxpool() {
     std::cout << "\n=== Test MaxPool 2x2 ===" << std::endl;
@@ -156,9 +252,9 @@ int test_maxpool() {
     
     srand(123);
     for (int i = 0; i < C * H * W; i++) {
-        float val = (rand() / (float)RAND_MAX) * 2.0f;
+        float val = (rand() / (float)RAND_MAX) * 2.0f * TB_IN_RANGE;
         hw_input[i] = data_t(val);
-        ref_input[i] = val;
+        ref_input[i] = hw_input[i].to_float();
     }
     
     // HW
@@ -170,6 +266,7 @@ int test_maxpool() {
     return compare_results(hw_output, ref_output, C * OUT_H * OUT_W, 0.01f) ? 0 : 1;
 }
 
+#if !CNN_INT8
 int test_conv2d() {
     std::cout << "\n=== Test Conv2D 3x3 ===" << std::endl;
     
@@ -220,19 +317,1377 @@ int test_conv2d() {
     return pass ? 0 : 1;
 }
 
+#endif
+
+int test_top_dataflow() {
+    std::cout << "\n=== Test Top-Level Dataflow Modes ===" << std::endl;
+    
+    // Two tiles in every dimension so each loop order actually reuses data
+    // Odd height leaves the line-buffer engine a single-row final pair
+    const int IC = 40, OC = 40, H = 21, W = 20, K = 3, S = 1, P = 1;
+    const int OUT_H = (H + 2*P - K) / S + 1;
+    const int OUT_W = (W + 2*P - K) / S + 1;
+    
+    data_t* hw_input = new data_t[IC * H * W];
+    data_t* hw_output = new data_t[OC * OUT_H * OUT_W];
+    weight_t* hw_weights = new weight_t[OC * IC * K * K];
+    bn_t hw_scale[OC], hw_shift[OC];
+    
+    float* ref_input = new float[IC * H * W];
+    float* ref_output = new float[OC * OUT_H * OUT_W];
+    float* ref_weights = new float[OC * IC * K * K];
+    
+    srand(789);
+    for (int i = 0; i < IC * H * W; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_IN_RANGE;
+        hw_input[i] = data_t(val);
+        ref_input[i] = hw_input[i].to_float();
+    }
+    for (int i = 0; i < OC * IC * K * K; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE;
+        hw_weights[i] = weight_t(val);
+        ref_weights[i] = hw_weights[i].to_float();
+    }
+    for (int i = 0; i < OC; i++) {
+        hw_scale[i] = bn_t(TB_OUT_SCALE);
+        hw_shift[i] = 0;
+    }
+    
+    conv2d_ref(ref_input, ref_output, ref_weights, IC, H, W, OC, K, S, P);
+    scale_ref(ref_output, OC * OUT_H * OUT_W);
+    
+    axi_data_t* ddr_input = pack_feature_map(hw_input, IC, H, W);
+    axi_data_t* ddr_output = new axi_data_t[OC * OUT_H * FM_PITCH(OUT_W) / AXI_LANES];
+    axi_data_t* ddr_weights = pack_weights(hw_weights, OC, IC, K);
+    
+    const char* names[] = {"output-stationary", "weight-stationary", "input-stationary"};
+    int fails = 0;
+    for (int mode = 0; mode < 3; mode++) {
+        ap_uint<32> control = 0, status = 0;
+        std::cout << "  Mode: " << names[mode] << std::endl;
+        for (int i = 0; i < OC * OUT_H * FM_PITCH(OUT_W) / AXI_LANES; i++) ddr_output[i] = 0;
+        cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights,
+                            hw_scale, hw_shift, NULL, 2, IC, OC, H, W, K, S, P, mode,
+                            ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+        unpack_feature_map(ddr_output, hw_output, OC, OUT_H, OUT_W);
+        if (!compare_results(hw_output, ref_output, OC * OUT_H * OUT_W, TB_TOL)) fails++;
+    }
+    
+    ap_uint<32> control = 0, status = 0;
+    std::cout << "  Engine: line-buffer" << std::endl;
+    for (int i = 0; i < OC * OUT_H * FM_PITCH(OUT_W) / AXI_LANES; i++) ddr_output[i] = 0;
+    cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights,
+                        hw_scale, hw_shift, NULL, 2, IC, OC, H, W, K, S, P,
+                        DATAFLOW_OUTPUT_STATIONARY, ENGINE_LINE_BUFFER, 0, 1, PERF_REGS, DECODE_OFF);
+    unpack_feature_map(ddr_output, hw_output, OC, OUT_H, OUT_W);
+    if (!compare_results(hw_output, ref_output, OC * OUT_H * OUT_W, TB_TOL)) fails++;
+    
+    delete[] ddr_input;
+    delete[] ddr_output;
+    delete[] ddr_weights;
+    delete[] hw_input;
+    delete[] hw_output;
+    delete[] hw_weights;
+    delete[] ref_input;
+    delete[] ref_output;
+    delete[] ref_weights;
+    
+    return fails;
+}
+
+int test_top_pool() {
+    std::cout << "\n=== Test Top-Level Fused Max Pool ===" << std::endl;
+    
+    // Odd map size: last spatial tile has a single row/col that pooling drops
+    // 3 input channels (as L0) leaves most MAC array input lanes unused
+    const int IC = 3, OC = 40, H = 29, W = 29, K = 3, S = 1, P = 1;
+    const int OUT_H = (H + 2*P - K) / S + 1;
+    const int OUT_W = (W + 2*P - K) / S + 1;
+    const int POOL_H = OUT_H / 2, POOL_W = OUT_W / 2;
+    
+    data_t* hw_input = new data_t[IC * H * W];
+    data_t* hw_output = new data_t[OC * OUT_H * OUT_W];
+    weight_t* hw_weights = new weight_t[OC * IC * K * K];
+    bn_t hw_scale[OC], hw_shift[OC];
+    
+    float* ref_input = new float[IC * H * W];
+    float* ref_conv = new float[OC * OUT_H * OUT_W];
+    float* ref_output = new float[OC * POOL_H * POOL_W];
+    float* ref_weights = new float[OC * IC * K * K];
+    
+    srand(321);
+    for (int i = 0; i < IC * H * W; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_IN_RANGE;
+        hw_input[i] = data_t(val);
+        ref_input[i] = hw_input[i].to_float();
+    }
+    for (int i = 0; i < OC * IC * K * K; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE;
+        hw_weights[i] = weight_t(val);
+        ref_weights[i] = hw_weights[i].to_float();
+    }
+    for (int i = 0; i < OC; i++) {
+        hw_scale[i] = bn_t(TB_OUT_SCALE);
+        hw_shift[i] = 0;
+    }
+    
+    conv2d_ref(ref_input, ref_conv, ref_weights, IC, H, W, OC, K, S, P);
+    scale_ref(ref_conv, OC * OUT_H * OUT_W);
+    leaky_relu_ref(ref_conv, OC * OUT_H * OUT_W);
+    maxpool2d_ref(ref_conv, ref_output, OC, OUT_H, OUT_W);
+    
+    axi_data_t* ddr_input = pack_feature_map(hw_input, IC, H, W);
+    axi_data_t* ddr_output = new axi_data_t[OC * POOL_H * FM_PITCH(POOL_W) / AXI_LANES];
+    axi_data_t* ddr_weights = pack_weights(hw_weights, OC, IC, K);
+    
+    const char* names[] = {"tiled", "line-buffer"};
+    int fails = 0;
+    for (int engine = ENGINE_TILED; engine <= ENGINE_LINE_BUFFER; engine++) {
+        ap_uint<32> control = 0, status = 0;
+        std::cout << "  Engine: " << names[engine] << std::endl;
+        for (int i = 0; i < OC * POOL_H * FM_PITCH(POOL_W) / AXI_LANES; i++) ddr_output[i] = 0;
+        cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights,
+                            hw_scale, hw_shift, NULL, 1, IC, OC, H, W, K, S, P,
+                            DATAFLOW_OUTPUT_STATIONARY, engine, 0, 1, PERF_REGS, DECODE_OFF);
+        unpack_feature_map(ddr_output, hw_output, OC, POOL_H, POOL_W);
+        if (!compare_results(hw_output, ref_output, OC * POOL_H * POOL_W, TB_TOL)) fails++;
+    }
+    
+    delete[] ddr_input;
+    delete[] ddr_output;
+    delete[] ddr_weights;
+    delete[] hw_input;
+    delete[] hw_output;
+    delete[] hw_weights;
+    delete[] ref_input;
+    delete[] ref_conv;
+    delete[] ref_output;
+    delete[] ref_weights;
+    
+    return fails;
+}
+
+// Differing values of two packed maps (pad columns are don't-care)
+static int map_mismatches(axi_data_t* a, axi_data_t* b, int channels, int height, int width) {
+    data_t* va = new data_t[channels * height * width];
+    data_t* vb = new data_t[channels * height * width];
+    unpack_feature_map(a, va, channels, height, width);
+    unpack_feature_map(b, vb, channels, height, width);
+    int mismatches = 0;
+    for (int i = 0; i < channels * height * width; i++) {
+        if (va[i] != vb[i]) mismatches++;
+    }
+    delete[] va;
+    delete[] vb;
+    return mismatches;
+}
+
+int test_top_winograd() {
+    std::cout << "\n=== Test Top-Level Winograd Engine ===" << std::endl;
+    
+    // L0-style 3 channels with pool, odd width without pool, and a full 64-channel ring
+    struct Shape { int type, ic, oc, h, w; };
+    const Shape shapes[] = {{1, 3, 40, 29, 29}, {0, 20, 24, 14, 13}, {1, 64, 32, 8, 8}};
+    int fails = 0;
+    
+    srand(246);
+    for (int t = 0; t < 3; t++) {
+        const Shape& sh = shapes[t];
+        int out_h = (sh.type == 1) ? sh.h / 2 : sh.h;
+        int out_w = (sh.type == 1) ? sh.w / 2 : sh.w;
+        int out_words = sh.oc * out_h * FM_PITCH(out_w) / AXI_LANES;
+        
+        data_t* input = new data_t[sh.ic * sh.h * sh.w];
+        weight_t* weights = new weight_t[sh.oc * sh.ic * 9];
+        bn_t* scale = new bn_t[sh.oc];
+        bn_t* shift = new bn_t[sh.oc];
+        for (int i = 0; i < sh.ic * sh.h * sh.w; i++) {
+            input[i] = data_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_IN_RANGE);
+        }
+        for (int i = 0; i < sh.oc * sh.ic * 9; i++) {
+            weights[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+        }
+        for (int i = 0; i < sh.oc; i++) {
+            scale[i] = bn_t((0.5f + rand() / (float)RAND_MAX) * TB_OUT_SCALE);
+            shift[i] = bn_t((rand() / (float)RAND_MAX - 0.5f) * 0.25f);
+        }
+        
+        axi_data_t* ddr_input = pack_feature_map(input, sh.ic, sh.h, sh.w);
+        axi_data_t* ddr_weights = pack_weights(weights, sh.oc, sh.ic, 3);
+        axi_data_t* ref = new axi_data_t[out_words];
+        axi_data_t* hw = new axi_data_t[out_words];
+        
+        ap_uint<32> control = 0, status = 0;
+        cnn_accelerator_top(&control, &status, ddr_input, ref, ddr_weights, scale, shift, NULL,
+                            sh.type, sh.ic, sh.oc, sh.h, sh.w, 3, 1, 1,
+                            DATAFLOW_OUTPUT_STATIONARY, ENGINE_LINE_BUFFER, 0, 1, PERF_REGS, DECODE_OFF);
+        int direct_macs = (int)perf_compute;
+        cnn_accelerator_top(&control, &status, ddr_input, hw, ddr_weights, scale, shift, NULL,
+                            sh.type, sh.ic, sh.oc, sh.h, sh.w, 3, 1, 1,
+                            DATAFLOW_OUTPUT_STATIONARY, ENGINE_WINOGRAD, 0, 1, PERF_REGS, DECODE_OFF);
+        
+        // Exact transforms: same values as the direct engine; 16 products per 2x2 block, not 36
+        int mismatches = map_mismatches(ref, hw, sh.oc, out_h, out_w);
+#if WINO_ENABLED
+        int ic_groups = (sh.ic + PARALLEL_IN_CH - 1) / PARALLEL_IN_CH;
+        int oc_groups = (sh.oc + PARALLEL_OUT_CH - 1) / PARALLEL_OUT_CH;
+        int expect_macs = oc_groups * ic_groups * 16 * ((sh.h + 1) / 2) * ((sh.w + 1) / 2);
+#else
+        int expect_macs = direct_macs;    // INT8 and nowino builds run the line-buffer engine
+#endif
+        std::cout << "  " << sh.ic << "->" << sh.oc << " " << sh.h << "x" << sh.w
+                  << (sh.type == 1 ? " pool" : "") << ": " << mismatches << " mismatches, compute "
+                  << perf_compute << " vs direct " << direct_macs << std::endl;
+        if (mismatches || (int)perf_compute != expect_macs) fails++;
+        
+        delete[] input;
+        delete[] weights;
+        delete[] scale;
+        delete[] shift;
+        delete[] ddr_input;
+        delete[] ddr_weights;
+        delete[] ref;
+        delete[] hw;
+    }
+    
+    return fails;
+}
+
+int test_top_wide_input() {
+    std::cout << "\n=== Test Top-Level Wide Inputs ===" << std::endl;
+    
+    // 416: Winograd falls back to the line buffer (block buffers hold 224);
+    // 608: the line buffer falls back to the tiled engine (accumulators hold 416)
+    struct Shape { int ic, oc, h, w, engine; };
+    const Shape shapes[] = {{3, 16, 5, 416, ENGINE_WINOGRAD}, {8, 8, 3, 608, ENGINE_LINE_BUFFER}};
+    int fails = 0;
+    
+    srand(357);
+    for (int t = 0; t < 2; t++) {
+        const Shape& sh = shapes[t];
+        int in_size = sh.ic * sh.h * sh.w;
+        int out_size = sh.oc * sh.h * sh.w;
+        int out_words = sh.oc * sh.h * FM_PITCH(sh.w) / AXI_LANES;
+        
+        data_t* input = new data_t[in_size];
+        weight_t* weights = new weight_t[sh.oc * sh.ic * 9];
+        data_t* output = new data_t[out_size];
+        float* ref_input = new float[in_size];
+        float* ref_weights = new float[sh.oc * sh.ic * 9];
+        float* ref_output = new float[out_size];
+        bn_t* scale = new bn_t[sh.oc];
+        bn_t* shift = new bn_t[sh.oc];
+        for (int i = 0; i < in_size; i++) {
+            input[i] = data_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_IN_RANGE);
+            ref_input[i] = input[i].to_float();
+        }
+        for (int i = 0; i < sh.oc * sh.ic * 9; i++) {
+            weights[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+            ref_weights[i] = weights[i].to_float();
+        }
+        for (int i = 0; i < sh.oc; i++) {
+            scale[i] = bn_t(TB_OUT_SCALE);
+            shift[i] = 0;
+        }
+        conv2d_ref(ref_input, ref_output, ref_weights, sh.ic, sh.h, sh.w, sh.oc, 3, 1, 1);
+        scale_ref(ref_output, out_size);
+        
+        axi_data_t* ddr_input = pack_feature_map(input, sh.ic, sh.h, sh.w);
+        axi_data_t* ddr_weights = pack_weights(weights, sh.oc, sh.ic, 3);
+        axi_data_t* ddr_output = new axi_data_t[out_words];
+        
+        ap_uint<32> control = 0, status = 0;
+        std::cout << "  " << sh.ic << "->" << sh.oc << " " << sh.h << "x" << sh.w << std::endl;
+        cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights, scale, shift, NULL,
+                            2, sh.ic, sh.oc, sh.h, sh.w, 3, 1, 1,
+                            DATAFLOW_OUTPUT_STATIONARY, sh.engine, 0, 1, PERF_REGS, DECODE_OFF);
+        unpack_feature_map(ddr_output, output, sh.oc, sh.h, sh.w);
+        if (!compare_results(output, ref_output, out_size, TB_TOL)) fails++;
+        
+        delete[] input;
+        delete[] weights;
+        delete[] output;
+        delete[] ref_input;
+        delete[] ref_weights;
+        delete[] ref_output;
+        delete[] scale;
+        delete[] shift;
+        delete[] ddr_input;
+        delete[] ddr_weights;
+        delete[] ddr_output;
+    }
+    
+    return fails;
+}
+
+int test_top_pointwise() {
+    std::cout << "\n=== Test Top-Level Pointwise (1x1) Path ===" << std::endl;
+    
+    // Enough channels to force two pixel tiles and two OC tiles
+    const int IC = 300, OC = 64, H = 9, W = 9, K = 1, S = 1, P = 0;
+    
+    data_t* hw_input = new data_t[IC * H * W];
+    data_t* hw_output = new data_t[OC * H * W];
+    weight_t* hw_weights = new weight_t[OC * IC];
+    bn_t hw_scale[OC], hw_shift[OC];
+    
+    float* ref_input = new float[IC * H * W];
+    float* ref_output = new float[OC * H * W];
+    float* ref_weights = new float[OC * IC];
+    
+    srand(654);
+    for (int i = 0; i < IC * H * W; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_IN_RANGE;
+        hw_input[i] = data_t(val);
+        ref_input[i] = hw_input[i].to_float();
+    }
+    for (int i = 0; i < OC * IC; i++) {
+        float val = (rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE;
+        hw_weights[i] = weight_t(val);
+        ref_weights[i] = hw_weights[i].to_float();
+    }
+    for (int i = 0; i < OC; i++) {
+        hw_scale[i] = bn_t(TB_OUT_SCALE);
+        hw_shift[i] = 0;
+    }
+    
+    conv2d_ref(ref_input, ref_output, ref_weights, IC, H, W, OC, K, S, P);
+    scale_ref(ref_output, OC * H * W);
+    
+    axi_data_t* ddr_input = pack_feature_map(hw_input, IC, H, W);
+    axi_data_t* ddr_output = new axi_data_t[OC * H * FM_PITCH(W) / AXI_LANES];
+    axi_data_t* ddr_weights = pack_weights(hw_weights, OC, IC, K);
+    
+    ap_uint<32> control = 0, status = 0;
+    cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights,
+                        hw_scale, hw_shift, NULL, 2, IC, OC, H, W, K, S, P,
+                        DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+    unpack_feature_map(ddr_output, hw_output, OC, H, W);
+    
+    bool pass = compare_results(hw_output, ref_output, OC * H * W, TB_TOL);
+    
+    delete[] ddr_input;
+    delete[] ddr_output;
+    delete[] ddr_weights;
+    delete[] hw_input;
+    delete[] hw_output;
+    delete[] hw_weights;
+    delete[] ref_input;
+    delete[] ref_output;
+    delete[] ref_weights;
+    
+    return pass ? 0 : 1;
+}
+
+int test_top_network() {
+    std::cout << "\n=== Test Command-List (Descriptor) Mode ===" << std::endl;
+    
+    // Two chained layers: 3->16 3x3 + pool, then 16->24 1x1 output head
+    const int C0 = 3, C1 = 16, C2 = 24, H = 16, W = 16;
+    const int PH = H / 2, PW = W / 2;
+    const int IN_WORDS = C0 * H * FM_PITCH(W) / AXI_LANES;
+    const int MID_WORDS = C1 * PH * FM_PITCH(PW) / AXI_LANES;
+    const int OUT_WORDS = C2 * PH * FM_PITCH(PW) / AXI_LANES;
+    const int W0 = C1 * C0 * 9, W1 = C2 * C1;
+    
+    data_t* input = new data_t[C0 * H * W];
+    weight_t* w0 = new weight_t[W0];
+    weight_t* w1 = new weight_t[W1];
+    bn_t scale[C1 + C2], shift[C1 + C2];
+    
+    srand(987);
+    init_random(input, C0 * H * W, TB_IN_RANGE);
+    for (int i = 0; i < W0; i++) w0[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 4.0f * TB_W_RANGE);
+    for (int i = 0; i < W1; i++) w1[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 4.0f * TB_W_RANGE);
+    for (int i = 0; i < C1 + C2; i++) {
+        scale[i] = bn_t((0.5f + rand() / (float)RAND_MAX) * TB_OUT_SCALE);
+        shift[i] = bn_t((rand() / (float)RAND_MAX - 0.5f) * 0.25f);
+    }
+    
+    axi_data_t* packed_in = pack_feature_map(input, C0, H, W);
+    axi_data_t* packed_w0 = pack_weights(w0, C1, C0, 3);
+    axi_data_t* packed_w1 = pack_weights(w1, C2, C1, 1);
+    const int W0_WORDS = (W0 + AXI_LANES - 1) / AXI_LANES;
+    
+    // Reference: two register-programmed starts
+    axi_data_t* mid = new axi_data_t[MID_WORDS];
+    axi_data_t* ref_out = new axi_data_t[OUT_WORDS];
+    ap_uint<32> control = 0, status = 0;
+    cnn_accelerator_top(&control, &status, packed_in, mid, packed_w0, scale, shift, NULL,
+                        1, C0, C1, H, W, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_LINE_BUFFER, 0, 1, PERF_REGS, DECODE_OFF);
+    int layer_beats = perf_read + perf_write;
+    cnn_accelerator_top(&control, &status, mid, ref_out, packed_w1, scale + C1, shift + C1, NULL,
+                        2, C1, C2, PH, PW, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+    layer_beats += perf_read + perf_write;
+    
+    // One DDR arena for feature maps and one for weights, as on the board
+    axi_data_t* fm = new axi_data_t[IN_WORDS + MID_WORDS + OUT_WORDS];
+    axi_data_t* wt = new axi_data_t[W0_WORDS + (W1 + AXI_LANES - 1) / AXI_LANES];
+    for (int i = 0; i < IN_WORDS + MID_WORDS + OUT_WORDS; i++) fm[i] = 0;
+    for (int i = 0; i < IN_WORDS; i++) fm[i] = packed_in[i];
+    for (int i = 0; i < W0_WORDS; i++) wt[i] = packed_w0[i];
+    for (int i = 0; i < (W1 + AXI_LANES - 1) / AXI_LANES; i++) wt[W0_WORDS + i] = packed_w1[i];
+    
+    int desc[2 * DESC_WORDS] = {
+        1, C0, C1, H, W, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_LINE_BUFFER,
+        1, 0, IN_WORDS, 0, 0, 0,
+        2, C1, C2, PH, PW, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED,
+        1, IN_WORDS, IN_WORDS + MID_WORDS, W0_WORDS, C1, 0,
+    };
+    cnn_accelerator_top(&control, &status, fm, fm, wt, scale, shift, desc,
+                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, PERF_REGS, DECODE_OFF);
+    
+    int mismatches = 0;
+    for (int i = 0; i < OUT_WORDS; i++) {
+        if (fm[IN_WORDS + MID_WORDS + i] != ref_out[i]) mismatches++;
+    }
+    std::cout << "  Word mismatches vs per-layer runs: " << mismatches << "/" << OUT_WORDS << std::endl;
+    
+    // Counters of one start cover every layer of the list
+    if ((int)(perf_read + perf_write) != layer_beats) {
+        std::cout << "  Counter beats " << perf_read + perf_write << " != per-layer sum "
+                  << layer_beats << std::endl;
+        mismatches++;
+    }
+    
+    delete[] input;
+    delete[] w0;
+    delete[] w1;
+    delete[] packed_in;
+    delete[] packed_w0;
+    delete[] packed_w1;
+    delete[] mid;
+    delete[] ref_out;
+    delete[] fm;
+    delete[] wt;
+    
+    return mismatches ? 1 : 0;
+}
+
+int test_top_resident() {
+    std::cout << "\n=== Test Resident Fused Tail ===" << std::endl;
+    
+    // Scaled-down L4-L6: 3x3 + pool, 3x3, 1x1 head, chained on chip
+    const int C0 = 32, C1 = 64, C2 = 128, C3 = 24, H = 14, W = 14;
+    const int PH = H / 2, PW = W / 2;
+    const int IN_WORDS = C0 * H * FM_PITCH(W) / AXI_LANES;
+    const int MID1_WORDS = C1 * PH * FM_PITCH(PW) / AXI_LANES;
+    const int MID2_WORDS = C2 * PH * FM_PITCH(PW) / AXI_LANES;
+    const int OUT_WORDS = C3 * PH * FM_PITCH(PW) / AXI_LANES;
+    const int W0 = C1 * C0 * 9, W1 = C2 * C1 * 9, W2 = C3 * C2;
+    const int W0_WORDS = W0 / AXI_LANES, W1_WORDS = W1 / AXI_LANES, W2_WORDS = W2 / AXI_LANES;
+    
+    data_t* input = new data_t[C0 * H * W];
+    weight_t* w0 = new weight_t[W0];
+    weight_t* w1 = new weight_t[W1];
+    weight_t* w2 = new weight_t[W2];
+    bn_t scale[C1 + C2 + C3], shift[C1 + C2 + C3];
+    
+    srand(135);
+    init_random(input, C0 * H * W, TB_IN_RANGE);
+    for (int i = 0; i < W0; i++) w0[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < W1; i++) w1[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < W2; i++) w2[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < C1 + C2 + C3; i++) {
+        scale[i] = bn_t((0.5f + rand() / (float)RAND_MAX) * TB_OUT_SCALE);
+        shift[i] = bn_t((rand() / (float)RAND_MAX - 0.5f) * 0.25f);
+    }
+    
+    axi_data_t* packed_in = pack_feature_map(input, C0, H, W);
+    axi_data_t* packed_w0 = pack_weights(w0, C1, C0, 3);
+    axi_data_t* packed_w1 = pack_weights(w1, C2, C1, 3);
+    axi_data_t* packed_w2 = pack_weights(w2, C3, C2, 1);
+    
+    // Reference: three register-programmed starts on the DDR engines
+    axi_data_t* mid1 = new axi_data_t[MID1_WORDS];
+    axi_data_t* mid2 = new axi_data_t[MID2_WORDS];
+    axi_data_t* ref_out = new axi_data_t[OUT_WORDS];
+    ap_uint<32> control = 0, status = 0;
+    cnn_accelerator_top(&control, &status, packed_in, mid1, packed_w0, scale, shift, NULL,
+                        1, C0, C1, H, W, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+    cnn_accelerator_top(&control, &status, mid1, mid2, packed_w1, scale + C1, shift + C1, NULL,
+                        0, C1, C2, PH, PW, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+    int layer_macs = perf_compute;
+    cnn_accelerator_top(&control, &status, mid2, ref_out, packed_w2, scale + C1 + C2, shift + C1 + C2,
+                        NULL, 2, C2, C3, PH, PW, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1,
+                        PERF_REGS, DECODE_OFF);
+    
+    // Fused: one command list, intermediate buffers must stay untouched
+    axi_data_t* fm = new axi_data_t[IN_WORDS + MID1_WORDS + MID2_WORDS + OUT_WORDS];
+    axi_data_t* wt = new axi_data_t[W0_WORDS + W1_WORDS + W2_WORDS];
+    for (int i = 0; i < IN_WORDS + MID1_WORDS + MID2_WORDS + OUT_WORDS; i++) fm[i] = 0;
+    for (int i = 0; i < IN_WORDS; i++) fm[i] = packed_in[i];
+    for (int i = 0; i < W0_WORDS; i++) wt[i] = packed_w0[i];
+    for (int i = 0; i < W1_WORDS; i++) wt[W0_WORDS + i] = packed_w1[i];
+    for (int i = 0; i < W2_WORDS; i++) wt[W0_WORDS + W1_WORDS + i] = packed_w2[i];
+    
+    const int MID1 = IN_WORDS, MID2 = MID1 + MID1_WORDS, OUT = MID2 + MID2_WORDS;
+    int desc[3 * DESC_WORDS] = {
+        1, C0, C1, H, W, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT,
+        1, 0, MID1, 0, 0, 0,
+        0, C1, C2, PH, PW, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT,
+        1, MID1, MID2, W0_WORDS, C1, 0,
+        2, C2, C3, PH, PW, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT,
+        1, MID2, OUT, W0_WORDS + W1_WORDS, C1 + C2, 0,
+    };
+    cnn_accelerator_top(&control, &status, fm, fm, wt, scale, shift, desc,
+                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, PERF_REGS, DECODE_OFF);
+    
+    data_t* hw = new data_t[C3 * PH * PW];
+    data_t* ref = new data_t[C3 * PH * PW];
+    unpack_feature_map(fm + OUT, hw, C3, PH, PW);
+    unpack_feature_map(ref_out, ref, C3, PH, PW);
+    int mismatches = 0;
+    for (int i = 0; i < C3 * PH * PW; i++) {
+        if (hw[i] != ref[i]) mismatches++;
+    }
+    std::cout << "  Value mismatches vs per-layer runs: " << mismatches << "/" << C3 * PH * PW << std::endl;
+    
+    // DDR traffic: the input map and weights in, the head out, nothing between
+    int untouched = 0;
+    for (int i = MID1; i < OUT; i++) {
+        if (fm[i] != 0) untouched++;
+    }
+    const int expect_read = IN_WORDS + W0_WORDS + W1_WORDS + W2_WORDS;
+    bool ok = untouched == 0 && (int)perf_read == expect_read && (int)perf_write == OUT_WORDS;
+    std::cout << "  read " << perf_read << " (expect " << expect_read << "), write " << perf_write
+              << " (expect " << OUT_WORDS << "), intermediate words written " << untouched
+              << (ok ? "" : "  FAIL") << std::endl;
+    if (!ok) mismatches++;
+    
+    // The resident engine keeps the array as busy as the tiled path on L5
+    cnn_accelerator_top(&control, &status, mid1, mid2, packed_w1, scale + C1, shift + C1, NULL,
+                        0, C1, C2, PH, PW, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT, 0, 1, PERF_REGS, DECODE_OFF);
+    if ((int)perf_compute != layer_macs) {
+        std::cout << "  Resident compute " << perf_compute << " != tiled " << layer_macs << std::endl;
+        mismatches++;
+    }
+    
+    delete[] input;
+    delete[] w0;
+    delete[] w1;
+    delete[] w2;
+    delete[] packed_in;
+    delete[] packed_w0;
+    delete[] packed_w1;
+    delete[] packed_w2;
+    delete[] mid1;
+    delete[] mid2;
+    delete[] ref_out;
+    delete[] fm;
+    delete[] wt;
+    delete[] hw;
+    delete[] ref;
+    
+    return mismatches ? 1 : 0;
+}
+
+int test_top_batch() {
+    std::cout << "\n=== Test Batched Inference ===" << std::endl;
+    
+    // L5-style 3x3 layer and a 1x1 head, NB images back to back in each buffer
+    const int NB = 4, C0 = 64, C1 = 128, C2 = 24, H = 7, W = 7;
+    const int IN_WORDS = C0 * H * FM_PITCH(W) / AXI_LANES;
+    const int MID_WORDS = C1 * H * FM_PITCH(W) / AXI_LANES;
+    const int OUT_WORDS = C2 * H * FM_PITCH(W) / AXI_LANES;
+    const int W0 = C1 * C0 * 9, W1 = C2 * C1;
+    const int W0_WORDS = W0 / AXI_LANES, W1_WORDS = W1 / AXI_LANES;
+    
+    weight_t* w0 = new weight_t[W0];
+    weight_t* w1 = new weight_t[W1];
+    data_t* input = new data_t[C0 * H * W];
+    bn_t scale[C1 + C2], shift[C1 + C2];
+    
+    srand(579);
+    for (int i = 0; i < W0; i++) w0[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < W1; i++) w1[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < C1 + C2; i++) {
+        scale[i] = bn_t((0.5f + rand() / (float)RAND_MAX) * TB_OUT_SCALE);
+        shift[i] = bn_t((rand() / (float)RAND_MAX - 0.5f) * 0.25f);
+    }
+    axi_data_t* packed_w0 = pack_weights(w0, C1, C0, 3);
+    axi_data_t* packed_w1 = pack_weights(w1, C2, C1, 1);
+    
+    // Reference: each image through its own single-image starts
+    axi_data_t* batch_in = new axi_data_t[NB * IN_WORDS];
+    axi_data_t* ref_mid = new axi_data_t[NB * MID_WORDS];
+    axi_data_t* ref_out = new axi_data_t[NB * OUT_WORDS];
+    ap_uint<32> control = 0, status = 0;
+    for (int b = 0; b < NB; b++) {
+        init_random(input, C0 * H * W, TB_IN_RANGE);
+        axi_data_t* packed_in = pack_feature_map(input, C0, H, W);
+        for (int i = 0; i < IN_WORDS; i++) batch_in[b * IN_WORDS + i] = packed_in[i];
+        cnn_accelerator_top(&control, &status, packed_in, ref_mid + b * MID_WORDS, packed_w0, scale, shift,
+                            NULL, 0, C0, C1, H, W, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1,
+                            PERF_REGS, DECODE_OFF);
+        cnn_accelerator_top(&control, &status, ref_mid + b * MID_WORDS, ref_out + b * OUT_WORDS, packed_w1,
+                            scale + C1, shift + C1, NULL, 2, C1, C2, H, W, 1, 1, 0,
+                            DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, 1, PERF_REGS, DECODE_OFF);
+        delete[] packed_in;
+    }
+    
+    int fails = 0;
+    axi_data_t* mid = new axi_data_t[NB * MID_WORDS];
+    const char* names[] = {"tiled", "", "resident"};
+    
+    // Register mode: the tiled path runs the images in turn, the resident
+    // engine holds all NB input maps and fetches each weight once
+    for (int engine = ENGINE_TILED; engine <= ENGINE_RESIDENT; engine += ENGINE_RESIDENT) {
+        for (int i = 0; i < NB * MID_WORDS; i++) mid[i] = 0;
+        cnn_accelerator_top(&control, &status, batch_in, mid, packed_w0, scale, shift, NULL,
+                            0, C0, C1, H, W, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, engine, 0, NB, PERF_REGS, DECODE_OFF);
+        int mismatches = 0;
+        for (int b = 0; b < NB; b++) {
+            mismatches += map_mismatches(mid + b * MID_WORDS, ref_mid + b * MID_WORDS, C1, H, W);
+        }
+        std::cout << "  " << names[engine] << " x" << NB << ": value mismatches " << mismatches << "/"
+                  << NB * C1 * H * W << ", read " << perf_read;
+        if (engine == ENGINE_RESIDENT) {
+            const int expect_read = NB * IN_WORDS + W0_WORDS;
+            std::cout << " (expect " << expect_read << ")";
+            if ((int)perf_read != expect_read) mismatches++;
+        }
+        std::cout << (mismatches ? "  FAIL" : "") << std::endl;
+        if (mismatches) fails++;
+    }
+    
+    // Command list: both layers resident and chained, the batch stays on chip
+    axi_data_t* fm = new axi_data_t[NB * (IN_WORDS + MID_WORDS + OUT_WORDS)];
+    axi_data_t* wt = new axi_data_t[W0_WORDS + W1_WORDS];
+    for (int i = 0; i < NB * (IN_WORDS + MID_WORDS + OUT_WORDS); i++) fm[i] = 0;
+    for (int i = 0; i < NB * IN_WORDS; i++) fm[i] = batch_in[i];
+    for (int i = 0; i < W0_WORDS; i++) wt[i] = packed_w0[i];
+    for (int i = 0; i < W1_WORDS; i++) wt[W0_WORDS + i] = packed_w1[i];
+    
+    const int MID = NB * IN_WORDS, OUT = MID + NB * MID_WORDS;
+    int desc[2 * DESC_WORDS] = {
+        0, C0, C1, H, W, 3, 1, 1, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT,
+        NB, 0, MID, 0, 0, 0,
+        2, C1, C2, H, W, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_RESIDENT,
+        NB, MID, OUT, W0_WORDS, C1, 0,
+    };
+    cnn_accelerator_top(&control, &status, fm, fm, wt, scale, shift, desc,
+                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, PERF_REGS, DECODE_OFF);
+    
+    int mismatches = 0, untouched = 0;
+    for (int b = 0; b < NB; b++) {
+        mismatches += map_mismatches(fm + OUT + b * OUT_WORDS, ref_out + b * OUT_WORDS, C2, H, W);
+    }
+    for (int i = MID; i < OUT; i++) {
+        if (fm[i] != 0) untouched++;
+    }
+    const int expect_read = NB * IN_WORDS + W0_WORDS + W1_WORDS;
+    bool ok = mismatches == 0 && untouched == 0 && (int)perf_read == expect_read &&
+              (int)perf_write == NB * OUT_WORDS;
+    std::cout << "  fused x" << NB << ": value mismatches " << mismatches << "/" << NB * C2 * H * W
+              << ", read " << perf_read << " (expect " << expect_read << "), write " << perf_write
+              << " (expect " << NB * OUT_WORDS << "), intermediate words written " << untouched
+              << (ok ? "" : "  FAIL") << std::endl;
+    if (!ok) fails++;
+    
+    delete[] w0;
+    delete[] w1;
+    delete[] input;
+    delete[] packed_w0;
+    delete[] packed_w1;
+    delete[] batch_in;
+    delete[] ref_mid;
+    delete[] ref_out;
+    delete[] mid;
+    delete[] fm;
+    delete[] wt;
+    
+    return fails;
+}
+
+int test_top_head_decode() {
+    std::cout << "\n=== Test Head Decode (candidate list) ===" << std::endl;
+    
+    // 1x1 head of 3 anchors x (5 + 3 classes) on a 7x7 grid, two images
+    const int NB = 2, C1 = 32, NA = 3, NC = 3, C2 = NA * (5 + NC), H = 7, W = 7;
+    const int P = FM_PITCH(W), PLANE = H * P;
+    const int IN_WORDS = C1 * H * P / AXI_LANES, OUT_WORDS = C2 * PLANE / AXI_LANES;
+    const float anchors[NA][2] = {{1.5f, 2.0f}, {3.25f, 2.5f}, {5.0f, 6.0f}};
+    
+    weight_t* w = new weight_t[C2 * C1];
+    data_t* input = new data_t[C1 * H * W];
+    bn_t scale[C2], shift[C2];
+    
+    srand(2468);
+    for (int i = 0; i < C2 * C1; i++) w[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 8.0f * TB_W_RANGE);
+    for (int i = 0; i < C2; i++) {
+        scale[i] = bn_t(1);
+        shift[i] = bn_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f);   // Conv bias
+    }
+    axi_data_t* packed_w = pack_weights(w, C2, C1, 1);
+    axi_data_t* fm = new axi_data_t[NB * (IN_WORDS + OUT_WORDS)];
+    for (int b = 0; b < NB; b++) {
+        init_random(input, C1 * H * W, TB_IN_RANGE);
+        axi_data_t* packed_in = pack_feature_map(input, C1, H, W);
+        for (int i = 0; i < IN_WORDS; i++) fm[b * IN_WORDS + i] = packed_in[i];
+        delete[] packed_in;
+    }
+    axi_data_t* head = fm + NB * IN_WORDS;
+    
+    // Plain run: the head map, and no candidates without decode
+    ap_uint<32> control = 0, status = 0;
+    num_candidates = 1;
+    cnn_accelerator_top(&control, &status, fm, head, packed_w, scale, shift, NULL,
+                        2, C1, C2, H, W, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, NB,
+                        PERF_REGS, DECODE_OFF);
+    int fails = (num_candidates != 0) ? 1 : 0;
+    axi_data_t* ref_head = new axi_data_t[NB * OUT_WORDS];
+    for (int i = 0; i < NB * OUT_WORDS; i++) ref_head[i] = head[i];
+    
+    data_t* map = new data_t[NB * C2 * H * W];
+    for (int b = 0; b < NB; b++) unpack_feature_map(ref_head + b * OUT_WORDS, map + b * C2 * H * W, C2, H, W);
+    auto raw = [&](int b, int c, int y, int x) {
+        return (int)(ap_int<16>)map[((b * C2 + c) * H + y) * W + x].range(15, 0);
+    };
+    
+    // Thresholds: about the top fifth of each anchor's objectness passes
+    int params[DECODE_PARAM_WORDS] = {NA, NC, DECODE_MAX_CANDS, 0};
+    for (int a = 0; a < NA; a++) {
+        std::vector<int> obj;
+        for (int b = 0; b < NB; b++)
+            for (int i = 0; i < H * W; i++) obj.push_back(raw(b, a * (5 + NC) + 4, i / W, i % W));
+        std::sort(obj.begin(), obj.end());
+        int* p = &params[DECODE_ANCHOR_BASE + DECODE_ANCHOR_WORDS * a];
+        p[DECODE_OBJ_MIN] = obj[obj.size() * 4 / 5];
+        p[DECODE_ANCHOR_W] = (int)(anchors[a][0] * 65536);
+        p[DECODE_ANCHOR_H] = (int)(anchors[a][1] * 65536);
+    }
+    
+    // Reference list, in the IP's order: image, cell row-major, anchor
+    struct RefCand { int b, cx, cy, a, cls, obj, best; float box[4]; };
+    std::vector<RefCand> ref;
+    for (int b = 0; b < NB; b++)
+        for (int cy = 0; cy < H; cy++)
+            for (int cx = 0; cx < W; cx++)
+                for (int a = 0; a < NA; a++) {
+                    int ch = a * (5 + NC);
+                    if (raw(b, ch + 4, cy, cx) < params[DECODE_ANCHOR_BASE + DECODE_ANCHOR_WORDS * a]) continue;
+                    int t[5 + NC];
+                    for (int k = 0; k < 5 + NC; k++) t[k] = raw(b, ch + k, cy, cx) + (int)(ap_int<16>)shift[ch + k].range(15, 0);
+                    RefCand r = {b, cx, cy, a, 0, t[4], t[5], {0, 0, 0, 0}};
+                    for (int c = 1; c < NC; c++) {
+                        if (t[5 + c] > r.best) { r.best = t[5 + c]; r.cls = c; }
+                    }
+                    float tw = std::min(std::max(t[2] / 256.0f, -8.0f), 8.0f - 1 / 256.0f);
+                    float th = std::min(std::max(t[3] / 256.0f, -8.0f), 8.0f - 1 / 256.0f);
+                    r.box[0] = 1 / (1 + std::exp(-t[0] / 256.0f)) + cx;
+                    r.box[1] = 1 / (1 + std::exp(-t[1] / 256.0f)) + cy;
+                    r.box[2] = std::min(std::exp(tw) * anchors[a][0], 255.99f);
+                    r.box[3] = std::min(std::exp(th) * anchors[a][1], 255.99f);
+                    ref.push_back(r);
+                }
+    
+    // Register mode: every candidate, against the reference
+    axi_data_t* cands = new axi_data_t[DECODE_MAX_CANDS * DECODE_CAND_WORDS];
+    for (int i = 0; i < DECODE_MAX_CANDS * DECODE_CAND_WORDS; i++) cands[i] = ~axi_data_t(0);
+    cnn_accelerator_top(&control, &status, fm, head, packed_w, scale, shift, NULL,
+                        2, C1, C2, H, W, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED, 0, NB,
+                        PERF_REGS, 1, params, cands, &num_candidates);
+    int field_errors = 0, map_errors = 0;
+    float box_err = 0;
+    for (int b = 0; b < NB; b++) {
+        map_errors += map_mismatches(head + b * OUT_WORDS, ref_head + b * OUT_WORDS, C2, H, W);
+    }
+    for (int n = 0; n < (int)ref.size() && n < (int)num_candidates; n++) {
+        axi_data_t w0 = cands[n * DECODE_CAND_WORDS], w1 = cands[n * DECODE_CAND_WORDS + 1];
+        const RefCand& r = ref[n];
+        if ((int)w1.range(7, 0) != r.cx || (int)w1.range(15, 8) != r.cy || (int)w1.range(19, 16) != r.a ||
+            (int)w1.range(23, 20) != r.b || (int)w1.range(31, 24) != r.cls ||
+            (int)(ap_int<16>)w1.range(47, 32) != r.obj || (int)(ap_int<16>)w1.range(63, 48) != r.best) {
+            field_errors++;
+        }
+        for (int k = 0; k < 4; k++) {
+            float v = (int)w0.range(16 * k + 15, 16 * k) / 256.0f;
+            float err = std::fabs(v - r.box[k]) / ((k < 2) ? 1.0f : std::max(r.box[k], 1.0f));
+            box_err = std::max(box_err, err);
+        }
+    }
+    // Sigmoid LUT: 1/16 input steps; exp tables exact, then Q8.8
+    bool ok = (int)num_candidates == (int)ref.size() && ref.size() > 0 && field_errors == 0 &&
+              map_errors == 0 && box_err <= 0.012f;
+    std::cout << "  register x" << NB << ": " << num_candidates << " candidates (expect " << ref.size()
+              << " of " << NB * H * W * NA << "), field mismatches " << field_errors
+              << ", max box error " << box_err << ", head map mismatches " << map_errors
+              << (ok ? "" : "  FAIL") << std::endl;
+    if (!ok) fails++;
+    
+    // Command list (DESC_DECODE) with a 4-entry list: the count is still the total
+    const int CAP = 4;
+    axi_data_t* first = new axi_data_t[CAP * DECODE_CAND_WORDS];
+    for (int i = 0; i < CAP * DECODE_CAND_WORDS; i++) first[i] = cands[i];
+    for (int i = 0; i < DECODE_MAX_CANDS * DECODE_CAND_WORDS; i++) cands[i] = ~axi_data_t(0);
+    params[DECODE_MAX_CAND] = CAP;
+    int desc[DESC_WORDS] = {
+        2, C1, C2, H, W, 1, 1, 0, DATAFLOW_INPUT_STATIONARY, ENGINE_TILED,
+        NB, 0, NB * IN_WORDS, 0, 0, 1,
+    };
+    cnn_accelerator_top(&control, &status, fm, fm, packed_w, scale, shift, desc,
+                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, PERF_REGS, 0, params, cands, &num_candidates);
+    int list_errors = 0;
+    for (int i = 0; i < DECODE_MAX_CANDS * DECODE_CAND_WORDS; i++) {
+        axi_data_t expect = (i < CAP * DECODE_CAND_WORDS) ? first[i] : axi_data_t(~axi_data_t(0));
+        if (cands[i] != expect) list_errors++;
+    }
+    ok = (int)num_candidates == (int)ref.size() && list_errors == 0;
+    std::cout << "  command list, " << CAP << " entries: " << num_candidates << " found, word mismatches "
+              << list_errors << (ok ? "" : "  FAIL") << std::endl;
+    if (!ok) fails++;
+    
+    delete[] w;
+    delete[] input;
+    delete[] packed_w;
+    delete[] fm;
+    delete[] ref_head;
+    delete[] map;
+    delete[] cands;
+    delete[] first;
+    
+    return fails;
+}
+
+int test_perf_counters() {
+    std::cout << "\n=== Test Activity Counters ===" << std::endl;
+    
+    // One tile (14x14 fits TILE_H x TILE_W, 32 OC = TILE_CH): counts are exact
+    const int IC = 16, OC = 32, H = 14, W = 14, K = 3;
+    const int OUT_WORDS = OC * H * FM_PITCH(W) / AXI_LANES;
+    
+    data_t* input = new data_t[IC * H * W];
+    weight_t* w = new weight_t[OC * IC * K * K];
+    bn_t scale[OC], shift[OC];
+    
+    srand(246);
+    init_random(input, IC * H * W, TB_IN_RANGE);
+    for (int i = 0; i < OC * IC * K * K; i++) w[i] = weight_t((rand() / (float)RAND_MAX - 0.5f) * 2.0f * TB_W_RANGE);
+    for (int i = 0; i < OC; i++) {
+        scale[i] = 1;
+        shift[i] = 0;
+    }
+    
+    axi_data_t* ddr_input = pack_feature_map(input, IC, H, W);
+    axi_data_t* ddr_weights = pack_weights(w, OC, IC, K);
+    axi_data_t* ddr_output = new axi_data_t[OUT_WORDS];
+    
+    // MAC cycles: OC groups x IC groups x taps x output pixels, on either engine.
+    // Weights: 9 taps x IC / AXI_LANES words per OC. Inputs: the tiled path
+    // reads each 16-wide halo row unaligned, one beat more than it spans
+    // (padding rows are not fetched); the line buffer reads each row once.
+    const int macs = (OC / PARALLEL_OUT_CH) * (IC / PARALLEL_IN_CH) * K * K * H * W;
+    const int w_beats = OC * K * K * (IC / AXI_LANES);
+    const int halo_beats = (W + 2 + AXI_LANES - 1) / AXI_LANES + 1;
+    const int expect_read[2] = {w_beats + IC * H * halo_beats, w_beats + IC * H * FM_PITCH(W) / AXI_LANES};
+    const char* names[] = {"tiled", "line-buffer"};
+    int fails = 0;
+    
+    const int last_engine = LINE_BUFFER_ENABLED ? ENGINE_LINE_BUFFER : ENGINE_TILED;
+    for (int engine = ENGINE_TILED; engine <= last_engine; engine++) {
+        ap_uint<32> control = 0, status = 0;
+        cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights,
+                            scale, shift, NULL, 0, IC, OC, H, W, K, 1, 1,
+                            DATAFLOW_OUTPUT_STATIONARY, engine, 0, 1, PERF_REGS, DECODE_OFF);
+        
+        bool ok = perf_compute == macs && perf_read == expect_read[engine] && perf_write == OUT_WORDS;
+        std::cout << "  " << names[engine] << ": compute " << perf_compute
+                  << " (expect " << macs << "), read " << perf_read
+                  << " (expect " << expect_read[engine] << "), write " << perf_write
+                  << " (expect " << OUT_WORDS << ")" << (ok ? "" : "  FAIL") << std::endl;
+        if (!ok) fails++;
+    }
+    
+    delete[] input;
+    delete[] w;
+    delete[] ddr_input;
+    delete[] ddr_weights;
+    delete[] ddr_output;
+    
+    return fails;
+}
+
+/*******************************************************************************
+ * Camera Preprocessing Test
+ * Frames streamed into camera_preprocess_top must give the same Q8.8 map as
+ * preprocess_image() on the ARM (sw/common/image_preprocess.c, linked into
+ * the testbench), upscaling the test image and downscaling a larger random
+ * frame. Junk pixels ahead of the start of frame are dropped and counted.
+ ******************************************************************************/
+int test_camera_preprocess() {
+    std::cout << "\n=== Test Camera Preprocessing ===" << std::endl;
+    
+    const int RAND_W = 300, RAND_H = 200, JUNK = 5;
+    const int DST = 224;    // CNN_INPUT_WIDTH x CNN_INPUT_HEIGHT, already pitched
+    unsigned char* random_frame = new unsigned char[RAND_W * RAND_H * 3];
+    fixed16_t* expect = new fixed16_t[3 * DST * DST];
+    axi_data_t* ddr_input = new axi_data_t[CAM_FM_DEPTH];
+    int fails = 0;
+    
+    srand(468);
+    for (int i = 0; i < RAND_W * RAND_H * 3; i++) random_frame[i] = (unsigned char)(rand() & 0xFF);
+    
+    struct Frame { const unsigned char* rgb; int w, h; };
+    const Frame frames[] = {{TEST_IMAGE, IMG_WIDTH, IMG_HEIGHT}, {random_frame, RAND_W, RAND_H}};
+    
+    for (int t = 0; t < 2; t++) {
+        const Frame& f = frames[t];
+        hls::stream<video_pixel_t> video;
+        for (int i = 0; i < JUNK + f.w * f.h; i++) {
+            video_pixel_t pix;
+            const unsigned char* rgb = f.rgb + 3 * (i < JUNK ? 0 : i - JUNK);
+            pix.data = (rgb[0] << 16) | (rgb[2] << 8) | rgb[1];    // {R, B, G}
+            pix.user = (i == JUNK);
+            pix.last = (i >= JUNK && (i - JUNK) % f.w == f.w - 1);
+            video.write(pix);
+        }
+        
+        ap_uint<32> dropped = 0;
+        camera_preprocess_top(video, ddr_input, f.w, f.h, DST, DST, &dropped);
+        preprocess_image(f.rgb, f.w, f.h, expect);
+        
+        int mismatches = 0;
+        for (int i = 0; i < 3 * DST * DST; i++) {
+            int v = (int)(short)(unsigned)ddr_input[i / CAM_LANES].range(16 * (i % CAM_LANES) + 15,
+                                                                          16 * (i % CAM_LANES));
+            if (v != expect[i]) mismatches++;
+        }
+        std::cout << "  " << f.w << "x" << f.h << " -> " << DST << "x" << DST << ": "
+                  << mismatches << " mismatches vs preprocess_image, dropped " << dropped
+                  << ", " << video.size() << " pixels left" << std::endl;
+        if (mismatches || dropped != JUNK || !video.empty()) fails++;
+    }
+    
+    delete[] random_frame;
+    delete[] expect;
+    delete[] ddr_input;
+    
+    return fails;
+}
+
+/*******************************************************************************
+ * ARM Q8.8 Model Test (Q8.8 bitstreams)
+ * The golden model of sw/common/layers_q88.c (linked into the testbench)
+ * against the top function, value for value: saturating group-order sums on
+ * the direct engines, exact sums (conv2d_q88_exact) on Winograd. Inputs and
+ * weights are large enough that partial sums saturate, so the case only
+ * passes if each engine's order is modelled; the direct model must also
+ * disagree with Winograd somewhere, or the case proves nothing.
+ ******************************************************************************/
+#if !CNN_INT8
+static int16_t q88_raw(float range) {
+    return (int16_t)((rand() / (float)RAND_MAX - 0.5f) * 2.0f * range * 256.0f);
+}
+
+int test_q88_model() {
+    std::cout << "\n=== Test ARM Q8.8 Model vs PL ===" << std::endl;
+    
+    struct Case { int type, ic, oc, h, w, k, pad, engine; };
+    const Case cases[] = {
+        {1, 16, 16, 14, 14, 3, 1, ENGINE_TILED}, {1, 16, 16, 14, 14, 3, 1, ENGINE_LINE_BUFFER},
+        {1, 16, 16, 14, 14, 3, 1, ENGINE_WINOGRAD}, {0, 24, 12, 10, 9, 3, 1, ENGINE_WINOGRAD},
+        {0, 32, 8, 7, 7, 1, 0, ENGINE_TILED},
+    };
+    const int NUM_CASES = sizeof(cases) / sizeof(cases[0]);
+    int fails = 0;
+    
+    srand(1357);
+    for (int t = 0; t < NUM_CASES; t++) {
+        const Case& c = cases[t];
+        bool wino = WINO_ENABLED && c.engine == ENGINE_WINOGRAD;
+        int in_pitch = FM_PITCH(c.w);
+        int out_h = (c.type == 1) ? c.h / 2 : c.h;
+        int out_w = (c.type == 1) ? c.w / 2 : c.w;
+        int out_pitch = FM_PITCH(out_w);
+        int taps = c.k * c.k * c.ic;
+        int w_words = (c.oc * taps + AXI_LANES - 1) / AXI_LANES;
+        
+        // Raw Q8.8 operands in the DDR layouts, shared by both sides
+        std::vector<int16_t> in(c.ic * c.h * in_pitch, 0), w(w_words * AXI_LANES, 0);
+        std::vector<int16_t> scale(c.oc), shift(c.oc);
+        for (int row = 0; row < c.ic * c.h; row++) {
+            for (int x = 0; x < c.w; x++) in[row * in_pitch + x] = q88_raw(100.0f);
+        }
+        for (int i = 0; i < c.oc * taps; i++) w[i] = q88_raw(100.0f);
+        for (int i = 0; i < c.oc; i++) {
+            scale[i] = (int16_t)(1 + rand() % 4);        // 1/256 .. 4/256
+            shift[i] = q88_raw(1.0f);
+        }
+        
+        axi_data_t* ddr_input = new axi_data_t[in.size() / AXI_LANES];
+        axi_data_t* ddr_weights = new axi_data_t[w_words];
+        axi_data_t* ddr_output = new axi_data_t[c.oc * out_h * out_pitch / AXI_LANES];
+        bn_t* bn_scale = new bn_t[c.oc];
+        bn_t* bn_shift = new bn_t[c.oc];
+        for (size_t i = 0; i < in.size() / AXI_LANES; i++) {
+            data_t v[AXI_LANES];
+            for (int j = 0; j < AXI_LANES; j++) v[j].range(15, 0) = in[i * AXI_LANES + j];
+            ddr_input[i] = pack_word(v);
+        }
+        for (int i = 0; i < w_words; i++) {
+            weight_t v[AXI_LANES];
+            for (int j = 0; j < AXI_LANES; j++) v[j].range(15, 0) = w[i * AXI_LANES + j];
+            ddr_weights[i] = pack_word(v);
+        }
+        for (int i = 0; i < c.oc; i++) {
+            bn_scale[i].range(15, 0) = scale[i];
+            bn_shift[i].range(15, 0) = shift[i];
+        }
+        
+        ap_uint<32> control = 0, status = 0;
+        cnn_accelerator_top(&control, &status, ddr_input, ddr_output, ddr_weights, bn_scale, bn_shift, NULL,
+                            c.type, c.ic, c.oc, c.h, c.w, c.k, 1, c.pad,
+                            DATAFLOW_OUTPUT_STATIONARY, c.engine, 0, 1, PERF_REGS, DECODE_OFF);
+        
+        // ARM model: conv -> bn_leaky -> pool, in the engine's summation order
+        int conv_h = c.h + 2 * c.pad - c.k + 1;
+        int conv_w = c.w + 2 * c.pad - c.k + 1;
+        std::vector<int32_t> acc(c.oc * conv_h * conv_w), acc_other(acc.size());
+        std::vector<int16_t> act(c.oc * conv_h * conv_w), model(c.oc * out_h * out_pitch, 0);
+        (wino ? conv2d_q88_exact : conv2d_q88)(in.data(), in_pitch, acc.data(), w.data(),
+                                              c.ic, c.h, c.w, c.oc, c.k, 1, c.pad);
+        (wino ? conv2d_q88 : conv2d_q88_exact)(in.data(), in_pitch, acc_other.data(), w.data(),
+                                              c.ic, c.h, c.w, c.oc, c.k, 1, c.pad);
+        if (c.type == 1) {
+            bn_leaky_q88(acc.data(), act.data(), conv_w, scale.data(), shift.data(),
+                         c.oc, conv_h, conv_w, c.type);
+            maxpool2d_q88(act.data(), conv_w, model.data(), out_pitch, c.oc, conv_h, conv_w);
+        } else {
+            bn_leaky_q88(acc.data(), model.data(), out_pitch, scale.data(), shift.data(),
+                         c.oc, conv_h, conv_w, c.type);
+        }
+        
+        int mismatches = 0, order_diffs = 0;
+        for (int row = 0; row < c.oc * out_h; row++) {
+            for (int x = 0; x < out_w; x++) {
+                int idx = row * out_pitch + x;
+                int hw = (int)(short)(unsigned)ddr_output[idx / AXI_LANES].range(16 * (idx % AXI_LANES) + 15,
+                                                                               16 * (idx % AXI_LANES));
+                if (hw != model[idx]) mismatches++;
+            }
+        }
+        for (size_t i = 0; i < acc.size(); i++) {
+            if (acc[i] != acc_other[i]) order_diffs++;
+        }
+        std::cout << "  " << c.ic << "->" << c.oc << " " << c.h << "x" << c.w << " k" << c.k
+                  << " engine " << c.engine << ": " << mismatches << " mismatches, "
+                  << order_diffs << " sums differ between saturating and exact orders" << std::endl;
+        if (mismatches || (c.k == 3 && order_diffs == 0)) fails++;
+        
+        delete[] ddr_input;
+        delete[] ddr_weights;
+        delete[] ddr_output;
+        delete[] bn_scale;
+        delete[] bn_shift;
+    }
+    
+    return fails;
+}
+#endif
+
+/*******************************************************************************
+ * Full-Network Test
+ * Every fpga_layers[] configuration through the top function, with the real
+ * weights (BN as Q8.8 scale/shift, as utils/pack_weights.py packs them, or as
+ * INT8 requantisation) and the test image. The PL chain is compared layer by layer against the float
+ * network of yolo_layers.h, with two differences that are properties of the
+ * PL rather than errors: LeakyReLU uses the PL's 1/8 slope, and reference
+ * values outside Q8.8 are clipped (and counted) before the SNR. The head is
+ * compared without its bias, which the ARM adds after the PL. The INT8 build
+ * calibrates each activation scale to the largest magnitude of the float
+ * map for the test image, which leaves nothing to clip.
+ ******************************************************************************/
+struct NetLayer {
+    int layer_type, ic, oc, h, w, k, s, p, dataflow, engine;
+    const float *weights, *gamma, *beta, *mean, *var;   // BN NULL: output head
+};
+
+// Same configurations as fpga_layers[] in sw/fpga_accelerated/main.c
+static const NetLayer net_layers[] = {
+    {1, 3,   16,  224, 224, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_WINOGRAD,    CONV0_W, BN0_GAMMA, BN0_BETA, BN0_MEAN, BN0_VAR},
+    {1, 16,  32,  112, 112, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_WINOGRAD,    CONV1_W, BN1_GAMMA, BN1_BETA, BN1_MEAN, BN1_VAR},
+    {1, 32,  64,   56,  56, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_WINOGRAD,    CONV2_W, BN2_GAMMA, BN2_BETA, BN2_MEAN, BN2_VAR},
+    {1, 64,  128,  28,  28, 3, 1, 1, DATAFLOW_WEIGHT_STATIONARY, ENGINE_WINOGRAD,    CONV3_W, BN3_GAMMA, BN3_BETA, BN3_MEAN, BN3_VAR},
+    {1, 128, 256,  14,  14, 3, 1, 1, DATAFLOW_INPUT_STATIONARY,  ENGINE_RESIDENT,    CONV4_W, BN4_GAMMA, BN4_BETA, BN4_MEAN, BN4_VAR},
+    {0, 256, 512,   7,   7, 3, 1, 1, DATAFLOW_INPUT_STATIONARY,  ENGINE_RESIDENT,    CONV5_W, BN5_GAMMA, BN5_BETA, BN5_MEAN, BN5_VAR},
+    {2, 512,  24,   7,   7, 1, 1, 0, DATAFLOW_INPUT_STATIONARY,  ENGINE_RESIDENT,    CONV6_W, NULL, NULL, NULL, NULL},
+};
+#define NET_LAYERS     (int)(sizeof(net_layers) / sizeof(net_layers[0]))
+#if CNN_INT8
+#define NET_MIN_SNR_DB 18.0f   // INT8 chain (max-calibrated scales) vs float, any layer
+#else
+#define NET_MIN_SNR_DB 25.0f   // Q8.8 chain vs float, any layer
+#endif
+
+static int net_out_h(const NetLayer& l) {
+    int h = (l.h + 2 * l.p - l.k) / l.s + 1;
+    return (l.layer_type == 1) ? h / 2 : h;
+}
+
+static int net_out_w(const NetLayer& l) {
+    int w = (l.w + 2 * l.p - l.k) / l.s + 1;
+    return (l.layer_type == 1) ? w / 2 : w;
+}
+
+// Test image resized to the network input (bilinear, pixel centres), [0, 1] CHW
+static void net_input(float* out) {
+    const float sx = (float)IMG_WIDTH / INPUT_SIZE, sy = (float)IMG_HEIGHT / INPUT_SIZE;
+    for (int y = 0; y < INPUT_SIZE; y++) {
+        float fy = fmaxf((y + 0.5f) * sy - 0.5f, 0.0f);
+        int y0 = (int)fy, y1 = (y0 + 1 < IMG_HEIGHT) ? y0 + 1 : y0;
+        float wy = fy - y0;
+        for (int x = 0; x < INPUT_SIZE; x++) {
+            float fx = fmaxf((x + 0.5f) * sx - 0.5f, 0.0f);
+            int x0 = (int)fx, x1 = (x0 + 1 < IMG_WIDTH) ? x0 + 1 : x0;
+            float wx = fx - x0;
+            for (int c = 0; c < IMG_CHANNELS; c++) {
+                float p00 = TEST_IMAGE[(y0 * IMG_WIDTH + x0) * IMG_CHANNELS + c];
+                float p01 = TEST_IMAGE[(y0 * IMG_WIDTH + x1) * IMG_CHANNELS + c];
+                float p10 = TEST_IMAGE[(y1 * IMG_WIDTH + x0) * IMG_CHANNELS + c];
+                float p11 = TEST_IMAGE[(y1 * IMG_WIDTH + x1) * IMG_CHANNELS + c];
+                float top = p00 + (p01 - p00) * wx, bot = p10 + (p11 - p10) * wx;
+                out[(c * INPUT_SIZE + y) * INPUT_SIZE + x] = (top + (bot - top) * wy) / 255.0f;
+            }
+        }
+    }
+}
+
+// Float reference of one layer (yolo_layers.h), dense [C][H][W] in and out
+static void net_ref_layer(const NetLayer& l, const float* in, float* out) {
+    int oh = (l.h + 2 * l.p - l.k) / l.s + 1, ow = (l.w + 2 * l.p - l.k) / l.s + 1;
+    float* conv = (l.layer_type == 1) ? new float[l.oc * oh * ow] : out;
+    
+    conv2d(in, conv, l.weights, l.ic, l.h, l.w, l.oc, l.k, l.s, l.p);
+    if (l.gamma) {
+        // batchnorm_leaky() with the PL's slope
+        for (int c = 0; c < l.oc; c++) {
+            float scale = l.gamma[c] / fast_sqrtf(l.var[c] + 1e-5f);
+            float shift = l.beta[c] - l.mean[c] * scale;
+            for (int i = 0; i < oh * ow; i++) {
+                float v = conv[c * oh * ow + i] * scale + shift;
+                conv[c * oh * ow + i] = v > 0.0f ? v : v * 0.125f;
+            }
+        }
+    }
+    if (l.layer_type == 1) {
+        maxpool2d(conv, out, l.oc, oh, ow);
+        delete[] conv;
+    }
+}
+
+// Activation scale of a map (value = code * scale): INT8 maps the largest
+// magnitude to code 127, Q8.8 stores values directly
+static float net_act_scale(const float* v, int size) {
+#if CNN_INT8
+    float m = 0.0f;
+    for (int i = 0; i < size; i++) m = fmaxf(m, fabsf(v[i]));
+    return (m > 0.0f) ? m / 127 : 1.0f;
+#else
+    (void)v;
+    (void)size;
+    return 1.0f;
+#endif
+}
+
+// Weights and BN scale/shift of one layer in the DDR layout. INT8 weights
+// are symmetric per output channel, and the input, weight and output scales
+// fold into the BN scale/shift (cnn_accel.h).
+static void net_pack_layer(const NetLayer& l, float s_in, float s_out,
+                           axi_data_t* ddr_weights, bn_t* scale, bn_t* shift) {
+    int filter = l.ic * l.k * l.k, size = l.oc * filter;
+    weight_t* w = new weight_t[size];
+    for (int c = 0; c < l.oc; c++) {
+        const float* f = &l.weights[c * filter];
+        double s = l.gamma ? l.gamma[c] / sqrt((double)l.var[c] + 1e-5) : 1.0;
+        double t = l.gamma ? l.beta[c] - l.mean[c] * s : 0.0;
+#if CNN_INT8
+        float w_max = 0.0f;
+        for (int i = 0; i < filter; i++) w_max = fmaxf(w_max, fabsf(f[i]));
+        double s_w = (w_max > 0.0f) ? w_max / 127.0 : 1.0;
+        for (int i = 0; i < filter; i++) w[c * filter + i] = weight_t(f[i] / s_w);
+        s *= s_in * s_w / s_out;
+        t /= s_out;
+#else
+        (void)s_in;
+        (void)s_out;
+        for (int i = 0; i < filter; i++) w[c * filter + i] = weight_t(f[i]);
+#endif
+        scale[c] = bn_t(s);
+        shift[c] = bn_t(t);
+    }
+    axi_data_t* packed = pack_weights(w, l.oc, l.ic, l.k);
+    for (int i = 0; i < (size + AXI_LANES - 1) / AXI_LANES; i++) ddr_weights[i] = packed[i];
+    delete[] w;
+    delete[] packed;
+}
+
+// SNR of hw codes x 'scale' against the reference clipped to the data_t range,
+// clipped values in 'saturated'
+static float snr_db(const data_t* hw, const float* ref, int size, float scale, int& saturated) {
+    const float lo = data_t(-1e9f).to_float() * scale, hi = data_t(1e9f).to_float() * scale;
+    double signal = 0, noise = 0;
+    saturated = 0;
+    for (int i = 0; i < size; i++) {
+        float r = fminf(fmaxf(ref[i], lo), hi);
+        double d = hw[i].to_float() * scale - r;
+        if (r != ref[i]) saturated++;
+        signal += (double)r * r;
+        noise += d * d;
+    }
+    return (noise > 0) ? (float)(10.0 * log10(signal / noise)) : 99.0f;
+}
+
+/*******************************************************************************
+ * Run layer 'only' (-1: all, chained) and append one report row per layer:
+ *   layer,engine,dataflow,snr_db,saturated,compute_cycles,read_beats,write_beats
+ * A single layer gets the quantized float activations as its input, so a
+ * cosim run of it is one transaction of the top function.
+ ******************************************************************************/
+int test_full_network(int only, const char* report) {
+    std::cout << "\n=== Test Full Network (real weights, test image) ===" << std::endl;
+    
+    // Buffers cover the m_axi depths (cosim copies whole ports)
+    axi_data_t* fm_a = new axi_data_t[DDR_FM_DEPTH];
+    axi_data_t* fm_b = new axi_data_t[DDR_FM_DEPTH];
+    axi_data_t* ddr_weights = new axi_data_t[DDR_WEIGHTS_DEPTH];
+    bn_t* scale = new bn_t[MAX_OUTPUT_CHANNELS];
+    bn_t* shift = new bn_t[MAX_OUTPUT_CHANNELS];
+    float* ref_in = new float[DDR_FM_DEPTH * AXI_LANES];
+    float* ref_out = new float[DDR_FM_DEPTH * AXI_LANES];
+    data_t* hw = new data_t[DDR_FM_DEPTH * AXI_LANES];
+    for (int i = 0; i < DDR_FM_DEPTH; i++) {
+        fm_a[i] = 0;
+        fm_b[i] = 0;
+    }
+    for (int i = 0; i < DDR_WEIGHTS_DEPTH; i++) ddr_weights[i] = 0;
+    
+    net_input(ref_in);
+    float s_in = net_act_scale(ref_in, 3 * INPUT_SIZE * INPUT_SIZE);
+    for (int i = 0; i < 3 * INPUT_SIZE * INPUT_SIZE; i++) hw[i] = data_t(ref_in[i] / s_in);
+    axi_data_t* packed = pack_feature_map(hw, 3, INPUT_SIZE, INPUT_SIZE);
+    for (int i = 0; i < 3 * INPUT_SIZE * FM_PITCH(INPUT_SIZE) / AXI_LANES; i++) fm_a[i] = packed[i];
+    delete[] packed;
+    
+    std::ofstream csv;
+    if (report) {
+        std::ifstream existing(report);
+        bool fresh = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+        existing.close();
+        csv.open(report, std::ios::app);
+        if (fresh) csv << "layer,engine,dataflow,snr_db,saturated,compute_cycles,read_beats,write_beats" << std::endl;
+    }
+    
+    int fails = 0;
+    for (int i = 0; i < NET_LAYERS && (only < 0 || i <= only); i++) {
+        const NetLayer& l = net_layers[i];
+        int oh = net_out_h(l), ow = net_out_w(l);
+        int out_size = l.oc * oh * ow;
+        
+        net_ref_layer(l, ref_in, ref_out);
+        float s_out = net_act_scale(ref_out, out_size);
+        if (only < 0 || i == only) {
+            if (i == only && i > 0) {
+                // Isolated layer: quantized float activations as its input
+                for (int j = 0; j < l.ic * l.h * l.w; j++) hw[j] = data_t(ref_in[j] / s_in);
+                packed = pack_feature_map(hw, l.ic, l.h, l.w);
+                for (int j = 0; j < l.ic * l.h * FM_PITCH(l.w) / AXI_LANES; j++) fm_a[j] = packed[j];
+                delete[] packed;
+            }
+            
+            net_pack_layer(l, s_in, s_out, ddr_weights, scale, shift);
+            ap_uint<32> control = 0, status = 0;
+            cnn_accelerator_top(&control, &status, fm_a, fm_b, ddr_weights, scale, shift, NULL,
+                                l.layer_type, l.ic, l.oc, l.h, l.w, l.k, l.s, l.p,
+                                l.dataflow, l.engine, 0, 1, PERF_REGS, DECODE_OFF);
+            
+            unpack_feature_map(fm_b, hw, l.oc, oh, ow);
+            int saturated;
+            float snr = snr_db(hw, ref_out, out_size, s_out, saturated);
+            bool ok = snr >= NET_MIN_SNR_DB;
+            std::cout << "  L" << i << " " << l.ic << "->" << l.oc << " " << l.h << "x" << l.w
+                      << ": SNR " << snr << " dB (" << saturated << " saturated), compute "
+                      << perf_compute << ", read " << perf_read << ", write " << perf_write
+                      << (ok ? "" : "  FAIL") << std::endl;
+            if (!ok) fails++;
+            if (report) {
+                csv << i << "," << l.engine << "," << l.dataflow << "," << snr << "," << saturated << ","
+                    << perf_compute << "," << perf_read << "," << perf_write << std::endl;
+            }
+            std::swap(fm_a, fm_b);
+        }
+        std::swap(ref_in, ref_out);
+        s_in = s_out;
+    }
+    
+    delete[] fm_a;
+    delete[] fm_b;
+    delete[] ddr_weights;
+    delete[] scale;
+    delete[] shift;
+    delete[] ref_in;
+    delete[] ref_out;
+    delete[] hw;
+    
+    return fails;
+}
+
 /*******************************************************************************
  * Main Testbench
+ *   (no arguments)            unit tests and the full network
+ *   network [report.csv]      full network only
+ *   bench <layer> [report]    one network layer (script.tcl bench target)
  ******************************************************************************/
-int main() {
+int main(int argc, char** argv) {
     int errors = 0;
     
+    if (argc > 1 && (strcmp(argv[1], "network") == 0 || strcmp(argv[1], "bench") == 0)) {
+        bool bench = strcmp(argv[1], "bench") == 0;
+        if (bench && argc < 3) {
+            std::cout << "usage: bench <layer> [report.csv]" << std::endl;
+            return 1;
+        }
+        int layer = bench ? atoi(argv[2]) : -1;
+        const char* report = (argc > (bench ? 3 : 2)) ? argv[bench ? 3 : 2] : NULL;
+        if (layer >= NET_LAYERS || (bench && layer < 0)) {
+            std::cout << "layer " << layer << " out of range (0-" << NET_LAYERS - 1 << ")" << std::endl;
+            return 1;
+        }
+        errors = test_full_network(layer, report);
+        std::cout << (errors ? "  NETWORK FAILED" : "  NETWORK PASSED") << std::endl;
+        return errors;
+    }
+    
     std::cout << "=======================================" << std::endl;
     std::cout << "  CNN Accelerator HLS Testbench" << std::endl;
     std::cout << "=======================================" << std::endl;
     
+#if !CNN_INT8
     errors += test_leaky_relu();
+#endif
     errors += test_maxpool();
+#if !CNN_INT8
     errors += test_conv2d();
+#endif
+    errors += test_top_dataflow();
+    errors += test_top_pool();
+    errors += test_top_winograd();
+    errors += test_top_wide_input();
+    errors += test_top_pointwise();
+    errors += test_top_network();
+#if RESIDENT_ENABLED
+    errors += test_top_resident();
+    errors += test_top_batch();
+#endif
+#if HEAD_DECODE_ENABLED
+    errors += test_top_head_decode();
+#endif
+    errors += test_perf_counters();
+    errors += test_camera_preprocess();
+#if !CNN_INT8
+    errors += test_q88_model();
+#endif
+    errors += test_full_network(-1, NULL);
     
     std::cout << "\n=======================================" << std::endl;
     if (errors == 0) {
@@ -7,43 +7,56 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
 #include "xil_printf.h"
-#include "xil_cache.h"
 #include "xil_io.h"
 
 #include "cnn_driver.h"
 #include "image_preprocess.h"
-#include "tiny_yolo_weights.h"
+#include "tiny_yolo_model.h"
 #include "yolo_layers.h"
+#include "conv_neon.h"
+#include "worker_pool.h"
+#include "layers_q88.h"
+#include "weight_loader.h"
+#include "buffer_plan.h"
+#include "perf_profile.h"
 #include "test_image.h"
 
-/*******************************************************************************
- * ARM Global Timer @ 333 MHz (CPU_FREQ / 2)
- ******************************************************************************/
-#define GLOBAL_TMR_BASE  0xF8F00200U
+/* 1: NEON engine (conv_neon.c), 0: reference scalar conv2d */
+#define USE_NEON_CONV  1
 
-static unsigned int read_timer_lo(void) {
-    return Xil_In32(GLOBAL_TMR_BASE);
-}
+/* 1: split layers across both cores by output channel (sw/cpu1_worker) */
+#define USE_DUAL_CORE  1
 
-static void enable_timer(void) {
-    unsigned int ctrl = Xil_In32(GLOBAL_TMR_BASE + 0x08);
-    Xil_Out32(GLOBAL_TMR_BASE + 0x08, ctrl | 1U);
-}
+/* 1: Q8.8 fixed-point network (layers_q88.c), bit-exact with the FPGA PL.
+      Needs the Q8.8 weight blob on SD or at DDR_WEIGHT_BLOB_ADDR, falls back to float */
+#define USE_Q88        0
+
+/* 1: float weights compiled in from tiny_yolo_weights.h (~6 MB of ELF), runs
+      without an SD card.
+   0: float32 blob from utils/pack_weights.py --f32 (README step 7), BN already
+      folded, read from SD (WEIGHT_BLOB_SD_F32) or from DDR_WEIGHT_BLOB_ADDR */
+#define WEIGHTS_IN_ELF 1
 
-/* Simple ms timer using 32-bit low counter (wraps at ~12.8 sec)
-   For longer measurements, we accumulate small chunks */
-static unsigned int t_start_lo;
+#if WEIGHTS_IN_ELF
+#include "tiny_yolo_weights.h"
+#elif !USE_NEON_CONV
+#error "The scalar reference path applies BN unfolded: set WEIGHTS_IN_ELF to 1"
+#endif
+
+/*******************************************************************************
+ * Timing: 64-bit ARM global timer, microseconds (perf_profile.h)
+ * Whole-network runs take longer than the 32-bit low word's 12.8 s wrap
+ ******************************************************************************/
+static uint64_t t_start;
 
 static void timer_start(void) {
-    t_start_lo = read_timer_lo();
+    t_start = perf_now();
 }
 
-/* Returns elapsed milliseconds (handles single wrap) */
-static int timer_elapsed_ms(void) {
-    unsigned int t_end = read_timer_lo();
-    unsigned int diff = t_end - t_start_lo; /* unsigned wrap is fine */
-    return (int)(diff / 333333U);  /* 333333 ticks per ms at 333 MHz */
+static int timer_elapsed_us(void) {
+    return (int)perf_elapsed_us(t_start);
 }
 
 /*******************************************************************************
@@ -58,138 +71,345 @@ static float* alloc_buf(int size, const char* name) {
     return p;
 }
 
-static void load_image(float* out) {
-    int ch, y, x;
-    for (ch = 0; ch < 3; ch++) {
-        for (y = 0; y < INPUT_SIZE; y++) {
-            for (x = 0; x < INPUT_SIZE; x++) {
-                int sy = y * IMG_HEIGHT / INPUT_SIZE;
-                int sx = x * IMG_WIDTH / INPUT_SIZE;
-                if (sy >= IMG_HEIGHT) sy = IMG_HEIGHT - 1;
-                if (sx >= IMG_WIDTH) sx = IMG_WIDTH - 1;
-                out[ch * INPUT_SIZE * INPUT_SIZE + y * INPUT_SIZE + x] =
-                    TEST_IMAGE[(sy * IMG_WIDTH + sx) * 3 + ch] / 255.0f;
-            }
+/*******************************************************************************
+ * Network Description (shared by the float and Q8.8 paths and the planner)
+ ******************************************************************************/
+static const LayerConfig net[] = {
+    {1, 3,   16,  224, 224, 3, 1, 1, 0, 0, 1},  /* L0: conv+bn+relu+pool */
+    {1, 16,  32,  112, 112, 3, 1, 1, 0, 0, 1},  /* L1: conv+bn+relu+pool */
+    {1, 32,  64,   56,  56, 3, 1, 1, 0, 0, 1},  /* L2: conv+bn+relu+pool */
+    {1, 64,  128,  28,  28, 3, 1, 1, 0, 0, 1},  /* L3: conv+bn+relu+pool */
+    {1, 128, 256,  14,  14, 3, 1, 1, 0, 0, 1},  /* L4: conv+bn+relu+pool */
+    {0, 256, 512,   7,   7, 3, 1, 1, 0, 0, 1},  /* L5: conv+bn+relu      */
+    {2, 512,  24,   7,   7, 1, 1, 0, 0, 0, 1},  /* L6: conv + bias (output) */
+};
+
+#define NUM_LAYERS (sizeof(net) / sizeof(net[0]))
+
+static const char* const layer_names[NUM_LAYERS] = {
+    "Conv  3->16  224x224 + BN + Pool -> 112x112",
+    "Conv 16->32  112x112 + BN + Pool ->  56x56 ",
+    "Conv 32->64   56x56  + BN + Pool ->  28x28 ",
+    "Conv 64->128  28x28  + BN + Pool ->  14x14 ",
+    "Conv 128->256 14x14  + BN + Pool ->   7x7  ",
+    "Conv 256->512  7x7   + BN (no pool)        ",
+    "Conv 512->24   7x7   (1x1 output)          ",
+};
+
+#if WEIGHTS_IN_ELF
+/* Float parameters per layer */
+typedef struct {
+    const float* w;
+    const float *gamma, *beta, *mean, *var;   /* NULL: conv + bias (output head) */
+    const float* bias;
+} SwLayer;
+
+static const SwLayer sw_layers[NUM_LAYERS] = {
+    {CONV0_W, BN0_GAMMA, BN0_BETA, BN0_MEAN, BN0_VAR, NULL},
+    {CONV1_W, BN1_GAMMA, BN1_BETA, BN1_MEAN, BN1_VAR, NULL},
+    {CONV2_W, BN2_GAMMA, BN2_BETA, BN2_MEAN, BN2_VAR, NULL},
+    {CONV3_W, BN3_GAMMA, BN3_BETA, BN3_MEAN, BN3_VAR, NULL},
+    {CONV4_W, BN4_GAMMA, BN4_BETA, BN4_MEAN, BN4_VAR, NULL},
+    {CONV5_W, BN5_GAMMA, BN5_BETA, BN5_MEAN, BN5_VAR, NULL},
+    {CONV6_W, NULL, NULL, NULL, NULL, CONV6_B},
+};
+#endif
+
+/* One cache-line-aligned arena holds every planned map */
+static uint8_t* alloc_arena(const BufferPlan* plan, const char* name) {
+    uint8_t* p = (uint8_t*)memalign(PLAN_ALIGN, plan->total_bytes);
+    if (!p) {
+        xil_printf("FATAL: arena %s (%d KB) failed\r\n", name, (int)(plan->total_bytes / 1024));
+        while(1);
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Float Network
+ ******************************************************************************/
+#if USE_NEON_CONV
+/* Per-layer operands prepared once at load time: BN folded into weights +
+   bias, weights in the NEON kernel's packed block order */
+typedef struct {
+    const float* packed_w;
+    const float* bias;
+} FusedLayer;
+
+static FusedLayer fused[NUM_LAYERS];
+static float* conv_pad;   /* Zero-padded input of the running layer, sized for the largest */
+
+static const float* pack_layer(int i, const float* w) {
+    const LayerConfig* c = &net[i];
+    float* p = alloc_buf((int)conv_neon_packed_size(c->in_channels, c->out_channels,
+                                                    c->kernel_size), "packed_w");
+
+    conv_neon_pack_weights(w, p, c->in_channels, c->out_channels, c->kernel_size);
+    return p;
+}
+
+static void alloc_conv_pad(void) {
+    size_t n, max = 0;
+    int i;
+
+    for (i = 0; i < NUM_LAYERS; i++) {
+        n = conv_neon_padded_size(net[i].in_channels, net[i].in_height, net[i].in_width,
+                                  net[i].kernel_size, net[i].stride, net[i].padding);
+        if (n > max) max = n;
+    }
+    conv_pad = alloc_buf((int)max, "conv_pad");
+}
+
+#if WEIGHTS_IN_ELF
+static void fold_layers(void) {
+    int i;
+
+    for (i = 0; i < NUM_LAYERS; i++) {
+        const SwLayer* L = &sw_layers[i];
+        int filter = net[i].in_channels * net[i].kernel_size * net[i].kernel_size;
+        float *w, *b;
+
+        if (!L->gamma) {
+            fused[i].packed_w = pack_layer(i, L->w);
+            fused[i].bias = L->bias;
+            continue;
         }
+        w = alloc_buf(net[i].out_channels * filter, "fused_w");
+        b = alloc_buf(net[i].out_channels, "fused_b");
+        fold_batchnorm(L->w, L->gamma, L->beta, L->mean, L->var,
+                       net[i].out_channels, filter, w, b);
+        fused[i].packed_w = pack_layer(i, w);
+        fused[i].bias = b;
+        free(w);
+    }
+    alloc_conv_pad();
+}
+#else
+/* The float32 blob is already folded: weights are packed from it, bias read in place */
+static void fold_layers(void) {
+    WeightTable wtab;
+    int i, ok = 0;
+
+#if WEIGHT_BLOB_USE_SD
+    ok = weight_blob_load_sd(WEIGHT_BLOB_SD_F32, &wtab) == 0;
+#endif
+    if (!ok) {
+        ok = weight_blob_load((const void*)DDR_WEIGHT_BLOB_ADDR, 0, &wtab) == 0;
+    }
+    ok = ok && wtab.dtype == WEIGHT_BLOB_DTYPE_F32 && wtab.num_layers == NUM_LAYERS;
+    for (i = 0; ok && i < NUM_LAYERS; i++) {
+        ok = wtab.layers[i].in_channels == net[i].in_channels &&
+             wtab.layers[i].out_channels == net[i].out_channels &&
+             wtab.layers[i].kernel_size == net[i].kernel_size;
+    }
+    if (!ok) {
+        xil_printf("FATAL: no float32 weight blob on SD or at 0x%08x\r\n", DDR_WEIGHT_BLOB_ADDR);
+        while(1);
+    }
+
+    for (i = 0; i < NUM_LAYERS; i++) {
+        fused[i].packed_w = pack_layer(i, (const float*)(UINTPTR)wtab.layers[i].weights_addr);
+        fused[i].bias = (const float*)(UINTPTR)wtab.layers[i].bn_shift_addr;
     }
+    alloc_conv_pad();
 }
+#endif
 
-/* Output buffer */
-static float output_buffer[NUM_ANCHORS * (5 + NUM_CLASSES) * 7 * 7];
+/* conv + bias + LeakyReLU + pool in one pass, output channels split across CPU0/CPU1.
+   CPU0 pads the input once; both cores read the same padded copy */
+static int run_layer(int i, const float* in, float* out, float* tmp) {
+    const LayerConfig* c = &net[i];
+    WorkArgs a = {WORKER_OP_CONV_FUSED, conv_pad, out, fused[i].packed_w, fused[i].bias, 0, 0,
+                  c->in_channels, c->in_height, c->in_width, c->out_channels,
+                  c->kernel_size, c->stride, c->padding,
+                  (c->layer_type != 2 ? CONV_FUSE_LEAKY : 0) |
+                  (c->layer_type == 1 ? CONV_FUSE_POOL : 0)};
+    (void)tmp;
+    conv_neon_pad_input(in, conv_pad, c->in_channels, c->in_height, c->in_width,
+                        c->kernel_size, c->stride, c->padding);
+    return worker_parallel_channels(&a);
+}
+
+#define PLAN_FLOAT_OPTIONS  0
+#else
+static void fold_layers(void) {
+}
+
+/* Reference: scalar conv2d, then BN/bias and pool as separate passes */
+static int run_layer(int i, const float* in, float* out, float* tmp) {
+    const SwLayer* L = &sw_layers[i];
+    const LayerConfig* c = &net[i];
+    int h = c->in_height + 2 * c->padding - c->kernel_size + 1;
+    int w = c->in_width + 2 * c->padding - c->kernel_size + 1;
+    float* conv_out = (c->layer_type == 1) ? tmp : out;
+    WorkArgs a = {WORKER_OP_NONE, 0, conv_out, 0, 0, 0, 0,
+                  c->out_channels, h, w, c->out_channels, 0, 0, 0};
+
+    conv2d(in, conv_out, L->w, c->in_channels, c->in_height, c->in_width,
+           c->out_channels, c->kernel_size, c->stride, c->padding);
+    if (L->gamma) {
+        a.op = WORKER_OP_BN_LEAKY;
+        a.p0 = L->gamma; a.p1 = L->beta; a.p2 = L->mean; a.p3 = L->var;
+    } else {
+        a.op = WORKER_OP_ADD_BIAS;
+        a.p0 = L->bias;
+    }
+    if (worker_parallel_channels(&a) != 0) {
+        return -1;
+    }
+    if (c->layer_type == 1) {
+        WorkArgs p = {WORKER_OP_MAXPOOL, tmp, out, 0, 0, 0, 0,
+                      c->out_channels, h, w, c->out_channels, 0, 0, 0};
+        return worker_parallel_channels(&p);
+    }
+    return 0;
+}
+
+/* The unpooled conv map of each pool layer needs its own slot */
+#define PLAN_FLOAT_OPTIONS  PLAN_SCRATCH_UNPOOLED
+#endif
+
+/*******************************************************************************
+ * Q8.8 Network: same layers, weights and arithmetic as the PL accelerator
+ ******************************************************************************/
+static int run_q88_network(void) {
+    WeightTable wtab;
+    BufferPlan plan;
+    uint8_t* arena;
+    int i, layer_us, total_us = 0, ok = 0;
+
+#if WEIGHT_BLOB_USE_SD
+    ok = weight_blob_load_sd(WEIGHT_BLOB_SD_Q88, &wtab) == 0;
+#endif
+    if (!ok) {
+        ok = weight_blob_load((const void*)DDR_WEIGHT_BLOB_ADDR, 0, &wtab) == 0;
+    }
+    if (!ok || wtab.dtype != WEIGHT_BLOB_DTYPE_Q88 || wtab.num_layers != NUM_LAYERS) {
+        xil_printf("    Q8.8: no weight blob on SD or at 0x%08x\r\n", DDR_WEIGHT_BLOB_ADDR);
+        return -1;
+    }
+
+    /* Same pitched layout as the PL's DDR maps */
+    buffer_plan_network(net, NUM_LAYERS, sizeof(fixed16_t), PLAN_PITCHED, &plan);
+    arena = alloc_arena(&plan, "q88");
+    xil_printf("    Q8.8 activation arena: %d KB\r\n", (int)(plan.total_bytes / 1024));
+
+    timer_start();
+    preprocess_image(TEST_IMAGE, IMG_WIDTH, IMG_HEIGHT,
+                     (fixed16_t*)(arena + PLAN_INPUT(&plan, 0)));
+    xil_printf("    Preprocess (Q8.8):                               " PERF_MS_FMT "\r\n",
+               PERF_MS(timer_elapsed_us()));
+
+    for (i = 0; i < NUM_LAYERS; i++) {
+        const WeightLayerAddr* w = &wtab.layers[i];
+
+        timer_start();
+        if (q88_run_layer(&net[i], (const int16_t*)(arena + PLAN_INPUT(&plan, i)),
+                          (int16_t*)(arena + PLAN_OUTPUT(&plan, i)),
+                          (const int16_t*)(UINTPTR)w->weights_addr,
+                          (const int16_t*)(UINTPTR)w->bn_scale_addr,
+                          (const int16_t*)(UINTPTR)w->bn_shift_addr) != 0) {
+            xil_printf("    Q8.8: out of memory in L%d\r\n", i);
+            free(arena);
+            return -1;
+        }
+        layer_us = timer_elapsed_us();
+        total_us += layer_us;
+        xil_printf("    L%d: Conv %3d->%-3d %3dx%-3d (Q8.8)                " PERF_MS_FMT "\r\n", i,
+                   net[i].in_channels, net[i].out_channels,
+                   net[i].in_height, net[i].in_width, PERF_MS(layer_us));
+    }
+
+    free(arena);
+
+    xil_printf("\r\n");
+    xil_printf("==============================================\r\n");
+    xil_printf("  ARM-Only Q8.8 Total Time: " PERF_MS_FMT " (%d seconds)\r\n",
+               PERF_MS(total_us), total_us / 1000000);
+    xil_printf("  Arithmetic: int16 Q8.8, int32 saturating accumulators\r\n");
+    xil_printf("  FPGA PL: Not used (outputs match it bit-for-bit)\r\n");
+    xil_printf("==============================================\r\n");
+    return 0;
+}
 
 /*******************************************************************************
  * Main - ARM Only Inference
  ******************************************************************************/
 int main(void) {
-    int h, w, layer_ms, total_ms = 0;
-    float *input, *a, *b, *t;
+    int i, layer_us, total_us = 0;
+    BufferPlan plan;
+    uint8_t* arena;
 
-    Xil_DCacheFlush();
-    enable_timer();
+    perf_init();
 
     xil_printf("\r\n\r\n");
     xil_printf("==============================================\r\n");
     xil_printf("  STEP 1: ARM-Only CNN Inference\r\n");
     xil_printf("  Zedboard Zynq-7020 (Cortex-A9 @ 667 MHz)\r\n");
     xil_printf("  All computation on ARM processor\r\n");
+    xil_printf("  Conv engine: %s\r\n", USE_NEON_CONV ?
+               "NEON 4x8, fused conv+BN+leaky+pool" : "scalar reference");
     xil_printf("  Architecture: 3->16->32->64->128->256->512->24\r\n");
     xil_printf("==============================================\r\n\r\n");
 
     cnn_accel_init();
 
+#if USE_DUAL_CORE
+    if (worker_pool_init() == 0) {
+        xil_printf("  CPU1 worker: online (layers split by output channel)\r\n\r\n");
+    } else {
+        xil_printf("  CPU1 worker: not responding, running on CPU0 only\r\n\r\n");
+    }
+#endif
+
+    /* All activations in one arena sized to the planned peak */
+    buffer_plan_network(net, NUM_LAYERS, sizeof(float), PLAN_FLOAT_OPTIONS, &plan);
+    arena = alloc_arena(&plan, "float");
+
     /* Load image */
     xil_printf("[1] Loading image (%dx%d -> %dx%d)...\r\n",
                IMG_WIDTH, IMG_HEIGHT, INPUT_SIZE, INPUT_SIZE);
-    input = alloc_buf(3 * INPUT_SIZE * INPUT_SIZE, "input");
-    load_image(input);
+    /* Same fused bilinear pass as the PL input, float output */
+    preprocess_image_float(TEST_IMAGE, IMG_WIDTH, IMG_HEIGHT, (float*)(arena + PLAN_INPUT(&plan, 0)));
+    xil_printf("    Activation arena: %d KB (planned peak)\r\n", (int)(plan.total_bytes / 1024));
     xil_printf("    Done.\r\n\r\n");
 
     xil_printf("[2] Running ARM-only inference (all layers on CPU)...\r\n\r\n");
 
-    h = INPUT_SIZE; w = INPUT_SIZE;
-    a = alloc_buf(16 * 224 * 224, "buf_a");
-    b = alloc_buf(16 * 224 * 224, "buf_b");
+#if USE_Q88
+    if (run_q88_network() == 0) {
+        while(1);
+    }
+    xil_printf("    Falling back to the float network\r\n\r\n");
+#endif
 
-    /* Layer 0 */
-    timer_start();
-    conv2d(input, a, CONV0_W, 3, h, w, 16, 3, 1, 1);
-    batchnorm_leaky(a, BN0_GAMMA, BN0_BETA, BN0_MEAN, BN0_VAR, 16, h, w);
-    maxpool2d(a, b, 16, h, w); h /= 2; w /= 2;
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L0: Conv  3->16  224x224 + BN + Pool -> 112x112  %d ms\r\n", layer_ms);
-
-    /* Layer 1 */
-    timer_start();
-    conv2d(a, b, CONV1_W, 16, h, w, 32, 3, 1, 1);
-    batchnorm_leaky(b, BN1_GAMMA, BN1_BETA, BN1_MEAN, BN1_VAR, 32, h, w);
-    t = a; a = b; b = t;
-    maxpool2d(a, b, 32, h, w); h /= 2; w /= 2;
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L1: Conv 16->32  112x112 + BN + Pool ->  56x56  %d ms\r\n", layer_ms);
-
-    /* Layer 2 */
-    timer_start();
-    conv2d(a, b, CONV2_W, 32, h, w, 64, 3, 1, 1);
-    batchnorm_leaky(b, BN2_GAMMA, BN2_BETA, BN2_MEAN, BN2_VAR, 64, h, w);
-    t = a; a = b; b = t;
-    maxpool2d(a, b, 64, h, w); h /= 2; w /= 2;
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L2: Conv 32->64   56x56  + BN + Pool ->  28x28  %d ms\r\n", layer_ms);
-
-    /* Layer 3 */
-    timer_start();
-    conv2d(a, b, CONV3_W, 64, h, w, 128, 3, 1, 1);
-    batchnorm_leaky(b, BN3_GAMMA, BN3_BETA, BN3_MEAN, BN3_VAR, 128, h, w);
-    t = a; a = b; b = t;
-    maxpool2d(a, b, 128, h, w); h /= 2; w /= 2;
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L3: Conv 64->128  28x28  + BN + Pool ->  14x14  %d ms\r\n", layer_ms);
-
-    /* Layer 4 */
     timer_start();
-    conv2d(a, b, CONV4_W, 128, h, w, 256, 3, 1, 1);
-    batchnorm_leaky(b, BN4_GAMMA, BN4_BETA, BN4_MEAN, BN4_VAR, 256, h, w);
-    t = a; a = b; b = t;
-    maxpool2d(a, b, 256, h, w); h /= 2; w /= 2;
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L4: Conv 128->256 14x14  + BN + Pool ->   7x7   %d ms\r\n", layer_ms);
-
-    /* Layer 5 */
-    timer_start();
-    conv2d(a, b, CONV5_W, 256, h, w, 512, 3, 1, 1);
-    batchnorm_leaky(b, BN5_GAMMA, BN5_BETA, BN5_MEAN, BN5_VAR, 512, h, w);
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    t = a; a = b; b = t;
-    xil_printf("    L5: Conv 256->512  7x7   + BN (no pool)          %d ms\r\n", layer_ms);
-
-    /* Layer 6 */
-    timer_start();
-    conv2d(a, output_buffer, CONV6_W, 512, h, w,
-           NUM_ANCHORS * (5 + NUM_CLASSES), 1, 1, 0);
-    add_bias(output_buffer, CONV6_B, NUM_ANCHORS * (5 + NUM_CLASSES), h, w, 0);
-    layer_ms = timer_elapsed_ms();
-    total_ms += layer_ms;
-    xil_printf("    L6: Conv 512->24   7x7   (1x1 output)            %d ms\r\n", layer_ms);
+    fold_layers();
+    xil_printf("    Weights prepared (%s): " PERF_MS_FMT "\r\n\r\n",
+               WEIGHTS_IN_ELF ? "BN folded and packed at load time" : "float32 blob, packed at load time",
+               PERF_MS(timer_elapsed_us()));
+
+    for (i = 0; i < NUM_LAYERS; i++) {
+        timer_start();
+        if (run_layer(i, (const float*)(arena + PLAN_INPUT(&plan, i)),
+                      (float*)(arena + PLAN_OUTPUT(&plan, i)),
+                      (float*)(arena + PLAN_SCRATCH(&plan, i))) != 0) {
+            xil_printf("FATAL: L%d failed on CPU0 or CPU1\r\n", i);
+            while(1);
+        }
+        layer_us = timer_elapsed_us();
+        total_us += layer_us;
+        xil_printf("    L%d: %s  " PERF_MS_FMT "\r\n", i, layer_names[i], PERF_MS(layer_us));
+    }
 
-    free(a);
-    free(b);
-    free(input);
+    free(arena);
 
     xil_printf("\r\n");
     xil_printf("==============================================\r\n");
-    xil_printf("  ARM-Only Total Time: %d ms (%d seconds)\r\n", total_ms, total_ms / 1000);
-    xil_printf("  Processor: ARM Cortex-A9 @ 667 MHz\r\n");
+    xil_printf("  ARM-Only Total Time: " PERF_MS_FMT " (%d seconds)\r\n",
+               PERF_MS(total_us), total_us / 1000000);
+    xil_printf("  Processor: ARM Cortex-A9 @ 667 MHz (%d core%s)\r\n",
+               worker_pool_active() ? 2 : 1, worker_pool_active() ? "s" : "");
     xil_printf("  FPGA PL: Not used\r\n");
     xil_printf("==============================================\r\n");
     xil_printf("\r\nDeploy STEP 2 (FPGA-accelerated) to compare.\r\n");
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Activation Buffer Planner Implementation
+ ******************************************************************************/
+
+#include "buffer_plan.h"
+#include <string.h>
+
+static int conv_height(const LayerConfig *cfg) {
+    return (cfg->in_height + 2 * cfg->padding - cfg->kernel_size) / cfg->stride + 1;
+}
+
+static int conv_width(const LayerConfig *cfg) {
+    return (cfg->in_width + 2 * cfg->padding - cfg->kernel_size) / cfg->stride + 1;
+}
+
+int plan_out_height(const LayerConfig *cfg) {
+    return (cfg->layer_type == 1) ? conv_height(cfg) / 2 : conv_height(cfg);
+}
+
+int plan_out_width(const LayerConfig *cfg) {
+    return (cfg->layer_type == 1) ? conv_width(cfg) / 2 : conv_width(cfg);
+}
+
+static uint32_t map_bytes(int c, int h, int w, int elem_bytes, int options) {
+    int row = (options & PLAN_PITCHED) ? FM_PITCH(w) : w;
+    return PLAN_ROUND((uint32_t)c * h * row * elem_bytes);
+}
+
+/*******************************************************************************
+ * Greedy placement: largest first, each at the lowest offset that does not
+ * overlap a placed tensor with an overlapping lifetime
+ ******************************************************************************/
+static void place(BufferPlan *plan, const int *first, const int *last) {
+    int order[PLAN_MAX_TENSORS];
+    int placed[PLAN_MAX_TENSORS];
+    int n = plan->num_tensors;
+    int i, j, k, np = 0;
+
+    for (i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    for (i = 1; i < n; i++) {
+        int t = order[i];
+        for (j = i; j > 0 && plan->bytes[order[j - 1]] < plan->bytes[t]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = t;
+    }
+
+    plan->total_bytes = 0;
+    for (i = 0; i < n; i++) {
+        int t = order[i];
+        int conflicts[PLAN_MAX_TENSORS];
+        int nc = 0;
+        uint32_t at = 0;
+
+        if (plan->bytes[t] == 0) {
+            plan->offset[t] = 0;
+            continue;
+        }
+
+        // Live-overlapping placed tensors, by offset
+        for (j = 0; j < np; j++) {
+            int u = placed[j];
+            if (first[u] <= last[t] && first[t] <= last[u]) {
+                for (k = nc; k > 0 && plan->offset[conflicts[k - 1]] > plan->offset[u]; k--) {
+                    conflicts[k] = conflicts[k - 1];
+                }
+                conflicts[k] = u;
+                nc++;
+            }
+        }
+
+        // First gap that fits
+        for (j = 0; j < nc; j++) {
+            int u = conflicts[j];
+            if (at + plan->bytes[t] <= plan->offset[u]) break;
+            if (plan->offset[u] + plan->bytes[u] > at) at = plan->offset[u] + plan->bytes[u];
+        }
+
+        plan->offset[t] = at;
+        placed[np++] = t;
+        if (at + plan->bytes[t] > plan->total_bytes) {
+            plan->total_bytes = at + plan->bytes[t];
+        }
+    }
+}
+
+int buffer_plan_network(const LayerConfig *layers, int num_layers,
+                        int elem_bytes, int options, BufferPlan *plan) {
+    int first[PLAN_MAX_TENSORS], last[PLAN_MAX_TENSORS];
+    int i;
+
+    if (num_layers < 1 || num_layers > PLAN_MAX_LAYERS) {
+        return -1;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->num_layers = num_layers;
+    plan->num_tensors = 2 * num_layers + 1;
+
+    plan->bytes[0] = map_bytes(layers[0].in_channels, layers[0].in_height,
+                               layers[0].in_width, elem_bytes, options);
+    first[0] = 0;
+    last[0] = 0;
+
+    for (i = 0; i < num_layers; i++) {
+        const LayerConfig *l = &layers[i];
+        int s = num_layers + 1 + i;
+
+        plan->bytes[i + 1] = map_bytes(l->out_channels, plan_out_height(l), plan_out_width(l),
+                                       elem_bytes, options);
+        first[i + 1] = i;
+        last[i + 1] = (i + 1 < num_layers) ? i + 1 : num_layers;
+
+        first[s] = i;
+        last[s] = i;
+        if ((options & PLAN_SCRATCH_UNPOOLED) && l->layer_type == 1) {
+            plan->bytes[s] = map_bytes(l->out_channels, conv_height(l), conv_width(l),
+                                       elem_bytes, options);
+        }
+    }
+
+    place(plan, first, last);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Activation Buffer Planner
+ * Places every feature map of a layer chain in one arena by lifetime:
+ * maps that are never live at the same time share bytes, so the arena is
+ * the real peak of the network instead of a fixed buffer per role.
+ *
+ * Tensors of an n-layer chain:
+ *   0            network input                live during layer 0
+ *   i + 1        output of layer i            live during layers i and i + 1
+ *                (the last output stays live after the network)
+ *   n + 1 + i    unpooled conv map of pool    live during layer i only
+ *                layer i (PLAN_SCRATCH_UNPOOLED: separate conv + pool passes)
+ *
+ * Offsets and sizes are multiples of PLAN_ALIGN, so no two maps share a
+ * cache line and every map suits the accelerator's 64-bit bursts. The same
+ * plan serves the ARM heap (one malloc) and the PL's DDR region map.
+ ******************************************************************************/
+
+#ifndef BUFFER_PLAN_H
+#define BUFFER_PLAN_H
+
+#include <stdint.h>
+#include "cnn_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAN_ALIGN            64  // Cache line (32 B on Cortex-A9) x 2, AXI word aligned
+#define PLAN_MAX_LAYERS       16
+#define PLAN_MAX_TENSORS      (2 * PLAN_MAX_LAYERS + 1)
+
+#define PLAN_ROUND(bytes)     (((bytes) + PLAN_ALIGN - 1) & ~(uint32_t)(PLAN_ALIGN - 1))
+
+/* Options */
+#define PLAN_PITCHED          (1 << 0)   // Rows padded to FM_PITCH (DDR layout)
+#define PLAN_SCRATCH_UNPOOLED (1 << 1)   // Also place each pool layer's full conv map
+
+typedef struct {
+    int num_layers;
+    int num_tensors;
+    uint32_t total_bytes;                // Arena size (the real peak)
+    uint32_t offset[PLAN_MAX_TENSORS];   // Byte offsets into the arena
+    uint32_t bytes[PLAN_MAX_TENSORS];    // Padded sizes, 0 if the tensor is unused
+} BufferPlan;
+
+#define PLAN_INPUT(plan, layer)    ((plan)->offset[(layer)])
+#define PLAN_OUTPUT(plan, layer)   ((plan)->offset[(layer) + 1])
+#define PLAN_SCRATCH(plan, layer)  ((plan)->offset[(plan)->num_layers + 1 + (layer)])
+
+/*******************************************************************************
+ * Plan the chain 'layers' (layer_type 1 pools 2x2)
+ * elem_bytes: 4 for float maps, 2 for Q8.8
+ * @return 0 on success, -1 if there are too many layers
+ ******************************************************************************/
+int buffer_plan_network(const LayerConfig *layers, int num_layers,
+                        int elem_bytes, int options, BufferPlan *plan);
+
+/*******************************************************************************
+ * Size of each map (helpers for callers that fill or read them)
+ ******************************************************************************/
+int plan_out_height(const LayerConfig *cfg);   // After the optional pool
+int plan_out_width(const LayerConfig *cfg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUFFER_PLAN_H
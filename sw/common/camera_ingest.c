@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Camera Ingest Driver Implementation
+ ******************************************************************************/
+
+#include "camera_ingest.h"
+#include "cnn_driver.h"
+#include "xil_io.h"
+#include "xil_cache.h"
+#include "xtime_l.h"
+#include "xil_printf.h"
+
+typedef struct {
+    int busy;
+    int result;
+    uint32_t map_addr;       // Map being written, invalidated at completion
+    uint32_t map_bytes;
+    XTime deadline;
+    int dst_width;
+    int dst_height;
+} CameraState;
+
+static CameraState cam = {0, CNN_OK, 0, 0, 0, 0, 0};
+
+static inline void write_reg(uint32_t offset, uint32_t value) {
+    Xil_Out32(CAMERA_CONTROL_BASE + offset, value);
+}
+
+static inline uint32_t read_reg(uint32_t offset) {
+    return Xil_In32(CAMERA_CONTROL_BASE + offset);
+}
+
+// Nothing of the map may sit dirty in the cache while the PL writes it, and
+// lines the A9 prefetched meanwhile are stale afterwards (HP port only)
+static void invalidate_map(void) {
+#if !CNN_ACCEL_USE_ACP
+    Xil_DCacheInvalidateRange(cam.map_addr, cam.map_bytes);
+#endif
+}
+
+int camera_ingest_init(int src_width, int src_height, int dst_width, int dst_height) {
+    if (src_width < 1 || src_width > CAM_MAX_SRC_WIDTH ||
+        src_height < 1 || src_height > CAM_MAX_SRC_HEIGHT ||
+        dst_width < 1 || dst_width > CAM_MAX_DST_SIZE ||
+        dst_height < 1 || dst_height > CAM_MAX_DST_SIZE) {
+        xil_printf("[CAM] Unsupported size %dx%d -> %dx%d\r\n", src_width, src_height,
+                   dst_width, dst_height);
+        return -1;
+    }
+    if (!(read_reg(CAM_REG_AP_CTRL) & AP_IDLE)) {
+        xil_printf("[CAM] Warning: camera IP not idle (ctrl=0x%08X)\r\n", (unsigned)read_reg(CAM_REG_AP_CTRL));
+        return -1;
+    }
+
+    write_reg(CAM_REG_SRC_WIDTH, src_width);
+    write_reg(CAM_REG_SRC_HEIGHT, src_height);
+    write_reg(CAM_REG_DST_WIDTH, dst_width);
+    write_reg(CAM_REG_DST_HEIGHT, dst_height);
+    cam.dst_width = dst_width;
+    cam.dst_height = dst_height;
+    cam.busy = 0;
+    cam.result = CNN_OK;
+
+    xil_printf("[CAM] %dx%d frames -> %dx%d Q8.8 input\r\n", src_width, src_height,
+               dst_width, dst_height);
+    return 0;
+}
+
+int camera_ingest_start(uint32_t input_addr) {
+    XTime now;
+
+    if (cam.busy || !(read_reg(CAM_REG_AP_CTRL) & AP_IDLE)) {
+        return CNN_ERR_BUSY;
+    }
+
+    cam.map_addr = input_addr;
+    cam.map_bytes = 3 * cam.dst_height * FM_PITCH(cam.dst_width) * 2;
+    invalidate_map();
+
+    write_reg(CAM_REG_INPUT_FM_LO, input_addr);
+    write_reg(CAM_REG_INPUT_FM_HI, 0);
+
+    XTime_GetTime(&now);
+    cam.deadline = now + (XTime)CAMERA_TIMEOUT_MS * (COUNTS_PER_SECOND / 1000);
+    cam.busy = 1;
+    write_reg(CAM_REG_AP_CTRL, AP_START);
+    return CNN_OK;
+}
+
+int camera_ingest_poll(void) {
+    XTime now;
+
+    if (!cam.busy) {
+        return cam.result;
+    }
+
+    // Reading ap_done also clears it
+    if (read_reg(CAM_REG_AP_CTRL) & AP_DONE) {
+        invalidate_map();
+        cam.busy = 0;
+        cam.result = CNN_OK;
+        return CNN_OK;
+    }
+
+    XTime_GetTime(&now);
+    if (now > cam.deadline) {
+        xil_printf("[CAM] Error: no frame after %u ms\r\n", (unsigned)CAMERA_TIMEOUT_MS);
+        cam.busy = 0;
+        cam.result = CNN_ERR_TIMEOUT;
+        return CNN_ERR_TIMEOUT;
+    }
+    return CNN_PENDING;
+}
+
+int camera_ingest_wait(void) {
+    int rc;
+
+    while ((rc = camera_ingest_poll()) == CNN_PENDING) {
+    }
+    return rc;
+}
+
+uint32_t camera_ingest_dropped(void) {
+    return read_reg(CAM_REG_DROPPED);
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Camera Ingest Driver
+ * For the camera preprocessing IP (hw/hls/src/camera_preprocess.cpp)
+ *
+ * The IP takes RGB888 frames from an AXI4-Stream video feed (VDMA MM2S or a
+ * sensor pipeline), resizes them to the network input and writes the Q8.8
+ * [3][H][FM_PITCH(W)] map straight into the accelerator's input buffer. The
+ * ARM only starts a capture and checks ap_done: the pixels never pass
+ * through its caches. Same values as preprocess_image() bit for bit.
+ *
+ * Built in with create_design.tcl: use_camera 1.
+ ******************************************************************************/
+
+#ifndef CAMERA_INGEST_H
+#define CAMERA_INGEST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+ * Base Address (create_design.tcl assigns it explicitly)
+ ******************************************************************************/
+#define CAMERA_CONTROL_BASE     0x40020000  // s_axi_control
+
+/*******************************************************************************
+ * Register Map - s_axi_control
+ * Offsets from HLS synthesis report
+ ******************************************************************************/
+#define CAM_REG_AP_CTRL         0x00  // Control: [0]=start, [1]=done, [2]=idle, [3]=ready
+#define CAM_REG_INPUT_FM_LO     0x10  // Destination map address [31:0]
+#define CAM_REG_INPUT_FM_HI     0x14  // Destination map address [63:32]
+#define CAM_REG_SRC_WIDTH       0x1C  // Camera frame width
+#define CAM_REG_SRC_HEIGHT      0x24  // Camera frame height
+#define CAM_REG_DST_WIDTH       0x2C  // Network input width
+#define CAM_REG_DST_HEIGHT      0x34  // Network input height
+#define CAM_REG_DROPPED         0x3C  // Pixels discarded before start of frame
+#define CAM_REG_DROPPED_CTRL    0x40
+
+/*******************************************************************************
+ * Limits (must match cnn_accel.h)
+ ******************************************************************************/
+#define CAM_MAX_SRC_WIDTH       1280
+#define CAM_MAX_SRC_HEIGHT      1024
+#define CAM_MAX_DST_SIZE        608   // MAX_INPUT_SIZE
+
+#define CAMERA_TIMEOUT_MS       200   // Start of frame plus one frame, at >= 10 FPS
+
+/*******************************************************************************
+ * Driver Functions
+ * Captures return CNN_OK, CNN_PENDING or CNN_ERR_* (cnn_driver.h)
+ ******************************************************************************/
+
+// Check the IP is idle and set the frame and network input sizes (0 on success)
+int camera_ingest_init(int src_width, int src_height, int dst_width, int dst_height);
+
+// Capture the next frame into the map at input_addr (returns at once)
+int camera_ingest_start(uint32_t input_addr);
+
+// CNN_PENDING until the map is complete, then CNN_OK (or CNN_ERR_TIMEOUT)
+int camera_ingest_poll(void);
+
+// Block until the capture completes
+int camera_ingest_wait(void);
+
+// Pixels the last capture skipped while waiting for start of frame
+uint32_t camera_ingest_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAMERA_INGEST_H
@@ -5,6 +5,8 @@
 
 #include "cnn_driver.h"
 #include "xil_io.h"
+#include "xil_cache.h"
+#include "xtime_l.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -18,11 +20,128 @@ static inline uint32_t read_reg(uint32_t base, uint32_t offset) {
     return Xil_In32(base + offset);
 }
 
+/*******************************************************************************
+ * Job State
+ * One submission is in flight at a time. The ISR (or cnn_accel_poll() when
+ * interrupts are off) retires it and fires the callback exactly once. The
+ * poll's timeout path masks the IRQ and re-checks busy before it retires,
+ * so an ap_done landing at the deadline cannot complete the job twice.
+ ******************************************************************************/
+typedef struct {
+    volatile int busy;
+    volatile int result;
+    CnnDoneCallback callback;
+    void *callback_ref;
+    XTime deadline;
+    uint32_t timeout_ms;
+    int irq_enabled;
+    XScuGic *gic;            // Set by cnn_accel_setup_interrupt
+    uint32_t result_addr;    // Map the ARM reads back, invalidated at completion
+    uint32_t result_bytes;
+    uint32_t cand_addr;      // Head decode candidate list (cnn_accel_set_decode)
+    uint32_t cand_bytes;
+    XTime t_submit;          // Entry to submit_*
+    XTime t_config;          // Cache maintenance done, registers next
+    XTime t_start;           // ap_start written
+    CnnJobStats stats;       // Last completed job
+} CnnAccelState;
+
+static CnnAccelState accel = {
+    0, CNN_OK, NULL, NULL, 0, CNN_ACCEL_TIMEOUT_MS, 0, NULL,
+    0, 0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0}
+};
+
+/*******************************************************************************
+ * Per-Buffer Cache Maintenance (HP port, see CNN_ACCEL_USE_ACP)
+ * Inputs are flushed so the PL reads what the ARM wrote. Outputs are
+ * invalidated before the start, so no dirty line can be evicted over the
+ * PL's writes, and again at completion, to drop lines the A9 prefetched
+ * while the PL was running. Plan-aligned maps never share a line.
+ ******************************************************************************/
+static int conv_out_dim(int in, const LayerConfig *cfg) {
+    return (in + 2 * cfg->padding - cfg->kernel_size) / cfg->stride + 1;
+}
+
+static uint32_t batch_of(const LayerConfig *cfg) {
+    return cfg->batch > 1 ? (uint32_t)cfg->batch : 1;
+}
+
+static uint32_t input_bytes(const LayerConfig *cfg) {
+    return batch_of(cfg) * cfg->in_channels * cfg->in_height * FM_PITCH(cfg->in_width) * 2;
+}
+
+static uint32_t output_bytes(const LayerConfig *cfg) {
+    int h = conv_out_dim(cfg->in_height, cfg);
+    int w = conv_out_dim(cfg->in_width, cfg);
+
+    if (cfg->layer_type == 1) {
+        h /= 2;
+        w /= 2;
+    }
+    return batch_of(cfg) * cfg->out_channels * h * FM_PITCH(w) * 2;
+}
+
+static void flush_input(uint32_t addr, uint32_t bytes) {
+#if !CNN_ACCEL_USE_ACP
+    Xil_DCacheFlushRange(addr, bytes);
+#endif
+}
+
+static void invalidate_output(uint32_t addr, uint32_t bytes) {
+#if !CNN_ACCEL_USE_ACP
+    Xil_DCacheInvalidateRange(addr, bytes);
+#endif
+}
+
+static void complete_job(int result) {
+    CnnDoneCallback cb = accel.callback;
+    void *ref = accel.callback_ref;
+    XTime t_done, t_end;
+
+    // Before the callback: it may read the result (and the stats)
+    if (result == CNN_OK) {
+        XTime_GetTime(&t_done);
+        invalidate_output(accel.result_addr, accel.result_bytes);
+        XTime_GetTime(&t_end);
+
+        accel.stats.setup_ticks = accel.t_start - accel.t_config;
+        accel.stats.run_ticks = t_done - accel.t_start;
+        accel.stats.cache_ticks = (accel.t_config - accel.t_submit) + (t_end - t_done);
+        accel.stats.compute_cycles = read_reg(CNN_ACCEL_CONTROL_BASE, REG_PERF_COMPUTE);
+        accel.stats.read_beats = read_reg(CNN_ACCEL_CONTROL_BASE, REG_PERF_READ);
+        accel.stats.write_beats = read_reg(CNN_ACCEL_CONTROL_BASE, REG_PERF_WRITE);
+    }
+    accel.callback = NULL;
+    accel.result = result;
+    accel.busy = 0;
+    if (cb) {
+        cb(ref, result);
+    }
+}
+
+static void cnn_accel_isr(void *ref) {
+    CnnAccelState *st = (CnnAccelState *)ref;
+    uint32_t isr = read_reg(CNN_ACCEL_CONTROL_BASE, REG_IP_ISR);
+
+    // ISR bits are toggle-on-write: writing them back clears them
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_IP_ISR, isr);
+
+    if ((isr & IP_INTR_DONE) && st->busy) {
+        // Clear ap_done by reading it
+        read_reg(CNN_ACCEL_CONTROL_BASE, REG_AP_CTRL);
+        complete_job(CNN_OK);
+    }
+}
+
 /*******************************************************************************
  * Driver Implementation
  ******************************************************************************/
 
 int cnn_accel_init(void) {
+    accel.busy = 0;
+    accel.result = CNN_OK;
+    accel.callback = NULL;
+    
     // Check if accelerator is present by reading AP_CTRL
     uint32_t ctrl = read_reg(CNN_ACCEL_CONTROL_BASE, REG_AP_CTRL);
     
@@ -46,12 +165,8 @@ int cnn_accel_is_done(void) {
     return (ctrl & AP_DONE) ? 1 : 0;
 }
 
-void cnn_accel_wait_done(void) {
-    while (!cnn_accel_is_done()) {
-        // Busy wait - could add timeout or sleep
-    }
-    // Clear done bit by reading it
-    read_reg(CNN_ACCEL_CONTROL_BASE, REG_AP_CTRL);
+int cnn_accel_wait_done(void) {
+    return cnn_accel_wait();
 }
 
 void cnn_accel_configure_layer(const LayerConfig *cfg) {
@@ -63,6 +178,11 @@ void cnn_accel_configure_layer(const LayerConfig *cfg) {
     write_reg(CNN_ACCEL_CONTROL_BASE, REG_KERNEL_SIZE, cfg->kernel_size);
     write_reg(CNN_ACCEL_CONTROL_BASE, REG_STRIDE, cfg->stride);
     write_reg(CNN_ACCEL_CONTROL_BASE, REG_PADDING, cfg->padding);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_DATAFLOW, cfg->dataflow);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_ENGINE, cfg->engine);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_BATCH, cfg->batch);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_DECODE, 0);      // Command lists decode
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_NUM_LAYERS, 0);  // Use the registers above
 }
 
 void cnn_accel_set_addresses(
@@ -90,10 +210,18 @@ void cnn_accel_set_addresses(
 }
 
 void cnn_accel_start(void) {
+    XTime now;
+    
+    // Arm the job before the IP can raise ap_done
+    XTime_GetTime(&now);
+    accel.t_start = now;
+    accel.deadline = now + (XTime)accel.timeout_ms * (COUNTS_PER_SECOND / 1000);
+    accel.busy = 1;
+    
     write_reg(CNN_ACCEL_CONTROL_BASE, REG_AP_CTRL, AP_START);
 }
 
-void cnn_accel_run_layer(
+int cnn_accel_run_layer(
     const LayerConfig *cfg,
     uint32_t input_addr,
     uint32_t output_addr,
@@ -101,22 +229,14 @@ void cnn_accel_run_layer(
     uint32_t bn_scale_addr,
     uint32_t bn_shift_addr
 ) {
-    // Wait for ready
-    while (!cnn_accel_is_ready()) {
-        // Busy wait
+    int rc = cnn_accel_submit_layer(cfg, input_addr, output_addr, weights_addr,
+                                    bn_scale_addr, bn_shift_addr, NULL, NULL);
+    if (rc != CNN_OK) {
+        return rc;
     }
     
-    // Configure layer
-    cnn_accel_configure_layer(cfg);
-    
-    // Set addresses
-    cnn_accel_set_addresses(input_addr, output_addr, weights_addr, bn_scale_addr, bn_shift_addr);
-    
-    // Start
-    cnn_accel_start();
-    
     // Wait for completion
-    cnn_accel_wait_done();
+    return cnn_accel_wait();
 }
 
 uint32_t cnn_accel_get_status(void) {
@@ -124,89 +244,221 @@ uint32_t cnn_accel_get_status(void) {
 }
 
 /*******************************************************************************
- * YOLO Lite Network Runner
- * Layer structure: 7 conv layers with pooling
+ * Command-List Execution
+ * The IP walks the descriptor table itself, so the ARM writes the pointer
+ * registers once and sees a single done for the whole network.
  ******************************************************************************/
- 
-// YOLO Lite layer configurations
-static const LayerConfig yolo_lite_layers[] = {
-    // Layer 0: Conv 224x224x3 -> 112x112x16 (conv+bn+relu+pool)
-    {1, 3, 16, 224, 224, 3, 1, 1},
+void cnn_accel_fill_descriptor(
+    LayerDescriptor *desc,
+    const LayerConfig *cfg,
+    uint32_t input_addr,
+    uint32_t output_addr,
+    uint32_t weights_addr,
+    uint32_t bn_scale_addr
+) {
+    desc->cfg = *cfg;
+    desc->input_offset = (int32_t)(input_addr - DDR_INPUT_FM_ADDR) / 8;
+    desc->output_offset = (int32_t)(output_addr - DDR_INPUT_FM_ADDR) / 8;
+    desc->weights_offset = (int32_t)(weights_addr - DDR_WEIGHTS_ADDR) / 8;
+    desc->bn_offset = (int32_t)(bn_scale_addr - DDR_BN_SCALE_ADDR) / 2;
+    desc->decode = 0;
+}
+
+int cnn_accel_run_network(const LayerDescriptor *descs, int num_layers) {
+    int rc = cnn_accel_submit_network(descs, num_layers, NULL, NULL);
+    if (rc != CNN_OK) {
+        return rc;
+    }
     
-    // Layer 1: Conv 112x112x16 -> 56x56x32 (conv+bn+relu+pool)
-    {1, 16, 32, 112, 112, 3, 1, 1},
+    return cnn_accel_wait();
+}
+
+/*******************************************************************************
+ * Asynchronous Interface
+ * submit_* return as soon as ap_start is written. Completion is signalled by
+ * the ap_done interrupt (after cnn_accel_setup_interrupt) or picked up by
+ * cnn_accel_poll(); either way a job that overruns its deadline is retired
+ * with CNN_ERR_TIMEOUT and the IP must be idle again before the next submit.
+ ******************************************************************************/
+int cnn_accel_setup_interrupt(XScuGic *gic) {
+    int status = XScuGic_Connect(gic, CNN_ACCEL_IRQ_ID,
+                                 (Xil_InterruptHandler)cnn_accel_isr, &accel);
+    if (status != XST_SUCCESS) {
+        printf("[CNN] Error: could not connect IRQ %d\n", CNN_ACCEL_IRQ_ID);
+        return -1;
+    }
+    
+    // HLS interrupt output is active-high level
+    XScuGic_SetPriorityTriggerType(gic, CNN_ACCEL_IRQ_ID, 0xA0, 0x1);
+    XScuGic_Enable(gic, CNN_ACCEL_IRQ_ID);
+    
+    // Clear stale status, then enable ap_done at the IP
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_IP_ISR,
+              read_reg(CNN_ACCEL_CONTROL_BASE, REG_IP_ISR));
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_IP_IER, IP_INTR_DONE);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_GIE, 1);
+    accel.gic = gic;
+    accel.irq_enabled = 1;
+    
+    return 0;
+}
+
+void cnn_accel_set_timeout(uint32_t timeout_ms) {
+    accel.timeout_ms = timeout_ms;
+}
+
+int cnn_accel_submit_layer(
+    const LayerConfig *cfg,
+    uint32_t input_addr,
+    uint32_t output_addr,
+    uint32_t weights_addr,
+    uint32_t bn_scale_addr,
+    uint32_t bn_shift_addr,
+    CnnDoneCallback callback,
+    void *callback_ref
+) {
+    // Refuse instead of spinning: a previous job (or a timed-out one) still owns the IP
+    if (accel.busy || !cnn_accel_is_ready()) {
+        return CNN_ERR_BUSY;
+    }
     
-    // Layer 2: Conv 56x56x32 -> 28x28x64 (conv+bn+relu+pool)
-    {1, 32, 64, 56, 56, 3, 1, 1},
+    XTime_GetTime(&accel.t_submit);
+    flush_input(input_addr, input_bytes(cfg));
+    accel.result_addr = output_addr;
+    accel.result_bytes = output_bytes(cfg);
+    invalidate_output(accel.result_addr, accel.result_bytes);
+    XTime_GetTime(&accel.t_config);
     
-    // Layer 3: Conv 28x28x64 -> 14x14x128 (conv+bn+relu+pool)
-    {1, 64, 128, 28, 28, 3, 1, 1},
+    cnn_accel_configure_layer(cfg);
+    cnn_accel_set_addresses(input_addr, output_addr, weights_addr, bn_scale_addr, bn_shift_addr);
     
-    // Layer 4: Conv 14x14x128 -> 14x14x256 (conv+bn+relu, no pool)
-    {0, 128, 256, 14, 14, 3, 1, 1},
+    accel.callback = callback;
+    accel.callback_ref = callback_ref;
+    cnn_accel_start();
     
-    // Layer 5: Conv 14x14x256 -> 7x7x512 (conv+bn+relu+pool)
-    {1, 256, 512, 14, 14, 3, 1, 1},
+    return CNN_OK;
+}
+
+int cnn_accel_submit_network(
+    const LayerDescriptor *descs,
+    int num_layers,
+    CnnDoneCallback callback,
+    void *callback_ref
+) {
+    const LayerDescriptor *last = &descs[num_layers - 1];
+    int i;
     
-    // Layer 6: Conv 7x7x512 -> 7x7x125 (output, conv only)
-    {2, 512, 125, 7, 7, 1, 1, 0}
-};
+    if (accel.busy || !cnn_accel_is_ready()) {
+        return CNN_ERR_BUSY;
+    }
+    
+    XTime_GetTime(&accel.t_submit);
+    
+    // The IP reads the table and the first input over its AXI masters;
+    // every layer's output is written behind the cache (maps may alias:
+    // the input is pushed out before its bytes are invalidated as an output)
+    flush_input((UINTPTR)descs, num_layers * sizeof(LayerDescriptor));
+    flush_input(DDR_INPUT_FM_ADDR + descs[0].input_offset * 8, input_bytes(&descs[0].cfg));
+    for (i = 0; i < num_layers; i++) {
+        invalidate_output(DDR_INPUT_FM_ADDR + descs[i].output_offset * 8,
+                          output_bytes(&descs[i].cfg));
+    }
+    accel.result_addr = DDR_INPUT_FM_ADDR + last->output_offset * 8;
+    accel.result_bytes = output_bytes(&last->cfg);
+    if (last->decode) {
+        // The ARM reads the candidates instead of the head map
+        accel.result_addr = accel.cand_addr;
+        accel.result_bytes = accel.cand_bytes;
+        invalidate_output(accel.result_addr, accel.result_bytes);
+    }
+    XTime_GetTime(&accel.t_config);
+    
+    // Both feature map ports share one base; descriptors select the buffers
+    cnn_accel_set_addresses(DDR_INPUT_FM_ADDR, DDR_INPUT_FM_ADDR, DDR_WEIGHTS_ADDR,
+                            DDR_BN_SCALE_ADDR, DDR_BN_SHIFT_ADDR);
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_DESC_LO, (uint32_t)(UINTPTR)descs);
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_DESC_HI, 0);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_DECODE, 0);
+    write_reg(CNN_ACCEL_CONTROL_BASE, REG_NUM_LAYERS, num_layers);
+    
+    accel.callback = callback;
+    accel.callback_ref = callback_ref;
+    cnn_accel_start();
+    
+    return CNN_OK;
+}
+
+int cnn_accel_poll(void) {
+    XTime now;
+    int rc;
+    
+    if (!accel.busy) {
+        return accel.result;
+    }
+    
+    // Without the IRQ, reading ap_done here also clears it
+    if (!accel.irq_enabled && cnn_accel_is_done()) {
+        complete_job(CNN_OK);
+        return CNN_OK;
+    }
+    
+    XTime_GetTime(&now);
+    if (now > accel.deadline) {
+        // The ISR must not retire the job between the check and the retire
+        if (accel.irq_enabled) {
+            XScuGic_Disable(accel.gic, CNN_ACCEL_IRQ_ID);
+        }
+        if (!accel.busy) {
+            rc = accel.result;           // The ISR got there first
+        } else if (cnn_accel_is_done()) {
+            complete_job(CNN_OK);        // Done at the deadline, IRQ not taken yet
+            rc = CNN_OK;
+        } else {
+            printf("[CNN] Error: timeout after %u ms (ctrl=0x%08X)\n",
+                   (unsigned)accel.timeout_ms,
+                   (unsigned)read_reg(CNN_ACCEL_CONTROL_BASE, REG_AP_CTRL));
+            complete_job(CNN_ERR_TIMEOUT);
+            rc = CNN_ERR_TIMEOUT;
+        }
+        if (accel.irq_enabled) {
+            XScuGic_Enable(accel.gic, CNN_ACCEL_IRQ_ID);
+        }
+        return rc;
+    }
+    
+    return CNN_PENDING;
+}
 
-#define NUM_YOLO_LAYERS (sizeof(yolo_lite_layers) / sizeof(yolo_lite_layers[0]))
+int cnn_accel_wait(void) {
+    int rc;
+    
+    while ((rc = cnn_accel_poll()) == CNN_PENDING) {
+        // Blocking callers only; async users interleave their own work with poll()
+    }
+    return rc;
+}
 
-// Weight offsets for each layer (pre-calculated based on layer sizes)
-static const uint32_t weight_offsets[] = {
-    0,                    // Layer 0: 3*16*3*3 = 432
-    432 * 2,              // Layer 1: 16*32*3*3 = 4608
-    (432 + 4608) * 2,     // Layer 2: 32*64*3*3 = 18432
-    // ... continue for all layers
-};
+void cnn_accel_get_stats(CnnJobStats *stats) {
+    *stats = accel.stats;
+}
+
+/*******************************************************************************
+ * Head Decode
+ * The IP reads the parameter block over its AXI master and appends the
+ * candidates of every decoding layer to the list, which the ARM then reads
+ * instead of the head map (see the coherency note in cnn_driver.h).
+ ******************************************************************************/
+void cnn_accel_set_decode(uint32_t params_addr, uint32_t candidates_addr, int max_candidates) {
+    flush_input(params_addr, DDR_ALIGN8(CNN_DECODE_PARAM_WORDS * 4));
+    accel.cand_addr = candidates_addr;
+    accel.cand_bytes = (uint32_t)max_candidates * CNN_CANDIDATE_BYTES;
+    
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_DECODE_PARAMS_LO, params_addr);
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_DECODE_PARAMS_HI, 0);
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_CANDIDATES_LO, candidates_addr);
+    write_reg(CNN_ACCEL_CONTROL_R_BASE, REG_CANDIDATES_HI, 0);
+}
 
-void cnn_accel_run_yolo_lite(uint32_t image_addr, uint32_t output_addr) {
-    printf("[CNN] Running YOLO Lite inference...\n");
-    
-    uint32_t current_input = image_addr;
-    uint32_t current_output = DDR_OUTPUT_FM_ADDR;
-    uint32_t weight_ptr = DDR_WEIGHTS_ADDR;
-    uint32_t bn_scale_ptr = DDR_BN_SCALE_ADDR;
-    uint32_t bn_shift_ptr = DDR_BN_SHIFT_ADDR;
-    
-    for (int i = 0; i < NUM_YOLO_LAYERS; i++) {
-        printf("[CNN] Layer %d: %dx%dx%d -> out_ch=%d\n", 
-               i, yolo_lite_layers[i].in_height, yolo_lite_layers[i].in_width,
-               yolo_lite_layers[i].in_channels, yolo_lite_layers[i].out_channels);
-        
-        // Calculate weight size for this layer
-        int weight_size = yolo_lite_layers[i].in_channels * 
-                         yolo_lite_layers[i].out_channels *
-                         yolo_lite_layers[i].kernel_size *
-                         yolo_lite_layers[i].kernel_size * 2;  // 16-bit = 2 bytes
-        
-        int bn_size = yolo_lite_layers[i].out_channels * 2;  // 16-bit = 2 bytes
-        
-        // Run layer
-        cnn_accel_run_layer(
-            &yolo_lite_layers[i],
-            current_input,
-            current_output,
-            weight_ptr,
-            bn_scale_ptr,
-            bn_shift_ptr
-        );
-        
-        // Update pointers for next layer
-        weight_ptr += weight_size;
-        bn_scale_ptr += bn_size;
-        bn_shift_ptr += bn_size;
-        
-        // Swap input/output buffers
-        uint32_t temp = current_input;
-        current_input = current_output;
-        current_output = temp;
-    }
-    
-    // Copy final output to requested address
-    // (memcpy or DMA from current_input to output_addr)
-    
-    printf("[CNN] YOLO Lite inference complete!\n");
+uint32_t cnn_accel_num_candidates(void) {
+    return read_reg(CNN_ACCEL_CONTROL_BASE, REG_NUM_CANDIDATES);
 }
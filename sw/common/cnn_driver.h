@@ -9,6 +9,7 @@
 #define CNN_DRIVER_H
 
 #include <stdint.h>
+#include "xscugic.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,9 +26,11 @@ extern "C" {
  ******************************************************************************/
 #define DDR_INPUT_FM_ADDR      0x10000000  // Input image/feature maps
 #define DDR_OUTPUT_FM_ADDR     0x14000000  // Output feature maps
+#define DDR_FM_ARENA_ADDR      DDR_INPUT_FM_ADDR  // Planned maps (buffer_plan.h), frame slots back to back
 #define DDR_WEIGHTS_ADDR       0x18000000  // Network weights
 #define DDR_BN_SCALE_ADDR      0x1C000000  // BatchNorm scale
 #define DDR_BN_SHIFT_ADDR      0x1C010000  // BatchNorm shift
+#define DDR_DESC_ADDR          0x1C020000  // Layer descriptor table
 
 /*******************************************************************************
  * Register Map - s_axi_control (Layer Configuration)
@@ -48,6 +51,19 @@ extern "C" {
 #define REG_KERNEL_SIZE     0x50  // Kernel size (1 or 3)
 #define REG_STRIDE          0x58  // Stride
 #define REG_PADDING         0x60  // Padding
+#define REG_DATAFLOW        0x68  // Tile loop order (DATAFLOW_*)
+#define REG_ENGINE          0x70  // Compute engine (ENGINE_*)
+#define REG_NUM_LAYERS      0x78  // 0: single layer from registers, N: run N descriptors
+#define REG_BATCH           0x80  // Images per layer, back to back in each buffer (0 or 1: one)
+#define REG_PERF_COMPUTE    0x88  // MAC array cycles of the last start
+#define REG_PERF_COMPUTE_CTRL 0x8C
+#define REG_PERF_READ       0x98  // 64-bit beats read (feature maps + weights)
+#define REG_PERF_READ_CTRL  0x9C
+#define REG_PERF_WRITE      0xA8  // 64-bit beats written
+#define REG_PERF_WRITE_CTRL 0xAC
+#define REG_DECODE          0xB8  // Register mode: YOLO head decode (the driver writes 0)
+#define REG_NUM_CANDIDATES  0xC0  // Head decode candidates found by the last start
+#define REG_NUM_CANDIDATES_CTRL 0xC4
 
 /*******************************************************************************
  * Register Map - s_axi_control_r (DDR Addresses, 64-bit)
@@ -62,6 +78,12 @@ extern "C" {
 #define REG_BN_SCALE_HI     0x38  // BN scale address [63:32]
 #define REG_BN_SHIFT_LO     0x40  // BN shift address [31:0]
 #define REG_BN_SHIFT_HI     0x44  // BN shift address [63:32]
+#define REG_DESC_LO         0x4C  // Descriptor table address [31:0]
+#define REG_DESC_HI         0x50  // Descriptor table address [63:32]
+#define REG_DECODE_PARAMS_LO 0x58 // Head decode parameter block [31:0]
+#define REG_DECODE_PARAMS_HI 0x5C // Head decode parameter block [63:32]
+#define REG_CANDIDATES_LO   0x64  // Candidate list [31:0]
+#define REG_CANDIDATES_HI   0x68  // Candidate list [63:32]
 
 /*******************************************************************************
  * AP_CTRL Bit Definitions
@@ -72,8 +94,84 @@ extern "C" {
 #define AP_READY    (1 << 3)
 #define AP_AUTO_RESTART  (1 << 7)
 
+/*******************************************************************************
+ * Interrupts (ap_done -> IRQ_F2P[0], see hw/fpga_accelerated/create_design.tcl)
+ ******************************************************************************/
+#define CNN_ACCEL_IRQ_ID    61          // IRQ_F2P[0] on the Zynq GIC
+#define IP_INTR_DONE        (1 << 0)    // IER/ISR bit 0: ap_done
+#define IP_INTR_READY       (1 << 1)    // IER/ISR bit 1: ap_ready
+
+/*******************************************************************************
+ * Driver Return Codes
+ ******************************************************************************/
+#define CNN_OK              0   // Completed
+#define CNN_PENDING         1   // Submitted, still running
+#define CNN_ERR_BUSY       -1   // A job is in flight or the IP is not idle
+#define CNN_ERR_TIMEOUT    -2   // No ap_done before the deadline
+
+#define CNN_ACCEL_TIMEOUT_MS  2000  // Default completion deadline
+
+/*******************************************************************************
+ * Dataflow Modes (tile loop order, must match cnn_accel.h)
+ ******************************************************************************/
+#define DATAFLOW_OUTPUT_STATIONARY  0  // Refetch inputs and weights per tile
+#define DATAFLOW_WEIGHT_STATIONARY  1  // Weights fetched once per OC tile (large maps)
+#define DATAFLOW_INPUT_STATIONARY   2  // Inputs fetched once per spatial tile (small maps)
+
+/*******************************************************************************
+ * Compute Engines (must match cnn_accel.h)
+ ******************************************************************************/
+#define ENGINE_TILED                0  // Tiled pipeline, any layer
+#define ENGINE_LINE_BUFFER          1  // Row streaming, 3x3/s1/p1 with <= 64 input channels
+#define ENGINE_RESIDENT             2  // Small maps on chip, 1x1 or 3x3 up to 14x14;
+                                       // consecutive resident layers of a command list skip
+                                       // DDR between them
+#define ENGINE_WINOGRAD             3  // Line-buffer shapes in the Winograd domain, 16
+                                       // products per 2x2 block instead of 36 (Q8.8
+                                       // bitstreams; INT8 runs the line-buffer engine)
+
+/*******************************************************************************
+ * DDR Data Layout (must match cnn_accel.h)
+ * The accelerator moves 4 x 16-bit values per 64-bit AXI beat. Every buffer
+ * base must be 8-byte aligned, feature maps are stored [C][H][FM_PITCH(W)]
+ * and weights channel-last [OC][KH][KW][IC].
+ ******************************************************************************/
+#define AXI_LANES           4
+#define FM_PITCH(w)         (((w) + AXI_LANES - 1) & ~(AXI_LANES - 1))
+#define DDR_ALIGN8(bytes)   (((bytes) + 7) & ~7)
+
+/*******************************************************************************
+ * Head Decode (must match DECODE_* in cnn_accel.h)
+ * Layouts of the parameter block and the entries: yolo_postprocess.h
+ ******************************************************************************/
+#define CNN_DECODE_PARAM_WORDS  40   // int32 words of the parameter block
+#define CNN_DECODE_MAX_CANDS    256  // Entries the IP writes per start
+#define CNN_CANDIDATE_BYTES     16   // Per entry (two 64-bit words)
+
+/*******************************************************************************
+ * Cache Coherency
+ * 0: the accelerator masters reach DDR through S_AXI_HP0, which bypasses the
+ *    CPU caches. Each submission flushes its input map and invalidates its
+ *    output maps (before the start and again at completion), so callers do
+ *    no cache maintenance on feature maps.
+ * 1: the masters go through S_AXI_ACP (create_design.tcl: use_acp 1) and are
+ *    snooped by the SCU, so the driver does no maintenance at all.
+ * When the last layer of a command list decodes its head (descriptor
+ * decode), the candidate list takes the place of that layer's map at
+ * completion: only the list is invalidated, the map is left to the caller.
+ ******************************************************************************/
+#ifndef CNN_ACCEL_USE_ACP
+#define CNN_ACCEL_USE_ACP   0
+#endif
+
 /*******************************************************************************
  * Layer Configuration Structure
+ * batch > 1 runs that many images in one start: each buffer holds the maps
+ * back to back, one map size apart, so a slot and its cache maintenance are
+ * batch times larger. ENGINE_RESIDENT layers fetch their weights once for
+ * the images that fit on chip (up to four L5 inputs) instead of once per
+ * image; the other engines run the images in turn. Initialisers that stop
+ * before the field get 0, i.e. one image.
  ******************************************************************************/
 typedef struct {
     int layer_type;      // 0: conv+bn+relu, 1: conv+bn+relu+pool, 2: conv only
@@ -84,8 +182,52 @@ typedef struct {
     int kernel_size;     // 1 or 3
     int stride;
     int padding;
+    int dataflow;        // DATAFLOW_* (falls back to output-stationary if it won't fit)
+    int engine;          // ENGINE_* (falls back to tiled if unsupported)
+    int batch;           // Images per start (0 or 1: one)
 } LayerConfig;
 
+/*******************************************************************************
+ * Layer Descriptor (command-list mode, must match DESC_* in cnn_accel.h)
+ * 64 bytes per layer. Offsets are relative to the network base addresses
+ * (DDR_INPUT_FM_ADDR for both feature map ports, DDR_WEIGHTS_ADDR,
+ * DDR_BN_SCALE_ADDR/DDR_BN_SHIFT_ADDR); use cnn_accel_fill_descriptor().
+ * Between two consecutive ENGINE_RESIDENT layers the map stays on chip: the
+ * first one's output buffer is not written (still allocate it, the IP falls
+ * back to DDR for layers that do not fit).
+ * decode on a layer-type-2 head (Q8.8 bitstreams) also reduces its output to
+ * YOLO candidate boxes in the list set by cnn_accel_set_decode().
+ ******************************************************************************/
+typedef struct {
+    LayerConfig cfg;
+    int32_t input_offset;    // 64-bit words
+    int32_t output_offset;   // 64-bit words
+    int32_t weights_offset;  // 64-bit words
+    int32_t bn_offset;       // 16-bit elements (scale and shift)
+    int32_t decode;          // Non-zero on the head: PL decode (cnn_accel_set_decode)
+} LayerDescriptor;
+
+/*******************************************************************************
+ * Job Statistics (last completed submission, see perf_profile.h)
+ * Times are global timer ticks (COUNTS_PER_SECOND); the counters are the
+ * PL's own, summed over every layer of a command list.
+ ******************************************************************************/
+typedef struct {
+    uint64_t setup_ticks;     // Register writes, up to ap_start
+    uint64_t run_ticks;       // ap_start to ap_done seen by the ISR / poll
+    uint64_t cache_ticks;     // Flush + invalidate, before the start and at completion
+    uint32_t compute_cycles;  // PL: MAC array cycles
+    uint32_t read_beats;      // PL: 64-bit read beats
+    uint32_t write_beats;     // PL: 64-bit write beats
+} CnnJobStats;
+
+/*******************************************************************************
+ * Completion Callback
+ * Called once per submission with CNN_OK or CNN_ERR_TIMEOUT. With interrupts
+ * enabled it runs in IRQ context, otherwise from cnn_accel_poll().
+ ******************************************************************************/
+typedef void (*CnnDoneCallback)(void *ref, int result);
+
 /*******************************************************************************
  * Driver Functions
  ******************************************************************************/
@@ -99,8 +241,8 @@ int cnn_accel_is_ready(void);
 // Check if accelerator is done
 int cnn_accel_is_done(void);
 
-// Wait for accelerator to complete
-void cnn_accel_wait_done(void);
+// Wait for accelerator to complete (CNN_OK or CNN_ERR_TIMEOUT)
+int cnn_accel_wait_done(void);
 
 // Configure layer parameters
 void cnn_accel_configure_layer(const LayerConfig *cfg);
@@ -117,8 +259,8 @@ void cnn_accel_set_addresses(
 // Start accelerator
 void cnn_accel_start(void);
 
-// Run a single layer (configure + start + wait)
-void cnn_accel_run_layer(
+// Run a single layer (configure + start + wait), returns CNN_OK or CNN_ERR_*
+int cnn_accel_run_layer(
     const LayerConfig *cfg,
     uint32_t input_addr,
     uint32_t output_addr,
@@ -130,6 +272,61 @@ void cnn_accel_run_layer(
 // Get status
 uint32_t cnn_accel_get_status(void);
 
+// Fill one descriptor from a layer config and absolute DDR addresses
+void cnn_accel_fill_descriptor(
+    LayerDescriptor *desc,
+    const LayerConfig *cfg,
+    uint32_t input_addr,
+    uint32_t output_addr,
+    uint32_t weights_addr,
+    uint32_t bn_scale_addr
+);
+
+// Run a whole descriptor table with a single start (blocking)
+int cnn_accel_run_network(const LayerDescriptor *descs, int num_layers);
+
+// Route ap_done through the GIC (gic must be initialized by the application)
+int cnn_accel_setup_interrupt(XScuGic *gic);
+
+// Deadline applied to every following submission
+void cnn_accel_set_timeout(uint32_t timeout_ms);
+
+// Non-blocking: configure + start a layer, returns CNN_OK or CNN_ERR_BUSY
+int cnn_accel_submit_layer(
+    const LayerConfig *cfg,
+    uint32_t input_addr,
+    uint32_t output_addr,
+    uint32_t weights_addr,
+    uint32_t bn_scale_addr,
+    uint32_t bn_shift_addr,
+    CnnDoneCallback callback,
+    void *callback_ref
+);
+
+// Non-blocking: start a descriptor table, returns CNN_OK or CNN_ERR_BUSY
+int cnn_accel_submit_network(
+    const LayerDescriptor *descs,
+    int num_layers,
+    CnnDoneCallback callback,
+    void *callback_ref
+);
+
+// CNN_PENDING while running, then the result of the last submission
+int cnn_accel_poll(void);
+
+// Poll until the current submission completes or times out
+int cnn_accel_wait(void);
+
+// Timing and PL counters of the last submission that completed with CNN_OK
+void cnn_accel_get_stats(CnnJobStats *stats);
+
+// Head decode: parameter block (yolo_decoder_hw_params) and candidate list
+// (max_candidates entries of CNN_CANDIDATE_BYTES) for the following starts
+void cnn_accel_set_decode(uint32_t params_addr, uint32_t candidates_addr, int max_candidates);
+
+// Candidates found by the last start (may exceed the list; 0 without decode)
+uint32_t cnn_accel_num_candidates(void);
+
 #ifdef __cplusplus
 }
 #endif
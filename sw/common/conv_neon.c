@@ -0,0 +1,395 @@
+/*******************************************************************************
+ * NEON Convolution Engine Implementation
+ ******************************************************************************/
+
+#include "conv_neon.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONV_USE_NEON 1
+#else
+#define CONV_USE_NEON 0
+#endif
+
+#define OC_BLOCK  CONV_NEON_OC_BLOCK   // Output channels per micro-kernel (one q-register of weights)
+#define PX_BLOCK  8                    // Output pixels per micro-kernel (two q-registers per channel)
+
+#define ROUND_UP(x, m)  (((x) + (m) - 1) / (m) * (m))
+
+/*******************************************************************************
+ * Operand Packing
+ ******************************************************************************/
+
+// Padded plane of conv_neon_pad_input()
+static void padded_dims(int in_h, int in_w, int kernel, int stride, int pad, int* ph, int* pw) {
+    int out_w = (in_w + 2*pad - kernel) / stride + 1;
+
+    *ph = in_h + 2*pad;
+    *pw = in_w + 2*pad;
+    // Stride 1: widen rows so the last 8-pixel block never reads past them
+    if (stride == 1 && ROUND_UP(out_w, PX_BLOCK) + kernel - 1 > *pw) {
+        *pw = ROUND_UP(out_w, PX_BLOCK) + kernel - 1;
+    }
+}
+
+size_t conv_neon_padded_size(int in_ch, int in_h, int in_w, int kernel, int stride, int pad) {
+    int ph, pw;
+
+    padded_dims(in_h, in_w, kernel, stride, pad, &ph, &pw);
+    return (size_t)in_ch * ph * pw;
+}
+
+// Zero-padded copy [in_ch][ph][pw]: removes every bounds check from the kernel
+void conv_neon_pad_input(const float* in, float* p,
+                         int in_ch, int in_h, int in_w, int kernel, int stride, int pad) {
+    int ph, pw, c, y;
+
+    padded_dims(in_h, in_w, kernel, stride, pad, &ph, &pw);
+    memset(p, 0, (size_t)in_ch * ph * pw * sizeof(float));
+    for (c = 0; c < in_ch; c++) {
+        for (y = 0; y < in_h; y++) {
+            memcpy(p + ((size_t)c * ph + y + pad) * pw + pad,
+                   in + ((size_t)c * in_h + y) * in_w, in_w * sizeof(float));
+        }
+    }
+}
+
+size_t conv_neon_packed_size(int in_ch, int out_ch, int kernel) {
+    return (size_t)ROUND_UP(out_ch, OC_BLOCK) * in_ch * kernel * kernel;
+}
+
+// [out_ch][in_ch][k][k] -> [oc/4][in_ch][k][k][4], zero-filled past out_ch
+void conv_neon_pack_weights(const float* w, float* p, int in_ch, int out_ch, int kernel) {
+    int kk = kernel * kernel;
+    int oc_blocks = ROUND_UP(out_ch, OC_BLOCK) / OC_BLOCK;
+    int ob, i, t, o;
+
+    for (ob = 0; ob < oc_blocks; ob++) {
+        for (i = 0; i < in_ch; i++) {
+            for (t = 0; t < kk; t++) {
+                float* dst = p + (((size_t)ob * in_ch + i) * kk + t) * OC_BLOCK;
+                for (o = 0; o < OC_BLOCK; o++) {
+                    int oc = ob * OC_BLOCK + o;
+                    dst[o] = (oc < out_ch) ? w[((size_t)oc * in_ch + i) * kk + t] : 0.0f;
+                }
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Micro-Kernel: 4 output channels x 8 output pixels, stride 1
+ * in:  padded input at (ic 0, first kernel row, first pixel)
+ * wp:  packed weights of one OC block
+ * acc: result [OC_BLOCK][PX_BLOCK]
+ ******************************************************************************/
+static void kernel_4x8(const float* in, const float* wp, int in_ch, int k,
+                       int plane, int pw, float acc[OC_BLOCK][PX_BLOCK]) {
+    int ic, kh, kw;
+
+#if CONV_USE_NEON
+    float32x4_t c00 = vdupq_n_f32(0.0f), c01 = vdupq_n_f32(0.0f);
+    float32x4_t c10 = vdupq_n_f32(0.0f), c11 = vdupq_n_f32(0.0f);
+    float32x4_t c20 = vdupq_n_f32(0.0f), c21 = vdupq_n_f32(0.0f);
+    float32x4_t c30 = vdupq_n_f32(0.0f), c31 = vdupq_n_f32(0.0f);
+
+    for (ic = 0; ic < in_ch; ic++) {
+        const float* ip = in + (size_t)ic * plane;
+        for (kh = 0; kh < k; kh++) {
+            const float* r = ip + kh * pw;
+            for (kw = 0; kw < k; kw++) {
+                float32x4_t w = vld1q_f32(wp);
+                float32x4_t x0 = vld1q_f32(r + kw);
+                float32x4_t x1 = vld1q_f32(r + kw + 4);
+                float32x2_t wl = vget_low_f32(w);
+                float32x2_t wh = vget_high_f32(w);
+                wp += OC_BLOCK;
+
+                // Cortex-A9 has no VFMA: VMLA by scalar lane
+                c00 = vmlaq_lane_f32(c00, x0, wl, 0);
+                c01 = vmlaq_lane_f32(c01, x1, wl, 0);
+                c10 = vmlaq_lane_f32(c10, x0, wl, 1);
+                c11 = vmlaq_lane_f32(c11, x1, wl, 1);
+                c20 = vmlaq_lane_f32(c20, x0, wh, 0);
+                c21 = vmlaq_lane_f32(c21, x1, wh, 0);
+                c30 = vmlaq_lane_f32(c30, x0, wh, 1);
+                c31 = vmlaq_lane_f32(c31, x1, wh, 1);
+            }
+        }
+    }
+
+    vst1q_f32(&acc[0][0], c00); vst1q_f32(&acc[0][4], c01);
+    vst1q_f32(&acc[1][0], c10); vst1q_f32(&acc[1][4], c11);
+    vst1q_f32(&acc[2][0], c20); vst1q_f32(&acc[2][4], c21);
+    vst1q_f32(&acc[3][0], c30); vst1q_f32(&acc[3][4], c31);
+#else
+    int o, x;
+
+    for (o = 0; o < OC_BLOCK; o++) {
+        for (x = 0; x < PX_BLOCK; x++) {
+            acc[o][x] = 0.0f;
+        }
+    }
+    for (ic = 0; ic < in_ch; ic++) {
+        const float* ip = in + (size_t)ic * plane;
+        for (kh = 0; kh < k; kh++) {
+            const float* r = ip + kh * pw;
+            for (kw = 0; kw < k; kw++) {
+                for (o = 0; o < OC_BLOCK; o++) {
+                    for (x = 0; x < PX_BLOCK; x++) {
+                        acc[o][x] += r[kw + x] * wp[o];
+                    }
+                }
+                wp += OC_BLOCK;
+            }
+        }
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Epilogue: bias, LeakyReLU and 2x2 max of one channel's block
+ * r0/r1: the block's conv rows (r1 NULL without pooling), n valid pixels.
+ * Bias and LeakyReLU are monotonic, so pooling first gives the same result
+ * with a quarter of the work.
+ ******************************************************************************/
+static void epilogue(const float* r0, const float* r1, int n, float b, int flags, float* dst) {
+    int x;
+
+#if CONV_USE_NEON
+    if (n == PX_BLOCK) {
+        float32x4_t lo = vld1q_f32(r0);
+        float32x4_t hi = vld1q_f32(r0 + 4);
+        float32x4_t bv = vdupq_n_f32(b);
+
+        if (r1) {
+            // Vertical max, then pairwise max: 8 columns -> 4 pooled outputs
+            float32x4_t vlo = vmaxq_f32(lo, vld1q_f32(r1));
+            float32x4_t vhi = vmaxq_f32(hi, vld1q_f32(r1 + 4));
+            float32x4_t v = vcombine_f32(vpmax_f32(vget_low_f32(vlo), vget_high_f32(vlo)),
+                                         vpmax_f32(vget_low_f32(vhi), vget_high_f32(vhi)));
+            v = vaddq_f32(v, bv);
+            if (flags & CONV_FUSE_LEAKY) v = vmaxq_f32(v, vmulq_n_f32(v, 0.1f));
+            vst1q_f32(dst, v);
+            return;
+        }
+
+        lo = vaddq_f32(lo, bv);
+        hi = vaddq_f32(hi, bv);
+        if (flags & CONV_FUSE_LEAKY) {
+            lo = vmaxq_f32(lo, vmulq_n_f32(lo, 0.1f));
+            hi = vmaxq_f32(hi, vmulq_n_f32(hi, 0.1f));
+        }
+        vst1q_f32(dst, lo);
+        vst1q_f32(dst + 4, hi);
+        return;
+    }
+#endif
+
+    if (r1) {
+        for (x = 0; x < n / 2; x++) {
+            float v = r0[2*x];
+            if (r0[2*x + 1] > v) v = r0[2*x + 1];
+            if (r1[2*x] > v) v = r1[2*x];
+            if (r1[2*x + 1] > v) v = r1[2*x + 1];
+            v += b;
+            dst[x] = ((flags & CONV_FUSE_LEAKY) && v < 0.0f) ? 0.1f * v : v;
+        }
+    } else {
+        for (x = 0; x < n; x++) {
+            float v = r0[x] + b;
+            dst[x] = ((flags & CONV_FUSE_LEAKY) && v < 0.0f) ? 0.1f * v : v;
+        }
+    }
+}
+
+/*******************************************************************************
+ * One result row of one OC block (a pooled row covers two conv rows)
+ * r: row of the result map; out_h/out_w: conv output size
+ ******************************************************************************/
+static void conv_row(const float* pin, const float* wblk, float* out_data,
+                     int in_ch, int k, int ph, int pw, int oc0, int out_ch,
+                     int r, int out_h, int out_w, const float* bias, int flags) {
+    float acc[OC_BLOCK][PX_BLOCK];
+    float acc1[OC_BLOCK][PX_BLOCK];
+    int pool = flags & CONV_FUSE_POOL;
+    int rh = pool ? out_h / 2 : out_h;
+    int rw = pool ? out_w / 2 : out_w;
+    int oy = pool ? 2 * r : r;
+    int ox, o;
+
+    for (ox = 0; ox < out_w; ox += PX_BLOCK) {
+        int n = (out_w - ox < PX_BLOCK) ? out_w - ox : PX_BLOCK;
+
+        kernel_4x8(pin + (size_t)oy * pw + ox, wblk, in_ch, k, ph * pw, pw, acc);
+        if (pool) {
+            kernel_4x8(pin + (size_t)(oy + 1) * pw + ox, wblk, in_ch, k, ph * pw, pw, acc1);
+        }
+
+        for (o = 0; o < OC_BLOCK && oc0 + o < out_ch; o++) {
+            float* dst = out_data + ((size_t)(oc0 + o) * rh + r) * rw + (pool ? ox / 2 : ox);
+            epilogue(acc[o], pool ? acc1[o] : NULL, n,
+                     bias ? bias[oc0 + o] : 0.0f, flags, dst);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Strided fallback (no stride > 1 layer in the current network)
+ * One conv sum per output pixel; pooled outputs take the 2x2 sums through
+ * the same epilogue, so no full-size map is needed.
+ ******************************************************************************/
+static float strided_sum(const float* pin, const float* wblk, int in_ch, int k, int stride,
+                         int ph, int pw, int oy, int ox) {
+    float sum = 0.0f;
+    int kk = k * k;
+    int ic, kh, kw;
+
+    for (ic = 0; ic < in_ch; ic++) {
+        for (kh = 0; kh < k; kh++) {
+            const float* r = pin + ((size_t)ic * ph + oy * stride + kh) * pw + ox * stride;
+            for (kw = 0; kw < k; kw++) {
+                sum += r[kw] * wblk[((size_t)ic * kk + kh * k + kw) * OC_BLOCK];
+            }
+        }
+    }
+    return sum;
+}
+
+static void conv_strided(const float* pin, const float* wpk, float* out_data,
+                         int in_ch, int k, int stride, int ph, int pw,
+                         int out_ch, int out_h, int out_w, const float* bias, int flags) {
+    int pool = flags & CONV_FUSE_POOL;
+    int rh = pool ? out_h / 2 : out_h;
+    int rw = pool ? out_w / 2 : out_w;
+    int kk = k * k;
+    int oc, y, x;
+
+    for (oc = 0; oc < out_ch; oc++) {
+        const float* wblk = wpk + (size_t)(oc / OC_BLOCK) * in_ch * kk * OC_BLOCK + oc % OC_BLOCK;
+        float b = bias ? bias[oc] : 0.0f;
+
+        for (y = 0; y < rh; y++) {
+            for (x = 0; x < rw; x++) {
+                float* dst = out_data + ((size_t)oc * rh + y) * rw + x;
+                float r0[2], r1[2];
+
+                if (pool) {
+                    r0[0] = strided_sum(pin, wblk, in_ch, k, stride, ph, pw, 2*y, 2*x);
+                    r0[1] = strided_sum(pin, wblk, in_ch, k, stride, ph, pw, 2*y, 2*x + 1);
+                    r1[0] = strided_sum(pin, wblk, in_ch, k, stride, ph, pw, 2*y + 1, 2*x);
+                    r1[1] = strided_sum(pin, wblk, in_ch, k, stride, ph, pw, 2*y + 1, 2*x + 1);
+                    epilogue(r0, r1, 2, b, flags, dst);
+                } else {
+                    r0[0] = strided_sum(pin, wblk, in_ch, k, stride, ph, pw, y, x);
+                    epilogue(r0, NULL, 1, b, flags, dst);
+                }
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Fused Convolution on Pre-Packed Operands
+ ******************************************************************************/
+int conv2d_fused_packed(
+    const float* pin,
+    float* out_data,
+    const float* wpk,
+    const float* bias,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad,
+    int flags
+) {
+    int out_h = (in_h + 2*pad - kernel) / stride + 1;
+    int out_w = (in_w + 2*pad - kernel) / stride + 1;
+    int rows = (flags & CONV_FUSE_POOL) ? out_h / 2 : out_h;
+    int kk = kernel * kernel;
+    int oc_blocks = ROUND_UP(out_ch, OC_BLOCK) / OC_BLOCK;
+    int ph, pw, ob, oy;
+
+    padded_dims(in_h, in_w, kernel, stride, pad, &ph, &pw);
+
+    if (stride != 1) {
+        conv_strided(pin, wpk, out_data, in_ch, kernel, stride, ph, pw,
+                     out_ch, out_h, out_w, bias, flags);
+    } else if ((size_t)in_ch * ph * pw * sizeof(float) <= CONV_NEON_L2_BYTES / 2) {
+        // Small maps, deep weights (L3-L6): input stays in L2, one OC block's
+        // weights (in_ch * k * k * 16 bytes) stay in L1 across all rows
+        for (ob = 0; ob < oc_blocks; ob++) {
+            const float* wblk = wpk + (size_t)ob * in_ch * kk * OC_BLOCK;
+            for (oy = 0; oy < rows; oy++) {
+                conv_row(pin, wblk, out_data, in_ch, kernel, ph, pw,
+                         ob * OC_BLOCK, out_ch, oy, out_h, out_w, bias, flags);
+            }
+        }
+    } else {
+        // Large maps, shallow weights (L0-L2): the k-row input strip of one
+        // output row stays in L1 while every OC block sweeps it
+        for (oy = 0; oy < rows; oy++) {
+            for (ob = 0; ob < oc_blocks; ob++) {
+                conv_row(pin, wpk + (size_t)ob * in_ch * kk * OC_BLOCK, out_data,
+                         in_ch, kernel, ph, pw, ob * OC_BLOCK, out_ch, oy, out_h, out_w,
+                         bias, flags);
+            }
+        }
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * Per-call padding and packing shared by the plain and fused entry points
+ ******************************************************************************/
+static int conv_run(
+    const float* in_data, float* out_data, const float* weights, const float* bias,
+    int in_ch, int in_h, int in_w, int out_ch, int kernel, int stride, int pad, int flags
+) {
+    float* pin = (float*)malloc(conv_neon_padded_size(in_ch, in_h, in_w, kernel, stride, pad) *
+                                sizeof(float));
+    float* wpk = (float*)malloc(conv_neon_packed_size(in_ch, out_ch, kernel) * sizeof(float));
+
+    if (!pin || !wpk) {
+        free(pin);
+        free(wpk);
+        return -1;
+    }
+    conv_neon_pad_input(in_data, pin, in_ch, in_h, in_w, kernel, stride, pad);
+    conv_neon_pack_weights(weights, wpk, in_ch, out_ch, kernel);
+    conv2d_fused_packed(pin, out_data, wpk, bias, in_ch, in_h, in_w,
+                        out_ch, kernel, stride, pad, flags);
+    free(pin);
+    free(wpk);
+    return 0;
+}
+
+/*******************************************************************************
+ * Convolution 2D
+ ******************************************************************************/
+int conv2d_neon(
+    const float* in_data,
+    float* out_data,
+    const float* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+) {
+    return conv_run(in_data, out_data, weights, NULL,
+                    in_ch, in_h, in_w, out_ch, kernel, stride, pad, 0);
+}
+
+/*******************************************************************************
+ * Fused Convolution + bias + LeakyReLU + maxpool
+ ******************************************************************************/
+int conv2d_fused_neon(
+    const float* in_data,
+    float* out_data,
+    const float* weights,
+    const float* bias,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad,
+    int flags
+) {
+    return conv_run(in_data, out_data, weights, bias,
+                    in_ch, in_h, in_w, out_ch, kernel, stride, pad, flags);
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * NEON Convolution Engine for Cortex-A9
+ * Drop-in replacement for conv2d() in yolo_layers.h
+ *
+ * Direct convolution on a zero-padded copy of the input with a register-blocked
+ * micro-kernel: 4 output channels x 8 output pixels held in 8 NEON registers,
+ * reduced over in_ch x k x k. Weights are repacked so the 4 output channels of
+ * one tap are a single 128-bit load.
+ *
+ * conv2d_neon()/conv2d_fused_neon() pad and pack per call. Callers that run
+ * the same layer every frame pack the weights once (conv_neon_pack_weights),
+ * pad into their own scratch (conv_neon_pad_input) and call
+ * conv2d_fused_packed(), which allocates nothing.
+ *
+ * Build with -mfpu=neon (Vitis: C/C++ Build Settings -> Miscellaneous) to get
+ * the NEON micro-kernel; without it the same blocking runs in scalar code.
+ ******************************************************************************/
+
+#ifndef CONV_NEON_H
+#define CONV_NEON_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cortex-A9 on Zynq-7020: 32 KB L1D per core, 512 KB shared L2
+#define CONV_NEON_L1_BYTES   (32 * 1024)
+#define CONV_NEON_L2_BYTES   (512 * 1024)
+
+// Output channels per packed weight block: a channel range that starts on a
+// multiple of this uses the same packed weights at offset oc0 * in_ch * k * k
+#define CONV_NEON_OC_BLOCK   4
+
+/*******************************************************************************
+ * Convolution 2D with padding (same layouts and result as conv2d)
+ * Input:  in_data  [in_ch][in_h][in_w]
+ * Output: out_data [out_ch][out_h][out_w]
+ * Kernel: weights  [out_ch][in_ch][k][k]
+ * Results differ from conv2d only by float summation order.
+ * @return 0 on success, -1 if the scratch buffers could not be allocated
+ ******************************************************************************/
+int conv2d_neon(
+    const float* in_data,
+    float* out_data,
+    const float* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+);
+
+/*******************************************************************************
+ * Fused Conv + bias + LeakyReLU + 2x2 maxpool (BN folded via fold_batchnorm)
+ * Each 4x8 output block gets bias, activation and pooling while it is still
+ * in L1, so only the final (pooled) map is written.
+ * Output: out_data [out_ch][out_h/2][out_w/2] with CONV_FUSE_POOL,
+ *         [out_ch][out_h][out_w] otherwise
+ * bias may be NULL (no bias)
+ ******************************************************************************/
+#define CONV_FUSE_LEAKY  (1 << 0)   // LeakyReLU 0.1
+#define CONV_FUSE_POOL   (1 << 1)   // 2x2 stride-2 max pool (floor dimensions)
+
+int conv2d_fused_neon(
+    const float* in_data,
+    float* out_data,
+    const float* weights,
+    const float* bias,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad,
+    int flags
+);
+
+/*******************************************************************************
+ * Pre-packed Operands
+ * conv_neon_packed_size/conv_neon_padded_size are in floats.
+ * Packed weights: [oc/4][in_ch][k][k][4], zero-filled past out_ch
+ * Padded input:   [in_ch][in_h + 2*pad][pw], zero border, pw widened so the
+ *                 last 8-pixel block of a stride-1 row stays inside it
+ ******************************************************************************/
+size_t conv_neon_packed_size(int in_ch, int out_ch, int kernel);
+
+void conv_neon_pack_weights(const float* weights, float* packed,
+                            int in_ch, int out_ch, int kernel);
+
+size_t conv_neon_padded_size(int in_ch, int in_h, int in_w, int kernel, int stride, int pad);
+
+void conv_neon_pad_input(const float* in_data, float* padded,
+                         int in_ch, int in_h, int in_w, int kernel, int stride, int pad);
+
+/*******************************************************************************
+ * Fused conv on pre-packed operands (same result as conv2d_fused_neon)
+ * padded/packed from the functions above with the same shape arguments.
+ * No allocation: always returns 0
+ ******************************************************************************/
+int conv2d_fused_packed(
+    const float* padded,
+    float* out_data,
+    const float* packed,
+    const float* bias,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad,
+    int flags
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONV_NEON_H
@@ -90,35 +90,138 @@ void image_to_fixed_point(const Image *img, fixed16_t *output) {
     }
 }
 
+/*******************************************************************************
+ * Fused Preprocessing: resize + normalize + HWC->CHW + Q8.8 in one pass
+ * Source coordinates are 16.16 fixed point, computed once per image; blend
+ * weights are Q8, rounded. Per output row the two source rows are blended
+ * vertically into three channel rows (NEON: VLD3 deinterleaves 16 RGB
+ * pixels, VMULL/VMLAL.U8 + VADDW blend them), then each output pixel blends
+ * two entries of its channel row and is scaled by 256/255 with shifts,
+ * rounding to nearest (within 1.5 LSB of an exact float bilinear).
+ ******************************************************************************/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PREPROC_USE_NEON 1
+#else
+#define PREPROC_USE_NEON 0
+#endif
+
+#define BLEND_BITS  8
+#define BLEND_ONE   (1 << BLEND_BITS)
+
+static uint16_t blend_rows_buf[3][PREPROC_MAX_SRC_WIDTH];   // Q8 channel rows
+static int16_t x0_tab[CNN_INPUT_WIDTH], x1_tab[CNN_INPUT_WIDTH];
+static int16_t y0_tab[CNN_INPUT_HEIGHT], y1_tab[CNN_INPUT_HEIGHT];
+static uint8_t fx_tab[CNN_INPUT_WIDTH], fy_tab[CNN_INPUT_HEIGHT];
+
+// Same sampling grid as image_resize_bilinear (corners aligned)
+static void bilinear_coords(int src, int dst, int16_t *i0, int16_t *i1, uint8_t *frac) {
+    uint32_t step = (dst > 1) ? ((uint32_t)(src - 1) << 16) / (dst - 1) : 0;
+    int d;
+
+    for (d = 0; d < dst; d++) {
+        uint32_t pos = (d * step + (1 << (15 - BLEND_BITS))) >> (16 - BLEND_BITS);
+        int i = (int)(pos >> BLEND_BITS);
+        i0[d] = (int16_t)i;
+        i1[d] = (int16_t)((i + 1 < src) ? i + 1 : i);
+        frac[d] = (uint8_t)(pos & (BLEND_ONE - 1));
+    }
+}
+
+static void blend_rows(const uint8_t *r0, const uint8_t *r1, int width, int fy) {
+    int x = 0;
+
+#if PREPROC_USE_NEON
+    // r0 * (256 - fy) + r1 * fy as r0 * (255 - fy) + r1 * fy + r0 (u8 weights)
+    uint8x8_t w0 = vdup_n_u8((uint8_t)(BLEND_ONE - 1 - fy));
+    uint8x8_t w1 = vdup_n_u8((uint8_t)fy);
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t a = vld3q_u8(r0 + 3 * x);
+        uint8x16x3_t b = vld3q_u8(r1 + 3 * x);
+        int c;
+
+        for (c = 0; c < 3; c++) {
+            uint8x8_t a_lo = vget_low_u8(a.val[c]), a_hi = vget_high_u8(a.val[c]);
+            vst1q_u16(&blend_rows_buf[c][x],
+                      vaddw_u8(vmlal_u8(vmull_u8(a_lo, w0), vget_low_u8(b.val[c]), w1), a_lo));
+            vst1q_u16(&blend_rows_buf[c][x + 8],
+                      vaddw_u8(vmlal_u8(vmull_u8(a_hi, w0), vget_high_u8(b.val[c]), w1), a_hi));
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        int c;
+        for (c = 0; c < 3; c++) {
+            blend_rows_buf[c][x] = (uint16_t)(r0[3 * x + c] * (BLEND_ONE - fy) + r1[3 * x + c] * fy);
+        }
+    }
+}
+
+// Q16 pixel (0..255 << 16) to Q8.8 of pixel / 255: x 256/255 = 1 + 1/256 + 1/65536 + ...
+static inline fixed16_t q16_to_q88(uint32_t v) {
+    return (fixed16_t)((v + (v >> 8) + (v >> 16) + (1 << 15)) >> 16);
+}
+
+static void preprocess_fused(const uint8_t *src, int src_w, int src_h,
+                             fixed16_t *q88, float *f32) {
+    const float to_float = 1.0f / (255.0f * (1 << (2 * BLEND_BITS)));
+    int hw = CNN_INPUT_HEIGHT * CNN_INPUT_WIDTH;
+    int x, y, c;
+
+    bilinear_coords(src_w, CNN_INPUT_WIDTH, x0_tab, x1_tab, fx_tab);
+    bilinear_coords(src_h, CNN_INPUT_HEIGHT, y0_tab, y1_tab, fy_tab);
+
+    for (y = 0; y < CNN_INPUT_HEIGHT; y++) {
+        blend_rows(src + y0_tab[y] * src_w * 3, src + y1_tab[y] * src_w * 3, src_w, fy_tab[y]);
+
+        for (c = 0; c < 3; c++) {
+            const uint16_t *row = blend_rows_buf[c];
+            int base = c * hw + y * CNN_INPUT_WIDTH;
+
+            for (x = 0; x < CNN_INPUT_WIDTH; x++) {
+                uint32_t v = (uint32_t)row[x0_tab[x]] * (BLEND_ONE - fx_tab[x]) +
+                             (uint32_t)row[x1_tab[x]] * fx_tab[x];
+                if (q88) {
+                    q88[base + x] = q16_to_q88(v);
+                } else {
+                    f32[base + x] = (float)v * to_float;
+                }
+            }
+        }
+    }
+}
+
 /*******************************************************************************
  * Full preprocessing pipeline
  ******************************************************************************/
-void preprocess_image(const uint8_t *src_data, int src_width, int src_height,
-                      fixed16_t *output) {
-    // Allocate temporary buffer for resized image
+static const uint8_t *narrow_source(const uint8_t *src_data, int *src_width, int *src_height) {
     static uint8_t resize_buffer[CNN_INPUT_WIDTH * CNN_INPUT_HEIGHT * 3];
-    
     Image src_img, resized_img;
-    
-    // Load source image
-    image_load_from_memory(src_data, src_width, src_height, &src_img);
-    
-    // Setup resized image
-    resized_img.data = resize_buffer;
-    resized_img.width = CNN_INPUT_WIDTH;
-    resized_img.height = CNN_INPUT_HEIGHT;
-    resized_img.channels = 3;
-    
-    // Resize if needed
-    if (src_width != CNN_INPUT_WIDTH || src_height != CNN_INPUT_HEIGHT) {
-        image_resize_bilinear(&src_img, &resized_img, CNN_INPUT_WIDTH, CNN_INPUT_HEIGHT);
-    } else {
-        // Just copy if already correct size
-        memcpy(resize_buffer, src_data, CNN_INPUT_WIDTH * CNN_INPUT_HEIGHT * 3);
+
+    if (*src_width <= PREPROC_MAX_SRC_WIDTH) {
+        return src_data;
     }
-    
-    // Convert to fixed-point
-    image_to_fixed_point(&resized_img, output);
+
+    // Too wide for the row buffer: resize first, then the fused pass is 1:1
+    image_load_from_memory(src_data, *src_width, *src_height, &src_img);
+    resized_img.data = resize_buffer;
+    image_resize_bilinear(&src_img, &resized_img, CNN_INPUT_WIDTH, CNN_INPUT_HEIGHT);
+    *src_width = CNN_INPUT_WIDTH;
+    *src_height = CNN_INPUT_HEIGHT;
+    return resize_buffer;
+}
+
+void preprocess_image(const uint8_t *src_data, int src_width, int src_height,
+                      fixed16_t *output) {
+    src_data = narrow_source(src_data, &src_width, &src_height);
+    preprocess_fused(src_data, src_width, src_height, output, NULL);
+}
+
+void preprocess_image_float(const uint8_t *src_data, int src_width, int src_height,
+                            float *output) {
+    src_data = narrow_source(src_data, &src_width, &src_height);
+    preprocess_fused(src_data, src_width, src_height, NULL, output);
 }
 
 /*******************************************************************************
@@ -23,11 +23,13 @@ extern "C" {
 #define CNN_INPUT_HEIGHT  224
 #define CNN_INPUT_CHANNELS 3
 
-// Fixed-point Q8.8 format
+// Fixed-point Q8.8 format (also declared by yolo_postprocess.h)
+#ifndef FIXED_SHIFT
 typedef int16_t fixed16_t;
 #define FIXED_SHIFT 8
-#define FLOAT_TO_FIXED(x) ((fixed16_t)((x) * (1 << FIXED_SHIFT)))
 #define FIXED_TO_FLOAT(x) ((float)(x) / (1 << FIXED_SHIFT))
+#endif
+#define FLOAT_TO_FIXED(x) ((fixed16_t)((x) * (1 << FIXED_SHIFT)))
 
 // Image structure
 typedef struct {
@@ -68,17 +70,29 @@ void image_to_fixed_point(const Image *img, fixed16_t *output);
 
 /*******************************************************************************
  * Full preprocessing pipeline
- * Resize + Normalize + Convert to fixed-point
+ * Resize + Normalize + Convert to fixed-point, fused into one pass over the
+ * output (fixed-point bilinear, NEON row blend): no intermediate image.
+ * Values round to nearest instead of through a uint8 image, so they can
+ * differ by 1-2 LSB from image_resize_bilinear() + image_to_fixed_point().
  * 
  * @param src_data: Source RGB888 image data
- * @param src_width: Source width
+ * @param src_width: Source width (wider than PREPROC_MAX_SRC_WIDTH: resized first)
  * @param src_height: Source height
  * @param output: Output buffer for CNN input (pre-allocated)
  *                Size: 3 * 224 * 224 * sizeof(fixed16_t) = 301,056 bytes
+ *                (224 is a multiple of AXI_LANES: already the DDR row pitch)
  ******************************************************************************/
+#define PREPROC_MAX_SRC_WIDTH  1280
+
 void preprocess_image(const uint8_t *src_data, int src_width, int src_height, 
                       fixed16_t *output);
 
+/*******************************************************************************
+ * Same fused pass with float output in [0, 1] (ARM float network input)
+ ******************************************************************************/
+void preprocess_image_float(const uint8_t *src_data, int src_width, int src_height,
+                            float *output);
+
 /*******************************************************************************
  * Create test pattern image (for testing without camera)
  * @param output: Output buffer for CNN input
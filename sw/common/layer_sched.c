@@ -0,0 +1,276 @@
+/*******************************************************************************
+ * Heterogeneous Layer Scheduler Implementation
+ ******************************************************************************/
+
+#include "layer_sched.h"
+#include "layers_q88.h"
+#include "xil_types.h"
+#include "xtime_l.h"
+#include "xil_printf.h"
+#include <string.h>
+
+/*******************************************************************************
+ * Layer Slices: output channels [ch_begin, ch_end) of one descriptor
+ ******************************************************************************/
+static uint32_t fm_addr(int32_t words) {
+    return DDR_INPUT_FM_ADDR + (uint32_t)words * 8;
+}
+
+static int pl_submit(const LayerDescriptor *d, int channels) {
+    LayerConfig cfg = d->cfg;
+
+    // The first 'channels' maps, filters and BN entries start at the layer bases
+    cfg.out_channels = channels;
+    return cnn_accel_submit_layer(&cfg, fm_addr(d->input_offset), fm_addr(d->output_offset),
+                                  DDR_WEIGHTS_ADDR + (uint32_t)d->weights_offset * 8,
+                                  DDR_BN_SCALE_ADDR + (uint32_t)d->bn_offset * 2,
+                                  DDR_BN_SHIFT_ADDR + (uint32_t)d->bn_offset * 2,
+                                  NULL, NULL);
+}
+
+static int arm_slice(const LayerDescriptor *d, int ch_begin, int ch_end) {
+    const LayerConfig *l = &d->cfg;
+    LayerConfig cfg = *l;
+    uint32_t map_bytes = (uint32_t)plan_out_height(l) * FM_PITCH(plan_out_width(l)) * 2;
+    uint32_t filter_bytes = (uint32_t)l->kernel_size * l->kernel_size * l->in_channels * 2;
+    uint32_t bn = (uint32_t)(d->bn_offset + ch_begin) * 2;
+    uint32_t weights = DDR_WEIGHTS_ADDR + (uint32_t)d->weights_offset * 8 + ch_begin * filter_bytes;
+    uint32_t out = fm_addr(d->output_offset) + ch_begin * map_bytes;
+
+    cfg.out_channels = ch_end - ch_begin;
+    if (q88_run_layer(&cfg,
+                      (const int16_t *)(UINTPTR)fm_addr(d->input_offset),
+                      (int16_t *)(UINTPTR)out,
+                      (const int16_t *)(UINTPTR)weights,
+                      (const int16_t *)(UINTPTR)(DDR_BN_SCALE_ADDR + bn),
+                      (const int16_t *)(UINTPTR)(DDR_BN_SHIFT_ADDR + bn)) != 0) {
+        return SCHED_ERR_NOMEM;
+    }
+    return CNN_OK;
+}
+
+/*******************************************************************************
+ * Calibration
+ * Two runs per target give a fixed and a per-channel cost; the ARM runs only
+ * a few channels, since its time is linear in the output channel count.
+ ******************************************************************************/
+static float elapsed_us(XTime t0) {
+    XTime t1;
+
+    XTime_GetTime(&t1);
+    return (float)(t1 - t0) * 1000000.0f / (float)COUNTS_PER_SECOND;
+}
+
+static int time_pl(const LayerDescriptor *d, int channels, float *us) {
+    XTime t0;
+    int rc;
+
+    XTime_GetTime(&t0);
+    rc = pl_submit(d, channels);
+    if (rc == CNN_OK) {
+        rc = cnn_accel_wait();
+    }
+    *us = elapsed_us(t0);
+    return rc;
+}
+
+static int time_arm(const LayerDescriptor *d, int channels, float *us) {
+    XTime t0;
+    int rc;
+
+    XTime_GetTime(&t0);
+    rc = arm_slice(d, 0, channels);
+    *us = elapsed_us(t0);
+    return rc;
+}
+
+// t = fixed + per_ch * k through (k1, t1) and (k2, t2), k2 >= k1
+static void fit(int k1, float t1, int k2, float t2, float *fixed, float *per_ch) {
+    *per_ch = t2 / k2;
+    *fixed = 0.0f;
+    if (k2 > k1 && t2 > t1) {
+        float slope = (t2 - t1) / (k2 - k1);
+        if (t1 - slope * k1 >= 0.0f) {
+            *per_ch = slope;
+            *fixed = t1 - slope * k1;
+        }
+    }
+}
+
+int sched_calibrate(const LayerDescriptor *descs, int num_layers, SchedCost *cost) {
+    int i, rc;
+
+    for (i = 0; i < num_layers; i++) {
+        const LayerDescriptor *d = &descs[i];
+        int oc = d->cfg.out_channels;
+        int half = (oc / 2) & ~(SCHED_SPLIT_ALIGN - 1);
+        int a = (oc < SCHED_CALIB_CHANNELS) ? oc : SCHED_CALIB_CHANNELS;
+        int b = (oc < 2 * a) ? oc : 2 * a;
+        float t_full, t_half, t_a, t_b;
+
+        if ((rc = time_pl(d, oc, &t_full)) != CNN_OK) return rc;
+        t_half = t_full;
+        if (half > 0 && (rc = time_pl(d, half, &t_half)) != CNN_OK) return rc;
+        fit(half > 0 ? half : oc, t_half, oc, t_full, &cost[i].pl_fixed_us, &cost[i].pl_ch_us);
+
+        if ((rc = time_arm(d, a, &t_a)) != CNN_OK) return rc;
+        t_b = t_a;
+        if (b > a && (rc = time_arm(d, b, &t_b)) != CNN_OK) return rc;
+        fit(a, t_a, b, t_b, &cost[i].arm_fixed_us, &cost[i].arm_ch_us);
+    }
+    return CNN_OK;
+}
+
+/*******************************************************************************
+ * Placement
+ ******************************************************************************/
+static float pl_time(const SchedCost *c, int channels) {
+    return channels ? c->pl_fixed_us + c->pl_ch_us * channels : 0.0f;
+}
+
+static float arm_time(const SchedCost *c, int channels) {
+    return channels ? c->arm_fixed_us + c->arm_ch_us * channels : 0.0f;
+}
+
+static float max_f(float a, float b) {
+    return (a > b) ? a : b;
+}
+
+// Best PL share of a split layer (0 if it cannot be split), both halves run at once
+static int best_split(const SchedCost *c, int oc, float *t) {
+    int k, best = 0;
+
+    *t = 0.0f;
+    for (k = SCHED_SPLIT_ALIGN; k < oc; k += SCHED_SPLIT_ALIGN) {
+        float tk = max_f(pl_time(c, k), arm_time(c, oc - k));
+        if (best == 0 || tk < *t) {
+            best = k;
+            *t = tk;
+        }
+    }
+    return best;
+}
+
+void sched_plan(const SchedCost *cost, const LayerDescriptor *descs, int num_layers,
+                int objective, uint32_t arm_frame_us, SchedPlan *plan) {
+    int i;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->num_layers = num_layers;
+    for (i = 0; i < num_layers; i++) {
+        int oc = descs[i].cfg.out_channels;
+        plan->target[i] = SCHED_PL;
+        plan->pl_channels[i] = oc;
+        plan->est_us[i] = cost ? (uint32_t)pl_time(&cost[i], oc) : 0;
+    }
+
+    if (cost && objective == SCHED_LATENCY) {
+        for (i = 0; i < num_layers; i++) {
+            int oc = descs[i].cfg.out_channels;
+            float t_pl = pl_time(&cost[i], oc);
+            float t_arm = arm_time(&cost[i], oc);
+            float t_split;
+            int k = best_split(&cost[i], oc, &t_split);
+
+            if (k && t_split < t_pl && t_split < t_arm) {
+                plan->target[i] = SCHED_SPLIT;
+                plan->pl_channels[i] = k;
+                plan->est_us[i] = (uint32_t)t_split;
+            } else if (t_arm < t_pl) {
+                plan->target[i] = SCHED_ARM;
+                plan->pl_channels[i] = 0;
+                plan->est_us[i] = (uint32_t)t_arm;
+            }
+        }
+    } else if (cost) {
+        // Frames overlap: the period is the busier of the two sides. Move
+        // trailing layers to the ARM (they run beside the next frame's
+        // head) while that shortens the period.
+        float pl_busy = 0.0f, arm_busy = (float)arm_frame_us;
+
+        for (i = 0; i < num_layers; i++) {
+            pl_busy += pl_time(&cost[i], descs[i].cfg.out_channels);
+        }
+        for (i = num_layers - 1; i >= 0; i--) {
+            int oc = descs[i].cfg.out_channels;
+            float pl_next = pl_busy - pl_time(&cost[i], oc);
+            float arm_next = arm_busy + arm_time(&cost[i], oc);
+
+            if (max_f(pl_next, arm_next) >= max_f(pl_busy, arm_busy)) break;
+            pl_busy = pl_next;
+            arm_busy = arm_next;
+            plan->target[i] = SCHED_ARM;
+            plan->pl_channels[i] = 0;
+            plan->est_us[i] = (uint32_t)arm_time(&cost[i], oc);
+        }
+    }
+
+    plan->head_end = num_layers;
+    while (plan->head_end > 0 && plan->target[plan->head_end - 1] == SCHED_ARM) {
+        plan->head_end--;
+    }
+}
+
+void sched_print_plan(const SchedPlan *plan) {
+    static const char *names[] = {"PL   ", "ARM  ", "SPLIT"};
+    int i;
+
+    for (i = 0; i < plan->num_layers; i++) {
+        xil_printf("[SCHED] L%d: %s %3d ch on PL, est %u us%s\r\n", i, names[plan->target[i]],
+                   plan->pl_channels[i], (unsigned)plan->est_us[i],
+                   (i >= plan->head_end) ? " (tail)" : "");
+    }
+}
+
+/*******************************************************************************
+ * Execution
+ ******************************************************************************/
+int sched_run(const SchedPlan *plan, const LayerDescriptor *descs, int begin, int end,
+              SchedIdleFn idle, void *ref) {
+    int idle_done = (idle == NULL);
+    int i = begin, j, rc;
+
+    while (i < end) {
+        const LayerDescriptor *d = &descs[i];
+        int oc = d->cfg.out_channels;
+
+        if (plan->target[i] == SCHED_PL) {
+            // One command list for the whole PL stretch; the ARM is free meanwhile
+            for (j = i + 1; j < end && plan->target[j] == SCHED_PL; j++) {
+            }
+            rc = cnn_accel_submit_network(d, j - i, NULL, NULL);
+            if (rc == CNN_OK && !idle_done) {
+                idle(ref);
+                idle_done = 1;
+            }
+            if (rc == CNN_OK) {
+                rc = cnn_accel_wait();
+            }
+            i = j;
+        } else if (plan->target[i] == SCHED_ARM) {
+            rc = arm_slice(d, 0, oc);
+            i++;
+        } else {
+            // Disjoint output slices: PL channels first, the rest on this core
+            int k = plan->pl_channels[i];
+            rc = pl_submit(d, k);
+            if (rc == CNN_OK) {
+                int arm_rc = arm_slice(d, k, oc);
+                rc = cnn_accel_wait();
+                if (rc == CNN_OK) {
+                    rc = arm_rc;
+                }
+            }
+            i++;
+        }
+
+        if (rc != CNN_OK) {
+            return rc;
+        }
+    }
+
+    if (!idle_done) {
+        idle(ref);
+    }
+    return CNN_OK;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Heterogeneous Layer Scheduler (PL + ARM)
+ * Places each layer of a descriptor table on the PL, on the ARM, or splits
+ * it by output channels across both at once, from a cost table measured at
+ * startup with calibration runs.
+ *
+ * The ARM side runs the bit-exact Q8.8 model (layers_q88.c) on the same DDR
+ * maps, weights and BN arrays as the PL, so any placement gives identical
+ * results. Output channels are contiguous in every layout ([C][H][PITCH]
+ * maps, [OC][KH][KW][IC] weights, per-channel BN), so a split layer is two
+ * disjoint slices: [0, pl_channels) on the PL, the rest on the ARM.
+ *
+ * Trailing ARM layers (from head_end on) are not run by the frame itself:
+ * a pipeline runs them from its idle hook while the PL starts the next
+ * frame, e.g. the 7x7 1x1 head on NEON while the PL runs the next L0.
+ *
+ * Plans are per image: descriptors must have batch 0 or 1, since a channel
+ * slice of a batched map is not contiguous.
+ ******************************************************************************/
+
+#ifndef LAYER_SCHED_H
+#define LAYER_SCHED_H
+
+#include <stdint.h>
+#include "cnn_driver.h"
+#include "buffer_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Targets */
+#define SCHED_PL              0
+#define SCHED_ARM             1
+#define SCHED_SPLIT           2   // PL and ARM on one layer, by output channels
+
+#define SCHED_SPLIT_ALIGN     8   // Split granularity: PARALLEL_OUT_CH, and whole cache lines per slice
+#define SCHED_CALIB_CHANNELS  8   // ARM calibration runs 8 and 16 output channels, then extrapolates
+
+/* Objectives */
+#define SCHED_LATENCY         0   // One frame at a time: fastest target per layer
+#define SCHED_THROUGHPUT      1   // Pipelined frames: balance PL and ARM busy time per frame
+
+#define SCHED_ERR_NOMEM      -3   // ARM layer could not allocate its scratch buffers
+
+/*******************************************************************************
+ * Cost of one layer: fixed + per_ch * output channels (microseconds)
+ ******************************************************************************/
+typedef struct {
+    float pl_fixed_us, pl_ch_us;     // PL: start, fill and drain / per channel
+    float arm_fixed_us, arm_ch_us;   // ARM Q8.8: padding and packing / per channel
+} SchedCost;
+
+typedef struct {
+    int num_layers;
+    int head_end;                        // Layers [head_end, n) are ARM-only
+    int target[PLAN_MAX_LAYERS];         // SCHED_*
+    int pl_channels[PLAN_MAX_LAYERS];    // Output channels on the PL
+    uint32_t est_us[PLAN_MAX_LAYERS];    // Predicted layer time
+} SchedPlan;
+
+/* Called once per sched_run() while the PL runs a stretch of PL-only layers */
+typedef void (*SchedIdleFn)(void *ref);
+
+/*******************************************************************************
+ * Time every layer on both targets, in the buffers of 'descs' (contents are
+ * overwritten). The PL is timed at all and half of the output channels.
+ * @return CNN_OK, or the first driver / SCHED_ERR_NOMEM error
+ ******************************************************************************/
+int sched_calibrate(const LayerDescriptor *descs, int num_layers, SchedCost *cost);
+
+/*******************************************************************************
+ * Choose a target per layer. cost NULL: every layer on the PL, so sched_run()
+ * is one command-list start. arm_frame_us: ARM work per frame outside the
+ * network (pre/post-processing), used by SCHED_THROUGHPUT.
+ ******************************************************************************/
+void sched_plan(const SchedCost *cost, const LayerDescriptor *descs, int num_layers,
+                int objective, uint32_t arm_frame_us, SchedPlan *plan);
+
+void sched_print_plan(const SchedPlan *plan);
+
+/*******************************************************************************
+ * Run layers [begin, end) of one frame (blocking). Consecutive PL layers go
+ * out as one command list; idle, if given, runs once while the first such
+ * stretch is on the PL (or at the end if there is none).
+ * @return CNN_OK, or the first driver / SCHED_ERR_NOMEM error
+ ******************************************************************************/
+int sched_run(const SchedPlan *plan, const LayerDescriptor *descs, int begin, int end,
+              SchedIdleFn idle, void *ref);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAYER_SCHED_H
@@ -0,0 +1,442 @@
+/*******************************************************************************
+ * Q8.8 Fixed-Point CNN Operators Implementation
+ ******************************************************************************/
+
+#include "layers_q88.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define Q88_USE_NEON 1
+#else
+#define Q88_USE_NEON 0
+#endif
+
+#define OC_BLOCK  4   // Output channels per micro-kernel
+#define PX_BLOCK  8   // Output pixels per micro-kernel (one q-register of int16)
+
+#define ROUND_UP(x, m)  (((x) + (m) - 1) / (m) * (m))
+
+/*******************************************************************************
+ * Saturation and Rounding (AP_SAT, AP_RND)
+ ******************************************************************************/
+static inline int32_t sat32(int64_t v) {
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+static inline int16_t sat16(int64_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// acc_t += data_t * weight_t
+static inline int32_t mac_sat(int32_t acc, int16_t x, int16_t w) {
+    return sat32((int64_t)acc + (int32_t)x * w);
+}
+
+// Drop 'bits' fractional bits, round half towards +inf
+static inline int64_t round_shift(int64_t v, int bits) {
+    return (v + ((int64_t)1 << (bits - 1))) >> bits;
+}
+
+int16_t q88_from_float(float x) {
+    return sat16((int64_t)floorf(x * 256.0f + 0.5f));
+}
+
+float q88_to_float(int16_t x) {
+    return (float)x / 256.0f;
+}
+
+/*******************************************************************************
+ * Operand Packing
+ ******************************************************************************/
+
+// Zero-padded dense copy [in_ch][ph][pw] of a pitched map
+static int16_t* pad_input(const int16_t* in, int in_pitch, int in_ch, int in_h, int in_w,
+                          int pad, int ph, int pw) {
+    int16_t* p = (int16_t*)malloc((size_t)in_ch * ph * pw * sizeof(int16_t));
+    int c, y;
+
+    if (!p) return NULL;
+    memset(p, 0, (size_t)in_ch * ph * pw * sizeof(int16_t));
+    for (c = 0; c < in_ch; c++) {
+        for (y = 0; y < in_h; y++) {
+            memcpy(p + ((size_t)c * ph + y + pad) * pw + pad,
+                   in + ((size_t)c * in_h + y) * in_pitch, in_w * sizeof(int16_t));
+        }
+    }
+    return p;
+}
+
+// Tap sequence in reduction order (group, kh, kw, channel): input offsets into
+// the padded map, and the matching index into one [k][k][in_ch] filter
+static int build_taps(int in_ch, int k, int ph, int pw, int* in_off, int* w_idx) {
+    int g, kh, kw, c, n = 0;
+
+    for (g = 0; g < in_ch; g += Q88_GROUP) {
+        int g_end = (g + Q88_GROUP < in_ch) ? g + Q88_GROUP : in_ch;
+        for (kh = 0; kh < k; kh++) {
+            for (kw = 0; kw < k; kw++) {
+                for (c = g; c < g_end; c++) {
+                    in_off[n] = (c * ph + kh) * pw + kw;
+                    w_idx[n] = (kh * k + kw) * in_ch + c;
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+// [out_ch][k][k][in_ch] -> [oc/4][tap][4], zero-filled past out_ch
+static int16_t* pack_weights(const int16_t* w, const int* w_idx, int taps, int out_ch) {
+    int oc_blocks = ROUND_UP(out_ch, OC_BLOCK) / OC_BLOCK;
+    int16_t* p = (int16_t*)malloc((size_t)oc_blocks * taps * OC_BLOCK * sizeof(int16_t));
+    int ob, t, o;
+
+    if (!p) return NULL;
+    for (ob = 0; ob < oc_blocks; ob++) {
+        for (t = 0; t < taps; t++) {
+            int16_t* dst = p + ((size_t)ob * taps + t) * OC_BLOCK;
+            for (o = 0; o < OC_BLOCK; o++) {
+                int oc = ob * OC_BLOCK + o;
+                dst[o] = (oc < out_ch) ? w[(size_t)oc * taps + w_idx[t]] : 0;
+            }
+        }
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Micro-Kernel: 4 output channels x 8 output pixels, stride 1
+ * in:  padded input at the first output pixel
+ * wp:  packed weights of one OC block
+ * acc: result [OC_BLOCK][PX_BLOCK]
+ ******************************************************************************/
+static void kernel_4x8(const int16_t* in, const int16_t* wp, const int* in_off, int taps,
+                       int32_t acc[OC_BLOCK][PX_BLOCK]) {
+    int t;
+
+#if Q88_USE_NEON
+    int32x4_t c00 = vdupq_n_s32(0), c01 = vdupq_n_s32(0);
+    int32x4_t c10 = vdupq_n_s32(0), c11 = vdupq_n_s32(0);
+    int32x4_t c20 = vdupq_n_s32(0), c21 = vdupq_n_s32(0);
+    int32x4_t c30 = vdupq_n_s32(0), c31 = vdupq_n_s32(0);
+
+    for (t = 0; t < taps; t++) {
+        int16x8_t x = vld1q_s16(in + in_off[t]);
+        int16x4_t w = vld1_s16(wp);
+        int16x4_t xl = vget_low_s16(x);
+        int16x4_t xh = vget_high_s16(x);
+        wp += OC_BLOCK;
+
+        // Exact Q16.16 products (VMULL), saturating accumulate (VQADD) as acc_t
+        c00 = vqaddq_s32(c00, vmull_lane_s16(xl, w, 0));
+        c01 = vqaddq_s32(c01, vmull_lane_s16(xh, w, 0));
+        c10 = vqaddq_s32(c10, vmull_lane_s16(xl, w, 1));
+        c11 = vqaddq_s32(c11, vmull_lane_s16(xh, w, 1));
+        c20 = vqaddq_s32(c20, vmull_lane_s16(xl, w, 2));
+        c21 = vqaddq_s32(c21, vmull_lane_s16(xh, w, 2));
+        c30 = vqaddq_s32(c30, vmull_lane_s16(xl, w, 3));
+        c31 = vqaddq_s32(c31, vmull_lane_s16(xh, w, 3));
+    }
+
+    vst1q_s32(&acc[0][0], c00); vst1q_s32(&acc[0][4], c01);
+    vst1q_s32(&acc[1][0], c10); vst1q_s32(&acc[1][4], c11);
+    vst1q_s32(&acc[2][0], c20); vst1q_s32(&acc[2][4], c21);
+    vst1q_s32(&acc[3][0], c30); vst1q_s32(&acc[3][4], c31);
+#else
+    int o, x;
+
+    for (o = 0; o < OC_BLOCK; o++) {
+        for (x = 0; x < PX_BLOCK; x++) {
+            acc[o][x] = 0;
+        }
+    }
+    for (t = 0; t < taps; t++) {
+        const int16_t* r = in + in_off[t];
+        for (o = 0; o < OC_BLOCK; o++) {
+            for (x = 0; x < PX_BLOCK; x++) {
+                acc[o][x] = mac_sat(acc[o][x], r[x], wp[o]);
+            }
+        }
+        wp += OC_BLOCK;
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Strided fallback (no stride > 1 layer in the current network)
+ ******************************************************************************/
+static void conv_strided(const int16_t* pin, const int16_t* wpk, const int* in_off, int taps,
+                         int32_t* acc, int stride, int pw, int out_ch, int out_h, int out_w) {
+    int oc, oy, ox, t;
+
+    for (oc = 0; oc < out_ch; oc++) {
+        const int16_t* wblk = wpk + (size_t)(oc / OC_BLOCK) * taps * OC_BLOCK + oc % OC_BLOCK;
+        for (oy = 0; oy < out_h; oy++) {
+            for (ox = 0; ox < out_w; ox++) {
+                const int16_t* r = pin + (size_t)oy * stride * pw + ox * stride;
+                int32_t sum = 0;
+                for (t = 0; t < taps; t++) {
+                    sum = mac_sat(sum, r[in_off[t]], wblk[(size_t)t * OC_BLOCK]);
+                }
+                acc[((size_t)oc * out_h + oy) * out_w + ox] = sum;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Exact sums, one saturation (Winograd engine; scalar, int64 per output)
+ ******************************************************************************/
+static void conv_exact(const int16_t* pin, const int16_t* wpk, const int* in_off, int taps,
+                       int32_t* acc, int stride, int pw, int out_ch, int out_h, int out_w) {
+    int oc, oy, ox, t;
+
+    for (oc = 0; oc < out_ch; oc++) {
+        const int16_t* wblk = wpk + (size_t)(oc / OC_BLOCK) * taps * OC_BLOCK + oc % OC_BLOCK;
+        for (oy = 0; oy < out_h; oy++) {
+            for (ox = 0; ox < out_w; ox++) {
+                const int16_t* r = pin + (size_t)oy * stride * pw + ox * stride;
+                int64_t sum = 0;
+                for (t = 0; t < taps; t++) {
+                    sum += (int32_t)r[in_off[t]] * wblk[(size_t)t * OC_BLOCK];
+                }
+                acc[((size_t)oc * out_h + oy) * out_w + ox] = sat32(sum);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Convolution 2D
+ ******************************************************************************/
+static int conv_q88(
+    const int16_t* in, int in_pitch,
+    int32_t* acc,
+    const int16_t* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad,
+    int exact
+) {
+    int out_h = (in_h + 2*pad - kernel) / stride + 1;
+    int out_w = (in_w + 2*pad - kernel) / stride + 1;
+    int taps = in_ch * kernel * kernel;
+    int oc_blocks = ROUND_UP(out_ch, OC_BLOCK) / OC_BLOCK;
+    int ph = in_h + 2*pad;
+    int pw = in_w + 2*pad;
+    int *in_off, *w_idx;
+    int16_t *pin, *wpk;
+    int32_t blk[OC_BLOCK][PX_BLOCK];
+    int ob, oy, ox, o, x;
+
+    // Stride 1: widen rows so the last 8-pixel block never reads past them
+    if (stride == 1 && ROUND_UP(out_w, PX_BLOCK) + kernel - 1 > pw) {
+        pw = ROUND_UP(out_w, PX_BLOCK) + kernel - 1;
+    }
+
+    in_off = (int*)malloc(2 * (size_t)taps * sizeof(int));
+    if (!in_off) return -1;
+    w_idx = in_off + taps;
+    build_taps(in_ch, kernel, ph, pw, in_off, w_idx);
+
+    pin = pad_input(in, in_pitch, in_ch, in_h, in_w, pad, ph, pw);
+    wpk = pack_weights(weights, w_idx, taps, out_ch);
+    if (!pin || !wpk) {
+        free(pin);
+        free(wpk);
+        free(in_off);
+        return -1;
+    }
+
+    if (exact) {
+        conv_exact(pin, wpk, in_off, taps, acc, stride, pw, out_ch, out_h, out_w);
+    } else if (stride != 1) {
+        conv_strided(pin, wpk, in_off, taps, acc, stride, pw, out_ch, out_h, out_w);
+    } else {
+        // The k-row input strip of one output row stays in L1 while every OC
+        // block sweeps it (half the bytes of the float engine per pixel)
+        for (oy = 0; oy < out_h; oy++) {
+            for (ob = 0; ob < oc_blocks; ob++) {
+                const int16_t* wblk = wpk + (size_t)ob * taps * OC_BLOCK;
+                for (ox = 0; ox < out_w; ox += PX_BLOCK) {
+                    int n = (out_w - ox < PX_BLOCK) ? out_w - ox : PX_BLOCK;
+
+                    kernel_4x8(pin + (size_t)oy * pw + ox, wblk, in_off, taps, blk);
+
+                    for (o = 0; o < OC_BLOCK && ob * OC_BLOCK + o < out_ch; o++) {
+                        int32_t* dst = acc + ((size_t)(ob * OC_BLOCK + o) * out_h + oy) * out_w + ox;
+                        for (x = 0; x < n; x++) {
+                            dst[x] = blk[o][x];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(pin);
+    free(wpk);
+    free(in_off);
+    return 0;
+}
+
+int conv2d_q88(
+    const int16_t* in, int in_pitch,
+    int32_t* acc,
+    const int16_t* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+) {
+    return conv_q88(in, in_pitch, acc, weights, in_ch, in_h, in_w,
+                    out_ch, kernel, stride, pad, 0);
+}
+
+int conv2d_q88_exact(
+    const int16_t* in, int in_pitch,
+    int32_t* acc,
+    const int16_t* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+) {
+    return conv_q88(in, in_pitch, acc, weights, in_ch, in_h, in_w,
+                    out_ch, kernel, stride, pad, 1);
+}
+
+/*******************************************************************************
+ * BatchNorm + LeakyReLU
+ ******************************************************************************/
+void bn_leaky_q88(
+    const int32_t* acc,
+    int16_t* out, int out_pitch,
+    const int16_t* scale, const int16_t* shift,
+    int channels, int h, int w, int layer_type
+) {
+    int c, y, x;
+
+    for (c = 0; c < channels; c++) {
+        for (y = 0; y < h; y++) {
+            const int32_t* src = acc + ((size_t)c * h + y) * w;
+            int16_t* dst = out + ((size_t)c * h + y) * out_pitch;
+            for (x = 0; x < w; x++) {
+                int32_t bn;
+
+                if (layer_type == 2) {
+                    bn = src[x];
+                } else {
+                    // acc_t(acc * scale + shift): exact Q.24 sum, rounded to Q.16
+                    int64_t v = (int64_t)src[x] * scale[c] + ((int64_t)shift[c] << 16);
+                    bn = sat32(round_shift(v, 8));
+                    if (bn <= 0) {
+                        bn >>= 3;       // acc_t >> 3 drops bits (floor)
+                    }
+                }
+                dst[x] = sat16(round_shift(bn, 8));
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Max Pooling 2x2
+ ******************************************************************************/
+void maxpool2d_q88(
+    const int16_t* in, int in_pitch,
+    int16_t* out, int out_pitch,
+    int channels, int in_h, int in_w
+) {
+    int out_h = in_h / 2;
+    int out_w = in_w / 2;
+    int c, y, x;
+
+    for (c = 0; c < channels; c++) {
+        for (y = 0; y < out_h; y++) {
+            const int16_t* r0 = in + ((size_t)c * in_h + 2*y) * in_pitch;
+            const int16_t* r1 = r0 + in_pitch;
+            int16_t* dst = out + ((size_t)c * out_h + y) * out_pitch;
+            for (x = 0; x < out_w; x++) {
+                int16_t m = r0[2*x];
+                if (r0[2*x + 1] > m) m = r0[2*x + 1];
+                if (r1[2*x] > m) m = r1[2*x];
+                if (r1[2*x + 1] > m) m = r1[2*x + 1];
+                dst[x] = m;
+            }
+        }
+    }
+}
+
+#ifndef LAYERS_Q88_KERNELS_ONLY
+/*******************************************************************************
+ * Winograd Layers (must match winograd_supported() in cnn_accel.cpp)
+ * The PL runs ENGINE_WINOGRAD on these shapes only and falls back to the
+ * direct line-buffer engine on the others
+ ******************************************************************************/
+#define Q88_WINO_MAX_IC     64    // ENGINE_MAX_IC
+#define Q88_WINO_MIN_WIDTH  8     // ENGINE_MIN_WIDTH
+#define Q88_WINO_MAX_WIDTH  224   // WINO_MAX_WIDTH
+#define Q88_WINO_ROW_BANK   448   // ENGINE_ROW_BANK
+
+static int winograd_layer(const LayerConfig* c) {
+    int ic_groups = (c->in_channels + Q88_GROUP - 1) / Q88_GROUP;
+
+    return c->engine == ENGINE_WINOGRAD &&
+           c->kernel_size == 3 && c->stride == 1 && c->padding == 1 &&
+           c->in_channels <= Q88_WINO_MAX_IC &&
+           c->in_width >= Q88_WINO_MIN_WIDTH && c->in_width <= Q88_WINO_MAX_WIDTH &&
+           (c->in_height % 2 == 0 || c->in_width >= 2 * Q88_WINO_MIN_WIDTH) &&
+           ic_groups * FM_PITCH(c->in_width) <= Q88_WINO_ROW_BANK;
+}
+
+/*******************************************************************************
+ * One Accelerator Layer (DDR layout in and out)
+ ******************************************************************************/
+int q88_run_layer(
+    const LayerConfig* cfg,
+    const int16_t* in,
+    int16_t* out,
+    const int16_t* weights,
+    const int16_t* bn_scale,
+    const int16_t* bn_shift
+) {
+    int k = cfg->kernel_size;
+    int out_h = (cfg->in_height + 2*cfg->padding - k) / cfg->stride + 1;
+    int out_w = (cfg->in_width + 2*cfg->padding - k) / cfg->stride + 1;
+    size_t n = (size_t)cfg->out_channels * out_h * out_w;
+    int32_t* acc = (int32_t*)malloc(n * sizeof(int32_t));
+    int16_t* act = NULL;
+
+    if (!acc) return -1;
+    if (conv_q88(in, FM_PITCH(cfg->in_width), acc, weights,
+                 cfg->in_channels, cfg->in_height, cfg->in_width,
+                 cfg->out_channels, k, cfg->stride, cfg->padding, winograd_layer(cfg)) != 0) {
+        free(acc);
+        return -1;
+    }
+
+    if (cfg->layer_type == 1) {
+        // The PL pools after the activation
+        act = (int16_t*)malloc(n * sizeof(int16_t));
+        if (!act) {
+            free(acc);
+            return -1;
+        }
+        bn_leaky_q88(acc, act, out_w, bn_scale, bn_shift,
+                     cfg->out_channels, out_h, out_w, cfg->layer_type);
+        maxpool2d_q88(act, out_w, out, FM_PITCH(out_w / 2),
+                      cfg->out_channels, out_h, out_w);
+        free(act);
+    } else {
+        bn_leaky_q88(acc, out, FM_PITCH(out_w), bn_scale, bn_shift,
+                     cfg->out_channels, out_h, out_w, cfg->layer_type);
+    }
+
+    free(acc);
+    return 0;
+}
+#endif
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * Q8.8 Fixed-Point CNN Operators (ARM golden model of the PL accelerator)
+ *
+ * Same arithmetic as the HLS types in hw/hls/src/cnn_accel.h:
+ *   data_t/weight_t  int16 Q8.8   ap_fixed<16,8,AP_RND,AP_SAT>
+ *   acc_t            int32 Q16.16 ap_fixed<32,16,AP_RND,AP_SAT>
+ * Products are exact, every accumulate saturates, BN/activation round half
+ * up and saturate exactly like bn_leaky(). Weights use the accelerator's DDR
+ * layout [OC][KH][KW][IC] and feature maps its [C][H][FM_PITCH(W)] layout, so
+ * the packed weight blob and DDR buffers are consumed as-is.
+ *
+ * Input channels are reduced in groups of 8 (group, kh, kw, channel), the
+ * order of the PL's direct engines, so their saturated partial sums match as
+ * well. The Winograd engine sums exactly and saturates once, which differs
+ * whenever a partial sum saturates: q88_run_layer() models it with exact
+ * sums (conv2d_q88_exact) on the layers the PL runs it for.
+ *
+ * With -mfpu=neon the 3x3/1x1 stride-1 convolution uses VMULL.S16 + VQADD.S32.
+ ******************************************************************************/
+
+#ifndef LAYERS_Q88_H
+#define LAYERS_Q88_H
+
+#include <stdint.h>
+#ifndef LAYERS_Q88_KERNELS_ONLY
+#include "cnn_driver.h"             // LayerConfig (not needed by the HLS testbench)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define Q88_GROUP  8   // Input channels per reduction group (PARALLEL_IN_CH)
+
+/*******************************************************************************
+ * Conversions (data_t rounding and saturation)
+ ******************************************************************************/
+int16_t q88_from_float(float x);
+float   q88_to_float(int16_t x);
+
+/*******************************************************************************
+ * Convolution to Q16.16 accumulators
+ * in:  [in_ch][in_h][in_pitch] Q8.8
+ * acc: [out_ch][out_h][out_w] Q16.16 (dense)
+ * weights: [out_ch][k][k][in_ch] Q8.8
+ * @return 0 on success, -1 if scratch buffers could not be allocated
+ ******************************************************************************/
+int conv2d_q88(
+    const int16_t* in, int in_pitch,
+    int32_t* acc,
+    const int16_t* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+);
+
+/*******************************************************************************
+ * Convolution to Q16.16 accumulators, exact sums saturated once
+ * (ENGINE_WINOGRAD arithmetic; same layouts as conv2d_q88)
+ * @return 0 on success, -1 if scratch buffers could not be allocated
+ ******************************************************************************/
+int conv2d_q88_exact(
+    const int16_t* in, int in_pitch,
+    int32_t* acc,
+    const int16_t* weights,
+    int in_ch, int in_h, int in_w,
+    int out_ch, int kernel, int stride, int pad
+);
+
+/*******************************************************************************
+ * BatchNorm + LeakyReLU (bn_leaky): acc * scale + shift, then x or x >> 3
+ * layer_type 2 (output head): scale 1, shift 0, no activation
+ * out: [ch][h][out_pitch] Q8.8
+ ******************************************************************************/
+void bn_leaky_q88(
+    const int32_t* acc,
+    int16_t* out, int out_pitch,
+    const int16_t* scale, const int16_t* shift,
+    int channels, int h, int w, int layer_type
+);
+
+/*******************************************************************************
+ * Max Pooling 2x2 stride 2 (floor dimensions, like the fused store stage)
+ ******************************************************************************/
+void maxpool2d_q88(
+    const int16_t* in, int in_pitch,
+    int16_t* out, int out_pitch,
+    int channels, int in_h, int in_w
+);
+
+#ifndef LAYERS_Q88_KERNELS_ONLY
+/*******************************************************************************
+ * One accelerator layer in DDR layout: conv -> bn_leaky -> optional pool
+ * Pitches are FM_PITCH of the input and (pooled) output widths. cfg->engine
+ * selects the arithmetic: exact sums where the PL runs ENGINE_WINOGRAD,
+ * saturating group-order sums otherwise.
+ * @return 0 on success, -1 if scratch buffers could not be allocated
+ ******************************************************************************/
+int q88_run_layer(
+    const LayerConfig* cfg,
+    const int16_t* in,
+    int16_t* out,
+    const int16_t* weights,
+    const int16_t* bn_scale,
+    const int16_t* bn_shift
+);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAYERS_Q88_H
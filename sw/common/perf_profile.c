@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * Performance Profiling Implementation
+ ******************************************************************************/
+
+#include "perf_profile.h"
+#include "cnn_driver.h"
+#include "xil_io.h"
+#include "xtime_l.h"
+#include "xil_printf.h"
+
+#define GLOBAL_TMR_BASE  0xF8F00200U
+#define GLOBAL_TMR_CTRL  0x08
+
+/*******************************************************************************
+ * Timer
+ * XTime_GetTime() reads the upper and lower halves until the upper one is
+ * stable, so the 64-bit count is consistent across a low-word carry.
+ ******************************************************************************/
+void perf_init(void) {
+    uint32_t ctrl = Xil_In32(GLOBAL_TMR_BASE + GLOBAL_TMR_CTRL);
+    Xil_Out32(GLOBAL_TMR_BASE + GLOBAL_TMR_CTRL, ctrl | 1U);
+}
+
+uint64_t perf_now(void) {
+    XTime t;
+
+    XTime_GetTime(&t);
+    return t;
+}
+
+uint32_t perf_ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000ULL / COUNTS_PER_SECOND);
+}
+
+uint32_t perf_elapsed_us(uint64_t t0) {
+    return perf_ticks_to_us(perf_now() - t0);
+}
+
+/*******************************************************************************
+ * Layer Records
+ ******************************************************************************/
+static uint32_t idle_cycles(uint32_t total, uint32_t busy) {
+    return (busy < total) ? total - busy : 0;
+}
+
+static uint32_t percent(uint32_t part, uint32_t total) {
+    return total ? (uint32_t)((uint64_t)part * 100 / total) : 0;
+}
+
+void perf_capture(PerfLayer *rec) {
+    CnnJobStats st;
+
+    cnn_accel_get_stats(&st);
+    rec->setup_us = perf_ticks_to_us(st.setup_ticks);
+    rec->run_us = perf_ticks_to_us(st.run_ticks);
+    rec->cache_us = perf_ticks_to_us(st.cache_ticks);
+    rec->pl_cycles = (uint32_t)(st.run_ticks * PERF_PL_CLOCK_HZ / COUNTS_PER_SECOND);
+    rec->compute_cycles = st.compute_cycles;
+    rec->read_beats = st.read_beats;
+    rec->write_beats = st.write_beats;
+    rec->read_stall = idle_cycles(rec->pl_cycles, st.read_beats);
+    rec->write_stall = idle_cycles(rec->pl_cycles, st.write_beats);
+}
+
+int perf_bound(const PerfLayer *rec) {
+    uint32_t busiest = rec->compute_cycles;
+    int bound = PERF_BOUND_COMPUTE;
+
+    if (rec->read_beats > busiest) {
+        busiest = rec->read_beats;
+        bound = PERF_BOUND_READ;
+    }
+    if (rec->write_beats > busiest) {
+        busiest = rec->write_beats;
+        bound = PERF_BOUND_WRITE;
+    }
+    return (percent(busiest, rec->pl_cycles) < 50) ? PERF_BOUND_STALL : bound;
+}
+
+void perf_print_header(void) {
+    // xil_printf has no %%: the percent signs go in as characters
+    xil_printf("[PERF] layer   setup_us     run_us   cache_us  pl_cycles  compute%c  rd_stall  wr_stall  bound\r\n",
+               '%');
+}
+
+void perf_print_layer(int layer, const PerfLayer *rec) {
+    static const char *bounds[] = {"compute", "read", "write", "stall"};
+
+    xil_printf("[PERF] L%-4d %9u  %9u  %9u  %9u  %7u%c  %8u  %8u  %s\r\n", layer,
+               (unsigned)rec->setup_us, (unsigned)rec->run_us, (unsigned)rec->cache_us,
+               (unsigned)rec->pl_cycles, (unsigned)percent(rec->compute_cycles, rec->pl_cycles), '%',
+               (unsigned)rec->read_stall, (unsigned)rec->write_stall, bounds[perf_bound(rec)]);
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Performance Profiling
+ * 64-bit ARM global timer with microsecond results, and a per-layer record
+ * of one accelerator submission:
+ *   ARM side   register setup, start-to-done, cache maintenance (driver)
+ *   PL side    start-to-done in PL clock cycles, MAC array cycles and the
+ *              beats moved on the read and write ports (perf_* registers)
+ *
+ * The PL counts issue slots of its II=1 loops, so a port's stall cycles are
+ * the layer's cycles in which it did not move a beat. Whichever of compute,
+ * read and write is busiest bounds the layer; if none is busy for most of
+ * the layer it is bound by AXI latency and pipeline fill.
+ ******************************************************************************/
+
+#ifndef PERF_PROFILE_H
+#define PERF_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERF_PL_CLOCK_HZ    100000000ULL   // Accelerator clock (FCLK_CLK0)
+
+/* Microseconds as "12.345 ms" for xil_printf: PERF_MS_FMT with PERF_MS(us) */
+#define PERF_MS_FMT         "%d.%03d ms"
+#define PERF_MS(us)         (int)((us) / 1000), (int)((us) % 1000)
+
+/* What a layer's time goes to */
+#define PERF_BOUND_COMPUTE  0
+#define PERF_BOUND_READ     1
+#define PERF_BOUND_WRITE    2
+#define PERF_BOUND_STALL    3   // No unit busy for half the layer
+
+/*******************************************************************************
+ * 64-bit Timer (global timer, COUNTS_PER_SECOND: no wrap in practice)
+ ******************************************************************************/
+void perf_init(void);                       // Starts the global timer
+uint64_t perf_now(void);                     // Ticks
+uint32_t perf_ticks_to_us(uint64_t ticks);
+uint32_t perf_elapsed_us(uint64_t t0);      // perf_now() - t0 in microseconds
+
+/*******************************************************************************
+ * Layer Record
+ ******************************************************************************/
+typedef struct {
+    uint32_t setup_us;        // ARM: register writes
+    uint32_t run_us;          // ARM: ap_start to done
+    uint32_t cache_us;        // ARM: flush + invalidate
+    uint32_t pl_cycles;       // run_us in PL clock cycles
+    uint32_t compute_cycles;  // PL: MAC array busy
+    uint32_t read_stall;      // PL cycles without a read beat
+    uint32_t write_stall;     // PL cycles without a write beat
+    uint32_t read_beats;
+    uint32_t write_beats;
+} PerfLayer;
+
+/* Fill rec from the last completed submission (cnn_accel_get_stats) */
+void perf_capture(PerfLayer *rec);
+
+/* PERF_BOUND_* of one record */
+int perf_bound(const PerfLayer *rec);
+
+/* One table: perf_print_header(), a perf_print_layer() per record */
+void perf_print_header(void);
+void perf_print_layer(int layer, const PerfLayer *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERF_PROFILE_H
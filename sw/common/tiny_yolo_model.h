@@ -0,0 +1,22 @@
+/*******************************************************************************
+ * Tiny YOLO Model Configuration
+ * Network constants shared by every build. The weights themselves come from
+ * a blob (utils/pack_weights.py, SD card or JTAG) or, for the reference
+ * builds, from tiny_yolo_weights.h
+ ******************************************************************************/
+
+#ifndef TINY_YOLO_MODEL_H
+#define TINY_YOLO_MODEL_H
+
+#define INPUT_SIZE 224
+#define NUM_CLASSES 3
+#define NUM_ANCHORS 3
+
+/* Anchors scaled for 7x7 grid */
+static const float ANCHORS[NUM_ANCHORS * 2] = {
+    10.0f, 14.0f,
+    23.0f, 27.0f,
+    37.0f, 58.0f
+};
+
+#endif /* TINY_YOLO_MODEL_H */
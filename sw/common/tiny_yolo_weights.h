@@ -7,17 +7,7 @@
 #ifndef TINY_YOLO_WEIGHTS_H
 #define TINY_YOLO_WEIGHTS_H
 
-#define INPUT_SIZE 224
-#define NUM_CLASSES 3
-#define NUM_ANCHORS 3
-
-/* Anchors scaled for 7x7 grid */
-static const float ANCHORS[NUM_ANCHORS * 2] = {
-    10.0f, 14.0f,
-    23.0f, 27.0f,
-    37.0f, 58.0f
-};
-
+#include "tiny_yolo_model.h"
 
 /* Layer 0: Conv 3x16x3x3 */
 static const float CONV0_W[432] = {
@@ -0,0 +1,211 @@
+/*******************************************************************************
+ * Packed Weight Blob Loader Implementation
+ ******************************************************************************/
+
+#include "weight_loader.h"
+#include "cnn_driver.h"
+#include "xil_io.h"
+#include "xil_cache.h"
+#include <stdio.h>
+#include <string.h>
+#if WEIGHT_BLOB_USE_SD
+#include "ff.h"
+#endif
+
+// Region sizes implied by the DDR layout in cnn_driver.h
+#define WEIGHTS_REGION_BYTES  (DDR_BN_SCALE_ADDR - DDR_WEIGHTS_ADDR)
+#define BN_REGION_BYTES       (DDR_BN_SHIFT_ADDR - DDR_BN_SCALE_ADDR)
+
+static uint32_t payload_checksum(const uint8_t *p, uint32_t bytes) {
+    const uint32_t *w = (const uint32_t *)p;
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < bytes / 4; i++) {
+        sum += w[i];
+    }
+    return sum;
+}
+
+// Header and section layout, shared by the DDR and SD paths
+static int check_header(const WeightBlobHeader *hdr, uint32_t size) {
+    uint32_t end;
+
+    if (hdr->magic != WEIGHT_BLOB_MAGIC || hdr->version == 0 || hdr->version > WEIGHT_BLOB_VERSION) {
+        printf("[WGT] Bad blob header (magic=0x%08X version=%u)\n",
+               (unsigned)hdr->magic, (unsigned)hdr->version);
+        return -1;
+    }
+    if (hdr->dtype != WEIGHT_BLOB_DTYPE_Q88 && hdr->dtype != WEIGHT_BLOB_DTYPE_F32) {
+        printf("[WGT] Unknown dtype %u\n", (unsigned)hdr->dtype);
+        return -1;
+    }
+    if (hdr->num_layers == 0 || hdr->num_layers > WEIGHT_BLOB_MAX_LAYERS) {
+        printf("[WGT] Bad layer count %u\n", (unsigned)hdr->num_layers);
+        return -1;
+    }
+
+    // Sections are contiguous: weights, scale, shift; Q8.8 ones must fit the PL regions
+    end = hdr->weights_start + hdr->weights_size + 2 * hdr->bn_size;
+    if (hdr->scale_start != hdr->weights_start + hdr->weights_size ||
+        hdr->shift_start != hdr->scale_start + hdr->bn_size ||
+        (size != 0 && end > size) ||
+        (hdr->dtype == WEIGHT_BLOB_DTYPE_Q88 &&
+         (hdr->weights_size > WEIGHTS_REGION_BYTES || hdr->bn_size > BN_REGION_BYTES))) {
+        printf("[WGT] Bad section layout\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Per-layer addresses from wherever the three sections ended up
+static int fill_table(const WeightBlobHeader *hdr, uint32_t weights, uint32_t scale,
+                      uint32_t shift, WeightTable *table) {
+    const WeightBlobLayer *layers = (const WeightBlobLayer *)(hdr + 1);
+    uint32_t elem = (hdr->dtype == WEIGHT_BLOB_DTYPE_F32) ? 4 : 2;
+    uint32_t i;
+
+    table->num_layers = hdr->num_layers;
+    table->flags = hdr->flags;
+    table->dtype = hdr->dtype;
+    for (i = 0; i < hdr->num_layers; i++) {
+        const WeightBlobLayer *l = &layers[i];
+
+        if (l->weights_offset + l->weights_bytes > hdr->weights_size ||
+            l->bn_offset + l->bn_count * elem > hdr->bn_size ||
+            (l->weights_offset & 7) != 0) {
+            printf("[WGT] Bad entry for layer %u\n", (unsigned)i);
+            return -1;
+        }
+
+        table->layers[i].in_channels = l->in_channels;
+        table->layers[i].out_channels = l->out_channels;
+        table->layers[i].kernel_size = l->kernel_size;
+        table->layers[i].weights_addr = weights + l->weights_offset;
+        table->layers[i].bn_scale_addr = scale + l->bn_offset;
+        table->layers[i].bn_shift_addr = shift + l->bn_offset;
+    }
+
+    printf("[WGT] Loaded %u layers: %u weight bytes, %u BN bytes, %s%s\n",
+           (unsigned)hdr->num_layers, (unsigned)hdr->weights_size, (unsigned)hdr->bn_size,
+           (hdr->dtype == WEIGHT_BLOB_DTYPE_F32) ? "float32 in place" : "Q8.8",
+           (hdr->flags & WEIGHT_BLOB_BN_FOLDED) ? " (BN folded)" : "");
+    return 0;
+}
+
+int weight_blob_load(const void *blob, uint32_t size, WeightTable *table) {
+    const uint8_t *base = (const uint8_t *)blob;
+    const WeightBlobHeader *hdr = (const WeightBlobHeader *)blob;
+
+    if (check_header(hdr, size) != 0) {
+        return -1;
+    }
+    if (payload_checksum(base + hdr->weights_start, hdr->weights_size + 2 * hdr->bn_size) !=
+        hdr->checksum) {
+        printf("[WGT] Checksum mismatch\n");
+        return -1;
+    }
+
+    // Float32 is only read by the ARM: point straight into the blob
+    if (hdr->dtype == WEIGHT_BLOB_DTYPE_F32) {
+        return fill_table(hdr, (uint32_t)(UINTPTR)(base + hdr->weights_start),
+                          (uint32_t)(UINTPTR)(base + hdr->scale_start),
+                          (uint32_t)(UINTPTR)(base + hdr->shift_start), table);
+    }
+
+    // Copy to the regions the accelerator reads, then push them out of the cache
+    // (loaded once, so the driver's per-submission maintenance leaves them alone)
+    memcpy((void *)(UINTPTR)DDR_WEIGHTS_ADDR, base + hdr->weights_start, hdr->weights_size);
+    memcpy((void *)(UINTPTR)DDR_BN_SCALE_ADDR, base + hdr->scale_start, hdr->bn_size);
+    memcpy((void *)(UINTPTR)DDR_BN_SHIFT_ADDR, base + hdr->shift_start, hdr->bn_size);
+#if !CNN_ACCEL_USE_ACP
+    Xil_DCacheFlushRange(DDR_WEIGHTS_ADDR, hdr->weights_size);
+    Xil_DCacheFlushRange(DDR_BN_SCALE_ADDR, hdr->bn_size);
+    Xil_DCacheFlushRange(DDR_BN_SHIFT_ADDR, hdr->bn_size);
+#endif
+
+    return fill_table(hdr, DDR_WEIGHTS_ADDR, DDR_BN_SCALE_ADDR, DDR_BN_SHIFT_ADDR, table);
+}
+
+#if WEIGHT_BLOB_USE_SD
+/*******************************************************************************
+ * SD Card Path (FatFs)
+ ******************************************************************************/
+static FATFS sd_fs;
+static int sd_mounted = 0;
+
+static int sd_read(FIL *fil, uint32_t offset, uint32_t addr, uint32_t bytes) {
+    UINT got = 0;
+
+    if (f_lseek(fil, offset) != FR_OK ||
+        f_read(fil, (void *)(UINTPTR)addr, bytes, &got) != FR_OK || got != bytes) {
+        printf("[WGT] SD read failed at offset %u\n", (unsigned)offset);
+        return -1;
+    }
+    return 0;
+}
+
+int weight_blob_load_sd(const char *path, WeightTable *table) {
+    const WeightBlobHeader *hdr = (const WeightBlobHeader *)DDR_WEIGHT_BLOB_ADDR;
+    uint32_t head = sizeof(WeightBlobHeader) + WEIGHT_BLOB_MAX_LAYERS * sizeof(WeightBlobLayer);
+    uint32_t size, sum;
+    FIL fil;
+    int rc = -1;
+
+    if (!sd_mounted) {
+        if (f_mount(&sd_fs, "0:/", 1) != FR_OK) {
+            printf("[WGT] No SD card\n");
+            return -1;
+        }
+        sd_mounted = 1;
+    }
+    if (f_open(&fil, path, FA_READ) != FR_OK) {
+        printf("[WGT] %s not found\n", path);
+        return -1;
+    }
+    size = (uint32_t)f_size(&fil);
+
+    // Header and layer table first, to route the sections
+    if (sd_read(&fil, 0, DDR_WEIGHT_BLOB_ADDR, size < head ? size : head) != 0 ||
+        check_header(hdr, size) != 0) {
+        goto done;
+    }
+
+    if (hdr->dtype == WEIGHT_BLOB_DTYPE_F32) {
+        // Whole file to the staging area, used in place from there
+        if (size > DDR_WEIGHT_BLOB_BYTES) {
+            printf("[WGT] %s: %u bytes exceed the staging area\n", path, (unsigned)size);
+        } else if (sd_read(&fil, 0, DDR_WEIGHT_BLOB_ADDR, size) == 0) {
+            rc = weight_blob_load((const void *)DDR_WEIGHT_BLOB_ADDR, size, table);
+        }
+        goto done;
+    }
+
+    // Q8.8: each section straight into its PL region, no staging copy
+    if (sd_read(&fil, hdr->weights_start, DDR_WEIGHTS_ADDR, hdr->weights_size) != 0 ||
+        sd_read(&fil, hdr->scale_start, DDR_BN_SCALE_ADDR, hdr->bn_size) != 0 ||
+        sd_read(&fil, hdr->shift_start, DDR_BN_SHIFT_ADDR, hdr->bn_size) != 0) {
+        goto done;
+    }
+    sum = payload_checksum((const uint8_t *)(UINTPTR)DDR_WEIGHTS_ADDR, hdr->weights_size) +
+          payload_checksum((const uint8_t *)(UINTPTR)DDR_BN_SCALE_ADDR, hdr->bn_size) +
+          payload_checksum((const uint8_t *)(UINTPTR)DDR_BN_SHIFT_ADDR, hdr->bn_size);
+    if (sum != hdr->checksum) {
+        printf("[WGT] Checksum mismatch\n");
+        goto done;
+    }
+#if !CNN_ACCEL_USE_ACP
+    Xil_DCacheFlushRange(DDR_WEIGHTS_ADDR, hdr->weights_size);
+    Xil_DCacheFlushRange(DDR_BN_SCALE_ADDR, hdr->bn_size);
+    Xil_DCacheFlushRange(DDR_BN_SHIFT_ADDR, hdr->bn_size);
+#endif
+    rc = fill_table(hdr, DDR_WEIGHTS_ADDR, DDR_BN_SCALE_ADDR, DDR_BN_SHIFT_ADDR, table);
+
+done:
+    f_close(&fil);
+    if (rc == 0) {
+        printf("[WGT] Read %s from SD (%u bytes)\n", path, (unsigned)size);
+    }
+    return rc;
+}
+#endif
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Packed Weight Blob Loader
+ * Loads a blob written by utils/pack_weights.py, from DDR (staged over JTAG)
+ * or from the SD card, and returns a per-layer address table. Q8.8 blobs
+ * land in the accelerator's DDR weight and BatchNorm regions; float32 blobs
+ * stay where they were loaded and the ARM kernels read them in place.
+ *
+ * Blob layout (little-endian):
+ *   WeightBlobHeader (64 bytes)
+ *   WeightBlobLayer[num_layers] (32 bytes each)
+ *   weights section: per layer, 8-byte aligned
+ *     Q8.8:    [OC][KH][KW][IC] int16 (PL layout)
+ *     float32: [OC][IC][KH][KW] float, BN folded (conv2d / conv_neon layout)
+ *   scale section, shift section: [OC] per layer in the same dtype, 8-byte aligned
+ *     (the output head's shift is its conv bias, added on the ARM)
+ ******************************************************************************/
+
+#ifndef WEIGHT_LOADER_H
+#define WEIGHT_LOADER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEIGHT_BLOB_MAGIC       0x574E4E43  // "CNNW"
+#define WEIGHT_BLOB_VERSION     2           // 2 added dtype; version 1 blobs are Q8.8
+#define WEIGHT_BLOB_BN_FOLDED   (1 << 0)    // Scale folded into the weights (scale = 1.0)
+#define WEIGHT_BLOB_MAX_LAYERS  16
+
+#define WEIGHT_BLOB_DTYPE_Q88   0           // int16 Q8.8 for the PL and layers_q88.c
+#define WEIGHT_BLOB_DTYPE_F32   1           // float32 for the ARM float network
+
+// Staging address for the raw blob, e.g. XSCT: dow -data weights.bin 0x1D000000
+// Up to the CPU1 image at 0x1E000000 (a float32 blob of this network is ~6.3 MB)
+#define DDR_WEIGHT_BLOB_ADDR    0x1D000000
+#define DDR_WEIGHT_BLOB_BYTES   0x01000000
+
+// 1: weight_blob_load_sd() (needs the xilffs library in the BSP)
+#ifndef WEIGHT_BLOB_USE_SD
+#define WEIGHT_BLOB_USE_SD      1
+#endif
+
+// Default SD card files
+#define WEIGHT_BLOB_SD_Q88      "0:/weights.bin"
+#define WEIGHT_BLOB_SD_F32      "0:/weights_f32.bin"
+
+/*******************************************************************************
+ * On-Disk Format (must match utils/pack_weights.py)
+ ******************************************************************************/
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_layers;
+    uint32_t flags;          // WEIGHT_BLOB_*
+    uint32_t weights_start;  // Byte offsets from the blob start
+    uint32_t weights_size;
+    uint32_t scale_start;
+    uint32_t shift_start;
+    uint32_t bn_size;        // Bytes in each of the scale and shift sections
+    uint32_t checksum;       // Sum of the payload as 32-bit words
+    uint32_t dtype;          // WEIGHT_BLOB_DTYPE_* (0 in version 1 blobs)
+    uint32_t reserved[5];
+} WeightBlobHeader;
+
+typedef struct {
+    uint32_t in_channels;
+    uint32_t out_channels;
+    uint32_t kernel_size;
+    uint32_t weights_offset; // Bytes into the weights section
+    uint32_t weights_bytes;
+    uint32_t bn_offset;      // Bytes into the scale and shift sections
+    uint32_t bn_count;
+    uint32_t reserved;
+} WeightBlobLayer;
+
+/*******************************************************************************
+ * Loaded Layer Table (absolute DDR addresses for cnn_accel_run_layer et al.,
+ * or into the blob itself for float32)
+ ******************************************************************************/
+typedef struct {
+    int in_channels;
+    int out_channels;
+    int kernel_size;
+    uint32_t weights_addr;
+    uint32_t bn_scale_addr;
+    uint32_t bn_shift_addr;
+} WeightLayerAddr;
+
+typedef struct {
+    int num_layers;
+    uint32_t flags;
+    uint32_t dtype;          // WEIGHT_BLOB_DTYPE_*
+    WeightLayerAddr layers[WEIGHT_BLOB_MAX_LAYERS];
+} WeightTable;
+
+/*******************************************************************************
+ * Validate the blob and build its layer table. Q8.8 sections are copied to
+ * DDR_WEIGHTS_ADDR, DDR_BN_SCALE_ADDR and DDR_BN_SHIFT_ADDR (caches flushed);
+ * float32 sections are used in place, so the blob must stay loaded
+ * @param blob: Blob in memory (8-byte aligned)
+ * @param size: Blob size in bytes, 0 if unknown (staged with dow -data)
+ * @param table: Output per-layer addresses
+ * @return 0 on success, -1 on a malformed blob
+ ******************************************************************************/
+int weight_blob_load(const void *blob, uint32_t size, WeightTable *table);
+
+#if WEIGHT_BLOB_USE_SD
+/*******************************************************************************
+ * Read a blob from the SD card (FatFs, volume mounted on first use).
+ * Q8.8 sections are read straight into the accelerator's DDR regions, with
+ * only the header kept at DDR_WEIGHT_BLOB_ADDR; a float32 blob is read whole
+ * to DDR_WEIGHT_BLOB_ADDR and used in place
+ * @param path: File on the card, e.g. WEIGHT_BLOB_SD_Q88
+ * @param table: Output per-layer addresses
+ * @return 0 on success, -1 if the file is missing, unreadable or malformed
+ ******************************************************************************/
+int weight_blob_load_sd(const char *path, WeightTable *table);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEIGHT_LOADER_H
@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * Dual-Core Worker Pool Implementation
+ ******************************************************************************/
+
+#include "worker_pool.h"
+#include "conv_neon.h"
+#include "yolo_layers.h"
+#include "xil_io.h"
+#include "xtime_l.h"
+#include <stddef.h>
+
+#define MAILBOX  ((WorkerMailbox*)WORKER_MAILBOX_ADDR)
+
+#define CPU1_BOOT_TIMEOUT_MS  100
+
+/*******************************************************************************
+ * Barriers and Events
+ ******************************************************************************/
+#if defined(__arm__)
+static inline void wp_dmb(void) { __asm__ volatile("dmb" ::: "memory"); }
+static inline void wp_dsb(void) { __asm__ volatile("dsb" ::: "memory"); }
+static inline void wp_sev(void) { __asm__ volatile("sev"); }
+static inline void wp_wfe(void) { __asm__ volatile("wfe"); }
+#else
+static inline void wp_dmb(void) { __sync_synchronize(); }
+static inline void wp_dsb(void) { __sync_synchronize(); }
+static inline void wp_sev(void) { }
+static inline void wp_wfe(void) { }
+#endif
+
+static int cpu1_active = 0;
+
+/*******************************************************************************
+ * Operator Dispatch (compiled into both ELFs)
+ ******************************************************************************/
+int worker_run_op(const WorkArgs* a, int c0, int c1) {
+    int n = c1 - c0;
+    int hw = a->h * a->w;
+
+    if (n <= 0) return 0;
+
+    switch (a->op) {
+    case WORKER_OP_CONV2D: {
+        int kk = a->kernel * a->kernel;
+        int oh = (a->h + 2 * a->pad - a->kernel) / a->stride + 1;
+        int ow = (a->w + 2 * a->pad - a->kernel) / a->stride + 1;
+        float* out = a->out + (size_t)c0 * oh * ow;
+        const float* wt = a->p0 + (size_t)c0 * a->in_ch * kk;
+
+        if (conv2d_neon(a->in, out, wt, a->in_ch, a->h, a->w, n,
+                        a->kernel, a->stride, a->pad) != 0) {
+            conv2d(a->in, out, wt, a->in_ch, a->h, a->w, n,
+                   a->kernel, a->stride, a->pad);
+        }
+        break;
+    }
+    case WORKER_OP_CONV_FUSED: {
+        int kk = a->kernel * a->kernel;
+        int oh = (a->h + 2 * a->pad - a->kernel) / a->stride + 1;
+        int ow = (a->w + 2 * a->pad - a->kernel) / a->stride + 1;
+        int plane = (a->flags & CONV_FUSE_POOL) ? (oh / 2) * (ow / 2) : oh * ow;
+
+        // Packed blocks: c0 is a multiple of CONV_NEON_OC_BLOCK (see the split)
+        return conv2d_fused_packed(a->in, a->out + (size_t)c0 * plane,
+                                   a->p0 + (size_t)c0 * a->in_ch * kk, a->p1 ? a->p1 + c0 : NULL,
+                                   a->in_ch, a->h, a->w, n, a->kernel, a->stride, a->pad, a->flags);
+    }
+    case WORKER_OP_BN_LEAKY:
+        batchnorm_leaky(a->out + (size_t)c0 * hw, a->p0 + c0, a->p1 + c0,
+                        a->p2 + c0, a->p3 + c0, n, a->h, a->w);
+        break;
+    case WORKER_OP_MAXPOOL:
+        maxpool2d(a->in + (size_t)c0 * hw, a->out + (size_t)c0 * (a->h / 2) * (a->w / 2),
+                  n, a->h, a->w);
+        break;
+    case WORKER_OP_ADD_BIAS:
+        add_bias(a->out + (size_t)c0 * hw, a->p0 + c0, n, a->h, a->w, 0);
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * CPU0 Side
+ ******************************************************************************/
+int worker_pool_init(void) {
+    WorkerMailbox* mb = MAILBOX;
+    XTime t0, now;
+
+    mb->ready = 0;
+    mb->seq = 0;
+    mb->done = 0;
+    mb->status = 0;
+    wp_dsb();
+
+    // Boot ROM holds CPU1 in WFE until the start vector is written
+    Xil_Out32(CPU1_START_VECTOR, CPU1_APP_BASE);
+    wp_dsb();
+    wp_sev();
+
+    XTime_GetTime(&t0);
+    do {
+        if (mb->ready == WORKER_READY_MAGIC) {
+            cpu1_active = 1;
+            return 0;
+        }
+        XTime_GetTime(&now);
+    } while (now - t0 < (XTime)CPU1_BOOT_TIMEOUT_MS * (COUNTS_PER_SECOND / 1000));
+
+    cpu1_active = 0;
+    return -1;
+}
+
+int worker_pool_active(void) {
+    return cpu1_active;
+}
+
+int worker_parallel_channels(const WorkArgs* args) {
+    WorkerMailbox* mb = MAILBOX;
+    int n = args->out_ch;
+    int split, rc;
+    uint32_t seq;
+
+    // Packed conv weights can only be split on whole OC blocks
+    if (!cpu1_active || n < 2 ||
+        (args->op == WORKER_OP_CONV_FUSED && n < 2 * CONV_NEON_OC_BLOCK)) {
+        return worker_run_op(args, 0, n);
+    }
+
+    // Even halves, on the NEON kernel's 4-channel blocks where possible
+    split = (n >= 2 * CONV_NEON_OC_BLOCK) ?
+            ((n / 2 + CONV_NEON_OC_BLOCK - 1) & ~(CONV_NEON_OC_BLOCK - 1)) : n / 2;
+
+    mb->args = *args;
+    mb->ch_begin = split;
+    mb->ch_end = n;
+    seq = mb->seq + 1;
+    wp_dmb();
+    mb->seq = seq;
+    wp_dsb();
+    wp_sev();
+
+    rc = worker_run_op(args, 0, split);
+
+    while (mb->done != seq) {
+        wp_wfe();
+    }
+    wp_dmb();
+    return (rc != 0 || mb->status != 0) ? -1 : 0;
+}
+
+/*******************************************************************************
+ * CPU1 Side
+ ******************************************************************************/
+void worker_pool_serve(void) {
+    WorkerMailbox* mb = MAILBOX;
+    uint32_t seen = mb->seq;
+
+    mb->done = seen;
+    mb->status = 0;
+    wp_dmb();
+    mb->ready = WORKER_READY_MAGIC;
+    wp_dsb();
+    wp_sev();
+
+    for (;;) {
+        while (mb->seq == seen) {
+            wp_wfe();
+        }
+        seen = mb->seq;
+        wp_dmb();
+
+        mb->status = worker_run_op((const WorkArgs*)&mb->args, mb->ch_begin, mb->ch_end);
+
+        wp_dmb();
+        mb->done = seen;
+        wp_dsb();
+        wp_sev();
+    }
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Dual-Core Worker Pool (bare-metal AMP)
+ * CPU0 runs the application, CPU1 runs sw/cpu1_worker and serves jobs posted
+ * through a shared-memory mailbox with SEV/WFE wakeup
+ *
+ * Jobs are operator IDs plus arguments (the two cores run separate ELFs, so
+ * function pointers cannot be shared). worker_parallel_channels() gives CPU1
+ * the upper part of a channel range, runs the lower part on CPU0 and returns
+ * when both are done. Without a live CPU1 everything runs on CPU0.
+ * The operators are the float conv layers' (arm_only/main.c); pre- and
+ * post-processing stay on CPU0.
+ *
+ * Both BSPs must keep DDR shareable/cacheable with the SCU coherency (SMP)
+ * bit set, which the standalone BSP does by default.
+ ******************************************************************************/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+ * Memory Map (shared by the CPU0 and CPU1 builds)
+ ******************************************************************************/
+#define CPU1_START_VECTOR     0xFFFFFFF0  // Boot ROM: CPU1 jumps here after SEV
+#define CPU1_APP_BASE         0x1E000000  // CPU1 ELF (ps7_ddr_0 ORIGIN in sw/cpu1_worker/lscript.ld)
+#define WORKER_MAILBOX_ADDR   0x1F000000  // Shared mailbox, above both images
+
+#define WORKER_READY_MAGIC    0x43505531  // "CPU1"
+
+/*******************************************************************************
+ * Operators
+ * Adding a stage: new ID here, a case in worker_run_op(), rebuild both ELFs
+ ******************************************************************************/
+#define WORKER_OP_NONE        0
+#define WORKER_OP_CONV2D      1   // Output-channel range of conv2d_neon
+#define WORKER_OP_BN_LEAKY    2   // Channel range of batchnorm_leaky
+#define WORKER_OP_MAXPOOL     3   // Channel range of maxpool2d
+#define WORKER_OP_ADD_BIAS    4   // Channel range of add_bias
+#define WORKER_OP_CONV_FUSED  5   // Output-channel range of conv2d_fused_packed: in padded by
+                                  // conv_neon_pad_input, p0 from conv_neon_pack_weights
+
+typedef struct {
+    int op;
+    const float* in;
+    float* out;
+    const float* p0;         // Weights / gamma / bias
+    const float* p1;         // beta / fused bias
+    const float* p2;         // mean
+    const float* p3;         // var
+    int in_ch, h, w;         // Input shape
+    int out_ch;              // Full channel count of the operator
+    int kernel, stride, pad;
+    int flags;               // CONV_FUSE_* for WORKER_OP_CONV_FUSED
+} WorkArgs;
+
+typedef struct {
+    volatile uint32_t ready;      // WORKER_READY_MAGIC once CPU1 is serving
+    volatile uint32_t seq;        // Bumped by CPU0 per job
+    volatile uint32_t done;       // Set to seq by CPU1 when its part is finished
+    volatile int32_t  status;     // worker_run_op() result of CPU1's part
+    volatile int32_t  ch_begin;   // CPU1's channel range
+    volatile int32_t  ch_end;
+    WorkArgs args;
+} WorkerMailbox;
+
+/*******************************************************************************
+ * Functions
+ ******************************************************************************/
+
+// CPU0: release CPU1 and wait for it to report ready (0 on success)
+int worker_pool_init(void);
+
+// CPU0: 1 if CPU1 is serving jobs
+int worker_pool_active(void);
+
+// CPU0: run op over channels [0, args->out_ch) split across both cores
+// (0 on success, -1 if either core's part failed)
+int worker_parallel_channels(const WorkArgs* args);
+
+// Both: run op over channels [ch_begin, ch_end) (0 on success, -1 on failure)
+int worker_run_op(const WorkArgs* args, int ch_begin, int ch_end);
+
+// CPU1: serve the mailbox forever
+void worker_pool_serve(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WORKER_POOL_H
@@ -1,5 +1,6 @@
 /*******************************************************************************
  * Tiny YOLO Layers - CNN Operations for Bare-Metal ARM
+ * Header-only (static inline): included by main.c and worker_pool.c
  ******************************************************************************/
 
 #ifndef YOLO_LAYERS_H
@@ -65,7 +66,7 @@ static inline float sigmoid(float x) {
  * Output: out_data [out_ch][out_h][out_w]
  * Kernel: weights  [out_ch][in_ch][k][k]
  ******************************************************************************/
-void conv2d(
+static inline void conv2d(
     const float* in_data, 
     float* out_data,
     const float* weights,
@@ -109,7 +110,7 @@ void conv2d(
  * Batch Normalization + LeakyReLU (fused for efficiency)
  * out = leaky_relu(gamma * (in - mean) / sqrt(var + eps) + beta)
  ******************************************************************************/
-void batchnorm_leaky(
+static inline void batchnorm_leaky(
     float* data,
     const float* gamma,
     const float* beta,
@@ -131,10 +132,38 @@ void batchnorm_leaky(
     }
 }
 
+/*******************************************************************************
+ * Fold BatchNorm into conv weights + bias (once, at load time)
+ * conv(x, w') + b' == gamma * (conv(x, w) - mean) / sqrt(var + eps) + beta
+ * filter_size = in_ch * k * k
+ ******************************************************************************/
+static inline void fold_batchnorm(
+    const float* weights,
+    const float* gamma,
+    const float* beta,
+    const float* mean,
+    const float* var,
+    int out_ch, int filter_size,
+    float* w_out,
+    float* bias_out
+) {
+    int c, i;
+    float eps = 1e-5f;
+
+    for (c = 0; c < out_ch; c++) {
+        float scale = gamma[c] / fast_sqrtf(var[c] + eps);
+
+        for (i = 0; i < filter_size; i++) {
+            w_out[c * filter_size + i] = weights[c * filter_size + i] * scale;
+        }
+        bias_out[c] = beta[c] - mean[c] * scale;
+    }
+}
+
 /*******************************************************************************
  * Add bias + activation (for layers without BN)
  ******************************************************************************/
-void add_bias(
+static inline void add_bias(
     float* data,
     const float* bias,
     int channels, int h, int w,
@@ -153,7 +182,7 @@ void add_bias(
 /*******************************************************************************
  * Max Pooling 2x2 stride 2
  ******************************************************************************/
-void maxpool2d(
+static inline void maxpool2d(
     const float* in_data,
     float* out_data,
     int channels, int in_h, int in_w
@@ -189,155 +218,4 @@ void maxpool2d(
     }
 }
 
-/*******************************************************************************
- * Detection structure
- ******************************************************************************/
-typedef struct {
-    float x, y, w, h;
-    float confidence;
-    int class_id;
-} YoloDetection;
-
-/*******************************************************************************
- * Decode YOLO output to detections
- ******************************************************************************/
-int decode_yolo_output(
-    const float* output,
-    int grid_h, int grid_w,
-    int num_anchors, int num_classes,
-    const float* anchors,
-    int input_size,
-    float conf_thresh,
-    YoloDetection* detections,
-    int max_detections
-) {
-    int num_dets = 0;
-    int gh, gw, a, c;
-    
-    /* Output format: [anchors][5+classes][grid_h][grid_w] */
-    int stride = grid_h * grid_w;
-    
-    for (gh = 0; gh < grid_h; gh++) {
-        for (gw = 0; gw < grid_w; gw++) {
-            for (a = 0; a < num_anchors; a++) {
-                int base = a * (5 + num_classes) * stride + gh * grid_w + gw;
-                
-                /* Get box coordinates */
-                float tx = output[base + 0 * stride];
-                float ty = output[base + 1 * stride];
-                float tw = output[base + 2 * stride];
-                float th = output[base + 3 * stride];
-                
-                /* Skip if any raw value is NaN */
-                if (is_nan(tx) || is_nan(ty) || is_nan(tw) || is_nan(th)) continue;
-                
-                /* Clamp tw/th to prevent exp overflow */
-                if (tw > 10.0f) tw = 10.0f;
-                if (tw < -10.0f) tw = -10.0f;
-                if (th > 10.0f) th = 10.0f;
-                if (th < -10.0f) th = -10.0f;
-                
-                float obj_conf = sigmoid(output[base + 4 * stride]);
-                
-                if (obj_conf < conf_thresh) continue;
-                
-                /* Find best class */
-                int best_class = 0;
-                float best_prob = 0;
-                for (c = 0; c < num_classes; c++) {
-                    float prob = sigmoid(output[base + (5 + c) * stride]);
-                    if (prob > best_prob) {
-                        best_prob = prob;
-                        best_class = c;
-                    }
-                }
-                
-                float confidence = obj_conf * best_prob;
-                if (confidence < conf_thresh) continue;
-                if (is_nan(confidence)) continue;
-                
-                /* Decode box to image coordinates */
-                float box_x = (sigmoid(tx) + gw) / grid_w * input_size;
-                float box_y = (sigmoid(ty) + gh) / grid_h * input_size;
-                float box_w = fast_expf(tw) * anchors[a * 2];
-                float box_h = fast_expf(th) * anchors[a * 2 + 1];
-                
-                /* Skip invalid boxes */
-                if (is_nan(box_x) || is_nan(box_y) || is_nan(box_w) || is_nan(box_h)) continue;
-                if (box_w <= 0 || box_h <= 0 || box_w > input_size * 2 || box_h > input_size * 2) continue;
-                
-                /* Convert to corner format */
-                if (num_dets < max_detections) {
-                    detections[num_dets].x = box_x - box_w / 2;
-                    detections[num_dets].y = box_y - box_h / 2;
-                    detections[num_dets].w = box_w;
-                    detections[num_dets].h = box_h;
-                    detections[num_dets].confidence = confidence;
-                    detections[num_dets].class_id = best_class;
-                    num_dets++;
-                }
-            }
-        }
-    }
-    
-    return num_dets;
-}
-
-/*******************************************************************************
- * Non-Maximum Suppression
- ******************************************************************************/
-float iou(YoloDetection* a, YoloDetection* b) {
-    float x1 = (a->x > b->x) ? a->x : b->x;
-    float y1 = (a->y > b->y) ? a->y : b->y;
-    float x2 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
-    float y2 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
-    
-    float inter_w = (x2 - x1 > 0) ? x2 - x1 : 0;
-    float inter_h = (y2 - y1 > 0) ? y2 - y1 : 0;
-    float inter = inter_w * inter_h;
-    
-    float area_a = a->w * a->h;
-    float area_b = b->w * b->h;
-    
-    return inter / (area_a + area_b - inter + 1e-6f);
-}
-
-int nms(YoloDetection* dets, int num_dets, float nms_thresh) {
-    int i, j;
-    int keep[100];
-    int num_keep = 0;
-    
-    /* Simple bubble sort by confidence */
-    for (i = 0; i < num_dets - 1; i++) {
-        for (j = i + 1; j < num_dets; j++) {
-            if (dets[j].confidence > dets[i].confidence) {
-                YoloDetection tmp = dets[i];
-                dets[i] = dets[j];
-                dets[j] = tmp;
-            }
-        }
-    }
-    
-    /* NMS */
-    for (i = 0; i < num_dets; i++) {
-        int suppress = 0;
-        for (j = 0; j < num_keep; j++) {
-            if (iou(&dets[keep[j]], &dets[i]) > nms_thresh) {
-                suppress = 1;
-                break;
-            }
-        }
-        if (!suppress && num_keep < 100) {
-            keep[num_keep++] = i;
-        }
-    }
-    
-    /* Compact array */
-    for (i = 0; i < num_keep; i++) {
-        dets[i] = dets[keep[i]];
-    }
-    
-    return num_keep;
-}
-
 #endif /* YOLO_LAYERS_H */
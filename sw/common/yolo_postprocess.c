@@ -8,68 +8,54 @@
 #include <string.h>
 
 /*******************************************************************************
- * Custom fast exponential (no libm dependency)
+ * exp / sigmoid tables, exact for Q8.8 inputs
+ * exp(v / 256) = exp(floor) * exp(frac): 41 integer parts (|v| <= 20 like
+ * the old Taylor clamp) and 256 fractions, built once without libm.
  ******************************************************************************/
-static inline float fast_expf(float x) {
-    if (x > 20.0f) return 485165195.4f;
-    if (x < -20.0f) return 0.0f;
-    /* Taylor series approximation */
-    float result = 1.0f;
-    float term = 1.0f;
-    for (int i = 1; i <= 12; i++) {
-        term *= x / (float)i;
-        result += term;
-    }
-    return result;
-}
+#define EXP_INT_MAX  20
 
-/*******************************************************************************
- * YOLO Lite anchor boxes (width, height) relative to grid cell
- * These are typical values - adjust based on your trained model
- ******************************************************************************/
-const float YOLO_ANCHORS[YOLO_NUM_ANCHORS][2] = {
-    {1.08f, 1.19f},
-    {3.42f, 4.41f},
-    {6.63f, 11.38f},
-    {9.42f, 5.11f},
-    {16.62f, 10.52f}
-};
+static float exp_int_tab[2 * EXP_INT_MAX + 1];
+static float exp_frac_tab[1 << FIXED_SHIFT];
+static int exp_tabs_ready;
 
-/*******************************************************************************
- * Pascal VOC class names
- ******************************************************************************/
-const char *YOLO_CLASS_NAMES[YOLO_NUM_CLASSES] = {
-    "aeroplane", "bicycle", "bird", "boat", "bottle",
-    "bus", "car", "cat", "chair", "cow",
-    "diningtable", "dog", "horse", "motorbike", "person",
-    "pottedplant", "sheep", "sofa", "train", "tvmonitor"
-};
+static void build_exp_tables(void) {
+    double e = 1.0, term;
+    int i, k;
 
-/*******************************************************************************
- * Sigmoid function
- ******************************************************************************/
-static inline float sigmoid(float x) {
-    return 1.0f / (1.0f + fast_expf(-x));
-}
-
-/*******************************************************************************
- * Softmax for class probabilities
- ******************************************************************************/
-static void softmax(const float *input, float *output, int n) {
-    float max_val = input[0];
-    for (int i = 1; i < n; i++) {
-        if (input[i] > max_val) max_val = input[i];
+    // e^1 from the series, accurate to double precision
+    double e1 = 1.0;
+    term = 1.0;
+    for (k = 1; k <= 20; k++) {
+        term /= k;
+        e1 += term;
     }
-    
-    float sum = 0.0f;
-    for (int i = 0; i < n; i++) {
-        output[i] = fast_expf(input[i] - max_val);
-        sum += output[i];
+    for (i = 0; i <= EXP_INT_MAX; i++) {
+        exp_int_tab[EXP_INT_MAX + i] = (float)e;
+        exp_int_tab[EXP_INT_MAX - i] = (float)(1.0 / e);
+        e *= e1;
     }
-    
-    for (int i = 0; i < n; i++) {
-        output[i] /= sum;
+
+    // Fractions in [0, 1): the series converges in a few terms
+    for (i = 0; i < (1 << FIXED_SHIFT); i++) {
+        double x = (double)i / (1 << FIXED_SHIFT), sum = 1.0;
+        term = 1.0;
+        for (k = 1; k <= 16; k++) {
+            term *= x / k;
+            sum += term;
+        }
+        exp_frac_tab[i] = (float)sum;
     }
+    exp_tabs_ready = 1;
+}
+
+static inline float exp_q(int32_t v) {
+    if (v > (EXP_INT_MAX << FIXED_SHIFT)) v = EXP_INT_MAX << FIXED_SHIFT;
+    if (v < -(EXP_INT_MAX << FIXED_SHIFT)) return 0.0f;
+    return exp_int_tab[EXP_INT_MAX + (v >> FIXED_SHIFT)] * exp_frac_tab[v & ((1 << FIXED_SHIFT) - 1)];
+}
+
+static inline float sigmoid_q(int32_t v) {
+    return 1.0f / (1.0f + exp_q(-v));
 }
 
 /*******************************************************************************
@@ -106,151 +92,329 @@ static float calculate_iou(const Detection *a, const Detection *b) {
     return inter_area / union_area;
 }
 
+/*******************************************************************************
+ * Decoder setup
+ ******************************************************************************/
+static int32_t to_q88(float x) {
+    return (int32_t)(x * (1 << FIXED_SHIFT) + (x >= 0 ? 0.5f : -0.5f));
+}
+
+// Smallest Q8.8 logit whose table sigmoid reaches p (same rounding as decode)
+static int32_t logit_threshold(float p) {
+    int32_t lo = -(EXP_INT_MAX << FIXED_SHIFT), hi = EXP_INT_MAX << FIXED_SHIFT;
+
+    if (p <= 0.0f) return INT16_MIN;
+    if (sigmoid_q(hi) < p) return hi + 1;
+    while (lo < hi) {
+        int32_t mid = lo + (hi - lo) / 2;
+        if (sigmoid_q(mid) >= p) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+int yolo_decoder_init(YoloDecoder *dec, const YoloModelConfig *model, const float *bias,
+                      float conf_threshold, float nms_threshold) {
+    int channels = model->num_anchors * (5 + model->num_classes);
+    int32_t obj_logit;
+    int a, c;
+
+    if (model->num_anchors < 1 || model->num_anchors > YOLO_MAX_ANCHORS ||
+        model->num_classes < 1 || model->num_classes > YOLO_MAX_CLASSES) {
+        printf("[YOLO] Model exceeds decoder limits (%d anchors, %d classes)\n",
+               model->num_anchors, model->num_classes);
+        return -1;
+    }
+    if (!exp_tabs_ready) {
+        build_exp_tables();
+    }
+
+    memset(dec, 0, sizeof(*dec));
+    dec->model = *model;
+    dec->conf_threshold = conf_threshold;
+    dec->nms_threshold = nms_threshold;
+
+    for (c = 0; c < channels; c++) {
+        dec->bias_q[c] = bias ? to_q88(bias[c]) : 0;
+    }
+
+    // confidence = sigmoid(obj) * class_prob <= sigmoid(obj): below this
+    // logit no class can reach the threshold
+    obj_logit = logit_threshold(conf_threshold);
+    for (a = 0; a < model->num_anchors; a++) {
+        int obj_ch = a * (5 + model->num_classes) + 4;
+        float sw = (model->anchor_units == YOLO_ANCHORS_PIXELS) ? (float)model->input_w
+                                                                : (float)model->grid_w;
+        float sh = (model->anchor_units == YOLO_ANCHORS_PIXELS) ? (float)model->input_h
+                                                                : (float)model->grid_h;
+
+        dec->obj_min[a] = obj_logit - dec->bias_q[obj_ch];
+        dec->anchor_w[a] = model->anchors[2 * a] / sw;
+        dec->anchor_h[a] = model->anchors[2 * a + 1] / sh;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * Bounded candidate heap: min-heap on confidence, the weakest box is
+ * replaced once YOLO_MAX_CANDIDATES are held
+ ******************************************************************************/
+static void heap_sift_down(Detection *h, int n, int i) {
+    Detection t = h[i];
+
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && h[c + 1].confidence < h[c].confidence) c++;
+        if (h[c].confidence >= t.confidence) break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = t;
+}
+
+static void heap_push(DetectionResult *r, const Detection *d) {
+    Detection *h = r->detections;
+    int i;
+
+    if (r->count == YOLO_MAX_CANDIDATES) {
+        if (d->confidence <= h[0].confidence) return;
+        h[0] = *d;
+        heap_sift_down(h, r->count, 0);
+        return;
+    }
+
+    i = r->count++;
+    while (i > 0 && h[(i - 1) / 2].confidence > d->confidence) {
+        h[i] = h[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h[i] = *d;
+}
+
+// Heap sort in place: popping the minimum to the back leaves descending order
+static void heap_sort_desc(DetectionResult *r) {
+    Detection *h = r->detections;
+    int n;
+
+    for (n = r->count; n > 1; n--) {
+        Detection t = h[0];
+        h[0] = h[n - 1];
+        h[n - 1] = t;
+        heap_sift_down(h, n - 1, 0);
+    }
+}
+
 /*******************************************************************************
  * Decode YOLO output
  ******************************************************************************/
-void yolo_decode(const fixed16_t *output, DetectionResult *result, float conf_threshold) {
-    result->count = 0;
+void yolo_decode(const YoloDecoder *dec, const fixed16_t *output, int pitch,
+                 DetectionResult *result) {
+    const YoloModelConfig *m = &dec->model;
+    int plane = m->grid_h * pitch;
+    int anchor_stride = 5 + m->num_classes;  // tx, ty, tw, th, obj, classes
+    int32_t wh_max = 10 << FIXED_SHIFT;      // Box size clamp, as before
     
-    int grid_size = YOLO_GRID_H * YOLO_GRID_W;
-    int anchor_stride = 5 + YOLO_NUM_CLASSES;  // tx, ty, tw, th, obj, classes
+    result->count = 0;
     
-    for (int cy = 0; cy < YOLO_GRID_H; cy++) {
-        for (int cx = 0; cx < YOLO_GRID_W; cx++) {
-            for (int a = 0; a < YOLO_NUM_ANCHORS; a++) {
-                // Calculate base index for this anchor
+    for (int cy = 0; cy < m->grid_h; cy++) {
+        for (int cx = 0; cx < m->grid_w; cx++) {
+            const fixed16_t *cell = output + cy * pitch + cx;
+            
+            for (int a = 0; a < m->num_anchors; a++) {
                 int base_ch = a * anchor_stride;
-                int spatial_idx = cy * YOLO_GRID_W + cx;
+                const fixed16_t *p = cell + base_ch * plane;
+                const int32_t *bias = &dec->bias_q[base_ch];
                 
-                // Extract raw values (CHW format)
-                float tx = FIXED_TO_FLOAT(output[(base_ch + 0) * grid_size + spatial_idx]);
-                float ty = FIXED_TO_FLOAT(output[(base_ch + 1) * grid_size + spatial_idx]);
-                float tw = FIXED_TO_FLOAT(output[(base_ch + 2) * grid_size + spatial_idx]);
-                float th = FIXED_TO_FLOAT(output[(base_ch + 3) * grid_size + spatial_idx]);
-                float obj = FIXED_TO_FLOAT(output[(base_ch + 4) * grid_size + spatial_idx]);
+                // Logit-domain reject: the common case ends here
+                if (p[4 * plane] < dec->obj_min[a]) continue;
                 
-                // Apply sigmoid to objectness
-                float objectness = sigmoid(obj);
+                float objectness = sigmoid_q(p[4 * plane] + bias[4]);
                 
-                // Skip low confidence
-                if (objectness < conf_threshold) continue;
-                
-                // Extract class probabilities
-                float class_probs_raw[YOLO_NUM_CLASSES];
-                float class_probs[YOLO_NUM_CLASSES];
-                for (int c = 0; c < YOLO_NUM_CLASSES; c++) {
-                    class_probs_raw[c] = FIXED_TO_FLOAT(output[(base_ch + 5 + c) * grid_size + spatial_idx]);
-                }
-                softmax(class_probs_raw, class_probs, YOLO_NUM_CLASSES);
-                
-                // Find best class
+                // Best class by logit (both activations are monotonic)
                 int best_class = 0;
-                float best_prob = class_probs[0];
-                for (int c = 1; c < YOLO_NUM_CLASSES; c++) {
-                    if (class_probs[c] > best_prob) {
-                        best_prob = class_probs[c];
+                int32_t best = p[5 * plane] + bias[5];
+                for (int c = 1; c < m->num_classes; c++) {
+                    int32_t v = p[(5 + c) * plane] + bias[5 + c];
+                    if (v > best) {
+                        best = v;
                         best_class = c;
                     }
                 }
                 
+                float best_prob;
+                if (m->class_activation == YOLO_CLASS_SOFTMAX) {
+                    float sum = 0.0f;
+                    for (int c = 0; c < m->num_classes; c++) {
+                        sum += exp_q(p[(5 + c) * plane] + bias[5 + c] - best);
+                    }
+                    best_prob = 1.0f / sum;
+                } else {
+                    best_prob = sigmoid_q(best);
+                }
+                
                 // Final confidence = objectness * class_prob
                 float confidence = objectness * best_prob;
-                if (confidence < conf_threshold) continue;
+                if (confidence < dec->conf_threshold) continue;
                 
-                // Decode bounding box
-                // x, y relative to image (0-1)
-                float bx = (sigmoid(tx) + cx) / YOLO_GRID_W;
-                float by = (sigmoid(ty) + cy) / YOLO_GRID_H;
-                float bw = (fast_expf(tw) * YOLO_ANCHORS[a][0]) / YOLO_GRID_W;
-                float bh = (fast_expf(th) * YOLO_ANCHORS[a][1]) / YOLO_GRID_H;
+                int32_t tw = p[2 * plane] + bias[2];
+                int32_t th = p[3 * plane] + bias[3];
+                if (tw > wh_max) tw = wh_max;
+                if (tw < -wh_max) tw = -wh_max;
+                if (th > wh_max) th = wh_max;
+                if (th < -wh_max) th = -wh_max;
                 
-                // Add detection
-                if (result->count < MAX_DETECTIONS) {
-                    Detection *det = &result->detections[result->count];
-                    det->x = bx;
-                    det->y = by;
-                    det->w = bw;
-                    det->h = bh;
-                    det->confidence = confidence;
-                    det->class_id = best_class;
-                    det->class_prob = best_prob;
-                    result->count++;
-                }
+                // Decode bounding box, x, y relative to image (0-1)
+                Detection det;
+                det.x = (sigmoid_q(p[0] + bias[0]) + cx) / m->grid_w;
+                det.y = (sigmoid_q(p[plane] + bias[1]) + cy) / m->grid_h;
+                det.w = exp_q(tw) * dec->anchor_w[a];
+                det.h = exp_q(th) * dec->anchor_h[a];
+                det.confidence = confidence;
+                det.class_id = best_class;
+                det.class_prob = best_prob;
+                
+                // Skip degenerate boxes
+                if (det.w <= 0 || det.h <= 0 || det.w > 2.0f || det.h > 2.0f) continue;
+                
+                heap_push(result, &det);
             }
         }
     }
+    
+    heap_sort_desc(result);
 }
 
 /*******************************************************************************
- * Non-Maximum Suppression
+ * PL head decode: parameter block and candidate list
  ******************************************************************************/
-void yolo_nms(DetectionResult *result, float nms_threshold) {
-    // Sort by confidence (simple bubble sort for small arrays)
-    for (int i = 0; i < result->count - 1; i++) {
-        for (int j = i + 1; j < result->count; j++) {
-            if (result->detections[j].confidence > result->detections[i].confidence) {
-                Detection temp = result->detections[i];
-                result->detections[i] = result->detections[j];
-                result->detections[j] = temp;
-            }
-        }
+int yolo_decoder_hw_params(const YoloDecoder *dec, int32_t *params, int max_candidates) {
+    const YoloModelConfig *m = &dec->model;
+    int a;
+
+    if (m->class_activation != YOLO_CLASS_SIGMOID ||
+        m->grid_w > YOLO_HW_MAX_GRID || m->grid_h > YOLO_HW_MAX_GRID ||
+        max_candidates < 1 || max_candidates > YOLO_MAX_CANDIDATES) {
+        return -1;
     }
+
+    memset(params, 0, YOLO_HW_PARAM_WORDS * sizeof(int32_t));
+    params[YOLO_HW_NUM_ANCHORS] = m->num_anchors;
+    params[YOLO_HW_NUM_CLASSES] = m->num_classes;
+    params[YOLO_HW_MAX_CANDS] = max_candidates;
+    for (a = 0; a < m->num_anchors; a++) {
+        int32_t *p = &params[YOLO_HW_ANCHOR_BASE + YOLO_HW_ANCHOR_WORDS * a];
+
+        // Same raw threshold as yolo_decode; anchors in grid cells, Q16.16
+        p[0] = dec->obj_min[a];
+        p[1] = (int32_t)(dec->anchor_w[a] * m->grid_w * 65536.0f + 0.5f);
+        p[2] = (int32_t)(dec->anchor_h[a] * m->grid_h * 65536.0f + 0.5f);
+    }
+    return 0;
+}
+
+void yolo_decode_candidates(const YoloDecoder *dec, const YoloHwCandidate *cands, int count,
+                            int max_candidates, DetectionResult *result) {
+    const YoloModelConfig *m = &dec->model;
+    float cell = 1.0f / (1 << FIXED_SHIFT);
+
+    if (count > max_candidates) {
+        printf("[YOLO] %d anchors passed, decoding the first %d\n", count, max_candidates);
+        count = max_candidates;
+    }
+
+    result->count = 0;
+    for (int i = 0; i < count; i++) {
+        const YoloHwCandidate *c = &cands[i];
+        float best_prob = sigmoid_q(c->class_logit);
+        float confidence = sigmoid_q(c->obj_logit) * best_prob;
+        if (confidence < dec->conf_threshold) continue;
+
+        // Boxes come in grid cells: relative to the image (0-1)
+        Detection det;
+        det.x = c->bx * cell / m->grid_w;
+        det.y = c->by * cell / m->grid_h;
+        det.w = (uint16_t)c->bw * cell / m->grid_w;
+        det.h = (uint16_t)c->bh * cell / m->grid_h;
+        det.confidence = confidence;
+        det.class_id = c->class_id;
+        det.class_prob = best_prob;
+
+        // Skip degenerate boxes
+        if (det.w <= 0 || det.h <= 0 || det.w > 2.0f || det.h > 2.0f) continue;
+
+        heap_push(result, &det);
+    }
+
+    heap_sort_desc(result);
+}
+
+/*******************************************************************************
+ * Non-Maximum Suppression
+ * Candidates are already sorted: keep each box unless a kept box of the
+ * same class overlaps it, stop at MAX_DETECTIONS
+ ******************************************************************************/
+void yolo_nms(const YoloDecoder *dec, DetectionResult *result) {
+    int kept = 0;
     
-    // Mark suppressed detections
-    int keep[MAX_DETECTIONS] = {0};
-    memset(keep, 1, result->count * sizeof(int));
-    
-    for (int i = 0; i < result->count; i++) {
-        if (!keep[i]) continue;
+    for (int i = 0; i < result->count && kept < MAX_DETECTIONS; i++) {
+        const Detection *d = &result->detections[i];
+        int suppress = 0;
         
-        for (int j = i + 1; j < result->count; j++) {
-            if (!keep[j]) continue;
-            
+        for (int j = 0; j < kept; j++) {
             // Only suppress same-class detections
-            if (result->detections[i].class_id != result->detections[j].class_id) continue;
-            
-            float iou = calculate_iou(&result->detections[i], &result->detections[j]);
-            if (iou > nms_threshold) {
-                keep[j] = 0;  // Suppress
+            if (result->detections[j].class_id != d->class_id) continue;
+            if (calculate_iou(&result->detections[j], d) > dec->nms_threshold) {
+                suppress = 1;
+                break;
             }
         }
-    }
-    
-    // Compact array
-    int new_count = 0;
-    for (int i = 0; i < result->count; i++) {
-        if (keep[i]) {
-            if (new_count != i) {
-                result->detections[new_count] = result->detections[i];
+        
+        if (!suppress) {
+            if (kept != i) {
+                result->detections[kept] = *d;
             }
-            new_count++;
+            kept++;
         }
     }
-    result->count = new_count;
+    result->count = kept;
 }
 
 /*******************************************************************************
  * Full post-processing pipeline
  ******************************************************************************/
-void yolo_postprocess(const fixed16_t *output, DetectionResult *result) {
+void yolo_postprocess(const YoloDecoder *dec, const fixed16_t *output, int pitch,
+                      DetectionResult *result) {
     // Decode YOLO output
-    yolo_decode(output, result, CONFIDENCE_THRESHOLD);
+    yolo_decode(dec, output, pitch, result);
     
     // Apply NMS
-    yolo_nms(result, NMS_THRESHOLD);
+    yolo_nms(dec, result);
+}
+
+void yolo_postprocess_candidates(const YoloDecoder *dec, const YoloHwCandidate *cands, int count,
+                                 int max_candidates, DetectionResult *result) {
+    yolo_decode_candidates(dec, cands, count, max_candidates, result);
+    yolo_nms(dec, result);
 }
 
 /*******************************************************************************
  * Print detections (for debugging)
  ******************************************************************************/
-void yolo_print_detections(const DetectionResult *result) {
+void yolo_print_detections(const YoloDecoder *dec, const DetectionResult *result) {
     printf("\n=== Detection Results (%d objects) ===\n", result->count);
     
     for (int i = 0; i < result->count; i++) {
         const Detection *det = &result->detections[i];
-        printf("[%d] %s: %.1f%% @ (%.3f, %.3f, %.3f, %.3f)\n",
-               i,
-               YOLO_CLASS_NAMES[det->class_id],
+        if (dec->model.class_names) {
+            printf("[%d] %s: ", i, dec->model.class_names[det->class_id]);
+        } else {
+            printf("[%d] class %d: ", i, det->class_id);
+        }
+        printf("%.1f%% @ (%.3f, %.3f, %.3f, %.3f)\n",
                det->confidence * 100,
                det->x, det->y, det->w, det->h);
     }
@@ -1,12 +1,19 @@
 /*******************************************************************************
  * YOLO Post-Processing for CNN Accelerator
  * Runs on ARM Cortex-A9
- * 
+ *
  * Functions:
  * - Decode YOLO output grid to bounding boxes
  * - Apply confidence threshold
  * - Non-Maximum Suppression (NMS)
  * - Output detection results
+ *
+ * The decoder is built from the model config (grid, anchors, classes) and
+ * reads the raw Q8.8 head map as the PL writes it. Objectness is compared
+ * against a precomputed raw logit per anchor before any transcendental, so
+ * a rejected cell costs one integer compare. exp/sigmoid come from tables
+ * that are exact for Q8.8 inputs; candidates go to a bounded heap and are
+ * sorted once before per-class greedy NMS.
  ******************************************************************************/
 
 #ifndef YOLO_POSTPROCESS_H
@@ -18,25 +25,80 @@
 extern "C" {
 #endif
 
-// YOLO Lite output dimensions
-#define YOLO_GRID_H      7
-#define YOLO_GRID_W      7
-#define YOLO_NUM_ANCHORS 5
-#define YOLO_NUM_CLASSES 20  // Pascal VOC classes
-
-// Output channels: 5 * (5 + 20) = 125
-// Per anchor: tx, ty, tw, th, objectness, class_probs[20]
-#define YOLO_OUTPUT_CHANNELS 125
+// Decoder limits (per-channel tables are sized from these)
+#define YOLO_MAX_ANCHORS     9
+#define YOLO_MAX_CLASSES     80
+#define YOLO_MAX_CHANNELS    (YOLO_MAX_ANCHORS * (5 + YOLO_MAX_CLASSES))
+#define YOLO_MAX_CANDIDATES  256  // Best boxes kept before NMS (bounded heap)
 
 // Detection thresholds
 #define CONFIDENCE_THRESHOLD 0.3f
 #define NMS_THRESHOLD        0.45f
 #define MAX_DETECTIONS       100
 
-// Fixed-point format (same as HLS)
+// Class score activation
+#define YOLO_CLASS_SIGMOID   0    // Independent class scores
+#define YOLO_CLASS_SOFTMAX   1    // Softmax over classes
+
+// Anchor units
+#define YOLO_ANCHORS_GRID    0    // Anchor sizes in grid cells
+#define YOLO_ANCHORS_PIXELS  1    // Anchor sizes in input pixels
+
+// Fixed-point format (same as HLS, also declared by image_preprocess.h)
+#ifndef FIXED_SHIFT
 typedef int16_t fixed16_t;
 #define FIXED_SHIFT 8
 #define FIXED_TO_FLOAT(x) ((float)(x) / (1 << FIXED_SHIFT))
+#endif
+
+// Model description: output is [num_anchors * (5 + num_classes)][grid_h][pitch]
+// Per anchor: tx, ty, tw, th, objectness, class scores
+typedef struct {
+    int grid_h, grid_w;
+    int num_anchors, num_classes;
+    const float *anchors;             // [num_anchors][2]: w, h
+    int anchor_units;                 // YOLO_ANCHORS_*
+    int input_w, input_h;
+    int class_activation;             // YOLO_CLASS_*
+    const char *const *class_names;   // NULL: print class ids
+} YoloModelConfig;
+
+// Decoder built from a model config by yolo_decoder_init()
+typedef struct {
+    YoloModelConfig model;
+    float anchor_w[YOLO_MAX_ANCHORS];     // Relative to the image
+    float anchor_h[YOLO_MAX_ANCHORS];
+    int32_t obj_min[YOLO_MAX_ANCHORS];    // Raw Q8.8 objectness at the threshold
+    int32_t bias_q[YOLO_MAX_CHANNELS];    // Head bias in Q8.8 (PL applies none)
+    float conf_threshold;
+    float nms_threshold;
+} YoloDecoder;
+
+/*******************************************************************************
+ * PL Head Decode Layout (must match DECODE_* in hw/hls/src/cnn_accel.h)
+ * The accelerator can threshold the head itself and hand back only the
+ * anchors whose objectness passes obj_min, box already decoded; the ARM
+ * finishes the confidence and runs NMS over that list. Sigmoid class
+ * scores only (no softmax on the PL).
+ ******************************************************************************/
+#define YOLO_HW_NUM_ANCHORS   0     // Parameter block word indices
+#define YOLO_HW_NUM_CLASSES   1
+#define YOLO_HW_MAX_CANDS     2
+#define YOLO_HW_ANCHOR_BASE   4     // Then per anchor: obj_min, anchor w, h, 0
+#define YOLO_HW_ANCHOR_WORDS  4
+#define YOLO_HW_PARAM_WORDS   (YOLO_HW_ANCHOR_BASE + YOLO_HW_ANCHOR_WORDS * YOLO_MAX_ANCHORS)
+#define YOLO_HW_MAX_GRID      19    // MAX_INPUT_SIZE / 32
+
+// One candidate (two 64-bit words), little-endian
+typedef struct {
+    int16_t bx, by;                   // Box centre in grid cells, Q8.8
+    int16_t bw, bh;                   // Box size in grid cells, Q8.8 (unsigned)
+    uint8_t cx, cy;                   // Cell
+    uint8_t anchor_image;             // [3:0] anchor, [7:4] batch image
+    uint8_t class_id;                 // Best class by logit
+    int16_t obj_logit;                // Objectness logit, bias included
+    int16_t class_logit;              // Best class logit, bias included
+} YoloHwCandidate;
 
 // Bounding box structure
 typedef struct {
@@ -49,47 +111,64 @@ typedef struct {
     float class_prob;
 } Detection;
 
-// Detection results
+// Detection results (candidates after decode, at most MAX_DETECTIONS after NMS)
 typedef struct {
-    Detection detections[MAX_DETECTIONS];
+    Detection detections[YOLO_MAX_CANDIDATES];
     int count;
 } DetectionResult;
 
-// Anchor box sizes (pre-defined for YOLO Lite)
-extern const float YOLO_ANCHORS[YOLO_NUM_ANCHORS][2];
-
-// Class names (Pascal VOC)
-extern const char *YOLO_CLASS_NAMES[YOLO_NUM_CLASSES];
+/*******************************************************************************
+ * Build a decoder
+ * @param bias: Per-channel head bias added to the raw map (NULL: none)
+ * @return 0 on success, -1 if the model exceeds the YOLO_MAX_* limits
+ ******************************************************************************/
+int yolo_decoder_init(YoloDecoder *dec, const YoloModelConfig *model, const float *bias,
+                      float conf_threshold, float nms_threshold);
 
 /*******************************************************************************
  * Decode YOLO output to bounding boxes
- * @param output: Raw CNN output (fixed-point, CHW format)
- *                Size: 125 x 7 x 7 = 6125 elements
- * @param result: Output detection results
- * @param conf_threshold: Confidence threshold (e.g., 0.3)
+ * @param output: Raw CNN output (Q8.8, [C][grid_h][pitch])
+ * @param pitch: Row pitch in elements (FM_PITCH(grid_w) for the PL map)
+ * @param result: Candidates above the threshold, best YOLO_MAX_CANDIDATES
+ *                sorted by confidence (highest first)
  ******************************************************************************/
-void yolo_decode(const fixed16_t *output, DetectionResult *result, float conf_threshold);
+void yolo_decode(const YoloDecoder *dec, const fixed16_t *output, int pitch,
+                 DetectionResult *result);
 
 /*******************************************************************************
- * Apply Non-Maximum Suppression
- * @param result: Detection results (modified in place)
- * @param nms_threshold: IoU threshold for suppression (e.g., 0.45)
+ * Apply Non-Maximum Suppression (per class, greedy over sorted candidates)
+ * @param result: Detection results from yolo_decode (modified in place)
  ******************************************************************************/
-void yolo_nms(DetectionResult *result, float nms_threshold);
+void yolo_nms(const YoloDecoder *dec, DetectionResult *result);
 
 /*******************************************************************************
  * Full post-processing pipeline
  * Decode + NMS
- * @param output: Raw CNN output
- * @param result: Output detection results
  ******************************************************************************/
-void yolo_postprocess(const fixed16_t *output, DetectionResult *result);
+void yolo_postprocess(const YoloDecoder *dec, const fixed16_t *output, int pitch,
+                      DetectionResult *result);
+
+/*******************************************************************************
+ * PL head decode
+ * yolo_decoder_hw_params() fills the YOLO_HW_PARAM_WORDS block the
+ * accelerator reads (0, or -1 if the model needs softmax or exceeds the
+ * PL limits). yolo_decode_candidates() turns the list it wrote into the
+ * same sorted candidates as yolo_decode(); count is the accelerator's,
+ * which may exceed the list when more anchors passed.
+ ******************************************************************************/
+int yolo_decoder_hw_params(const YoloDecoder *dec, int32_t *params, int max_candidates);
+
+void yolo_decode_candidates(const YoloDecoder *dec, const YoloHwCandidate *cands, int count,
+                            int max_candidates, DetectionResult *result);
+
+// Candidate decode + NMS
+void yolo_postprocess_candidates(const YoloDecoder *dec, const YoloHwCandidate *cands, int count,
+                                 int max_candidates, DetectionResult *result);
 
 /*******************************************************************************
  * Print detection results (for debugging)
- * @param result: Detection results
  ******************************************************************************/
-void yolo_print_detections(const DetectionResult *result);
+void yolo_print_detections(const YoloDecoder *dec, const DetectionResult *result);
 
 /*******************************************************************************
  * Convert detection to screen coordinates
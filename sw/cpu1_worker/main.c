@@ -0,0 +1,13 @@
+/*******************************************************************************
+ * CPU1 Worker: serves channel-range jobs posted by CPU0
+ * Build as a second standalone application for ps7_cortexa9_1 with the
+ * lscript.ld next to this file (ps7_ddr_0 at CPU1_APP_BASE, 16 MB up to the
+ * mailbox), -DUSE_AMP=1 and the sw/common sources (shared operator dispatch)
+ ******************************************************************************/
+
+#include "worker_pool.h"
+
+int main(void) {
+    worker_pool_serve();
+    return 0;
+}
@@ -8,83 +8,125 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
 #include "xil_printf.h"
-#include "xil_cache.h"
 #include "xil_io.h"
+#include "xil_exception.h"
+#include "xparameters.h"
+#include "xscugic.h"
 
 #include "cnn_driver.h"
+#include "camera_ingest.h"
+#include "weight_loader.h"
+#include "buffer_plan.h"
 #include "image_preprocess.h"
-#include "tiny_yolo_weights.h"
-#include "yolo_layers.h"
+#include "tiny_yolo_model.h"
+#include "yolo_postprocess.h"
+#include "layers_q88.h"
+#include "layer_sched.h"
+#include "perf_profile.h"
 #include "test_image.h"
 
-/*******************************************************************************
- * ARM Global Timer @ 333 MHz
- ******************************************************************************/
-#define GLOBAL_TMR_BASE  0xF8F00200U
+/* 1: start and time each layer separately with the PL counters (setup, run,
+      cache, compute vs AXI stall), 0: one start for the whole network */
+#define PROFILE_LAYERS  0
 
-static unsigned int read_timer_lo(void) {
-    return Xil_In32(GLOBAL_TMR_BASE);
-}
+/* Continuous mode: frames pushed through the pre/PL/post pipeline (0 = off) */
+#define PIPELINE_FRAMES 16
 
-static void enable_timer(void) {
-    unsigned int ctrl = Xil_In32(GLOBAL_TMR_BASE + 0x08);
-    Xil_Out32(GLOBAL_TMR_BASE + 0x08, ctrl | 1U);
-}
+/* 1: check the PL output against the bit-exact Q8.8 ARM model (layers_q88.c,
+      exact sums on the ENGINE_WINOGRAD layers like the PL) */
+#define VERIFY_Q88      1
+
+/* 1: frames from the camera preprocessing IP (create_design.tcl: use_camera 1),
+      written by the PL straight into each slot's input map; 0: TEST_IMAGE
+      preprocessed on the ARM */
+#define LIVE_VIDEO      0
+#define CAMERA_WIDTH    640
+#define CAMERA_HEIGHT   480
 
-static unsigned int t_start_lo;
+/* 1: calibrate both targets at startup and place layers on the PL, the ARM
+   or both (layer_sched.c), 0: every layer on the PL */
+#define HETERO_SCHED    1
+
+/* 1: continuous mode lets the PL threshold and decode the head when it runs
+      the last layer, and the ARM finishes only the candidate list (Q8.8
+      bitstreams); 0: the ARM decodes the whole head map */
+#define PL_DECODE       1
+
+/*******************************************************************************
+ * Timing: 64-bit ARM global timer, microseconds (perf_profile.h)
+ ******************************************************************************/
+static uint64_t t_start;
 
 static void timer_start(void) {
-    t_start_lo = read_timer_lo();
+    t_start = perf_now();
 }
 
-static int timer_elapsed_ms(void) {
-    unsigned int t_end = read_timer_lo();
-    unsigned int diff = t_end - t_start_lo;
-    return (int)(diff / 333333U);
+static int timer_elapsed_us(void) {
+    return (int)perf_elapsed_us(t_start);
 }
 
 /*******************************************************************************
- * Helpers
+ * Interrupts: GIC drives the accelerator's ap_done callback
  ******************************************************************************/
-static float* alloc_buf(int size, const char* name) {
-    float* p = (float*)malloc(size * sizeof(float));
-    if (!p) {
-        xil_printf("FATAL: malloc %s failed\r\n", name);
-        while(1);
+static XScuGic gic;
+
+static int setup_gic(void) {
+    XScuGic_Config *cfg = XScuGic_LookupConfig(XPAR_SCUGIC_SINGLE_DEVICE_ID);
+    if (!cfg || XScuGic_CfgInitialize(&gic, cfg, cfg->CpuBaseAddress) != XST_SUCCESS) {
+        return -1;
     }
-    return p;
+
+    Xil_ExceptionInit();
+    Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
+                                 (Xil_ExceptionHandler)XScuGic_InterruptHandler, &gic);
+    Xil_ExceptionEnable();
+
+    return cnn_accel_setup_interrupt(&gic);
 }
 
-static void load_image(float* out) {
-    int ch, y, x;
-    for (ch = 0; ch < 3; ch++) {
-        for (y = 0; y < INPUT_SIZE; y++) {
-            for (x = 0; x < INPUT_SIZE; x++) {
-                int sy = y * IMG_HEIGHT / INPUT_SIZE;
-                int sx = x * IMG_WIDTH / INPUT_SIZE;
-                if (sy >= IMG_HEIGHT) sy = IMG_HEIGHT - 1;
-                if (sx >= IMG_WIDTH) sx = IMG_WIDTH - 1;
-                out[ch * INPUT_SIZE * INPUT_SIZE + y * INPUT_SIZE + x] =
-                    TEST_IMAGE[(sy * IMG_WIDTH + sx) * 3 + ch] / 255.0f;
-            }
-        }
-    }
+static volatile int cnn_done_us = -1;
+
+static void on_network_done(void *ref, int result) {
+    (void)ref;
+    cnn_done_us = (result == CNN_OK) ? timer_elapsed_us() : -1;
 }
 
 /*******************************************************************************
  * FPGA Layer Configurations
  ******************************************************************************/
+/* Large maps keep weights resident, small maps with big weights keep inputs resident */
+#define WS DATAFLOW_WEIGHT_STATIONARY
+#define IS DATAFLOW_INPUT_STATIONARY
+
+/* Large maps stream rows through the line buffer as Winograd F(2x2,3x3) tiles;
+   the small L4-L6 tail stays on chip between layers when run as one command list */
+#define WG ENGINE_WINOGRAD
+#define RS ENGINE_RESIDENT
+
 static LayerConfig fpga_layers[] = {
-    {1, 3,   16,  224, 224, 3, 1, 1},  /* L0: conv+bn+relu+pool */
-    {1, 16,  32,  112, 112, 3, 1, 1},  /* L1: conv+bn+relu+pool */
-    {1, 32,  64,   56,  56, 3, 1, 1},  /* L2: conv+bn+relu+pool */
-    {1, 64,  128,  28,  28, 3, 1, 1},  /* L3: conv+bn+relu+pool */
-    {1, 128, 256,  14,  14, 3, 1, 1},  /* L4: conv+bn+relu+pool */
-    {0, 256, 512,   7,   7, 3, 1, 1},  /* L5: conv+bn+relu      */
-    {2, 512,  24,   7,   7, 1, 1, 0},  /* L6: conv only (output) */
+    {1, 3,   16,  224, 224, 3, 1, 1, WS, WG, 1},  /* L0: conv+bn+relu+pool */
+    {1, 16,  32,  112, 112, 3, 1, 1, WS, WG, 1},  /* L1: conv+bn+relu+pool */
+    {1, 32,  64,   56,  56, 3, 1, 1, WS, WG, 1},  /* L2: conv+bn+relu+pool */
+    {1, 64,  128,  28,  28, 3, 1, 1, WS, WG, 1},  /* L3: conv+bn+relu+pool */
+    {1, 128, 256,  14,  14, 3, 1, 1, IS, RS, 1},  /* L4: conv+bn+relu+pool */
+    {0, 256, 512,   7,   7, 3, 1, 1, IS, RS, 1},  /* L5: conv+bn+relu      */
+    {2, 512,  24,   7,   7, 1, 1, 0, IS, RS, 1},  /* L6: conv only (output) */
 };
 
+#define NUM_FPGA_LAYERS (sizeof(fpga_layers) / sizeof(fpga_layers[0]))
+
+/* Feature-map placement in DDR, from buffer lifetimes (one plan per frame) */
+static BufferPlan fm_plan;
+
+/* Measured layer costs and the placement in use (all-PL without HETERO_SCHED) */
+static SchedCost sched_cost[NUM_FPGA_LAYERS];
+static SchedPlan sched;
+
+/* Descriptor table read by the IP (command-list mode) */
+static LayerDescriptor fpga_descs[NUM_FPGA_LAYERS] __attribute__((aligned(64)));
+
 static const char* layer_names[] = {
     "Conv  3->16  224x224 + BN + Pool",
     "Conv 16->32  112x112 + BN + Pool",
@@ -95,94 +137,520 @@ static const char* layer_names[] = {
     "Conv 512->24   7x7   (output)   ",
 };
 
+/*******************************************************************************
+ * Weights: Q8.8 blob from utils/pack_weights.py, read from the SD card
+ * (WEIGHT_BLOB_SD_Q88) or staged in DDR over JTAG; nothing is compiled in
+ ******************************************************************************/
+static WeightTable wtab;
+
+/* Conv bias of the head, which the PL leaves to the decoder: the blob's Q8.8
+   head shift, the precision the decoder applies it at */
+static float head_bias[NUM_ANCHORS * (5 + NUM_CLASSES)];
+
+static int blob_matches(void) {
+    int i, ok = wtab.num_layers == NUM_FPGA_LAYERS && wtab.dtype == WEIGHT_BLOB_DTYPE_Q88;
+
+    for (i = 0; ok && i < NUM_FPGA_LAYERS; i++) {
+        ok = wtab.layers[i].in_channels == fpga_layers[i].in_channels &&
+             wtab.layers[i].out_channels == fpga_layers[i].out_channels &&
+             wtab.layers[i].kernel_size == fpga_layers[i].kernel_size;
+    }
+    return ok;
+}
+
+static void load_weights(void) {
+    const int16_t* shift;
+    uint32_t wt_addr = DDR_WEIGHTS_ADDR;
+    uint32_t bn_off  = 0;
+    int i, ok = 0;
+
+    timer_start();
+#if WEIGHT_BLOB_USE_SD
+    ok = weight_blob_load_sd(WEIGHT_BLOB_SD_Q88, &wtab) == 0 && blob_matches();
+#endif
+    if (!ok) {
+        ok = weight_blob_load((const void*)DDR_WEIGHT_BLOB_ADDR, 0, &wtab) == 0 && blob_matches();
+    }
+    if (ok) {
+        shift = (const int16_t*)(UINTPTR)wtab.layers[NUM_FPGA_LAYERS - 1].bn_shift_addr;
+        for (i = 0; i < wtab.layers[NUM_FPGA_LAYERS - 1].out_channels; i++) {
+            head_bias[i] = q88_to_float(shift[i]);
+        }
+        xil_printf("    Weights loaded: " PERF_MS_FMT "\r\n", PERF_MS(timer_elapsed_us()));
+        return;
+    }
+
+    /* No usable blob: same packed layout, timing is valid but outputs are not */
+    xil_printf("    WARNING: no weight blob on SD or at 0x%08x, using unloaded layout\r\n",
+               DDR_WEIGHT_BLOB_ADDR);
+    wtab.num_layers = NUM_FPGA_LAYERS;
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        wtab.layers[i].in_channels = fpga_layers[i].in_channels;
+        wtab.layers[i].out_channels = fpga_layers[i].out_channels;
+        wtab.layers[i].kernel_size = fpga_layers[i].kernel_size;
+        wtab.layers[i].weights_addr = wt_addr;
+        wtab.layers[i].bn_scale_addr = DDR_BN_SCALE_ADDR + bn_off;
+        wtab.layers[i].bn_shift_addr = DDR_BN_SHIFT_ADDR + bn_off;
+
+        wt_addr += DDR_ALIGN8(fpga_layers[i].in_channels * fpga_layers[i].out_channels *
+                              fpga_layers[i].kernel_size * fpga_layers[i].kernel_size * 2);
+        bn_off += DDR_ALIGN8(fpga_layers[i].out_channels * 2);
+    }
+}
+
+/*******************************************************************************
+ * Frame Pipeline
+ * Three DDR slots rotate through: while the PL runs frame N from its slot the
+ * ARM preprocesses frame N+1 into the next slot (LIVE_VIDEO: starts the
+ * camera IP on it) and decodes frame N-1 from the previous one. Each slot is one planned feature-map arena with its own
+ * descriptor table, so no stage ever touches a buffer another stage is
+ * using; the slots sit back to back at DDR_FM_ARENA_ADDR.
+ ******************************************************************************/
+#define NUM_FRAME_SLOTS   3
+
+#define OUT_CH     (NUM_ANCHORS * (5 + NUM_CLASSES))
+#define OUT_GRID   7
+#define OUT_PITCH  FM_PITCH(OUT_GRID)
+
+typedef struct {
+    uint32_t base;                /* Arena of this slot (fm_plan.total_bytes) */
+    uint32_t input;               /* Frame input map */
+    uint32_t result;              /* Final layer output */
+    uint64_t t_start;             /* Timer at start of preprocessing */
+    int num_cands;                /* PL decode: candidates found, -1 if the head was not decoded */
+    LayerDescriptor descs[NUM_FPGA_LAYERS] __attribute__((aligned(64)));
+    YoloHwCandidate cands[CNN_DECODE_MAX_CANDS] __attribute__((aligned(64)));
+} FrameSlot;
+
+static FrameSlot frame_slots[NUM_FRAME_SLOTS];
+static DetectionResult frame_dets;
+
+/* Decoder generated from the model config in tiny_yolo_model.h */
+static const char* const class_names[NUM_CLASSES] = {"person", "vehicle", "animal"};
+
+static const YoloModelConfig yolo_model = {
+    OUT_GRID, OUT_GRID, NUM_ANCHORS, NUM_CLASSES, ANCHORS, YOLO_ANCHORS_PIXELS,
+    INPUT_SIZE, INPUT_SIZE, YOLO_CLASS_SIGMOID, class_names
+};
+
+static YoloDecoder yolo_dec;
+
+/* PL decode parameters from yolo_dec, shared by the slots (0: ready) */
+static int32_t decode_params[CNN_DECODE_PARAM_WORDS] __attribute__((aligned(64)));
+static int decode_params_rc = -1;
+
+static void setup_frame_slot(FrameSlot* s, int k) {
+    int i;
+
+    s->base = DDR_FM_ARENA_ADDR + k * fm_plan.total_bytes;
+    s->input = s->base + PLAN_INPUT(&fm_plan, 0);
+    s->result = s->base + PLAN_OUTPUT(&fm_plan, NUM_FPGA_LAYERS - 1);
+
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        cnn_accel_fill_descriptor(&s->descs[i], &fpga_layers[i],
+                                  s->base + PLAN_INPUT(&fm_plan, i),
+                                  s->base + PLAN_OUTPUT(&fm_plan, i),
+                                  wtab.layers[i].weights_addr, wtab.layers[i].bn_scale_addr);
+    }
+
+    /* The head is decoded where it is computed: only when its PL stretch ends the network */
+    s->num_cands = -1;
+    s->descs[NUM_FPGA_LAYERS - 1].decode = PL_DECODE && decode_params_rc == 0 &&
+                                           sched.head_end == NUM_FPGA_LAYERS &&
+                                           sched.target[NUM_FPGA_LAYERS - 1] == SCHED_PL;
+}
+
+/* Stage 1: resize + Q8.8 straight into the slot (224 is already pitched), on
+   the ARM or, with LIVE_VIDEO, by the camera IP while the ARM moves on */
+static void preprocess_frame(FrameSlot* s) {
+    s->t_start = perf_now();
+#if LIVE_VIDEO
+    camera_ingest_start(s->input);
+#else
+    preprocess_image(TEST_IMAGE, IMG_WIDTH, IMG_HEIGHT, (fixed16_t*)(UINTPTR)s->input);
+#endif
+}
+
+/* The slot's input map is complete (the ARM's own preprocessing already is) */
+static int frame_input_ready(void) {
+#if LIVE_VIDEO
+    return camera_ingest_wait();
+#else
+    return CNN_OK;
+#endif
+}
+
+/* ARM stage 3: decode + NMS on the pitched Q8.8 head as the PL wrote it (the
+   decoder folds in the conv bias the PL does not apply), or only confidence
+   + NMS on the PL's candidate list, returns detections */
+static int postprocess_frame(const FrameSlot* s) {
+    if (s->num_cands >= 0) {
+        yolo_postprocess_candidates(&yolo_dec, s->cands, s->num_cands, CNN_DECODE_MAX_CANDS,
+                                    &frame_dets);
+    } else {
+        yolo_postprocess(&yolo_dec, (const fixed16_t*)(UINTPTR)s->result, OUT_PITCH, &frame_dets);
+    }
+    return frame_dets.count;
+}
+
+/* ARM side of one pipeline step, run while the PL works on the current frame */
+typedef struct {
+    FrameSlot* next;              /* Frame f+1: preprocess (NULL at the end) */
+    FrameSlot* prev;              /* Frame f-1: ARM tail layers + decode (NULL at the start) */
+    int rc;
+    int dets;
+    unsigned int lat_us;
+} PipelineStep;
+
+static void pipeline_arm_stage(void* ref) {
+    PipelineStep* st = (PipelineStep*)ref;
+
+    if (st->next) {
+        preprocess_frame(st->next);
+    }
+    if (st->prev) {
+        st->rc = sched_run(&sched, st->prev->descs, sched.head_end, NUM_FPGA_LAYERS, NULL, NULL);
+        st->dets = postprocess_frame(st->prev);
+        st->lat_us = perf_elapsed_us(st->prev->t_start);
+    }
+}
+
+static void run_pipeline(int num_frames) {
+    uint64_t t_prev, t_now, steady_ticks = 0;
+    unsigned int t_first_done = 0, steady_us;
+    unsigned int lat_min = ~0U, lat_max = 0;
+    unsigned long long lat_sum = 0;
+    int f, k, rc, dets = 0;
+    PipelineStep st;
+
+    for (k = 0; k < NUM_FRAME_SLOTS; k++) {
+        setup_frame_slot(&frame_slots[k], k);
+    }
+
+    preprocess_frame(&frame_slots[0]);
+    t_prev = perf_now();
+
+    for (f = 0; f <= num_frames; f++) {
+        FrameSlot* cur  = &frame_slots[f % NUM_FRAME_SLOTS];
+
+        st.next = (f + 1 < num_frames) ? &frame_slots[(f + 1) % NUM_FRAME_SLOTS] : NULL;
+        st.prev = (f > 0) ? &frame_slots[(f + NUM_FRAME_SLOTS - 1) % NUM_FRAME_SLOTS] : NULL;
+        st.rc = CNN_OK;
+
+        /* PL: frame f up to its ARM tail; the ARM stage runs beside it:
+           frame f+1 in, frame f-1's tail layers and decode out */
+        rc = CNN_OK;
+        if (f < num_frames) {
+            rc = frame_input_ready();
+            if (rc == CNN_OK) {
+                if (cur->descs[NUM_FPGA_LAYERS - 1].decode) {
+                    cnn_accel_set_decode((uint32_t)(UINTPTR)decode_params,
+                                         (uint32_t)(UINTPTR)cur->cands, CNN_DECODE_MAX_CANDS);
+                }
+                rc = sched_run(&sched, cur->descs, 0, sched.head_end, pipeline_arm_stage, &st);
+                if (cur->descs[NUM_FPGA_LAYERS - 1].decode) {
+                    cur->num_cands = (int)cnn_accel_num_candidates();
+                }
+            }
+        } else {
+            pipeline_arm_stage(&st);
+        }
+        if (rc != CNN_OK || st.rc != CNN_OK) {
+            xil_printf("    Frame %d: scheduler error %d\r\n", f, rc != CNN_OK ? rc : st.rc);
+            return;
+        }
+        if (st.prev) {
+            dets = st.dets;
+            lat_sum += st.lat_us;
+            if (st.lat_us < lat_min) lat_min = st.lat_us;
+            if (st.lat_us > lat_max) lat_max = st.lat_us;
+        }
+
+        /* Steady state: one frame retired per iteration after the first */
+        t_now = perf_now();
+        if (f > 0) {
+            steady_ticks += t_now - t_prev;
+        } else {
+            t_first_done = perf_ticks_to_us(t_now - frame_slots[0].t_start);
+        }
+        t_prev = t_now;
+    }
+
+    xil_printf("    Frames: %d (%d slots), last frame %d detections\r\n",
+               num_frames, NUM_FRAME_SLOTS, dets);
+    xil_printf("    Fill (first frame through PL): " PERF_MS_FMT "\r\n", PERF_MS(t_first_done));
+    xil_printf("    Latency per frame: avg " PERF_MS_FMT ", min " PERF_MS_FMT ", max " PERF_MS_FMT "\r\n",
+               PERF_MS((unsigned int)(lat_sum / num_frames)), PERF_MS(lat_min), PERF_MS(lat_max));
+    steady_us = perf_ticks_to_us(steady_ticks);
+    if (num_frames > 1 && steady_us > 0) {
+        /* num_frames iterations after the first retire num_frames frames */
+        unsigned int fps_x100 = (unsigned int)(100000000ULL * num_frames / steady_us);
+        xil_printf("    Steady-state throughput: %d.%02d FPS\r\n",
+                   fps_x100 / 100, fps_x100 % 100);
+    }
+}
+
+/*******************************************************************************
+ * Golden Check: replay the network on the ARM in Q8.8 and compare with the
+ * PL's final map value for value (same input, weights and BN arrays in DDR).
+ * q88_run_layer() follows each layer's engine, so saturating frames match too
+ ******************************************************************************/
+static void verify_q88(uint8_t* arena, uint32_t result_addr) {
+    const fixed16_t* hw = (const fixed16_t*)(UINTPTR)result_addr;
+    const fixed16_t* sw = (const fixed16_t*)(arena + PLAN_OUTPUT(&fm_plan, NUM_FPGA_LAYERS - 1));
+    int i, c, y, x, diff, mismatches = 0, max_diff = 0;
+
+    xil_printf("\r\n[2b] Verifying against the Q8.8 ARM model...\r\n");
+
+    /* Same plan as the PL's DDR maps, in a heap arena whose input is a copy */
+    timer_start();
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        const WeightLayerAddr* w = &wtab.layers[i];
+
+        if (q88_run_layer(&fpga_layers[i],
+                          (const int16_t*)(arena + PLAN_INPUT(&fm_plan, i)),
+                          (int16_t*)(arena + PLAN_OUTPUT(&fm_plan, i)),
+                          (const int16_t*)(UINTPTR)w->weights_addr,
+                          (const int16_t*)(UINTPTR)w->bn_scale_addr,
+                          (const int16_t*)(UINTPTR)w->bn_shift_addr) != 0) {
+            xil_printf("    Skipped: out of memory in L%d\r\n", i);
+            return;
+        }
+    }
+
+    for (c = 0; c < OUT_CH; c++) {
+        for (y = 0; y < OUT_GRID; y++) {
+            for (x = 0; x < OUT_GRID; x++) {
+                int idx = (c * OUT_GRID + y) * OUT_PITCH + x;
+                diff = hw[idx] - sw[idx];
+                if (diff < 0) diff = -diff;
+                if (diff) mismatches++;
+                if (diff > max_diff) max_diff = diff;
+            }
+        }
+    }
+
+    xil_printf("    ARM Q8.8 model: " PERF_MS_FMT "\r\n", PERF_MS(timer_elapsed_us()));
+    xil_printf("    %s: %d of %d outputs differ (max %d LSB)\r\n",
+               mismatches ? "MISMATCH" : "Bit-exact", mismatches,
+               OUT_CH * OUT_GRID * OUT_GRID, max_diff);
+}
+
 /*******************************************************************************
  * Main - FPGA PL Accelerated Inference
  ******************************************************************************/
 int main(void) {
-    int i, layer_ms, total_ms = 0, prepost_ms = 0;
-    float* input;
+    int i, total_us = 0, prepost_us = 0, post_us;
+#if !PROFILE_LAYERS && !HETERO_SCHED
+    int polls = 0;
+#endif
+    uint32_t input_addr, result_addr;
+#if PROFILE_LAYERS
+    PerfLayer perf[NUM_FPGA_LAYERS];
+#endif
+#if VERIFY_Q88
+    uint8_t* golden;
+#endif
 
-    Xil_DCacheFlush();
-    enable_timer();
+    perf_init();
 
     xil_printf("\r\n\r\n");
     xil_printf("==============================================\r\n");
     xil_printf("  STEP 2: FPGA PL Accelerated CNN Inference\r\n");
     xil_printf("  Zedboard Zynq-7020\r\n");
     xil_printf("  Conv layers: FPGA PL (HLS IP @ 100 MHz)\r\n");
+#if LIVE_VIDEO
+    xil_printf("  Pre-processing: camera IP (PL), post: ARM Cortex-A9\r\n");
+#else
     xil_printf("  Pre/Post processing: ARM Cortex-A9\r\n");
+#endif
     xil_printf("  Architecture: 3->16->32->64->128->256->512->24\r\n");
     xil_printf("==============================================\r\n\r\n");
 
     cnn_accel_init();
+    if (setup_gic() != 0) {
+        xil_printf("GIC setup failed, falling back to polling\r\n");
+    }
+    load_weights();
+#if LIVE_VIDEO
+    if (camera_ingest_init(CAMERA_WIDTH, CAMERA_HEIGHT, INPUT_SIZE, INPUT_SIZE) != 0) {
+        xil_printf("Camera IP not available\r\n");
+        while(1);
+    }
+#endif
+    yolo_decoder_init(&yolo_dec, &yolo_model, head_bias, CONFIDENCE_THRESHOLD, NMS_THRESHOLD);
+#if PL_DECODE
+    decode_params_rc = yolo_decoder_hw_params(&yolo_dec, decode_params, CNN_DECODE_MAX_CANDS);
+#endif
+    buffer_plan_network(fpga_layers, NUM_FPGA_LAYERS, sizeof(fixed16_t), PLAN_PITCHED, &fm_plan);
+    input_addr = DDR_FM_ARENA_ADDR + PLAN_INPUT(&fm_plan, 0);
+    result_addr = DDR_FM_ARENA_ADDR + PLAN_OUTPUT(&fm_plan, NUM_FPGA_LAYERS - 1);
+    xil_printf("Feature-map arena: %d KB per frame (planned peak)\r\n\r\n",
+               (int)(fm_plan.total_bytes / 1024));
+
+    /* Layer placement: time each layer on both targets in frame slot 0 (the
+       single-frame buffers), before the real input is written there */
+    setup_frame_slot(&frame_slots[0], 0);
+#if HETERO_SCHED
+    xil_printf("[0] Calibrating PL and ARM layer costs...\r\n");
+    if (sched_calibrate(frame_slots[0].descs, NUM_FPGA_LAYERS, sched_cost) != CNN_OK) {
+        xil_printf("    Calibration failed\r\n");
+        while(1);
+    }
+#endif
 
+#if LIVE_VIDEO
+    /* One camera frame, resized and converted by the PL into the input map */
+    xil_printf("[1] Capturing a frame through the camera IP...\r\n");
+    timer_start();
+    if (camera_ingest_start(input_addr) != CNN_OK || camera_ingest_wait() != CNN_OK) {
+        xil_printf("    No camera frame\r\n");
+        while(1);
+    }
+    xil_printf("    Frame captured: " PERF_MS_FMT " (%d pixels before start of frame)\r\n\r\n",
+               PERF_MS(timer_elapsed_us()), (int)camera_ingest_dropped());
+#else
     /* Pre-processing on ARM */
     xil_printf("[1] Pre-processing on ARM...\r\n");
     timer_start();
-    input = alloc_buf(3 * INPUT_SIZE * INPUT_SIZE, "input");
-    load_image(input);
+    /* Resize + Q8.8 straight into the PL's input map (224 is already pitched) */
+    preprocess_image(TEST_IMAGE, IMG_WIDTH, IMG_HEIGHT, (fixed16_t*)(UINTPTR)input_addr);
+    prepost_us = timer_elapsed_us();
+    xil_printf("    Image loaded & preprocessed: " PERF_MS_FMT "\r\n\r\n", PERF_MS(prepost_us));
+#endif
 
-    /* Copy input to DDR region for FPGA access */
-    Xil_DCacheFlush();
-    prepost_ms = timer_elapsed_ms();
-    xil_printf("    Image loaded & preprocessed: %d ms\r\n\r\n", prepost_ms);
+    sched_plan(HETERO_SCHED ? sched_cost : NULL, frame_slots[0].descs, NUM_FPGA_LAYERS,
+               SCHED_LATENCY, 0, &sched);
 
-    free(input);
+#if VERIFY_Q88
+    /* The planner reuses the input's bytes after L0: copy it for the ARM model */
+    golden = (uint8_t*)memalign(PLAN_ALIGN, fm_plan.total_bytes);
+    if (golden) {
+        memcpy(golden + PLAN_INPUT(&fm_plan, 0), (const void*)(UINTPTR)input_addr,
+               3 * INPUT_SIZE * FM_PITCH(INPUT_SIZE) * sizeof(fixed16_t));
+    }
+#endif
 
     /* CNN layers on FPGA PL */
     xil_printf("[2] Running CNN on FPGA PL block...\r\n");
     xil_printf("    (HLS accelerator @ 100 MHz, 220 DSP slices)\r\n\r\n");
 
-    uint32_t in_addr  = DDR_INPUT_FM_ADDR;
-    uint32_t out_addr = DDR_OUTPUT_FM_ADDR;
-    uint32_t wt_addr  = DDR_WEIGHTS_ADDR;
-    uint32_t bn_s     = DDR_BN_SCALE_ADDR;
-    uint32_t bn_h     = DDR_BN_SHIFT_ADDR;
-
-    for (i = 0; i < 7; i++) {
-        int wt_size = fpga_layers[i].in_channels *
-                      fpga_layers[i].out_channels *
-                      fpga_layers[i].kernel_size *
-                      fpga_layers[i].kernel_size * 2;
-        int bn_size = fpga_layers[i].out_channels * 2;
+    /* Build the command list: planned feature maps, packed weights/BN */
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        const WeightLayerAddr* w = &wtab.layers[i];
+        uint32_t in_addr  = DDR_FM_ARENA_ADDR + PLAN_INPUT(&fm_plan, i);
+        uint32_t out_addr = DDR_FM_ARENA_ADDR + PLAN_OUTPUT(&fm_plan, i);
 
+        cnn_accel_fill_descriptor(&fpga_descs[i], &fpga_layers[i],
+                                  in_addr, out_addr, w->weights_addr, w->bn_scale_addr);
+#if PROFILE_LAYERS
         timer_start();
-        cnn_accel_run_layer(&fpga_layers[i],
-                            in_addr, out_addr,
-                            wt_addr, bn_s, bn_h);
-        layer_ms = timer_elapsed_ms();
-        total_ms += layer_ms;
+        if (cnn_accel_run_layer(&fpga_layers[i],
+                                in_addr, out_addr, w->weights_addr,
+                                w->bn_scale_addr, w->bn_shift_addr) != CNN_OK) {
+            xil_printf("    L%d: accelerator timeout\r\n", i);
+            while(1);
+        }
+        total_us += timer_elapsed_us();
+        perf_capture(&perf[i]);
 
-        xil_printf("    L%d: %s  %d ms\r\n", i, layer_names[i], layer_ms);
+        xil_printf("    L%d: %s  " PERF_MS_FMT "\r\n", i, layer_names[i],
+                   PERF_MS(perf[i].setup_us + perf[i].run_us + perf[i].cache_us));
+#endif
+    }
 
-        wt_addr += wt_size;
-        bn_s += bn_size;
-        bn_h += bn_size;
+#if PROFILE_LAYERS
+    /* Where each layer's time goes: ARM setup/cache vs PL, and on the PL
+       MAC array cycles vs cycles its read / write ports moved no data */
+    xil_printf("\r\n");
+    perf_print_header();
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        perf_print_layer(i, &perf[i]);
+    }
+#endif
 
-        /* Swap buffers */
-        uint32_t tmp = in_addr;
-        in_addr = out_addr;
-        out_addr = tmp;
+#if !PROFILE_LAYERS && HETERO_SCHED
+    /* Calibrated placement: PL stretches as command lists, split layers on both */
+    sched_print_plan(&sched);
+    timer_start();
+    if (sched_run(&sched, fpga_descs, 0, NUM_FPGA_LAYERS, NULL, NULL) != CNN_OK) {
+        xil_printf("    Scheduler error\r\n");
+        while(1);
+    }
+    total_us = timer_elapsed_us();
+
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        xil_printf("    L%d: %s\r\n", i, layer_names[i]);
+    }
+    xil_printf("    All layers (scheduled): " PERF_MS_FMT "\r\n", PERF_MS(total_us));
+#elif !PROFILE_LAYERS
+    /* Whole network with one start: the IP walks the descriptor table */
+    timer_start();
+    if (cnn_accel_submit_network(fpga_descs, NUM_FPGA_LAYERS,
+                                 on_network_done, NULL) != CNN_OK) {
+        xil_printf("    Accelerator busy\r\n");
+        while(1);
+    }
+
+    /* The ARM is free until the callback fires: frame work can go here */
+    while (cnn_accel_poll() == CNN_PENDING) {
+        polls++;
+    }
+    if (cnn_done_us < 0) {
+        xil_printf("    Accelerator timeout\r\n");
+        while(1);
+    }
+    total_us = cnn_done_us;
+    xil_printf("    ARM idle polls while PL busy: %d\r\n", polls);
+
+    for (i = 0; i < NUM_FPGA_LAYERS; i++) {
+        xil_printf("    L%d: %s\r\n", i, layer_names[i]);
+    }
+    xil_printf("    All layers (one start): " PERF_MS_FMT "\r\n", PERF_MS(total_us));
+#endif
+
+#if VERIFY_Q88
+    if (golden) {
+        verify_q88(golden, result_addr);
+        free(golden);
+    } else {
+        xil_printf("\r\n[2b] Q8.8 check skipped: out of memory\r\n");
     }
+#endif
 
     /* Post-processing on ARM */
     xil_printf("\r\n[3] Post-processing on ARM...\r\n");
     timer_start();
-    /* Post-processing would go here (decode, NMS, etc.) */
-    int post_ms = timer_elapsed_ms();
-    prepost_ms += post_ms;
-    xil_printf("    Post-processing: %d ms\r\n\r\n", post_ms);
+    /* Output is 24 x 7 x FM_PITCH(7): decoded in place, [c][y][x] with row pitch 8 */
+    yolo_postprocess(&yolo_dec, (const fixed16_t*)(UINTPTR)result_addr, OUT_PITCH, &frame_dets);
+    post_us = timer_elapsed_us();
+    prepost_us += post_us;
+    xil_printf("    Decode + NMS: %d detections, " PERF_MS_FMT "\r\n", frame_dets.count, PERF_MS(post_us));
+    yolo_print_detections(&yolo_dec, &frame_dets);
+    xil_printf("\r\n");
 
     xil_printf("==============================================\r\n");
-    xil_printf("  FPGA PL Total (CNN layers): %d ms\r\n", total_ms);
-    xil_printf("  ARM Total (pre+post):       %d ms\r\n", prepost_ms);
-    xil_printf("  Overall Total:              %d ms\r\n", total_ms + prepost_ms);
+    xil_printf("  FPGA PL Total (CNN layers): " PERF_MS_FMT "\r\n", PERF_MS(total_us));
+    xil_printf("  ARM Total (pre+post):       " PERF_MS_FMT "\r\n", PERF_MS(prepost_us));
+    xil_printf("  Overall Total:              " PERF_MS_FMT "\r\n", PERF_MS(total_us + prepost_us));
     xil_printf("  FPGA clock:  100 MHz (PL fabric)\r\n");
     xil_printf("  DSP slices:  220\r\n");
-    xil_printf("  Parallelism: 8 MACs/cycle\r\n");
+    xil_printf("  Parallelism: 8x8 = 64 MACs/cycle\r\n");
     xil_printf("==============================================\r\n");
     xil_printf("\r\nCompare with STEP 1 ARM-only results.\r\n");
 
+#if PIPELINE_FRAMES > 0
+    /* Continuous mode: pre(N+1) || PL(N) || post(N-1); trailing ARM
+       layers of N-1 move into the post stage when that evens out the sides */
+    xil_printf("\r\n[4] Continuous mode: pipelined frames...\r\n");
+    sched_plan(HETERO_SCHED ? sched_cost : NULL, frame_slots[0].descs, NUM_FPGA_LAYERS,
+               SCHED_THROUGHPUT, (uint32_t)prepost_us, &sched);
+#if HETERO_SCHED
+    sched_print_plan(&sched);
+#endif
+    run_pipeline(PIPELINE_FRAMES);
+#endif
+
     while(1);
     return 0;
 }
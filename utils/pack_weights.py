@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""Pack tiny_yolo_weights.h into a weight blob for the FPGA accelerator or the ARM
+
+Default (Q8.8, for the PL and layers_q88.c): folds BatchNorm into per-channel
+scale/shift (or into the weights with --fold), quantises to Q8.8 with the IP's
+rounding/saturation (AP_RND, AP_SAT) and lays the weights out exactly as the
+HLS load path reads them:
+
+  [OC][KH][KW][IC], each layer starting on a 64-bit word
+
+so every weight fetch of an output channel tap is one contiguous burst.
+
+--f32 (for the ARM float network): BN folded into float32 weights and bias in
+the conv2d / conv_neon layout [OC][IC][KH][KW], computed op by op in float32
+exactly as fold_batchnorm() in yolo_layers.h, so the kernels read the blob in
+place and match the build with the weights compiled in.
+
+The blob is loaded by sw/common/weight_loader.c (see WeightBlobHeader there),
+from DDR after dow -data or from the SD card.
+
+Usage: pack_weights.py [weights.h] [weights.bin] [--fold | --f32]
+"""
+import math
+import re
+import struct
+import sys
+
+MAGIC = 0x574E4E43          # "CNNW"
+VERSION = 2
+FLAG_BN_FOLDED = 1 << 0
+DTYPE_Q88 = 0
+DTYPE_F32 = 1
+BN_EPS = 1e-5               # Same as batchnorm_leaky() in yolo_layers.h
+HEADER_WORDS = 16           # 64-byte header
+LAYER_WORDS = 8             # 32 bytes per layer entry
+
+
+def parse_header(path):
+    """Return {name: [floats]} for every static const float array"""
+    with open(path) as f:
+        text = f.read()
+    arrays = {}
+    for m in re.finditer(r"static const float (\w+)\[(\d+)\]\s*=\s*\{(.*?)\};", text, re.S):
+        vals = [float(v.strip().rstrip("f")) for v in m.group(3).split(",") if v.strip()]
+        if len(vals) != int(m.group(2)):
+            raise ValueError(f"{m.group(1)}: expected {m.group(2)} values, got {len(vals)}")
+        arrays[m.group(1)] = vals
+    return arrays
+
+
+def to_q88(x):
+    """ap_fixed<16,8,AP_RND,AP_SAT>: round half up, saturate"""
+    q = int(math.floor(x * 256.0 + 0.5))
+    return max(-32768, min(32767, q))
+
+
+def align8(n):
+    return (n + 7) & ~7
+
+
+def f32(x):
+    """Round to float32, i.e. one single-precision operation on the ARM"""
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+
+def fast_sqrtf(x):
+    """fast_sqrtf() in yolo_layers.h: five Newton steps from x / 2"""
+    if x <= 0.0:
+        return f32(0.0001)
+    guess = f32(x * 0.5)
+    if guess < f32(0.0001):
+        guess = f32(0.0001)
+    for _ in range(5):
+        guess = f32(0.5 * f32(guess + f32(x / guess)))
+    return guess
+
+
+def pack_layers_f32(arrays):
+    """fold_batchnorm() in yolo_layers.h, weights kept in [OC][IC][KH][KW]"""
+    layers = []
+    in_ch = 3
+    eps = f32(1e-5)
+    n = 0
+    while f"CONV{n}_W" in arrays:
+        w = [f32(v) for v in arrays[f"CONV{n}_W"]]
+        if f"BN{n}_GAMMA" in arrays:
+            gamma = [f32(v) for v in arrays[f"BN{n}_GAMMA"]]
+            beta = [f32(v) for v in arrays[f"BN{n}_BETA"]]
+            mean = [f32(v) for v in arrays[f"BN{n}_MEAN"]]
+            var = [f32(v) for v in arrays[f"BN{n}_VAR"]]
+            out_ch = len(gamma)
+            filt = len(w) // out_ch
+            weights, bias = [], []
+            for c in range(out_ch):
+                scale = f32(gamma[c] / fast_sqrtf(f32(var[c] + eps)))
+                weights += [f32(v * scale) for v in w[c * filt:(c + 1) * filt]]
+                bias.append(f32(beta[c] - f32(mean[c] * scale)))
+        else:
+            bias = [f32(v) for v in arrays[f"CONV{n}_B"]]
+            out_ch = len(bias)
+            weights = w
+
+        k = int(round(math.sqrt(len(w) / (out_ch * in_ch))))
+        if out_ch * in_ch * k * k != len(w):
+            raise ValueError(f"CONV{n}_W: {len(w)} values do not match {out_ch}x{in_ch}xKxK")
+
+        layers.append({
+            "in_ch": in_ch, "out_ch": out_ch, "k": k,
+            "weights": weights,
+            "scale": [1.0] * out_ch,
+            "shift": bias,
+        })
+        in_ch = out_ch
+        n += 1
+    return layers
+
+
+def pack_layers(arrays, fold):
+    layers = []
+    in_ch = 3
+    n = 0
+    while f"CONV{n}_W" in arrays:
+        w = arrays[f"CONV{n}_W"]
+        if f"BN{n}_GAMMA" in arrays:
+            gamma, beta = arrays[f"BN{n}_GAMMA"], arrays[f"BN{n}_BETA"]
+            mean, var = arrays[f"BN{n}_MEAN"], arrays[f"BN{n}_VAR"]
+            out_ch = len(gamma)
+            scale = [g / math.sqrt(v + BN_EPS) for g, v in zip(gamma, var)]
+            shift = [b - m * s for b, m, s in zip(beta, mean, scale)]
+        else:
+            # Output head: the IP uses scale 1 / shift 0 here and never reads
+            # these; the bias is added on the ARM after unpitching the head
+            shift = arrays[f"CONV{n}_B"]
+            out_ch = len(shift)
+            scale = [1.0] * out_ch
+
+        k = int(round(math.sqrt(len(w) / (out_ch * in_ch))))
+        if out_ch * in_ch * k * k != len(w):
+            raise ValueError(f"CONV{n}_W: {len(w)} values do not match {out_ch}x{in_ch}xKxK")
+
+        # Source is [OC][IC][KH][KW] (conv2d in yolo_layers.h)
+        packed = []
+        for oc in range(out_ch):
+            s = scale[oc] if fold else 1.0
+            for kh in range(k):
+                for kw in range(k):
+                    for ic in range(in_ch):
+                        packed.append(to_q88(w[((oc * in_ch + ic) * k + kh) * k + kw] * s))
+        if fold:
+            scale = [1.0] * out_ch
+
+        layers.append({
+            "in_ch": in_ch, "out_ch": out_ch, "k": k,
+            "weights": packed,
+            "scale": [to_q88(v) for v in scale],
+            "shift": [to_q88(v) for v in shift],
+        })
+        in_ch = out_ch
+        n += 1
+    return layers
+
+
+def section(values, dtype):
+    """Q8.8 values as little-endian int16 or floats as float32, padded to a 64-bit word"""
+    fmt = "f" if dtype == DTYPE_F32 else "h"
+    data = struct.pack(f"<{len(values)}{fmt}", *values)
+    return data + b"\0" * (align8(len(data)) - len(data))
+
+
+def build_blob(layers, fold, dtype):
+    weights, scale, shift, entries = b"", b"", b"", []
+    elem = 4 if dtype == DTYPE_F32 else 2
+    for l in layers:
+        entries.append((l["in_ch"], l["out_ch"], l["k"],
+                        len(weights), len(l["weights"]) * elem,
+                        len(scale), l["out_ch"], 0))
+        weights += section(l["weights"], dtype)
+        scale += section(l["scale"], dtype)
+        shift += section(l["shift"], dtype)
+
+    weights_start = align8((HEADER_WORDS + LAYER_WORDS * len(layers)) * 4)
+    scale_start = weights_start + len(weights)
+    shift_start = scale_start + len(scale)
+    payload = weights + scale + shift
+    checksum = sum(struct.unpack(f"<{len(payload) // 4}I", payload)) & 0xFFFFFFFF
+
+    header = struct.pack("<16I", MAGIC, VERSION, len(layers), FLAG_BN_FOLDED if fold else 0,
+                         weights_start, len(weights), scale_start, shift_start, len(scale),
+                         checksum, dtype, 0, 0, 0, 0, 0)
+    table = b"".join(struct.pack("<8I", *e) for e in entries)
+    head = header + table
+    return head + b"\0" * (weights_start - len(head)) + payload
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    dtype = DTYPE_F32 if "--f32" in sys.argv else DTYPE_Q88
+    fold = "--fold" in sys.argv or dtype == DTYPE_F32
+    src = args[0] if len(args) > 0 else "sw/common/tiny_yolo_weights.h"
+    out = args[1] if len(args) > 1 else ("weights_f32.bin" if dtype == DTYPE_F32 else "weights.bin")
+
+    arrays = parse_header(src)
+    layers = pack_layers_f32(arrays) if dtype == DTYPE_F32 else pack_layers(arrays, fold)
+    blob = build_blob(layers, fold, dtype)
+    with open(out, "wb") as f:
+        f.write(blob)
+
+    elem = 4 if dtype == DTYPE_F32 else 2
+    print(f"Packed {len(layers)} layers from {src} -> {out} ({len(blob)} bytes)")
+    for i, l in enumerate(layers):
+        sat = 0 if dtype == DTYPE_F32 else sum(1 for v in l["weights"] if v in (-32768, 32767))
+        print(f"  L{i}: {l['in_ch']:3d}->{l['out_ch']:3d} {l['k']}x{l['k']}  "
+              f"{len(l['weights']) * elem:8d} bytes  saturated {sat}")
+    print(f"BN {'folded into weights' if fold else 'as scale/shift'}, "
+          f"{'float32' if dtype == DTYPE_F32 else 'Q8.8'}")
+
+
+if __name__ == "__main__":
+    main()